@@ -0,0 +1,149 @@
+#pragma once
+
+#ifndef __CAPTURE_ARCHIVE_H__
+#define __CAPTURE_ARCHIVE_H__
+
+#include <QByteArray>
+#include <QFile>
+#include <QFuture>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+
+// Archive layout (little-endian):
+//   header  : "DSCA" | u16 version | u16 flags | u32 blockSize | u32 reserved
+//   blocks  : qCompress() output, back to back, each block independent
+//   index   : per block u64 fileOffset | u64 rawOffset | u32 compressedSize | u32 rawSize
+//   trailer : u64 indexOffset | u64 rawSize | u32 blockCount | "DSCI"
+// The index lives at the end so the writer can stream; readers seek to the trailer first.
+
+struct CaptureArchiveBlock
+{
+    qint64 fileOffset = 0;
+    qint64 rawOffset = 0;
+    qint32 compressedSize = 0;
+    qint32 rawSize = 0;
+};
+
+struct CaptureArchiveStats
+{
+    qint64 rawBytes = 0;
+    qint64 archiveBytes = 0;
+    int blockCount = 0;
+    qint64 elapsedNs = 0;
+
+    double ratio() const;
+    double throughputMBps() const;
+};
+
+class CaptureArchiveWriter
+{
+public:
+    static constexpr int kDefaultBlockSize = 1 << 20;
+    static constexpr int kDefaultCompressionLevel = 6;
+
+private:
+    struct PendingBlock
+    {
+        qint64 rawOffset = 0;
+        qint32 rawSize = 0;
+        QFuture<QByteArray> compressed;
+    };
+
+    QFile m_file;
+    int m_blockSize = kDefaultBlockSize;
+    int m_compressionLevel = kDefaultCompressionLevel;
+    int m_maxInFlight = 1;
+    QByteArray m_currentBlock;
+    qint64 m_rawOffset = 0;
+    QList<PendingBlock> m_pending;
+    QList<CaptureArchiveBlock> m_index;
+    bool m_failed = false;
+
+    void submitCurrentBlock();
+    bool drainOne();
+
+public:
+    CaptureArchiveWriter();
+    ~CaptureArchiveWriter();
+
+    bool open(const QString &path,
+              int blockSize = kDefaultBlockSize,
+              int compressionLevel = kDefaultCompressionLevel);
+    bool write(const QByteArray &data);
+    bool close();
+    bool isOpen() const;
+
+    qint64 rawSize() const;
+    qint64 archiveSize() const;
+    int blockCount() const;
+};
+
+class CaptureArchiveReader
+{
+private:
+    QFile m_file;
+    int m_blockSize = 0;
+    qint64 m_rawSize = 0;
+    QList<CaptureArchiveBlock> m_index;
+    QString m_errorString;
+
+    QByteArray readCompressedBlock(int index);
+
+public:
+    CaptureArchiveReader();
+    ~CaptureArchiveReader();
+
+    // Rejects an index whose sizes could make a block inflate past blockSize().
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    int blockSize() const;
+    int blockCount() const;
+    qint64 rawSize() const;
+    const CaptureArchiveBlock &block(int index) const;
+    int blockForOffset(qint64 rawOffset) const;
+
+    QByteArray readBlock(int index);
+    QByteArray read(qint64 rawOffset, qint64 length);
+    bool extractTo(QIODevice &output);
+};
+
+// Read-only view of an archive's raw bytes, so whatever reads a capture file
+// can read an archived one. Inflates one block at a time.
+class CaptureArchiveDevice : public QIODevice
+{
+private:
+    CaptureArchiveReader m_reader;
+    int m_blockIndex = -1;
+    QByteArray m_block;
+    qint64 m_pos = 0;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+public:
+    CaptureArchiveDevice();
+    ~CaptureArchiveDevice() override;
+
+    bool openArchive(const QString &path);
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+};
+
+bool isCaptureArchive(const QString &path);
+bool packCaptureArchive(const QString &rawPath,
+                        const QString &archivePath,
+                        CaptureArchiveStats *stats = nullptr,
+                        int blockSize = CaptureArchiveWriter::kDefaultBlockSize,
+                        int compressionLevel = CaptureArchiveWriter::kDefaultCompressionLevel);
+bool unpackCaptureArchive(const QString &archivePath,
+                          const QString &rawPath,
+                          CaptureArchiveStats *stats = nullptr);
+
+#endif
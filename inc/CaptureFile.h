@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef __CAPTURE_FILE_H__
+#define __CAPTURE_FILE_H__
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+#include "CaptureArchive.h"
+
+// Capture file layout (little-endian):
+//   header : "DSCF" | u16 version | u16 reserved | i64 wallClockOffsetNs
+//   record : i64 timestampNs | u8 direction | u8 channel | u8[2] reserved | u32 length | payload
+// timestampNs is CLOCK_MONOTONIC; wall time = timestampNs + wallClockOffsetNs.
+// The writer shifts stamps by any clock step (NTP, suspend) seen after the
+// header was written, so that sum stays right for the whole file.
+// channel tells ports apart in a merged timeline and is 0 for a single port.
+
+enum class CaptureDirection : quint8 {
+    Rx = 0,
+    Tx = 1,
+};
+
+struct CaptureRecord
+{
+    qint64 timestampNs = 0;
+    CaptureDirection direction = CaptureDirection::Rx;
+    quint8 channel = 0;
+    QByteArray data;
+};
+
+class CaptureFileWriter
+{
+private:
+    QFile m_file;
+    qint64 m_recordCount = 0;
+    bool m_failed = false;
+
+public:
+    CaptureFileWriter();
+    ~CaptureFileWriter();
+
+    bool open(const QString &path, qint64 wallClockOffsetNs);
+    bool write(const CaptureRecord &record);
+    // Pushes buffered records to the file so a reader opened now sees them.
+    bool flush();
+    bool close();
+    bool isOpen() const;
+
+    QString fileName() const;
+    qint64 recordCount() const;
+    // Bytes written so far, header included.
+    qint64 size() const;
+};
+
+// Reads raw captures and block archives of them (see CaptureArchive.h) alike.
+class CaptureFileReader
+{
+private:
+    QFile m_file;
+    CaptureArchiveDevice m_archive;
+    QIODevice *m_device = nullptr;
+    qint64 m_wallClockOffsetNs = 0;
+    qint64 m_endOffset = -1;
+    QString m_errorString;
+
+public:
+    CaptureFileReader();
+    ~CaptureFileReader();
+
+    // length > 0 reads only that many leading bytes, for a file that is still
+    // being appended to (see CaptureFileWriter::size()).
+    bool open(const QString &path, qint64 length = -1);
+    void close();
+    bool isOpen() const;
+
+    // Appends up to maxRecords to batch. Returns false at end of file or on error.
+    bool readBatch(QList<CaptureRecord> &batch, int maxRecords);
+    bool atEnd() const;
+    double progress() const;
+
+    qint64 wallClockOffsetNs() const;
+    QString errorString() const;
+};
+
+bool isCaptureFile(const QString &path);
+bool writeCaptureFile(const QString &path, const QList<CaptureRecord> &records, qint64 wallClockOffsetNs);
+// Joins the first lengths[i] bytes of each source into a standalone capture:
+// the first source's header, then every source's records. The sources must
+// share one header (segments of one session spool). The caller opens them, so
+// a segment deleted after that still copies on POSIX systems.
+bool copyCaptureSegments(const QList<std::shared_ptr<QFile>> &sources,
+                         const QList<qint64> &lengths,
+                         const QString &targetPath);
+
+#endif
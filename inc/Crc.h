@@ -0,0 +1,23 @@
+#pragma once
+
+#ifndef __CRC_H__
+#define __CRC_H__
+
+#include <QtGlobal>
+
+// Table-driven CRCs used by TX placeholders and file transfer protocols. Pass
+// the previous result back in to continue a running CRC over several buffers.
+
+// CRC-16/MODBUS: poly 0x8005 reflected, init 0xFFFF, sent low byte first.
+constexpr quint16 kCrc16ModbusInit = 0xFFFF;
+quint16 crc16Modbus(const char *data, qsizetype size, quint16 crc = kCrc16ModbusInit);
+
+// CRC-16/XMODEM: poly 0x1021, init 0, sent high byte first.
+constexpr quint16 kCrc16XmodemInit = 0x0000;
+quint16 crc16Xmodem(const char *data, qsizetype size, quint16 crc = kCrc16XmodemInit);
+
+// CRC-32 (IEEE 802.3, as in zlib and ZMODEM): reflected, init and final XOR
+// 0xFFFFFFFF, sent low byte first. Pass the previous result to continue.
+quint32 crc32(const char *data, qsizetype size, quint32 crc = 0);
+
+#endif
@@ -0,0 +1,254 @@
+#pragma once
+
+#ifndef __FILE_TRANSFER_H__
+#define __FILE_TRANSFER_H__
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QtGlobal>
+
+#include <functional>
+
+enum class TransferProtocol {
+    XmodemCrc, // 128-byte blocks, CRC-16; falls back to checksums if the receiver asks with NAK
+    Xmodem1k,  // 1024-byte blocks, 128 for a short tail
+    Ymodem,    // batch XMODEM-1K with name and size in block 0
+    Zmodem,    // streaming, CRC-32 when the receiver offers it, ZRPOS recovery
+};
+
+struct TransferOptions
+{
+    TransferProtocol protocol = TransferProtocol::Zmodem;
+    // ZMODEM send: bytes allowed past the last ZACK. 0 streams without waiting.
+    qint64 zmodemWindowBytes = 64 * 1024;
+    // ZMODEM receive: a file of the same name that the sender confirms with
+    // ZCRC is continued (shorter) or skipped (same size) instead of saved
+    // under a new name. A ZCRECOV sender (sz -r) is trusted without the check.
+    bool resume = false;
+};
+
+struct TransferProgress
+{
+    QString fileName;
+    int fileIndex = 0;     // 1-based, 0 before the first file
+    int fileCount = 0;     // 0 when a receiver can't know
+    qint64 fileSize = -1;  // -1 when the protocol doesn't say (XMODEM receive)
+    qint64 fileOffset = 0; // bytes of the current file sent or written
+    qint64 resumedFrom = 0;
+    qint64 bytesMoved = 0; // payload bytes over the line in this transfer, all files
+    int errors = 0;        // NAKs, bad CRCs, timeouts and repositions
+    qint64 elapsedNs = 0;
+
+    double bytesPerSecond() const;
+};
+
+// X/Y/ZMODEM sender and receiver. It runs on the thread that owns the port:
+// SerialManager hands it every received chunk while a transfer is active and
+// calls writeReady() when the port drains, so the protocol never waits on the
+// GUI. Sends are paced by the port's output queue; ZMODEM additionally keeps
+// at most the window size past the receiver's last ZACK, asking for ZACKs
+// with ZCRCQ subpackets so data keeps flowing while acknowledgements return.
+class FileTransfer
+{
+public:
+    using WriteHandler = std::function<qint64(const QByteArray &data)>;
+    using PendingWriteHandler = std::function<qint64()>;
+    using LogCallback = std::function<void(const QString &message)>;
+    using FinishedCallback = std::function<void(bool ok, const QString &message)>;
+
+    static constexpr int kMaxRetries = 10;
+    static constexpr qint64 kMaxQueuedBytes = 8 * 1024;
+    static constexpr int kZmodemSubpacketBytes = 1024;
+    static constexpr int kZmodemMaxSubpacketBytes = 8192;
+
+private:
+    enum class Role {
+        Idle,
+        Send,
+        Receive,
+    };
+
+    enum class Phase {
+        // XMODEM/YMODEM send
+        XySendWaitStart,      // waiting for 'C' or NAK
+        XySendWaitHeaderAck,  // YMODEM block 0 out
+        XySendWaitBlockAck,
+        XySendWaitEotAck,
+        // XMODEM/YMODEM receive
+        XyReceiveWaitHeader,  // YMODEM, polling with 'C' for block 0
+        XyReceiveWaitData,    // polling with 'C' (or NAK) for block 1, then blocks
+        // ZMODEM send
+        ZSendWaitInit,        // ZRQINIT out, waiting for ZRINIT
+        ZSendWaitPosition,    // ZFILE out, waiting for ZRPOS or ZSKIP
+        ZSendStreaming,
+        ZSendWaitAck,         // window full or ZCRCW out
+        ZSendWaitEofAck,      // ZEOF out, waiting for ZRINIT
+        ZSendWaitFin,
+        // ZMODEM receive
+        ZReceiveWaitFile,     // ZRINIT out
+        ZReceiveWaitCrc,      // ZCRC out, checking a file we already have
+        ZReceiveWaitData,     // ZRPOS out, waiting for ZDATA
+        ZReceiveData,         // inside a ZDATA frame
+        ZReceiveWaitOver,     // ZFIN answered, waiting for "OO"
+    };
+
+    // Incoming ZMODEM bytes, framed into headers and data subpackets.
+    enum class ZState {
+        Hunt,       // looking for ZPAD
+        Pad,        // ZPAD seen
+        PadZdle,    // ZPAD ZDLE seen, format byte next
+        HexHeader,
+        BinaryHeader,
+        Subpacket,
+        SubpacketCrc,
+    };
+
+    enum class ZSubpacket {
+        None,
+        FileInfo,
+        Attention,
+        FileData,
+    };
+
+    TransferOptions m_options;
+    Role m_role = Role::Idle;
+    Phase m_phase = Phase::XySendWaitStart;
+    WriteHandler m_writeHandler;
+    PendingWriteHandler m_pendingWriteHandler;
+    LogCallback m_logCallback;
+    FinishedCallback m_finishedCallback;
+    QTimer m_timer;     // protocol timeouts
+    QTimer m_pumpTimer; // retries a send the port queue held back
+    TransferProgress m_progress;
+    qint64 m_startNs = 0;
+    int m_retries = 0;
+    int m_cancelCount = 0;
+
+    QStringList m_sendPaths;
+    QString m_receiveTarget; // directory, or the file for XMODEM
+    QFile m_file;
+    qint64 m_filePos = 0;
+    qint64 m_fileSize = -1;
+    qint64 m_fileMtime = 0;
+
+    // XMODEM/YMODEM
+    QByteArray m_rx;
+    QByteArray m_block;        // last block sent, for retransmission
+    qsizetype m_blockLength = 0; // file bytes in m_block
+    QByteArray m_heldBlock;    // last block received, written once we know it isn't the tail
+    quint8 m_blockNumber = 0;
+    bool m_crcMode = true;
+    bool m_headerSent = false;
+    bool m_eotNaked = false;
+    bool m_purging = false;      // receive: dropping input until the line goes quiet
+
+    // ZMODEM
+    ZState m_zState = ZState::Hunt;
+    ZSubpacket m_zExpect = ZSubpacket::None;
+    bool m_zEscape = false;
+    bool m_zCrc32 = false;      // of the frame being parsed
+    bool m_zSendCrc32 = false;  // receiver offered CANFC32
+    bool m_zEscapeControl = false;
+    int m_zHeaderLength = 0;
+    QByteArray m_zHeader;
+    QByteArray m_zData;
+    QByteArray m_zCrc;
+    char m_zFrameEnd = 0;
+    QByteArray m_zLastHeader;   // resent on ZNAK and timeouts
+    qint64 m_zAckedPos = 0;
+    qint64 m_zReceiverBuffer = 0; // ZRINIT buffer size, 0 for full streaming
+    qint64 m_zFrameStart = 0;   // position of the current ZDATA frame
+    qint64 m_zQueryPos = 0;     // next position to ask for a ZACK
+    qint64 m_zLastRposPos = -1;
+    int m_zRposRepeats = 0;
+    QByteArray m_zOut;          // send: built subpackets not yet handed to the port
+    bool m_zFrameOpen = false;  // send: the current ZDATA frame takes more subpackets
+    char m_zLastByte = 0;       // receive: spots the closing "OO"
+    uchar m_zFileConversion = 0; // receive: ZF0 of the last ZFILE
+    QString m_zFileName;        // receive: the ZFILE waiting on a ZCRC answer
+    qint64 m_zFileSize = -1;
+    qint64 m_zCheckLength = 0;  // receive: bytes of the existing file the ZCRC covers
+
+    // common
+    void resetState(const TransferOptions &options, Role role);
+    void write(const QByteArray &data);
+    qint64 pendingWrite() const;
+    void log(const QString &message);
+    void finish(bool ok, const QString &message);
+    void fail(const QString &message);
+    void startTimer(int ms);
+    void handleTimeout();
+    bool openNextSendFile();
+    QString receivePath(const QString &name) const;
+    bool openReceiveFile(const QString &name, qint64 size, bool allowResume, bool *skip);
+    void closeReceivedFile();
+
+    // XMODEM/YMODEM
+    void feedXySend(const QByteArray &data);
+    void feedXyReceive(const QByteArray &data);
+    void sendXyHeader();
+    void sendXyBlock();
+    void handleXyBlock(quint8 number, const char *data, qsizetype size);
+    void handleXyEot();
+    void purgeXyReceive();
+    void flushHeldBlock(bool last);
+    QByteArray buildXyBlock(quint8 number, const QByteArray &payload, qsizetype blockSize, char pad) const;
+
+    // ZMODEM
+    void feedZmodem(const QByteArray &data);
+    void handleZSendHeader(int type, qint64 position, const uchar *bytes);
+    void handleZReceiveHeader(int type, qint64 position, const uchar *bytes);
+    void handleZSubpacket();
+    void finishZHeader();
+    void startZSubpacket(ZSubpacket expect);
+    void finishZSubpacket();
+    void zmodemDataError(const QString &reason);
+    // Position headers carry the offset little-endian; flag headers pass ZP0..ZP3 as is.
+    QByteArray zHexHeader(int type, qint64 position) const;
+    QByteArray zHexHeader(int type, const uchar (&bytes)[4]) const;
+    QByteArray zBinaryHeader(int type, qint64 position) const;
+    QByteArray zBinaryHeader(int type, const uchar (&bytes)[4]) const;
+    void sendZHeader(const QByteArray &header);
+    void appendZSubpacket(QByteArray &out, const char *data, qsizetype size, char frameEnd) const;
+    void appendZEscaped(QByteArray &out, const char *data, qsizetype size) const;
+    void sendZFile();
+    void nextZFile();
+    void sendZData(qint64 position);
+    void pumpZmodem();
+    void sendZReceiverInit();
+    void acceptZFile(bool existingMatches);
+
+public:
+    FileTransfer();
+    ~FileTransfer();
+
+    // Protocol timers follow; call while idle.
+    void moveToThread(QThread *thread);
+
+    void setWriteHandler(WriteHandler handler);
+    void setPendingWriteHandler(PendingWriteHandler handler);
+    void setLogCallback(LogCallback callback);
+    void setFinishedCallback(FinishedCallback callback);
+
+    // XMODEM sends exactly one file; YMODEM and ZMODEM send them all as a batch.
+    bool startSend(const TransferOptions &options, const QStringList &paths, QString *errorString = nullptr);
+    // target: the file for XMODEM, the download directory otherwise.
+    bool startReceive(const TransferOptions &options, const QString &target, QString *errorString = nullptr);
+    void cancel();
+
+    bool isActive() const;
+    bool isSending() const;
+    TransferOptions options() const;
+    TransferProgress progress() const;
+
+    void feed(const QByteArray &data);
+    void writeReady();
+
+    static QString protocolName(TransferProtocol protocol);
+};
+
+#endif
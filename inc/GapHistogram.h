@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef __GAP_HISTOGRAM_H__
+#define __GAP_HISTOGRAM_H__
+
+#include <QString>
+#include <QtGlobal>
+
+#include <array>
+
+// Log2-bucketed histogram of inter-chunk gaps. Bucket i counts gaps in
+// [2^i, 2^(i+1)) ns, bucket 0 also takes gaps below 1 ns.
+class GapHistogram
+{
+public:
+    static constexpr int kBucketCount = 40; // top bucket starts around 9 minutes
+
+private:
+    std::array<quint64, kBucketCount> m_buckets{};
+    quint64 m_count = 0;
+    qint64 m_minNs = 0;
+    qint64 m_maxNs = 0;
+    long double m_sumNs = 0;
+
+public:
+    void add(qint64 gapNs);
+    void clear();
+
+    quint64 count() const;
+    quint64 bucket(int index) const;
+    qint64 minNs() const;
+    qint64 maxNs() const;
+    qint64 meanNs() const;
+    qint64 percentileNs(double percentile) const;
+
+    static qint64 bucketLowerBoundNs(int index);
+    static int bucketForGap(qint64 gapNs);
+    static QString formatDuration(qint64 ns);
+
+    QString toText(int barWidth = 40) const;
+};
+
+#endif
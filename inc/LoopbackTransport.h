@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef __LOOPBACK_TRANSPORT_H__
+#define __LOOPBACK_TRANSPORT_H__
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QTimer>
+#include <QtGlobal>
+
+#include <deque>
+#include <functional>
+
+struct LoopbackConfig
+{
+    bool paceToBaud = false;    // hold each fragment until it would have left the wire
+    qint32 baudRate = 115200;
+    int bitsPerCharacter = 10;  // start + data + parity + stop
+    qint64 latencyUs = 0;       // fixed delay added to every fragment
+    int maxFragmentBytes = 0;   // split writes into 1..N byte reads, 0 keeps them whole
+    double bitErrorRate = 0.0;  // probability that any given bit is flipped
+    quint64 seed = 1;           // same seed, same fragment sizes and bit errors
+};
+
+// In-memory transport that echoes every write back as received data. Delivery
+// is always asynchronous (from a timer on the owning thread), like a real port,
+// and can optionally be paced to the baud rate, delayed, fragmented and
+// corrupted. With everything off it runs as fast as the receive path can eat.
+class LoopbackTransport
+{
+public:
+    // lateNs: how long after its due time the fragment was handed over (timer
+    // slack, a busy thread), so the receiver can stamp it at the due time.
+    using DeliverCallback = std::function<void(const QByteArray &data, qint64 lateNs)>;
+
+private:
+    struct Fragment
+    {
+        qint64 dueNs = 0;
+        QByteArray data;
+    };
+
+    LoopbackConfig m_config;
+    DeliverCallback m_deliverCallback;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    std::deque<Fragment> m_pending;
+    qint64 m_pendingBytes = 0;
+    bool m_open = false;
+    qint64 m_lineFreeNs = 0; // when the simulated wire finishes the last queued byte
+    quint64 m_rngState = 1;
+    quint64 m_nextBitError = 0; // bits until the next flipped bit
+    quint64 m_bytesWritten = 0;
+    quint64 m_bytesDelivered = 0;
+    quint64 m_bitsFlipped = 0;
+
+    quint64 nextRandom();
+    double nextUniform();
+    quint64 drawBitErrorGap();
+    void corrupt(QByteArray &data);
+    void scheduleNext();
+    void deliverDue();
+
+public:
+    LoopbackTransport();
+
+    // The delivery timer follows; call before open().
+    void moveToThread(QThread *thread);
+    bool open(const LoopbackConfig &config);
+    void close();
+    bool isOpen() const;
+    const LoopbackConfig &config() const;
+
+    qint64 write(const QByteArray &data);
+    void setDeliverCallback(DeliverCallback callback);
+    qint64 bytesPending() const;
+
+    quint64 bytesWritten() const;
+    quint64 bytesDelivered() const;
+    quint64 bitsFlipped() const;
+
+    static int bitsPerCharacter(int dataBits, bool parity, int stopBits);
+};
+
+#endif
@@ -0,0 +1,224 @@
+#pragma once
+
+#ifndef __PACKET_DECODER_H__
+#define __PACKET_DECODER_H__
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <deque>
+
+// Packet schema (JSON):
+//   {
+//     "endian": "little",                 // default for every field, "big" or "little"
+//     "sync": "AA 55",                    // optional; frames start with these bytes,
+//                                         // which header fields must cover
+//     "header": [ fields... ],            // shared by every packet type
+//     "discriminator": "type",            // header field that selects the packet type
+//     "length": {"field": "len", "adjust": 4}, // optional; total size = len + adjust
+//     "packets": [
+//       {"id": 1, "name": "imu", "fields": [ fields... ]}
+//     ]
+//   }
+// field: {"name": "ax", "type": "i16", "scale": 0.01, "bias": 0, "endian": "big",
+//         "enum": {"0": "idle", "1": "run"}}
+//        {"type": "pad", "size": 2}
+//        {"type": "u8", "bits": [{"name": "mode", "offset": 0, "width": 3, "enum": {...}}]}
+// Types: u8 i8 u16 i16 u32 i32 u64 i64 f32 f64. Fields are laid out back to back,
+// packet fields right after the header. Without a discriminator there must be
+// exactly one packet type; without a length field every packet is its fixed size.
+
+enum class PacketFieldType : quint8 {
+    U8,
+    I8,
+    U16,
+    I16,
+    U32,
+    I32,
+    U64,
+    I64,
+    F32,
+    F64,
+};
+
+struct PacketColumn
+{
+    QString name;
+    QHash<qint64, QString> enumNames;
+    bool integral = true; // no scale, bias or float source: show without decimals
+};
+
+struct PacketLayout
+{
+    QString name;
+    qint64 id = 0;
+    int size = 0;     // header + fields, the smallest a packet of this type can be
+    int firstOp = 0;  // ops for this type (header ops included) are [firstOp, firstOp + opCount)
+    int opCount = 0;
+    QList<PacketColumn> columns;
+};
+
+struct PacketDecodeOp;
+using PacketFieldLoader = double (*)(const uchar *data, const PacketDecodeOp &op);
+
+// One step of the decode program: load the field at offset through a loader
+// picked at compile time for its type, byte order and bitfield, then scale.
+struct PacketDecodeOp
+{
+    PacketFieldLoader load = nullptr;
+    quint32 offset = 0;
+    quint32 column = 0;
+    quint8 shift = 0;
+    quint8 width = 0;
+    double scale = 1.0;
+    double bias = 0.0;
+};
+
+// A schema compiled into a flat decode program. Field offsets, loaders and the
+// discriminator lookup are all resolved up front, so decoding a packet is one
+// table lookup plus a straight run over its ops.
+class PacketSchema
+{
+public:
+    static constexpr int kMaxPacketSize = 64 * 1024;
+
+private:
+    struct RawField
+    {
+        PacketFieldType type = PacketFieldType::U8;
+        bool bigEndian = false;
+        quint32 offset = 0;
+    };
+
+    QList<PacketLayout> m_layouts;
+    QList<PacketDecodeOp> m_ops;
+    QByteArray m_sync;
+    int m_headerSize = 0;
+    int m_headerColumnCount = 0;
+    bool m_hasDiscriminator = false;
+    RawField m_discriminator;
+    QList<qint16> m_layoutByDiscriminator; // direct table for 8 and 16 bit discriminators
+    QHash<qint64, int> m_layoutById;       // wider discriminators
+    bool m_hasLength = false;
+    RawField m_length;
+    qint64 m_lengthAdjust = 0;
+
+    static qint64 readRaw(const uchar *data, const RawField &field);
+
+public:
+    bool isValid() const;
+    const QList<PacketLayout> &layouts() const;
+    const QList<PacketDecodeOp> &ops() const;
+    const QByteArray &sync() const;
+    int headerSize() const;
+    int headerColumnCount() const; // every packet type's columns start with these
+    int maxColumnCount() const;
+
+    // Packet type for a header, or -1 if the discriminator matches nothing.
+    int layoutFor(const uchar *header) const;
+    // Total packet size from the header, or -1 if it is out of range for the type.
+    qint64 packetSize(const uchar *header, int layoutIndex) const;
+    void decode(const uchar *packet, int layoutIndex, double *values) const;
+
+    static bool compile(const QByteArray &json, PacketSchema &schema, QString *errorString = nullptr);
+    static int typeSize(PacketFieldType type);
+};
+
+// Decoded packets, one row-major value table per packet type. Values are
+// stored as double so any column can be plotted; 64-bit integers above 2^53
+// lose their low bits.
+class PacketTable
+{
+public:
+    static constexpr qsizetype kDefaultCapacity = 1000000;
+
+private:
+    struct Rows
+    {
+        QList<qint64> timestampsNs;
+        QList<double> values;
+        quint64 evicted = 0;
+    };
+
+    QList<int> m_columnCounts;
+    QList<Rows> m_rows;
+    QList<double> m_scratch;
+    QList<qint32> m_order; // layout of every kept row, a ring once the table is full
+    qsizetype m_orderHead = 0;
+    qsizetype m_capacity = kDefaultCapacity;
+    qsizetype m_rowCount = 0;
+    quint64 m_rowsEvicted = 0;
+
+public:
+    void reset(const PacketSchema &schema);
+    void clear();
+    // Also clears the table.
+    void setCapacity(qsizetype rows);
+
+    // Space for one row of layoutIndex. Once the table is full the oldest row,
+    // whatever its type, is evicted to make room, so the newest packets are
+    // always the ones kept.
+    double *appendRow(int layoutIndex, qint64 timestampNs);
+
+    int layoutCount() const;
+    int columnCount(int layoutIndex) const;
+    qsizetype rowCount() const;
+    qsizetype rowCount(int layoutIndex) const;
+    quint64 rowsEvicted() const;
+    // Row 0 of layoutIndex is packet number rowsEvicted(layoutIndex) of that type.
+    quint64 rowsEvicted(int layoutIndex) const;
+    qint64 timestampNs(int layoutIndex, qsizetype row) const;
+    double value(int layoutIndex, qsizetype row, int column) const;
+    const double *row(int layoutIndex, qsizetype row) const;
+
+    bool writeCsv(const QString &path,
+                  const PacketSchema &schema,
+                  int layoutIndex,
+                  qint64 wallClockOffsetNs,
+                  QString *errorString = nullptr) const;
+
+    static QString formatValue(const PacketColumn &column, double value);
+};
+
+// Splits an RX byte stream into packets using the schema's sync bytes and
+// length field, and decodes them into a PacketTable. Anything that does not
+// frame (no sync, unknown type, bad length) is skipped a byte at a time.
+class PacketDecoder
+{
+private:
+    struct Chunk
+    {
+        qint64 streamOffset = 0;
+        qint64 timestampNs = 0;
+    };
+
+    PacketSchema m_schema;
+    QByteArray m_buffer;
+    qsizetype m_readPos = 0;
+    qint64 m_streamOffset = 0; // stream offset of m_buffer[0]
+    std::deque<Chunk> m_chunks;
+    bool m_enabled = false;
+    quint64 m_packetsDecoded = 0;
+    quint64 m_bytesSkipped = 0;
+
+    qint64 timestampAt(qint64 streamOffset);
+    void compact();
+
+public:
+    void setSchema(const PacketSchema &schema);
+    const PacketSchema &schema() const;
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void reset();
+
+    // Packets are stamped with the arrival of the chunk holding their first byte.
+    void feed(const QByteArray &data, qint64 timestampNs, PacketTable &table);
+
+    quint64 packetsDecoded() const;
+    quint64 bytesSkipped() const;
+    void resetStatistics();
+};
+
+#endif
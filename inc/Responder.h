@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef __RESPONDER_H__
+#define __RESPONDER_H__
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+
+#include <functional>
+
+#include "GapHistogram.h"
+
+struct ResponderRule
+{
+    enum Kind {
+        Exact,
+        Prefix,
+        Regex,
+    };
+
+    Kind kind = Exact;
+    QString source;
+    QByteArray match;
+    QRegularExpression regex;
+    QByteArray response;
+    bool substitute = false; // response contains $0, $1.., ${name}
+};
+
+// Device emulator: splits RX into frames on a delimiter and answers each frame
+// from a rule table. Exact rules sit in a hash, prefix rules in a byte trie
+// (longest prefix wins), so lookup cost follows frame length rather than rule
+// count; regex rules are tried last, in order.
+class Responder
+{
+public:
+    using SendCallback = std::function<void(const QByteArray &response, int ruleIndex)>;
+    static constexpr qsizetype kMaxFrameSize = 64 * 1024;
+
+private:
+    QList<ResponderRule> m_rules;
+    QHash<QByteArray, int> m_exactIndex;
+    QHash<quint64, qint32> m_prefixEdges; // (node << 8) | byte -> child node
+    QList<int> m_prefixRuleAtNode;        // node -> rule index or -1
+    QList<int> m_regexRules;
+    QByteArray m_delimiter = "\n";
+    QByteArray m_frameBuffer;
+    bool m_enabled = false;
+    quint64 m_framesSeen = 0;
+    quint64 m_framesAnswered = 0;
+    GapHistogram m_latency;
+
+    QByteArray buildResponse(const ResponderRule &rule,
+                             const QByteArray &frame,
+                             const QRegularExpressionMatch *match) const;
+
+public:
+    Responder();
+
+    void setRules(const QList<ResponderRule> &rules);
+    const QList<ResponderRule> &rules() const;
+    void setDelimiter(const QByteArray &delimiter);
+    QByteArray delimiter() const;
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void reset();
+
+    void feed(const QByteArray &data, const SendCallback &send);
+    int respond(const QByteArray &frame, QByteArray &response) const;
+
+    quint64 framesSeen() const;
+    quint64 framesAnswered() const;
+    GapHistogram &latency();
+    const GapHistogram &latency() const;
+    void resetStatistics();
+
+    // One rule per line: "<exact|prefix|regex|hex>:<match> => <response>"
+    // A response starting with "hex:" is sent as raw bytes. Matches take
+    // TxEncoder::unescape() escapes or hex pairs, responses TxEncoder's formats.
+    // A line that fails to parse is left out and reported in errorString; the
+    // other rules are still returned.
+    static bool parseRules(const QString &text, QList<ResponderRule> &rules, QString *errorString = nullptr);
+};
+
+#endif
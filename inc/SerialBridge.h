@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef __SERIAL_BRIDGE_H__
+#define __SERIAL_BRIDGE_H__
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+#include <QThread>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QTcpServer>
+
+#include <functional>
+
+struct BridgeConfig
+{
+    quint16 tcpPort = 0;            // read-write clients; 0 = no TCP listener
+    quint16 observerTcpPort = 0;    // read-only clients; anything they send is dropped
+    QString localSocketName;        // Unix socket / named pipe; empty = off
+    bool localhostOnly = true;
+    qint64 maxPendingBytes = 4 * 1024 * 1024;
+};
+
+// Forwards serial RX to every connected client and client data back to the port,
+// the same job ser2net does, but inside the app so the GUI keeps seeing the traffic.
+//
+// There is no splice()/pipe path. Every RX chunk has to reach userspace anyway
+// for the display, triggers, responder, spool and shared-memory ring. A tty
+// either can't be spliced from (EINVAL on some kernels) or copies into the
+// pipe internally, so splice() would save nothing. vmsplice() of the chunk
+// that was read would leave the pipe pointing at pages Qt may free or reuse
+// before the sockets drain. So each client gets the same implicitly shared
+// QByteArray through its QIODevice. That is one kernel copy per client, the
+// same as splice() would do into each socket.
+class SerialBridge
+{
+public:
+    using WriteHandler = std::function<qint64(const QByteArray &)>;
+    using ClientsChangedCallback = std::function<void(int clients, int observers)>;
+
+private:
+    struct Client
+    {
+        QIODevice *device = nullptr;
+        bool readOnly = false;
+    };
+
+    QTcpServer m_tcpServer;
+    QTcpServer m_observerServer;
+    QLocalServer m_localServer;
+    QList<Client> m_clients;
+    BridgeConfig m_config;
+    WriteHandler m_writeHandler;
+    ClientsChangedCallback m_clientsChangedCallback;
+    QString m_lastError;
+
+    void acceptTcpClients(QTcpServer &server, bool readOnly);
+    void acceptLocalClients();
+    void addClient(QIODevice *device, bool readOnly);
+    void removeClient(QIODevice *device);
+    void handleClientReadyRead(QIODevice *device, bool readOnly);
+    void notifyClientsChanged();
+
+public:
+    SerialBridge();
+    ~SerialBridge();
+
+    // Servers and, through them, every accepted client; call before start().
+    void moveToThread(QThread *thread);
+    bool start(const BridgeConfig &config);
+    void stop();
+    bool isActive() const;
+
+    void forwardToClients(const QByteArray &data);
+    void setWriteHandler(WriteHandler handler);
+    void setClientsChangedCallback(ClientsChangedCallback callback);
+
+    int clientCount() const;
+    int observerCount() const;
+    QString lastError() const;
+    BridgeConfig getConfig() const;
+};
+
+#endif
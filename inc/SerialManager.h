@@ -5,37 +5,104 @@
 
 #include <QByteArray>
 #include <QList>
+#include <QObject>
 #include <QString>
+#include <QThread>
 #include <QtSerialPort/QSerialPort>
 #include <QtSerialPort/QSerialPortInfo>
 #include <QDebug>
 
+#include <atomic>
 #include <functional>
 
+#include "FileTransfer.h"
+#include "GapHistogram.h"
+#include "LoopbackTransport.h"
+#include "SerialBridge.h"
+#include "Responder.h"
+#include "ShmPublisher.h"
+#include "TriggerEngine.h"
+#include "TxEncoder.h"
+
+enum class SerialMode {
+  Free,
+  Rs485,
+  Loopback, // no port is opened; TX is echoed back as RX in memory
+};
+
 struct SerialConfig {
+  SerialMode mode = SerialMode::Free;
   QString portName;
   qint32 baudRate = QSerialPort::Baud115200;
   QSerialPort::DataBits dataBits = QSerialPort::Data8;
   QSerialPort::Parity parity = QSerialPort::NoParity;
   QSerialPort::StopBits stopBits = QSerialPort::OneStop;
   QSerialPort::FlowControl flowControl = QSerialPort::NoFlowControl;
+  LoopbackConfig loopback; // baud rate and character size are taken from the fields above
 };
 
+// The port and everything that reacts to it without the user (gap histogram,
+// triggers, responder, file transfer, bridge, shared memory) live on a
+// dedicated I/O thread, so arrival stamps and automatic replies never wait for
+// the GUI. Public methods can be called from the thread that created the
+// manager and hop to the I/O thread themselves; callbacks are delivered back
+// on that thread, in the order things happened. The component accessors
+// return I/O-thread objects: from anywhere else, touch them only inside
+// runOnIoThread().
 class SerialManager {
     public:
-        using ReceiveCallback = std::function<void(const QByteArray &)>;
+        // timestampNs: CLOCK_MONOTONIC when the chunk came off the port.
+        using ReceiveCallback = std::function<void(const QByteArray &data, qint64 timestampNs)>;
+        using TransmitCallback = std::function<void(const QByteArray &data, qint64 timestampNs)>;
+        using TriggerCallback = std::function<void(const TriggerRule &rule, const TriggerMatch &match, qint64 timestampNs)>;
+        // timestampNs: when the response was handed to the driver.
+        using ResponderCallback = std::function<void(const ResponderRule &rule, const QByteArray &response, qint64 written, qint64 latencyNs, qint64 timestampNs)>;
+        using BridgeTransmitCallback = std::function<void(const QByteArray &data, qint64 written, qint64 timestampNs)>;
+        using BridgeClientsChangedCallback = std::function<void(int clients, int observers)>;
+        using TransferLogCallback = std::function<void(const QString &message)>;
+        using TransferFinishedCallback = std::function<void(bool ok, const QString &message)>;
 
     private:
+        QThread m_ioThread;
+        mutable QObject m_ioContext; // lives on m_ioThread, runs the queued calls
+        QObject m_ownerContext;      // lives on the creating thread, runs the callbacks
         QSerialPort m_serial;
+        LoopbackTransport m_loopback;
         SerialConfig m_config;
         ReceiveCallback m_receiveCallback;
+        TransmitCallback m_transmitCallback;
+        SerialBridge m_bridge;
+        ShmPublisher m_shmPublisher;
+        BridgeTransmitCallback m_bridgeTransmitCallback;
+        BridgeClientsChangedCallback m_bridgeClientsChangedCallback;
+        GapHistogram m_gapHistogram;
+        TriggerEngine m_triggers;
+        TriggerCallback m_triggerCallback;
+        Responder m_responder;
+        ResponderCallback m_responderCallback;
+        FileTransfer m_fileTransfer;
+        TransferLogCallback m_transferLogCallback;
+        TransferFinishedCallback m_transferFinishedCallback;
+        std::atomic<bool> m_connected{false};
+        std::atomic<bool> m_loopbackOpen{false};
+        qint64 m_lastReceiveTimestampNs = -1;
+        std::atomic<qint64> m_lastTransmitTimestampNs{-1};
 
         void handleReadyRead();
+        void processReceivedData(const QByteArray &data, qint64 timestampNs);
+        void resetReceiveState();
+        void closePort();
+        qint64 writeToPort(const QByteArray &data);
+        void postToOwner(std::function<void()> task);
 
     public:
         SerialManager();
         ~SerialManager();
 
+        // Runs task on the I/O thread and waits for it; runs it directly when
+        // already there.
+        void runOnIoThread(const std::function<void()> &task) const;
+
         QList<QSerialPortInfo> getAvailablePorts();
 
         bool connectPort();
@@ -44,11 +111,60 @@ class SerialManager {
 
         void disconnectPort();
         bool isConnected() const;
+        bool isLoopback() const;
+        LoopbackTransport &loopback();
 
         qint64 sendText(const QString &text);
         qint64 sendHex(const QString &hexText);
+        // Returns bytes written, or -1 with errorPosition set to the offending
+        // input character (-1 if the failure was not in the input).
+        qint64 sendEncoded(QStringView text,
+                           const TxEncodeOptions &options,
+                           QString *errorString = nullptr,
+                           qint64 *errorPosition = nullptr);
+        qint64 sendFile(const QString &path,
+                        const TxEncodeOptions &options,
+                        QString *errorString = nullptr,
+                        qint64 *errorPosition = nullptr);
+        // -1 while a file transfer is running, like a closed port.
         qint64 sendBytes(const QByteArray &data);
         void setReceiveCallback(ReceiveCallback callback);
+        void setTransmitCallback(TransmitCallback callback);
+
+        void setTriggerRules(const QList<TriggerRule> &rules);
+        const TriggerEngine &triggers() const;
+        void setTriggerCallback(TriggerCallback callback);
+
+        Responder &responder();
+        void setResponderCallback(ResponderCallback callback);
+
+        // While a transfer runs it gets every received chunk instead of the
+        // triggers, responder and receive callback; its writes skip the
+        // transmit callback.
+        FileTransfer &fileTransfer();
+        void setTransferLogCallback(TransferLogCallback callback);
+        void setTransferFinishedCallback(TransferFinishedCallback callback);
+
+        static qint64 monotonicNowNs();
+        // CLOCK_REALTIME minus CLOCK_MONOTONIC, sampled on every call: a clock
+        // step or a suspend moves it, so never cache it for later stamps.
+        static qint64 wallClockOffsetNs();
+        qint64 lastTransmitTimestampNs() const;
+        const GapHistogram &gapHistogram() const;
+        void resetGapHistogram();
+
+        bool startBridge(const BridgeConfig &config);
+        void stopBridge();
+        bool isBridgeActive() const;
+        SerialBridge &bridge();
+        void setBridgeTransmitCallback(BridgeTransmitCallback callback);
+        void setBridgeClientsChangedCallback(BridgeClientsChangedCallback callback);
+
+        bool startSharedMemoryPublisher(const QString &name,
+                                        qint64 capacity = ShmPublisher::kDefaultCapacity);
+        void stopSharedMemoryPublisher();
+        bool isSharedMemoryPublishing() const;
+        ShmPublisher &sharedMemoryPublisher();
 
         bool applyConfig(const SerialConfig &config);
         SerialConfig getConfig() const;
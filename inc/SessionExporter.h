@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef __SESSION_EXPORTER_H__
+#define __SESSION_EXPORTER_H__
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+
+#include "CaptureFile.h"
+
+enum class ExportFormat {
+    Csv,
+    JsonLines,
+    Pcapng,
+};
+
+// Supplies records to the exporter; only ever called from the export thread.
+class ExportSource
+{
+public:
+    virtual ~ExportSource() = default;
+
+    // Appends up to maxRecords to batch. Returns false when exhausted or on error.
+    virtual bool readBatch(QList<CaptureRecord> &batch, int maxRecords) = 0;
+    virtual double progress() const = 0;
+    virtual qint64 wallClockOffsetNs() const = 0;
+    virtual QString errorString() const;
+    // One name per CaptureRecord::channel; a single port by default.
+    virtual QStringList channelNames() const;
+
+    // Takes the list by value: move it in, or pass one nobody appends to any
+    // more, or the next append pays for a full copy.
+    static std::unique_ptr<ExportSource> fromRecords(QList<CaptureRecord> records,
+                                                     qint64 wallClockOffsetNs);
+    // length > 0 stops after that many bytes, for a capture still being written.
+    static std::unique_ptr<ExportSource> fromCaptureFile(const QString &path,
+                                                         QString *errorString = nullptr,
+                                                         qint64 length = -1);
+};
+
+// Writes a session to CSV, JSON Lines or PCAPNG on a background thread. Records
+// are formatted in slices on the thread pool and written back in order, so memory
+// stays bounded no matter how long the session is.
+class SessionExporter
+{
+public:
+    // LINKTYPE_USER0; point Wireshark's DLT_USER table at a dissector (or "data").
+    static constexpr quint16 kPcapLinkType = 147;
+
+private:
+    QThread *m_thread = nullptr;
+    std::atomic_bool m_cancelRequested{false};
+    std::atomic_bool m_finished{false};
+    std::atomic<qint64> m_recordsWritten{0};
+    std::atomic<int> m_progressPermille{0};
+    bool m_succeeded = false;
+    QString m_errorString;
+
+    void run(const QString &path, ExportFormat format, ExportSource &source);
+
+public:
+    SessionExporter();
+    ~SessionExporter();
+
+    bool start(const QString &path, ExportFormat format, std::unique_ptr<ExportSource> source);
+    void cancel();
+    bool wait();
+
+    bool isRunning() const;
+    bool isFinished() const;
+    bool succeeded() const;
+    bool wasCancelled() const;
+    QString errorString() const;
+    qint64 recordsWritten() const;
+    int progressPermille() const;
+
+    static ExportFormat formatForPath(const QString &path);
+    static QByteArray formatRecords(const CaptureRecord *records,
+                                    qsizetype count,
+                                    ExportFormat format,
+                                    qint64 wallClockOffsetNs);
+    static QByteArray fileHeader(ExportFormat format, const QStringList &channelNames = {"serial"});
+};
+
+#endif
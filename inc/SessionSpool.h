@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef __SESSION_SPOOL_H__
+#define __SESSION_SPOOL_H__
+
+#include <QFuture>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+#include "CaptureFile.h"
+#include "SessionExporter.h"
+
+// The running session's records, kept in capture files on disk so a long
+// session doesn't grow the process. The spool is a ring of segment files:
+// once they add up to more than maxBytes the oldest segment is deleted, so a
+// multi-day session keeps its most recent part and the disk doesn't fill up.
+// The files go in the app's cache directory by default. A directory on tmpfs,
+// as /tmp often is, would hold the spool in RAM again.
+// Readers get a snapshot of what was written when they asked and read it on
+// their own thread while appends carry on.
+class SessionSpool
+{
+public:
+    static constexpr qint64 kDefaultMaxBytes = 1024LL * 1024 * 1024;
+    static constexpr qint64 kMinMaxBytes = 16LL * 1024 * 1024;
+    static constexpr int kSegmentsPerSpool = 8;
+
+private:
+    struct Segment
+    {
+        QString path;
+        qint64 size = 0;
+        qint64 records = 0;
+    };
+
+    CaptureFileWriter m_writer;
+    QString m_path;            // the segment being written
+    QList<Segment> m_segments; // finished segments, oldest first
+    qint64 m_segmentBytes = 0;
+    qint64 m_segmentRecords = 0;
+    QString m_directory;
+    qint64 m_maxBytes = kDefaultMaxBytes;
+    qint64 m_wallClockOffsetNs = 0;
+    qint64 m_droppedRecords = 0;
+
+    bool openSegment();
+    bool rotate();
+    void trim();
+    void removeFiles();
+
+public:
+    SessionSpool();
+    ~SessionSpool();
+
+    // Empty means defaultDirectory(). Takes effect at the next open().
+    void setDirectory(const QString &directory);
+    QString directory() const;
+    static QString defaultDirectory();
+    // Clamped to kMinMaxBytes; a lower cap drops old segments right away.
+    void setMaxBytes(qint64 maxBytes);
+    qint64 maxBytes() const;
+
+    // Starts an empty spool, dropping the previous one.
+    bool open(qint64 wallClockOffsetNs);
+    void close();
+    bool isOpen() const;
+
+    bool append(const CaptureRecord &record);
+    bool isEmpty() const;
+    // Records still in the spool, and records lost to the size cap since open().
+    qint64 recordCount() const;
+    qint64 droppedRecords() const;
+    qint64 sizeOnDisk() const;
+    qint64 wallClockOffsetNs() const;
+    QString fileName() const;
+
+    // The records appended so far; later appends are not part of it.
+    std::unique_ptr<ExportSource> exportSource(QString *errorString = nullptr);
+    // Copies the records appended so far into a standalone capture on the pool.
+    QFuture<bool> saveSnapshot(const QString &path);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef __SHM_PUBLISHER_H__
+#define __SHM_PUBLISHER_H__
+
+#include <QByteArray>
+#include <QString>
+
+#include "ShmRing.h"
+
+// Publishes received chunks into the POSIX shared-memory ring described in ShmRing.h.
+// Linux only; open() fails elsewhere.
+class ShmPublisher
+{
+public:
+    static constexpr qint64 kDefaultCapacity = 4 * 1024 * 1024;
+
+private:
+#if defined(__linux__)
+    ds_shm_writer m_writer;
+#endif
+    bool m_open = false;
+    QString m_name;
+    QString m_lastError;
+
+public:
+    ShmPublisher();
+    ~ShmPublisher();
+
+    bool open(const QString &name, qint64 capacity = kDefaultCapacity);
+    void close();
+    bool isOpen() const;
+
+    void publish(const QByteArray &data, qint64 timestampNs);
+
+    QString name() const;
+    QString lastError() const;
+};
+
+#endif
@@ -0,0 +1,547 @@
+#pragma once
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+/*
+ * Shared-memory ring carrying the live RX stream to other local processes.
+ * Plain C so decoders and loggers can include it without Qt (Python can use
+ * the same layout through ctypes/mmap).
+ *
+ * One writer (the app), any number of readers. Readers never lock and never
+ * slow the writer down: a reader that falls more than `capacity` bytes behind
+ * sees an overrun and resynchronises to the newest record.
+ *
+ * Mapping layout (each part starts on a page boundary):
+ *   [ds_shm_ring_header, 128 bytes][ds_shm_ring_shared][data area, capacity bytes (power of two)]
+ * page_size, shared_offset and data_offset are in the header.
+ * Data area holds ds_shm_ring_record headers, each followed by its payload,
+ * padded to 8 bytes. A record never wraps: the writer pads to the end of the
+ * area (PAD record, or nothing if fewer than sizeof(record) bytes remain).
+ *
+ * Positions are monotonically increasing byte counters; offset = pos & (capacity - 1).
+ * The writer publishes reserve_pos before touching the data area and write_pos
+ * after, so a reader knows its bytes are intact while reserve_pos <= read_pos + capacity.
+ *
+ * A writer that goes away or replaces the ring under the same name sets `closed`
+ * in the old header and wakes every waiter; readers then reopen by name.
+ *
+ * Readers map the header and the data area read-only, so a buggy or hostile
+ * reader can't touch write_pos, last_seq or the records other readers see.
+ * The one word readers write, the waiter count, sits alone on its own page
+ * (ds_shm_ring_shared) with a separate read-write mapping. The worst a reader
+ * can do there is make the writer wake nobody, which only delays readers
+ * until their wait timeout. They wait on `notify` in the read-only header;
+ * FUTEX_WAIT only needs read access.
+ *
+ * Linux only (futex wakeup on a shared word).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DS_SHM_RING_MAGIC 0x52525344u /* "DSRR" */
+#define DS_SHM_RING_VERSION 2u
+#define DS_SHM_RING_DEFAULT_NAME "/desktop_serial_rx"
+
+#define DS_SHM_RECORD_PAD 0x1u
+#define DS_SHM_RECORD_CONTINUED 0x2u /* chunk was split, more pieces follow */
+
+typedef struct ds_shm_ring_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t data_offset;
+    uint64_t writer_pid;
+    uint64_t reserve_pos;
+    uint64_t write_pos;
+    uint64_t last_seq;
+    uint32_t notify; /* futex word, bumped on every commit */
+    uint32_t closed; /* set once this ring is retired; reopen by name */
+    uint64_t shared_offset;
+    uint64_t page_size; /* the writer's; shared_offset and data_offset are multiples */
+    uint8_t reserved[128 - 80];
+} ds_shm_ring_header;
+
+/* The only reader-writable part of the ring, alone on its page. */
+typedef struct ds_shm_ring_shared
+{
+    uint32_t waiters; /* readers blocked in ds_shm_reader_wait */
+    uint32_t reserved0;
+} ds_shm_ring_shared;
+
+typedef struct ds_shm_ring_record
+{
+    uint32_t length;
+    uint32_t flags;
+    uint64_t seq;
+    uint64_t timestamp_ns; /* CLOCK_MONOTONIC when the chunk arrived */
+} ds_shm_ring_record;
+
+typedef char ds_shm_ring_header_size_check[sizeof(ds_shm_ring_header) == 128 ? 1 : -1];
+typedef char ds_shm_ring_record_size_check[sizeof(ds_shm_ring_record) == 24 ? 1 : -1];
+
+typedef struct ds_shm_writer
+{
+    ds_shm_ring_header *header;
+    ds_shm_ring_shared *shared;
+    uint8_t *data;
+    size_t map_size;
+    int fd;
+    char name[256];
+} ds_shm_writer;
+
+typedef struct ds_shm_reader
+{
+    const ds_shm_ring_header *header; /* start of the read-only mapping of the whole ring */
+    ds_shm_ring_shared *shared;       /* separate read-write mapping of the shared page */
+    const uint8_t *data;
+    size_t map_size;
+    size_t shared_map_size;
+    int fd;
+    uint64_t read_pos;
+    uint64_t pending_pos; /* read_pos after the record returned by peek */
+    uint64_t last_seq;
+    uint64_t overruns;
+    uint64_t lost_records;
+} ds_shm_reader;
+
+static inline uint64_t ds_shm_align8(uint64_t value)
+{
+    return (value + 7u) & ~(uint64_t)7u;
+}
+
+#if defined(__linux__)
+
+static inline uint64_t ds_shm_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void ds_shm_futex_wake(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static inline int ds_shm_futex_wait(uint32_t *word, uint32_t expected, int timeout_ms)
+{
+    struct timespec timeout;
+    struct timespec *timeout_ptr = NULL;
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+    return (int)syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout_ptr, NULL, 0);
+}
+
+static inline void ds_shm_header_mark_closed(ds_shm_ring_header *header)
+{
+    __atomic_store_n(&header->closed, 1u, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&header->notify, 1u, __ATOMIC_SEQ_CST);
+    ds_shm_futex_wake(&header->notify);
+}
+
+/* ===== Writer ===== */
+
+/* Marks an existing ring under name closed so readers still mapping it reattach. */
+static inline void ds_shm_ring_retire(const char *name)
+{
+    struct stat st;
+    void *map;
+    const int fd = shm_open(name, O_RDWR, 0);
+
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ds_shm_ring_header)) {
+        map = mmap(NULL, sizeof(ds_shm_ring_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            ds_shm_ring_header *header = (ds_shm_ring_header *)map;
+            if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == DS_SHM_RING_MAGIC) {
+                ds_shm_header_mark_closed(header);
+            }
+            munmap(map, sizeof(ds_shm_ring_header));
+        }
+    }
+
+    close(fd);
+}
+
+/* capacity is rounded up to a power of two. Returns 0 on success, -errno on failure. */
+static inline int ds_shm_writer_open(ds_shm_writer *writer, const char *name, uint64_t capacity)
+{
+    uint64_t rounded = 4096;
+    const long page_size = sysconf(_SC_PAGESIZE);
+    const uint64_t page = page_size > 0 ? (uint64_t)page_size : 4096u;
+    size_t map_size;
+    void *map;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = -1;
+
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    if (strlen(name) >= sizeof(writer->name)) {
+        return -ENAMETOOLONG;
+    }
+    strcpy(writer->name, name);
+
+    /* Recreate so a reader still mapping an old ring never sees a resized one;
+       the old one is flagged first so its readers move over. */
+    ds_shm_ring_retire(name);
+    shm_unlink(name);
+    writer->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (writer->fd < 0) {
+        return -errno;
+    }
+
+    map_size = (size_t)(2 * page + rounded);
+    if (ftruncate(writer->fd, (off_t)map_size) != 0) {
+        int error = errno;
+        close(writer->fd);
+        shm_unlink(name);
+        writer->fd = -1;
+        return -error;
+    }
+
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+    if (map == MAP_FAILED) {
+        int error = errno;
+        close(writer->fd);
+        shm_unlink(name);
+        writer->fd = -1;
+        return -error;
+    }
+
+    writer->header = (ds_shm_ring_header *)map;
+    writer->shared = (ds_shm_ring_shared *)((uint8_t *)map + page);
+    writer->data = (uint8_t *)map + 2 * page;
+    writer->map_size = map_size;
+
+    writer->header->capacity = rounded;
+    writer->header->page_size = page;
+    writer->header->shared_offset = page;
+    writer->header->data_offset = 2 * page;
+    writer->header->writer_pid = (uint64_t)getpid();
+    writer->header->version = DS_SHM_RING_VERSION;
+    /* Magic last: readers treat a ring without it as not ready yet. */
+    __atomic_store_n(&writer->header->magic, DS_SHM_RING_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static inline void ds_shm_writer_close(ds_shm_writer *writer)
+{
+    if (writer->header != NULL) {
+        ds_shm_header_mark_closed(writer->header);
+        munmap(writer->header, writer->map_size);
+        writer->header = NULL;
+        writer->shared = NULL;
+        writer->data = NULL;
+    }
+
+    if (writer->fd >= 0) {
+        close(writer->fd);
+        shm_unlink(writer->name);
+        writer->fd = -1;
+    }
+}
+
+static inline void ds_shm_writer_put(ds_shm_writer *writer,
+                                     const uint8_t *payload,
+                                     uint32_t length,
+                                     uint32_t flags,
+                                     uint64_t timestamp_ns)
+{
+    ds_shm_ring_header *header = writer->header;
+    const uint64_t capacity = header->capacity;
+    const uint64_t total = ds_shm_align8(sizeof(ds_shm_ring_record) + length);
+    uint64_t pos = header->write_pos;
+    uint64_t offset = pos & (capacity - 1);
+    ds_shm_ring_record *record;
+
+    if (capacity - offset < total) {
+        const uint64_t remaining = capacity - offset;
+        __atomic_store_n(&header->reserve_pos, pos + remaining, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (remaining >= sizeof(ds_shm_ring_record)) {
+            record = (ds_shm_ring_record *)(writer->data + offset);
+            record->length = 0;
+            record->flags = DS_SHM_RECORD_PAD;
+            record->seq = 0;
+            record->timestamp_ns = 0;
+        }
+        pos += remaining;
+        offset = 0;
+    }
+
+    __atomic_store_n(&header->reserve_pos, pos + total, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    record = (ds_shm_ring_record *)(writer->data + offset);
+    record->length = length;
+    record->flags = flags;
+    record->seq = header->last_seq + 1;
+    record->timestamp_ns = timestamp_ns;
+    memcpy(record + 1, payload, length);
+
+    __atomic_store_n(&header->last_seq, record->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->write_pos, pos + total, __ATOMIC_RELEASE);
+}
+
+/* Publishes one chunk; chunks larger than a quarter of the ring are split. */
+static inline void ds_shm_writer_publish(ds_shm_writer *writer,
+                                         const void *payload,
+                                         size_t length,
+                                         uint64_t timestamp_ns)
+{
+    const uint8_t *bytes = (const uint8_t *)payload;
+    const size_t max_piece = (size_t)(writer->header->capacity / 4) - sizeof(ds_shm_ring_record);
+
+    while (length > max_piece) {
+        ds_shm_writer_put(writer, bytes, (uint32_t)max_piece, DS_SHM_RECORD_CONTINUED, timestamp_ns);
+        bytes += max_piece;
+        length -= max_piece;
+    }
+    ds_shm_writer_put(writer, bytes, (uint32_t)length, 0, timestamp_ns);
+
+    __atomic_add_fetch(&writer->header->notify, 1u, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writer->shared->waiters, __ATOMIC_SEQ_CST) != 0) {
+        ds_shm_futex_wake(&writer->header->notify);
+    }
+}
+
+/* ===== Reader ===== */
+
+static inline void ds_shm_reader_close(ds_shm_reader *reader)
+{
+    if (reader->shared != NULL) {
+        munmap(reader->shared, reader->shared_map_size);
+        reader->shared = NULL;
+    }
+
+    if (reader->header != NULL) {
+        munmap((void *)reader->header, reader->map_size);
+        reader->header = NULL;
+        reader->data = NULL;
+    }
+
+    if (reader->fd >= 0) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
+
+/* 1 once the writer has gone away or replaced the ring: close and reopen by name. */
+static inline int ds_shm_reader_closed(const ds_shm_reader *reader)
+{
+    return __atomic_load_n(&reader->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+/* Starts at the live tail. Returns 0 on success, -errno on failure (-EAGAIN: ring not ready). */
+static inline int ds_shm_reader_open(ds_shm_reader *reader, const char *name)
+{
+    struct stat st;
+    void *map;
+    const ds_shm_ring_header *header;
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    memset(reader, 0, sizeof(*reader));
+    /* Read-only descriptor for the ring; only the shared page below is mapped
+       through a writable one. */
+    reader->fd = shm_open(name, O_RDONLY, 0);
+    if (reader->fd < 0) {
+        return -errno;
+    }
+
+    if (fstat(reader->fd, &st) != 0 || (size_t)st.st_size < sizeof(ds_shm_ring_header)) {
+        close(reader->fd);
+        reader->fd = -1;
+        return -EAGAIN;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (map == MAP_FAILED) {
+        int error = errno;
+        close(reader->fd);
+        reader->fd = -1;
+        return -error;
+    }
+    reader->header = header = (const ds_shm_ring_header *)map;
+    reader->map_size = (size_t)st.st_size;
+
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != DS_SHM_RING_MAGIC
+        || header->version != DS_SHM_RING_VERSION
+        || page_size <= 0
+        || header->page_size != (uint64_t)page_size
+        || header->shared_offset < sizeof(ds_shm_ring_header)
+        || header->shared_offset % (uint64_t)page_size != 0
+        || header->data_offset < header->shared_offset + (uint64_t)page_size
+        || header->data_offset + header->capacity > reader->map_size
+        || __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE) != 0) {
+        ds_shm_reader_close(reader);
+        return -EAGAIN;
+    }
+
+    {
+        /* Only the shared page is mapped writable. */
+        const int rw_fd = shm_open(name, O_RDWR, 0);
+        if (rw_fd < 0) {
+            int error = errno;
+            ds_shm_reader_close(reader);
+            return -error;
+        }
+        map = mmap(NULL, (size_t)page_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, (off_t)header->shared_offset);
+        close(rw_fd);
+        if (map == MAP_FAILED) {
+            int error = errno;
+            ds_shm_reader_close(reader);
+            return -error;
+        }
+        reader->shared = (ds_shm_ring_shared *)map;
+        reader->shared_map_size = (size_t)page_size;
+    }
+
+    reader->data = (const uint8_t *)header + header->data_offset;
+    reader->read_pos = __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE);
+    reader->pending_pos = reader->read_pos;
+    reader->last_seq = __atomic_load_n(&header->last_seq, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+static inline int ds_shm_reader_intact(const ds_shm_reader *reader, uint64_t pos)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&reader->header->reserve_pos, __ATOMIC_RELAXED)
+        <= pos + reader->header->capacity;
+}
+
+static inline void ds_shm_reader_resync(ds_shm_reader *reader)
+{
+    reader->overruns++;
+    reader->read_pos = __atomic_load_n(&reader->header->write_pos, __ATOMIC_ACQUIRE);
+    reader->pending_pos = reader->read_pos;
+}
+
+/*
+ * Points record and payload straight into shared memory (no copy).
+ * Returns 1 when a record is available, 0 when caught up, -1 after an overrun
+ * (the reader has already skipped to the newest data).
+ * The payload must be validated with ds_shm_reader_consume() after use.
+ */
+static inline int ds_shm_reader_peek(ds_shm_reader *reader,
+                                     const ds_shm_ring_record **record,
+                                     const uint8_t **payload)
+{
+    const uint64_t capacity = reader->header->capacity;
+
+    for (;;) {
+        const uint64_t write_pos = __atomic_load_n(&reader->header->write_pos, __ATOMIC_ACQUIRE);
+        uint64_t offset;
+        const ds_shm_ring_record *candidate;
+        uint32_t length;
+        uint32_t flags;
+
+        if (write_pos == reader->read_pos) {
+            return 0;
+        }
+
+        if (write_pos - reader->read_pos > capacity) {
+            ds_shm_reader_resync(reader);
+            return -1;
+        }
+
+        offset = reader->read_pos & (capacity - 1);
+        if (capacity - offset < sizeof(ds_shm_ring_record)) {
+            reader->read_pos += capacity - offset;
+            continue;
+        }
+
+        candidate = (const ds_shm_ring_record *)(reader->data + offset);
+        length = candidate->length;
+        flags = candidate->flags;
+        if (!ds_shm_reader_intact(reader, reader->read_pos)) {
+            ds_shm_reader_resync(reader);
+            return -1;
+        }
+
+        if (flags & DS_SHM_RECORD_PAD) {
+            reader->read_pos += capacity - offset;
+            continue;
+        }
+
+        if (length > capacity - offset - sizeof(ds_shm_ring_record)) {
+            ds_shm_reader_resync(reader);
+            return -1;
+        }
+
+        *record = candidate;
+        *payload = (const uint8_t *)(candidate + 1);
+        reader->pending_pos = reader->read_pos + ds_shm_align8(sizeof(ds_shm_ring_record) + length);
+        return 1;
+    }
+}
+
+/* Returns 0 if the peeked record was intact while in use, -1 if it was overwritten. */
+static inline int ds_shm_reader_consume(ds_shm_reader *reader, const ds_shm_ring_record *record)
+{
+    const uint64_t seq = record->seq;
+
+    if (!ds_shm_reader_intact(reader, reader->read_pos)) {
+        ds_shm_reader_resync(reader);
+        return -1;
+    }
+
+    if (reader->last_seq != 0 && seq > reader->last_seq + 1) {
+        reader->lost_records += seq - reader->last_seq - 1;
+    }
+    reader->last_seq = seq;
+    reader->read_pos = reader->pending_pos;
+    return 0;
+}
+
+/* Blocks until the writer commits something new, retires the ring, or
+   timeout_ms elapses (-1 = forever). */
+static inline void ds_shm_reader_wait(ds_shm_reader *reader, int timeout_ms)
+{
+    const ds_shm_ring_header *header = reader->header;
+    const uint32_t seen = __atomic_load_n(&header->notify, __ATOMIC_SEQ_CST);
+
+    __atomic_add_fetch(&reader->shared->waiters, 1u, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->write_pos, __ATOMIC_SEQ_CST) == reader->read_pos
+        && !ds_shm_reader_closed(reader)) {
+        ds_shm_futex_wait((uint32_t *)&header->notify, seen, timeout_ms);
+    }
+    __atomic_sub_fetch(&reader->shared->waiters, 1u, __ATOMIC_SEQ_CST);
+}
+
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
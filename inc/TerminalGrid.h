@@ -0,0 +1,195 @@
+#pragma once
+
+#ifndef __TERMINAL_GRID_H__
+#define __TERMINAL_GRID_H__
+
+#include <QList>
+#include <QtGlobal>
+
+// Palette indices 0..255, truecolor is kTerminalRgbColor | 0xRRGGBB.
+constexpr quint32 kTerminalDefaultColor = 0xFFFFFFFF;
+constexpr quint32 kTerminalRgbColor = 0x01000000;
+
+enum TerminalAttribute {
+    TerminalBold = 0x01,
+    TerminalDim = 0x02,
+    TerminalItalic = 0x04,
+    TerminalUnderline = 0x08,
+    TerminalBlink = 0x10,
+    TerminalInverse = 0x20,
+    TerminalHidden = 0x40,
+    TerminalStrike = 0x80,
+};
+
+struct TerminalCell
+{
+    char32_t ch = U' ';
+    quint32 fg = kTerminalDefaultColor;
+    quint32 bg = kTerminalDefaultColor;
+    quint16 attrs = 0;
+
+    bool sameStyle(const TerminalCell &other) const
+    {
+        return fg == other.fg && bg == other.bg && attrs == other.attrs;
+    }
+};
+
+using TerminalLine = QList<TerminalCell>;
+
+struct TerminalRowDamage
+{
+    int row = 0;
+    int firstColumn = 0;
+    int lastColumn = 0; // inclusive
+};
+
+struct TerminalDamage
+{
+    bool full = false;
+    int scrolledLines = 0; // whole-screen scroll that happened before the row damage
+    QList<TerminalRowDamage> rows;
+};
+
+// Character-cell screen of a VT100/xterm terminal. The primary screen is the
+// tail of a ring of lines, so a full-screen scroll moves a line into
+// scrollback in O(1) instead of shifting every row. Every write records the
+// touched column range per row; a renderer collects it with takeDamage() and
+// repaints only those cells, plus a blit for whole-screen scrolls.
+class TerminalGrid
+{
+public:
+    static constexpr int kDefaultScrollback = 5000;
+
+private:
+    int m_columns = 80;
+    int m_rows = 24;
+    int m_scrollbackLimit = kDefaultScrollback;
+
+    QList<TerminalLine> m_lines; // ring: scrollback followed by the primary screen
+    qsizetype m_ringStart = 0;
+    qsizetype m_lineCount = 0;
+    QList<TerminalLine> m_altScreen;
+    bool m_altActive = false;
+
+    struct SavedCursor
+    {
+        int row = 0;
+        int column = 0;
+        TerminalCell pen;
+        bool originMode = false;
+        bool charsetGraphics[2] = {false, false}; // G0, G1
+        int activeCharset = 0;
+    };
+
+    int m_cursorRow = 0;
+    int m_cursorColumn = 0;
+    bool m_wrapPending = false;
+    TerminalCell m_pen;
+    SavedCursor m_savedCursor;
+    SavedCursor m_savedAltCursor;
+    int m_scrollTop = 0;
+    int m_scrollBottom = 23;
+    QList<bool> m_tabStops;
+
+    bool m_autoWrap = true;
+    bool m_originMode = false;
+    bool m_insertMode = false;
+    bool m_cursorVisible = true;
+    bool m_applicationCursorKeys = false;
+    bool m_charsetGraphics[2] = {false, false}; // G0, G1 designated as DEC special graphics
+    int m_activeCharset = 0;                    // shifted in with SI (G0) / SO (G1)
+    bool m_decGraphics = false;                 // the active one, for print()
+    char32_t m_lastPrinted = U' ';
+
+    QList<int> m_damageFirst; // per row, first > last means clean
+    QList<int> m_damageLast;
+    int m_scrolledLines = 0;
+    bool m_fullDamage = true;
+
+    qsizetype ringCapacity() const;
+    QList<TerminalLine> takePrimaryLines();
+    void setPrimaryLines(QList<TerminalLine> lines);
+    TerminalLine &screenLine(int row);
+    TerminalLine blankLine() const;
+    TerminalCell blankCell() const;
+    void damage(int row, int firstColumn, int lastColumn);
+    void damageRows(int firstRow, int lastRow);
+    void damageAll();
+    void scrollRegionUp(int top, int bottom, int count, bool keepHistory);
+    void scrollRegionDown(int top, int bottom, int count);
+    void resetTabStops();
+    void clampCursor();
+
+public:
+    TerminalGrid();
+
+    int columns() const;
+    int rows() const;
+    void resize(int columns, int rows);
+    void setScrollbackLimit(int lines);
+    int scrollbackSize() const;
+
+    // row in [-scrollbackSize(), rows()); negative rows are history, oldest first.
+    // Lines may be shorter or longer than columns(); missing cells are blank.
+    const TerminalLine &lineAt(int row) const;
+
+    int cursorRow() const;
+    int cursorColumn() const;
+    bool isCursorVisible() const;
+    bool applicationCursorKeys() const;
+    bool isAlternateScreen() const;
+
+    void takeDamage(TerminalDamage &damage);
+    void reset();
+    void clearScrollback();
+
+    // Printing
+    TerminalCell &pen();
+    void print(char32_t ch);
+    void printAscii(const char *text, qsizetype length);
+    void repeatLastCharacter(int count);
+    // Charset state is saved and restored with the cursor (DECSC/DECRC).
+    void designateCharset(int slot, bool decGraphics);
+    void selectCharset(int slot);
+
+    // C0 controls
+    void carriageReturn();
+    void lineFeed();
+    void reverseLineFeed();
+    void backspace();
+    void tab(int count = 1);
+    void backTab(int count = 1);
+    void setTabStop();
+    void clearTabStop(bool all);
+
+    // Cursor, 0-based; moveCursorTo honours origin mode.
+    void moveCursorTo(int row, int column);
+    void moveCursorBy(int rows, int columns);
+    void setCursorColumn(int column);
+    void setCursorRow(int row);
+    void saveCursor();
+    void restoreCursor();
+
+    // Editing
+    void eraseInDisplay(int mode);
+    void eraseInLine(int mode);
+    void eraseCharacters(int count);
+    void insertCharacters(int count);
+    void deleteCharacters(int count);
+    void insertLines(int count);
+    void deleteLines(int count);
+    void scrollUp(int count);
+    void scrollDown(int count);
+    void setScrollRegion(int top, int bottom);
+    void fillWithE();
+
+    // Modes
+    void setAutoWrap(bool enabled);
+    void setOriginMode(bool enabled);
+    void setInsertMode(bool enabled);
+    void setCursorVisible(bool visible);
+    void setApplicationCursorKeys(bool enabled);
+    void setAlternateScreen(bool enabled, bool saveAndClear);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+
+#ifndef __TIMELINE_MERGER_H__
+#define __TIMELINE_MERGER_H__
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "CaptureFile.h"
+#include "SessionExporter.h"
+
+// Heap entry for a channel's head record; ties go to the lower channel so the
+// merge is deterministic.
+struct TimelineHead
+{
+    qint64 timestampNs = 0;
+    int channel = 0;
+
+    bool operator>(const TimelineHead &other) const
+    {
+        return timestampNs != other.timestampNs ? timestampNs > other.timestampNs : channel > other.channel;
+    }
+};
+
+// Offline k-way merge of several record streams (usually capture files) into
+// one time-ordered stream, tagging each record with its source as channel.
+// Each source is read a batch at a time and only its head sits in the heap,
+// so memory is k batches and every record costs O(log k). Sources recorded by
+// different sessions are aligned on wall clock and rebased onto the first
+// source's clock.
+class TimelineMerger : public ExportSource
+{
+public:
+    static constexpr int kMaxSources = 256; // CaptureRecord::channel is a byte
+    static constexpr int kSourceBatchRecords = 4096;
+
+private:
+    struct Cursor
+    {
+        std::unique_ptr<ExportSource> source;
+        QString name;
+        QList<CaptureRecord> batch;
+        qsizetype next = 0;
+        qint64 rebaseNs = 0; // added to this source's timestamps
+        bool exhausted = false;
+    };
+
+    std::vector<Cursor> m_cursors;
+    std::vector<TimelineHead> m_heap;
+    bool m_started = false;
+    QString m_errorString;
+
+    bool refill(int channel);
+    void pushHead(int channel);
+
+public:
+    bool addSource(std::unique_ptr<ExportSource> source, const QString &name);
+    int sourceCount() const;
+
+    bool readBatch(QList<CaptureRecord> &batch, int maxRecords) override;
+    double progress() const override;
+    qint64 wallClockOffsetNs() const override;
+    QString errorString() const override;
+    QStringList channelNames() const override;
+
+    static std::unique_ptr<TimelineMerger> fromCaptureFiles(const QStringList &paths, QString *errorString = nullptr);
+};
+
+// Live merge of chunks pushed from several ports. A chunk is released once
+// no channel can still produce an earlier one: every active channel has been
+// seen at or past its timestamp, or it is older than the hold time. Channels
+// are stamped on arrival, so an idle channel holds the others back by at most
+// the hold time.
+class LiveTimelineMerger
+{
+public:
+    using OutputCallback = std::function<void(const CaptureRecord &record)>;
+    static constexpr qint64 kDefaultHoldNs = 20 * 1000 * 1000;
+
+private:
+    struct Channel
+    {
+        QString name;
+        std::deque<CaptureRecord> pending;
+        qint64 lastTimestampNs = std::numeric_limits<qint64>::min();
+        bool active = true;
+    };
+
+    std::vector<Channel> m_channels;
+    std::vector<TimelineHead> m_heap;
+    OutputCallback m_outputCallback;
+    QTimer m_timer;
+    qint64 m_holdNs = kDefaultHoldNs;
+    qint64 m_lastEmittedNs = std::numeric_limits<qint64>::min();
+    qint64 m_pendingRecords = 0;
+    quint64 m_recordsMerged = 0;
+    quint64 m_lateRecords = 0;
+
+    void release(qint64 watermarkNs);
+    void scheduleRelease();
+
+public:
+    LiveTimelineMerger();
+
+    int addChannel(const QString &name);
+    void setChannelActive(int channel, bool active);
+    bool isChannelActive(int channel) const;
+    int channelCount() const;
+    QStringList channelNames() const;
+    void setHoldNs(qint64 holdNs);
+    qint64 holdNs() const;
+    void setOutputCallback(OutputCallback callback);
+
+    // Timestamps must not go backwards within a channel.
+    void push(int channel, CaptureDirection direction, const QByteArray &data, qint64 timestampNs);
+    void releaseDue();
+    void flush();
+    void clear();
+
+    qint64 pendingRecords() const;
+    quint64 recordsMerged() const;
+    quint64 lateRecords() const;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef __TRIGGER_ENGINE_H__
+#define __TRIGGER_ENGINE_H__
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+enum TriggerAction {
+    TriggerHighlight = 0x01,
+    TriggerNotify = 0x02,
+    TriggerStopCapture = 0x04,
+    TriggerSnapshotCapture = 0x08,
+    TriggerReply = 0x10,
+};
+
+struct TriggerRule
+{
+    QString source;   // the rule line as the user wrote it
+    QByteArray pattern;
+    int actions = TriggerHighlight;
+    QByteArray reply;
+};
+
+struct TriggerMatch
+{
+    int ruleIndex = -1;
+    qsizetype endInChunk = 0; // one past the last matched byte, relative to the chunk fed
+};
+
+// All rule patterns compiled into one Aho-Corasick automaton, expanded to a full
+// 256-column DFA so each input byte costs one table lookup no matter how many
+// patterns are loaded. State carries across feed() calls, so patterns split
+// between readAll() chunks still match.
+class TriggerEngine
+{
+public:
+    using MatchCallback = std::function<void(const TriggerMatch &match)>;
+
+private:
+    QList<TriggerRule> m_rules;
+    QList<qint32> m_transitions;    // state * 256 + byte -> next state
+    QList<qint32> m_outputOffsets;  // state -> first entry in m_outputs, size = states + 1
+    QList<qint32> m_outputs;        // rule indices, including those reached through failure links
+    qint32 m_state = 0;
+
+public:
+    TriggerEngine();
+
+    void setRules(const QList<TriggerRule> &rules);
+    const QList<TriggerRule> &rules() const;
+    bool isEmpty() const;
+    int stateCount() const;
+
+    void reset();
+    void feed(const QByteArray &data, const MatchCallback &callback);
+
+    // One rule per line: "<text|hex>:<pattern> => <action>[, <action>...]"
+    // actions: highlight, notify, stop, snapshot, reply:<text>, replyhex:<hex>
+    // Patterns take TxEncoder::unescape() escapes or hex pairs; replies follow
+    // TxEncoder's Escaped and Hex formats. A line that fails to parse is left
+    // out and reported in errorString; the other rules are still returned.
+    static bool parseRules(const QString &text, QList<TriggerRule> &rules, QString *errorString = nullptr);
+};
+
+#endif
@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef __TX_ENCODER_H__
+#define __TX_ENCODER_H__
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+enum class TxFormat {
+    Text,    // UTF-8, sent as typed
+    Escaped, // UTF-8 with C escapes (\r \n \t \0 \e \\ \xHH) and placeholders
+    Hex,     // hex byte pairs; whitespace, ',' ':' and 0x prefixes are ignored; placeholders
+};
+
+enum class TxLineEnding {
+    None,
+    Lf,
+    Cr,
+    CrLf,
+};
+
+struct TxEncodeOptions {
+    TxFormat format = TxFormat::Text;
+    TxLineEnding lineEnding = TxLineEnding::None;
+};
+
+// Single-pass encoder for TX payloads. Input can be fed in chunks of any size,
+// either as QString text or as raw UTF-8 bytes (e.g. a file), and escapes,
+// placeholders and hex pairs may straddle chunk boundaries. Encoded bytes are
+// appended to one output buffer that the caller drains with takeOutput().
+//
+// Placeholders (Escaped and Hex formats):
+//   {len}          one byte, the number of bytes after it up to the next
+//                  {crc16...} or the end of the payload
+//   {crc16}        CRC-16/MODBUS of the frame so far, low byte first
+//   {crc16:xmodem} CRC-16/XMODEM of the frame so far, high byte first
+// A frame starts at the beginning of the payload and after every CRC. The line
+// ending is appended after the last frame and is not covered by either.
+//
+// Errors carry the offset of the offending input character (UTF-16 units for
+// QString input, bytes for UTF-8 input), counted from the first feed().
+class TxEncoder
+{
+public:
+    static constexpr int kMaxLenSpan = 255;
+    static constexpr int kMaxPlaceholderLength = 16;
+
+private:
+    enum class State {
+        Normal,
+        Escape,    // after '\'
+        EscapeHex, // after '\x'
+        Placeholder,
+    };
+
+    TxEncodeOptions m_options;
+    State m_state = State::Normal;
+    QByteArray m_output;
+    QByteArray m_token; // escape digits or placeholder name collected so far
+    qint64 m_position = 0;
+    qint64 m_tokenPosition = -1;
+    int m_pendingNibble = -1;
+    qint64 m_nibblePosition = -1;
+    char16_t m_highSurrogate = 0;
+    qsizetype m_lenOffset = -1; // into m_output; -1 when no {len} is open
+    qint64 m_lenPosition = -1;
+    qsizetype m_crcFolded = 0; // m_output bytes before this are in the running CRCs
+    quint16 m_crcModbus = 0;
+    quint16 m_crcXmodem = 0;
+    bool m_finished = false;
+    qint64 m_errorPosition = -1;
+    QString m_errorString;
+
+    template <typename Char>
+    bool feedChars(const Char *data, qsizetype size);
+    template <typename Char>
+    qsizetype feedHexRun(const Char *data, qsizetype size);
+    template <typename Char>
+    qsizetype feedTextRun(const Char *data, qsizetype size);
+
+    bool consumeHex(char32_t ch, qint64 position);
+    bool consumeText(char32_t ch, qint64 position);
+    bool consumePlaceholder(char32_t ch);
+    bool resolvePlaceholder(const QByteArray &name, qint64 position);
+    void appendCodeUnit(char32_t ch);
+    bool closeLen();
+    void foldCrc(qsizetype end);
+    bool fail(qint64 position, const QString &message);
+
+public:
+    TxEncoder();
+    explicit TxEncoder(const TxEncodeOptions &options);
+
+    void reset(const TxEncodeOptions &options);
+    const TxEncodeOptions &options() const;
+
+    bool feed(QStringView text);
+    bool feed(QByteArrayView utf8);
+    bool finish();
+
+    // Bytes that are final. Bytes after an open {len} stay until its span ends.
+    QByteArray takeOutput();
+    qsizetype outputSize() const;
+    qint64 inputPosition() const;
+
+    bool hasError() const;
+    qint64 errorPosition() const;
+    QString errorString() const;
+
+    static bool encode(QStringView text,
+                       const TxEncodeOptions &options,
+                       QByteArray &bytes,
+                       QString *errorString = nullptr,
+                       qint64 *errorPosition = nullptr);
+    static QByteArray lineEndingBytes(TxLineEnding lineEnding);
+
+    // For match patterns, which describe received bytes: the Escaped format's
+    // escapes without placeholders, so '{' is literal. Unknown or incomplete
+    // escapes are kept as written rather than rejected.
+    static QByteArray unescape(QStringView text);
+    // Hex pairs and separators as in the Hex format, without placeholders.
+    static bool decodeHex(QStringView text, QByteArray &bytes, QString *errorString = nullptr);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef __VT_PARSER_H__
+#define __VT_PARSER_H__
+
+#include <QByteArray>
+#include <QString>
+
+#include <functional>
+
+class TerminalGrid;
+
+// Incremental VT100/xterm escape-sequence parser (a trimmed-down version of the
+// DEC ANSI state machine) that drives a TerminalGrid. Sequences and UTF-8
+// characters may be split across feed() calls. Runs of printable ASCII skip the
+// state machine and go to the grid in one call.
+class VtParser
+{
+public:
+    using ReplyCallback = std::function<void(const QByteArray &reply)>;
+    static constexpr int kMaxParameters = 16;
+    static constexpr int kMaxStringLength = 4096;
+
+private:
+    enum class State {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        Csi,
+        CsiIgnore,
+        OscString,
+        StringIgnore,
+    };
+
+    TerminalGrid &m_grid;
+    ReplyCallback m_replyCallback;
+    State m_state = State::Ground;
+
+    int m_params[kMaxParameters] = {};
+    int m_paramCount = 0;
+    quint32 m_subParameters = 0; // bit i: m_params[i] followed a ':'
+    char m_privateMarker = 0;
+    char m_intermediate = 0;
+    QByteArray m_string;
+    bool m_stringEscape = false;
+    QString m_title;
+
+    char32_t m_codepoint = 0;
+    int m_utf8Remaining = 0;
+
+    void clearSequence();
+    int param(int index, int defaultValue) const;
+    bool isSubParameter(int index) const;
+    void reply(const QByteArray &data);
+    void execute(unsigned char byte);
+    void printUtf8(unsigned char byte);
+    void flushIncompleteUtf8();
+    void dispatchEscape(unsigned char final);
+    void dispatchCsi(unsigned char final);
+    void dispatchPrivateMode(bool enabled);
+    void dispatchOsc();
+    void selectGraphicRendition();
+
+public:
+    explicit VtParser(TerminalGrid &grid);
+
+    void setReplyCallback(ReplyCallback callback);
+    void feed(const QByteArray &data);
+    void reset();
+    QString title() const;
+};
+
+#endif
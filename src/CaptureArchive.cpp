@@ -0,0 +1,678 @@
+#include "CaptureArchive.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+const char kHeaderMagic[4] = {'D', 'S', 'C', 'A'};
+const char kTrailerMagic[4] = {'D', 'S', 'C', 'I'};
+constexpr quint16 kFormatVersion = 1;
+constexpr int kHeaderSize = 16;
+constexpr int kIndexEntrySize = 24;
+constexpr int kTrailerSize = 24;
+constexpr int kMinBlockSize = 4 * 1024;
+constexpr int kMaxBlockSize = 64 * 1024 * 1024;
+constexpr qint64 kCopyChunkSize = 4 * 1024 * 1024;
+
+template <typename T>
+void appendLittleEndian(QByteArray &buffer, T value)
+{
+    char raw[sizeof(T)];
+    qToLittleEndian(value, raw);
+    buffer.append(raw, sizeof(T));
+}
+
+template <typename T>
+T readLittleEndian(const char *data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+int inFlightLimit()
+{
+    // Two blocks per worker keeps every core busy while the writer drains in order.
+    return std::max(2, QThreadPool::globalInstance()->maxThreadCount() * 2);
+}
+} // namespace
+
+double CaptureArchiveStats::ratio() const
+{
+    if (archiveBytes <= 0) {
+        return 0.0;
+    }
+
+    return static_cast<double>(rawBytes) / static_cast<double>(archiveBytes);
+}
+
+double CaptureArchiveStats::throughputMBps() const
+{
+    if (elapsedNs <= 0) {
+        return 0.0;
+    }
+
+    return (static_cast<double>(rawBytes) / (1024.0 * 1024.0))
+        / (static_cast<double>(elapsedNs) / 1e9);
+}
+
+CaptureArchiveWriter::CaptureArchiveWriter() = default;
+
+CaptureArchiveWriter::~CaptureArchiveWriter()
+{
+    close();
+}
+
+bool CaptureArchiveWriter::open(const QString &path, int blockSize, int compressionLevel)
+{
+    close();
+
+    m_blockSize = std::clamp(blockSize, kMinBlockSize, kMaxBlockSize);
+    m_compressionLevel = std::clamp(compressionLevel, -1, 9);
+    m_maxInFlight = inFlightLimit();
+    m_currentBlock.clear();
+    m_currentBlock.reserve(m_blockSize);
+    m_rawOffset = 0;
+    m_pending.clear();
+    m_index.clear();
+    m_failed = false;
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QByteArray header;
+    header.reserve(kHeaderSize);
+    header.append(kHeaderMagic, sizeof(kHeaderMagic));
+    appendLittleEndian<quint16>(header, kFormatVersion);
+    appendLittleEndian<quint16>(header, 0);
+    appendLittleEndian<quint32>(header, static_cast<quint32>(m_blockSize));
+    appendLittleEndian<quint32>(header, 0);
+
+    if (m_file.write(header) != header.size()) {
+        m_file.close();
+        return false;
+    }
+
+    return true;
+}
+
+bool CaptureArchiveWriter::write(const QByteArray &data)
+{
+    if (!m_file.isOpen() || m_failed) {
+        return false;
+    }
+
+    qsizetype consumed = 0;
+    while (consumed < data.size()) {
+        const qsizetype room = m_blockSize - m_currentBlock.size();
+        const qsizetype take = std::min(room, data.size() - consumed);
+        m_currentBlock.append(data.constData() + consumed, take);
+        consumed += take;
+
+        if (m_currentBlock.size() >= m_blockSize) {
+            submitCurrentBlock();
+        }
+    }
+
+    return !m_failed;
+}
+
+void CaptureArchiveWriter::submitCurrentBlock()
+{
+    if (m_currentBlock.isEmpty()) {
+        return;
+    }
+
+    while (m_pending.size() >= m_maxInFlight && !m_failed) {
+        drainOne();
+    }
+
+    PendingBlock pending;
+    pending.rawOffset = m_rawOffset;
+    pending.rawSize = static_cast<qint32>(m_currentBlock.size());
+    pending.compressed = QtConcurrent::run(QThreadPool::globalInstance(),
+                                           [block = m_currentBlock, level = m_compressionLevel]() {
+                                               return qCompress(block, level);
+                                           });
+    m_pending.append(pending);
+
+    m_rawOffset += m_currentBlock.size();
+    m_currentBlock = QByteArray();
+    m_currentBlock.reserve(m_blockSize);
+}
+
+bool CaptureArchiveWriter::drainOne()
+{
+    if (m_pending.isEmpty()) {
+        return true;
+    }
+
+    PendingBlock pending = m_pending.takeFirst();
+    const QByteArray compressed = pending.compressed.result();
+
+    CaptureArchiveBlock block;
+    block.fileOffset = m_file.pos();
+    block.rawOffset = pending.rawOffset;
+    block.compressedSize = static_cast<qint32>(compressed.size());
+    block.rawSize = pending.rawSize;
+
+    if (compressed.isEmpty() || m_file.write(compressed) != compressed.size()) {
+        m_failed = true;
+        return false;
+    }
+
+    m_index.append(block);
+    return true;
+}
+
+bool CaptureArchiveWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return !m_failed;
+    }
+
+    submitCurrentBlock();
+    while (!m_pending.isEmpty()) {
+        if (!drainOne()) {
+            // Still wait for the remaining workers so they don't outlive their inputs' owner.
+            for (PendingBlock &pending : m_pending) {
+                pending.compressed.waitForFinished();
+            }
+            m_pending.clear();
+        }
+    }
+
+    if (!m_failed) {
+        const qint64 indexOffset = m_file.pos();
+
+        QByteArray tail;
+        tail.reserve(m_index.size() * kIndexEntrySize + kTrailerSize);
+        for (const CaptureArchiveBlock &block : m_index) {
+            appendLittleEndian<quint64>(tail, static_cast<quint64>(block.fileOffset));
+            appendLittleEndian<quint64>(tail, static_cast<quint64>(block.rawOffset));
+            appendLittleEndian<quint32>(tail, static_cast<quint32>(block.compressedSize));
+            appendLittleEndian<quint32>(tail, static_cast<quint32>(block.rawSize));
+        }
+
+        appendLittleEndian<quint64>(tail, static_cast<quint64>(indexOffset));
+        appendLittleEndian<quint64>(tail, static_cast<quint64>(m_rawOffset));
+        appendLittleEndian<quint32>(tail, static_cast<quint32>(m_index.size()));
+        tail.append(kTrailerMagic, sizeof(kTrailerMagic));
+
+        if (m_file.write(tail) != tail.size()) {
+            m_failed = true;
+        }
+    }
+
+    m_file.close();
+    return !m_failed;
+}
+
+bool CaptureArchiveWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+qint64 CaptureArchiveWriter::rawSize() const
+{
+    return m_rawOffset + m_currentBlock.size();
+}
+
+qint64 CaptureArchiveWriter::archiveSize() const
+{
+    return m_file.isOpen() ? m_file.pos() : m_file.size();
+}
+
+int CaptureArchiveWriter::blockCount() const
+{
+    return static_cast<int>(m_index.size());
+}
+
+CaptureArchiveReader::CaptureArchiveReader() = default;
+
+CaptureArchiveReader::~CaptureArchiveReader()
+{
+    close();
+}
+
+bool CaptureArchiveReader::open(const QString &path)
+{
+    close();
+    m_errorString.clear();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < kHeaderSize + kTrailerSize) {
+        close();
+        return false;
+    }
+
+    const QByteArray header = m_file.read(kHeaderSize);
+    if (header.size() != kHeaderSize
+        || !header.startsWith(QByteArray::fromRawData(kHeaderMagic, sizeof(kHeaderMagic)))
+        || readLittleEndian<quint16>(header.constData() + 4) != kFormatVersion) {
+        close();
+        return false;
+    }
+    const quint32 blockSize = readLittleEndian<quint32>(header.constData() + 8);
+    if (blockSize < static_cast<quint32>(kMinBlockSize) || blockSize > static_cast<quint32>(kMaxBlockSize)) {
+        close();
+        m_errorString = QString("Corrupt archive: block size %1").arg(blockSize);
+        return false;
+    }
+    m_blockSize = static_cast<int>(blockSize);
+
+    if (!m_file.seek(fileSize - kTrailerSize)) {
+        close();
+        return false;
+    }
+
+    const QByteArray trailer = m_file.read(kTrailerSize);
+    if (trailer.size() != kTrailerSize
+        || !trailer.endsWith(QByteArray::fromRawData(kTrailerMagic, sizeof(kTrailerMagic)))) {
+        close();
+        return false;
+    }
+
+    const qint64 indexOffset = static_cast<qint64>(readLittleEndian<quint64>(trailer.constData()));
+    m_rawSize = static_cast<qint64>(readLittleEndian<quint64>(trailer.constData() + 8));
+    const quint32 blockCount = readLittleEndian<quint32>(trailer.constData() + 16);
+
+    if (indexOffset < kHeaderSize
+        || indexOffset + static_cast<qint64>(blockCount) * kIndexEntrySize != fileSize - kTrailerSize
+        || !m_file.seek(indexOffset)) {
+        close();
+        return false;
+    }
+
+    const QByteArray index = m_file.read(static_cast<qint64>(blockCount) * kIndexEntrySize);
+    if (index.size() != static_cast<qsizetype>(blockCount) * kIndexEntrySize) {
+        close();
+        return false;
+    }
+
+    m_index.reserve(blockCount);
+    qint64 expectedRawOffset = 0;
+    for (quint32 i = 0; i < blockCount; ++i) {
+        const char *entry = index.constData() + static_cast<qsizetype>(i) * kIndexEntrySize;
+
+        CaptureArchiveBlock block;
+        block.fileOffset = static_cast<qint64>(readLittleEndian<quint64>(entry));
+        block.rawOffset = static_cast<qint64>(readLittleEndian<quint64>(entry + 8));
+        block.compressedSize = static_cast<qint32>(readLittleEndian<quint32>(entry + 16));
+        const quint32 rawSize = readLittleEndian<quint32>(entry + 20);
+
+        // Checked before anything is inflated: qUncompress allocates what it's told.
+        if (rawSize == 0 || rawSize > static_cast<quint32>(m_blockSize)) {
+            close();
+            m_errorString = QString("Corrupt archive block %1").arg(i);
+            return false;
+        }
+        block.rawSize = static_cast<qint32>(rawSize);
+
+        if (block.rawOffset != expectedRawOffset
+            || block.compressedSize <= 0
+            || block.fileOffset + block.compressedSize > indexOffset) {
+            close();
+            return false;
+        }
+
+        expectedRawOffset += block.rawSize;
+        m_index.append(block);
+    }
+
+    if (expectedRawOffset != m_rawSize) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureArchiveReader::close()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+
+    m_blockSize = 0;
+    m_rawSize = 0;
+    m_index.clear();
+}
+
+bool CaptureArchiveReader::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QString CaptureArchiveReader::errorString() const
+{
+    return m_errorString;
+}
+
+int CaptureArchiveReader::blockSize() const
+{
+    return m_blockSize;
+}
+
+int CaptureArchiveReader::blockCount() const
+{
+    return static_cast<int>(m_index.size());
+}
+
+qint64 CaptureArchiveReader::rawSize() const
+{
+    return m_rawSize;
+}
+
+const CaptureArchiveBlock &CaptureArchiveReader::block(int index) const
+{
+    return m_index.at(index);
+}
+
+int CaptureArchiveReader::blockForOffset(qint64 rawOffset) const
+{
+    if (rawOffset < 0 || rawOffset >= m_rawSize) {
+        return -1;
+    }
+
+    const auto it = std::upper_bound(m_index.cbegin(),
+                                     m_index.cend(),
+                                     rawOffset,
+                                     [](qint64 offset, const CaptureArchiveBlock &block) {
+                                         return offset < block.rawOffset;
+                                     });
+    return static_cast<int>(std::distance(m_index.cbegin(), it)) - 1;
+}
+
+QByteArray CaptureArchiveReader::readCompressedBlock(int index)
+{
+    if (index < 0 || index >= m_index.size()) {
+        return QByteArray();
+    }
+
+    const CaptureArchiveBlock &block = m_index.at(index);
+    if (!m_file.seek(block.fileOffset)) {
+        return QByteArray();
+    }
+
+    QByteArray compressed = m_file.read(block.compressedSize);
+    // qUncompress sizes its buffer from this prefix; it must match the checked index.
+    if (compressed.size() < 4
+        || qFromBigEndian<quint32>(compressed.constData()) != static_cast<quint32>(block.rawSize)) {
+        return QByteArray();
+    }
+
+    return compressed;
+}
+
+QByteArray CaptureArchiveReader::readBlock(int index)
+{
+    const QByteArray compressed = readCompressedBlock(index);
+    if (compressed.isEmpty()) {
+        return QByteArray();
+    }
+
+    const QByteArray raw = qUncompress(compressed);
+    if (raw.size() != m_index.at(index).rawSize) {
+        return QByteArray();
+    }
+
+    return raw;
+}
+
+QByteArray CaptureArchiveReader::read(qint64 rawOffset, qint64 length)
+{
+    QByteArray result;
+    if (length <= 0) {
+        return result;
+    }
+
+    length = std::min(length, m_rawSize - rawOffset);
+    int index = blockForOffset(rawOffset);
+    if (index < 0) {
+        return result;
+    }
+
+    result.reserve(length);
+    while (result.size() < length && index < m_index.size()) {
+        const QByteArray raw = readBlock(index);
+        if (raw.isEmpty()) {
+            return QByteArray();
+        }
+
+        const qint64 start = rawOffset + result.size() - m_index.at(index).rawOffset;
+        const qint64 take = std::min<qint64>(raw.size() - start, length - result.size());
+        result.append(raw.constData() + start, take);
+        ++index;
+    }
+
+    return result;
+}
+
+bool CaptureArchiveReader::extractTo(QIODevice &output)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // Compressed reads stay on this thread (QFile isn't shared); inflating fans out to the pool.
+    const int maxInFlight = inFlightLimit();
+    QList<QFuture<QByteArray>> pending;
+    int nextToSubmit = 0;
+    int nextToWrite = 0;
+    bool ok = true;
+
+    while (nextToWrite < m_index.size()) {
+        while (ok && nextToSubmit < m_index.size() && pending.size() < maxInFlight) {
+            const QByteArray compressed = readCompressedBlock(nextToSubmit);
+            if (compressed.isEmpty()) {
+                ok = false;
+                break;
+            }
+
+            pending.append(QtConcurrent::run(QThreadPool::globalInstance(), [compressed]() {
+                return qUncompress(compressed);
+            }));
+            ++nextToSubmit;
+        }
+
+        if (pending.isEmpty()) {
+            break;
+        }
+
+        const QByteArray raw = pending.takeFirst().result();
+        if (!ok || raw.size() != m_index.at(nextToWrite).rawSize
+            || output.write(raw) != raw.size()) {
+            ok = false;
+        }
+        ++nextToWrite;
+
+        if (!ok) {
+            for (QFuture<QByteArray> &future : pending) {
+                future.waitForFinished();
+            }
+            return false;
+        }
+    }
+
+    return ok && nextToWrite == m_index.size();
+}
+
+CaptureArchiveDevice::CaptureArchiveDevice() = default;
+
+CaptureArchiveDevice::~CaptureArchiveDevice()
+{
+    close();
+}
+
+bool CaptureArchiveDevice::openArchive(const QString &path)
+{
+    close();
+
+    if (!m_reader.open(path)) {
+        setErrorString(m_reader.errorString().isEmpty() ? QString("Not a capture archive") : m_reader.errorString());
+        return false;
+    }
+
+    // Unbuffered: records are read in small pieces and the block cache already buffers.
+    return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void CaptureArchiveDevice::close()
+{
+    if (isOpen()) {
+        QIODevice::close();
+    }
+
+    m_reader.close();
+    m_blockIndex = -1;
+    m_block.clear();
+    m_pos = 0;
+}
+
+bool CaptureArchiveDevice::isSequential() const
+{
+    return false;
+}
+
+qint64 CaptureArchiveDevice::size() const
+{
+    return m_reader.rawSize();
+}
+
+bool CaptureArchiveDevice::seek(qint64 pos)
+{
+    if (pos < 0 || pos > size() || !QIODevice::seek(pos)) {
+        return false;
+    }
+
+    m_pos = pos;
+    return true;
+}
+
+qint64 CaptureArchiveDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 done = 0;
+    while (done < maxSize && m_pos < m_reader.rawSize()) {
+        const int index = m_reader.blockForOffset(m_pos);
+        if (index != m_blockIndex) {
+            m_block = m_reader.readBlock(index);
+            m_blockIndex = m_block.isEmpty() ? -1 : index;
+            if (m_blockIndex < 0) {
+                setErrorString(QString("Corrupt archive block %1").arg(index));
+                return done > 0 ? done : -1;
+            }
+        }
+
+        const qint64 start = m_pos - m_reader.block(index).rawOffset;
+        const qint64 take = std::min<qint64>(m_block.size() - start, maxSize - done);
+        memcpy(data + done, m_block.constData() + start, static_cast<size_t>(take));
+        done += take;
+        m_pos += take;
+    }
+
+    return done;
+}
+
+qint64 CaptureArchiveDevice::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+bool isCaptureArchive(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    return file.read(sizeof(kHeaderMagic))
+        == QByteArray::fromRawData(kHeaderMagic, sizeof(kHeaderMagic));
+}
+
+bool packCaptureArchive(const QString &rawPath,
+                        const QString &archivePath,
+                        CaptureArchiveStats *stats,
+                        int blockSize,
+                        int compressionLevel)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile input(rawPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    CaptureArchiveWriter writer;
+    if (!writer.open(archivePath, blockSize, compressionLevel)) {
+        return false;
+    }
+
+    while (!input.atEnd()) {
+        const QByteArray chunk = input.read(kCopyChunkSize);
+        if (chunk.isEmpty() && input.error() != QFileDevice::NoError) {
+            writer.close();
+            return false;
+        }
+
+        if (!writer.write(chunk)) {
+            writer.close();
+            return false;
+        }
+    }
+
+    const bool ok = writer.close();
+
+    if (stats != nullptr) {
+        stats->rawBytes = writer.rawSize();
+        stats->archiveBytes = QFileInfo(archivePath).size();
+        stats->blockCount = writer.blockCount();
+        stats->elapsedNs = timer.nsecsElapsed();
+    }
+
+    return ok;
+}
+
+bool unpackCaptureArchive(const QString &archivePath,
+                          const QString &rawPath,
+                          CaptureArchiveStats *stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    CaptureArchiveReader reader;
+    if (!reader.open(archivePath)) {
+        return false;
+    }
+
+    QFile output(rawPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    const bool ok = reader.extractTo(output);
+    output.close();
+
+    if (stats != nullptr) {
+        stats->rawBytes = reader.rawSize();
+        stats->archiveBytes = QFileInfo(archivePath).size();
+        stats->blockCount = reader.blockCount();
+        stats->elapsedNs = timer.nsecsElapsed();
+    }
+
+    return ok;
+}
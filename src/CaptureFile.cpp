@@ -0,0 +1,294 @@
+#include "CaptureFile.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const char kMagic[4] = {'D', 'S', 'C', 'F'};
+constexpr quint16 kFormatVersion = 1;
+constexpr int kHeaderSize = 16;
+constexpr int kRecordHeaderSize = 16;
+constexpr quint32 kMaxRecordSize = 256 * 1024 * 1024;
+constexpr qint64 kCopyChunkSize = 1024 * 1024;
+} // namespace
+
+CaptureFileWriter::CaptureFileWriter() = default;
+
+CaptureFileWriter::~CaptureFileWriter()
+{
+    close();
+}
+
+bool CaptureFileWriter::open(const QString &path, qint64 wallClockOffsetNs)
+{
+    close();
+    m_recordCount = 0;
+    m_failed = false;
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    char header[kHeaderSize] = {};
+    memcpy(header, kMagic, sizeof(kMagic));
+    qToLittleEndian<quint16>(kFormatVersion, header + 4);
+    qToLittleEndian<qint64>(wallClockOffsetNs, header + 8);
+
+    if (m_file.write(header, kHeaderSize) != kHeaderSize) {
+        m_file.close();
+        return false;
+    }
+
+    return true;
+}
+
+bool CaptureFileWriter::write(const CaptureRecord &record)
+{
+    if (!m_file.isOpen() || m_failed) {
+        return false;
+    }
+
+    char header[kRecordHeaderSize] = {};
+    qToLittleEndian<qint64>(record.timestampNs, header);
+    header[8] = static_cast<char>(record.direction);
+    header[9] = static_cast<char>(record.channel);
+    qToLittleEndian<quint32>(static_cast<quint32>(record.data.size()), header + 12);
+
+    if (m_file.write(header, kRecordHeaderSize) != kRecordHeaderSize
+        || m_file.write(record.data) != record.data.size()) {
+        m_failed = true;
+        return false;
+    }
+
+    ++m_recordCount;
+    return true;
+}
+
+bool CaptureFileWriter::flush()
+{
+    if (!m_file.isOpen() || m_failed) {
+        return false;
+    }
+
+    m_failed = !m_file.flush();
+    return !m_failed;
+}
+
+bool CaptureFileWriter::close()
+{
+    if (m_file.isOpen()) {
+        m_failed = !m_file.flush() || m_failed;
+        m_file.close();
+    }
+
+    return !m_failed;
+}
+
+bool CaptureFileWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QString CaptureFileWriter::fileName() const
+{
+    return m_file.fileName();
+}
+
+qint64 CaptureFileWriter::recordCount() const
+{
+    return m_recordCount;
+}
+
+qint64 CaptureFileWriter::size() const
+{
+    return m_file.isOpen() ? m_file.pos() : 0;
+}
+
+CaptureFileReader::CaptureFileReader() = default;
+
+CaptureFileReader::~CaptureFileReader()
+{
+    close();
+}
+
+bool CaptureFileReader::open(const QString &path, qint64 length)
+{
+    close();
+    m_errorString.clear();
+    m_endOffset = length > 0 ? length : -1;
+
+    if (isCaptureArchive(path)) {
+        if (!m_archive.openArchive(path)) {
+            m_errorString = m_archive.errorString();
+            return false;
+        }
+        m_device = &m_archive;
+    } else {
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            m_errorString = m_file.errorString();
+            return false;
+        }
+        m_device = &m_file;
+    }
+
+    const QByteArray header = m_device->read(kHeaderSize);
+    if (header.size() != kHeaderSize
+        || memcmp(header.constData(), kMagic, sizeof(kMagic)) != 0
+        || qFromLittleEndian<quint16>(header.constData() + 4) != kFormatVersion) {
+        m_errorString = "Not a capture file";
+        close();
+        return false;
+    }
+
+    m_wallClockOffsetNs = qFromLittleEndian<qint64>(header.constData() + 8);
+    return true;
+}
+
+void CaptureFileReader::close()
+{
+    if (m_device != nullptr) {
+        m_device->close();
+        m_device = nullptr;
+    }
+}
+
+bool CaptureFileReader::isOpen() const
+{
+    return m_device != nullptr && m_device->isOpen();
+}
+
+bool CaptureFileReader::readBatch(QList<CaptureRecord> &batch, int maxRecords)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    for (int i = 0; i < maxRecords; ++i) {
+        char header[kRecordHeaderSize];
+        const qint64 headerRead = m_endOffset >= 0 && m_device->pos() >= m_endOffset
+            ? 0
+            : m_device->read(header, kRecordHeaderSize);
+        if (headerRead == 0) {
+            return !batch.isEmpty();
+        }
+
+        const quint32 length = qFromLittleEndian<quint32>(header + 12);
+        if (headerRead != kRecordHeaderSize || length > kMaxRecordSize) {
+            m_errorString = QString("Truncated or corrupt record at offset %1")
+                                .arg(m_device->pos() - std::max<qint64>(headerRead, 0));
+            return false;
+        }
+
+        CaptureRecord record;
+        record.timestampNs = qFromLittleEndian<qint64>(header);
+        record.direction = header[8] == static_cast<char>(CaptureDirection::Tx)
+            ? CaptureDirection::Tx
+            : CaptureDirection::Rx;
+        record.channel = static_cast<quint8>(header[9]);
+        record.data = m_device->read(length);
+        if (record.data.size() != static_cast<qsizetype>(length)) {
+            m_errorString = QString("Truncated record at offset %1")
+                                .arg(m_device->pos() - record.data.size() - kRecordHeaderSize);
+            return false;
+        }
+
+        batch.append(record);
+    }
+
+    return true;
+}
+
+bool CaptureFileReader::atEnd() const
+{
+    return !isOpen() || m_device->atEnd() || (m_endOffset >= 0 && m_device->pos() >= m_endOffset);
+}
+
+double CaptureFileReader::progress() const
+{
+    if (!isOpen()) {
+        return 1.0;
+    }
+
+    const qint64 size = m_endOffset >= 0 ? m_endOffset : m_device->size();
+    return size <= 0 ? 1.0 : static_cast<double>(m_device->pos()) / static_cast<double>(size);
+}
+
+qint64 CaptureFileReader::wallClockOffsetNs() const
+{
+    return m_wallClockOffsetNs;
+}
+
+QString CaptureFileReader::errorString() const
+{
+    return m_errorString;
+}
+
+bool isCaptureFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    return file.read(sizeof(kMagic)) == QByteArray::fromRawData(kMagic, sizeof(kMagic));
+}
+
+bool writeCaptureFile(const QString &path, const QList<CaptureRecord> &records, qint64 wallClockOffsetNs)
+{
+    CaptureFileWriter writer;
+    if (!writer.open(path, wallClockOffsetNs)) {
+        return false;
+    }
+
+    for (const CaptureRecord &record : records) {
+        if (!writer.write(record)) {
+            writer.close();
+            return false;
+        }
+    }
+
+    return writer.close();
+}
+
+bool copyCaptureSegments(const QList<std::shared_ptr<QFile>> &sources,
+                         const QList<qint64> &lengths,
+                         const QString &targetPath)
+{
+    QFile target(targetPath);
+    if (sources.isEmpty()
+        || sources.size() != lengths.size()
+        || !target.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    const auto fail = [&target]() {
+        target.close();
+        target.remove();
+        return false;
+    };
+
+    for (qsizetype i = 0; i < sources.size(); ++i) {
+        QFile &source = *sources.at(i);
+        // Later segments repeat the first header; only their records are copied.
+        const qint64 start = i == 0 ? 0 : kHeaderSize;
+        if (lengths.at(i) < kHeaderSize || !source.isOpen() || !source.seek(start)) {
+            return fail();
+        }
+
+        qint64 remaining = lengths.at(i) - start;
+        while (remaining > 0) {
+            const QByteArray chunk = source.read(std::min(remaining, kCopyChunkSize));
+            if (chunk.isEmpty() || target.write(chunk) != chunk.size()) {
+                return fail();
+            }
+            remaining -= chunk.size();
+        }
+    }
+
+    return target.flush();
+}
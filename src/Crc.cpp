@@ -0,0 +1,109 @@
+#include "Crc.h"
+
+#include <array>
+
+namespace
+{
+// Slicing-by-8: table k advances a byte that is followed by k more bytes, so
+// eight input bytes cost eight independent lookups instead of a serial chain.
+using SliceTables = std::array<std::array<quint16, 256>, 8>;
+
+constexpr SliceTables makeReflectedTables(quint16 poly)
+{
+    SliceTables tables{};
+    for (int i = 0; i < 256; ++i) {
+        quint16 crc = static_cast<quint16>(i);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) != 0 ? static_cast<quint16>((crc >> 1) ^ poly) : static_cast<quint16>(crc >> 1);
+        }
+        tables[0][i] = crc;
+    }
+    for (int k = 1; k < 8; ++k) {
+        for (int i = 0; i < 256; ++i) {
+            const quint16 previous = tables[k - 1][i];
+            tables[k][i] = static_cast<quint16>((previous >> 8) ^ tables[0][previous & 0xFF]);
+        }
+    }
+    return tables;
+}
+
+constexpr SliceTables makeTables(quint16 poly)
+{
+    SliceTables tables{};
+    for (int i = 0; i < 256; ++i) {
+        quint16 crc = static_cast<quint16>(i << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) != 0 ? static_cast<quint16>((crc << 1) ^ poly) : static_cast<quint16>(crc << 1);
+        }
+        tables[0][i] = crc;
+    }
+    for (int k = 1; k < 8; ++k) {
+        for (int i = 0; i < 256; ++i) {
+            const quint16 previous = tables[k - 1][i];
+            tables[k][i] = static_cast<quint16>((previous << 8) ^ tables[0][previous >> 8]);
+        }
+    }
+    return tables;
+}
+
+constexpr std::array<quint32, 256> makeCrc32Table()
+{
+    std::array<quint32, 256> table{};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr SliceTables kModbusTables = makeReflectedTables(0xA001);
+constexpr SliceTables kXmodemTables = makeTables(0x1021);
+constexpr std::array<quint32, 256> kCrc32Table = makeCrc32Table();
+} // namespace
+
+quint16 crc16Modbus(const char *data, qsizetype size, quint16 crc)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    const SliceTables &t = kModbusTables;
+
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const uchar *p = bytes + i;
+        crc = static_cast<quint16>(t[7][(crc ^ p[0]) & 0xFF] ^ t[6][((crc >> 8) ^ p[1]) & 0xFF]
+                                   ^ t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]]);
+    }
+    for (; i < size; ++i) {
+        crc = static_cast<quint16>((crc >> 8) ^ t[0][(crc ^ bytes[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+quint16 crc16Xmodem(const char *data, qsizetype size, quint16 crc)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    const SliceTables &t = kXmodemTables;
+
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const uchar *p = bytes + i;
+        crc = static_cast<quint16>(t[7][((crc >> 8) ^ p[0]) & 0xFF] ^ t[6][(crc ^ p[1]) & 0xFF]
+                                   ^ t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]]);
+    }
+    for (; i < size; ++i) {
+        crc = static_cast<quint16>((crc << 8) ^ t[0][((crc >> 8) ^ bytes[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+quint32 crc32(const char *data, qsizetype size, quint32 crc)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    crc = ~crc;
+    for (qsizetype i = 0; i < size; ++i) {
+        crc = (crc >> 8) ^ kCrc32Table[(crc ^ bytes[i]) & 0xFF];
+    }
+    return ~crc;
+}
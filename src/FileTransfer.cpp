@@ -0,0 +1,1854 @@
+#include "FileTransfer.h"
+
+#include "Crc.h"
+#include "SerialManager.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QObject>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+constexpr char kSoh = 0x01;
+constexpr char kStx = 0x02;
+constexpr char kEot = 0x04;
+constexpr char kAck = 0x06;
+constexpr char kNak = 0x15;
+constexpr char kCan = 0x18;
+constexpr char kSub = 0x1A;
+constexpr char kCrcRequest = 'C';
+
+constexpr int kStartTimeoutMs = 60000;
+constexpr int kPollIntervalMs = 3000;
+constexpr int kBlockTimeoutMs = 10000;
+// XMODEM is receiver-driven: the receiver NAKs when a block doesn't arrive, so
+// the sender's timeout only gives up. Resending on it as well would let both
+// ends retransmit at once, and the duplicate ACK would skip a block.
+constexpr int kAckTimeoutMs = 2 * kBlockTimeoutMs;
+constexpr int kOverTimeoutMs = 2000;
+constexpr int kPurgeQuietMs = 1000;
+constexpr int kPumpRetryMs = 2;
+constexpr int kEotRetries = 3;
+constexpr int kChecksumFallbackPolls = 3; // XMODEM receive: 'C' polls before trying NAK
+constexpr int kFileMode = 0100644;
+
+// Eight CANs then backspaces to erase them from a terminal, as lrzsz sends.
+const QByteArray kAbortSequence("\x18\x18\x18\x18\x18\x18\x18\x18\x08\x08\x08\x08\x08\x08\x08\x08\x08\x08");
+
+// ZMODEM framing
+constexpr char kZpad = '*';
+constexpr char kZdle = 0x18;
+constexpr char kZbin = 'A';
+constexpr char kZhex = 'B';
+constexpr char kZbin32 = 'C';
+constexpr char kZcrce = 'h'; // end of frame, header follows
+constexpr char kZcrcg = 'i'; // frame continues, no response
+constexpr char kZcrcq = 'j'; // frame continues, ZACK expected
+constexpr char kZcrcw = 'k'; // end of frame, ZACK expected
+constexpr char kZrub0 = 'l';
+constexpr char kZrub1 = 'm';
+constexpr char kXon = 0x11;
+
+enum ZFrameType {
+    ZRQINIT = 0,
+    ZRINIT,
+    ZSINIT,
+    ZACK,
+    ZFILE,
+    ZSKIP,
+    ZNAK,
+    ZABORT,
+    ZFIN,
+    ZRPOS,
+    ZDATA,
+    ZEOF,
+    ZFERR,
+    ZCRC,
+    ZCHALLENGE,
+    ZCOMPL,
+    ZCAN,
+    ZFREECNT,
+    ZCOMMAND,
+};
+
+// Header byte 3 is ZF0, the flag byte of ZRINIT and ZFILE.
+constexpr int kZf0 = 3;
+constexpr uchar kCanFdx = 0x01;
+constexpr uchar kCanOvio = 0x02;
+constexpr uchar kCanFc32 = 0x20;
+constexpr uchar kEscCtl = 0x40;
+constexpr uchar kZcbin = 1;
+constexpr uchar kZcrecov = 3; // ZFILE ZF0: continue an interrupted transfer
+
+constexpr std::array<bool, 256> makeZEscapeTable(bool control)
+{
+    std::array<bool, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        switch (c) {
+        case 0x18: // ZDLE
+        case 0x10: // DLE
+        case 0x11: // XON
+        case 0x13: // XOFF
+        case 0x90:
+        case 0x91:
+        case 0x93:
+        case 0x98:
+            table[c] = true;
+            break;
+        default:
+            table[c] = control && (c & 0x60) == 0;
+            break;
+        }
+    }
+    return table;
+}
+
+constexpr std::array<bool, 256> kZEscape = makeZEscapeTable(false);
+constexpr std::array<bool, 256> kZEscapeControl = makeZEscapeTable(true);
+
+inline bool isFlowControl(uchar c)
+{
+    return c == 0x11 || c == 0x13 || c == 0x91 || c == 0x93;
+}
+
+inline int hexNibble(uchar c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+void positionBytes(qint64 position, uchar *bytes)
+{
+    const quint32 value = static_cast<quint32>(position);
+    bytes[0] = static_cast<uchar>(value);
+    bytes[1] = static_cast<uchar>(value >> 8);
+    bytes[2] = static_cast<uchar>(value >> 16);
+    bytes[3] = static_cast<uchar>(value >> 24);
+}
+
+qint64 bytesPosition(const uchar *bytes)
+{
+    return static_cast<qint64>(static_cast<quint32>(bytes[0]) | static_cast<quint32>(bytes[1]) << 8
+                               | static_cast<quint32>(bytes[2]) << 16 | static_cast<quint32>(bytes[3]) << 24);
+}
+
+// What a ZCRC header carries: CRC-32 of the first length bytes of the file.
+quint32 fileCrc32(QFile &file, qint64 length)
+{
+    const qint64 restore = file.pos();
+    file.seek(0);
+    quint32 crc = 0;
+    qint64 done = 0;
+    while (done < length) {
+        const QByteArray chunk = file.read(std::min<qint64>(64 * 1024, length - done));
+        if (chunk.isEmpty()) {
+            break;
+        }
+        crc = crc32(chunk.constData(), chunk.size(), crc);
+        done += chunk.size();
+    }
+    file.seek(restore);
+    return crc;
+}
+
+QString uniquePath(const QDir &dir, const QString &fileName)
+{
+    const QFileInfo info(fileName);
+    const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    for (int n = 1;; ++n) {
+        const QString candidate = dir.filePath(QString("%1 (%2)%3").arg(info.completeBaseName()).arg(n).arg(suffix));
+        if (!QFileInfo::exists(candidate)) {
+            return candidate;
+        }
+    }
+}
+} // namespace
+
+double TransferProgress::bytesPerSecond() const
+{
+    return elapsedNs > 0 ? bytesMoved * 1e9 / elapsedNs : 0.0;
+}
+
+FileTransfer::FileTransfer()
+{
+    m_timer.setSingleShot(true);
+    QObject::connect(&m_timer, &QTimer::timeout, [this]() {
+        handleTimeout();
+    });
+
+    m_pumpTimer.setSingleShot(true);
+    QObject::connect(&m_pumpTimer, &QTimer::timeout, [this]() {
+        writeReady();
+    });
+}
+
+FileTransfer::~FileTransfer()
+{
+    m_timer.stop();
+    m_pumpTimer.stop();
+}
+
+void FileTransfer::moveToThread(QThread *thread)
+{
+    m_timer.moveToThread(thread);
+    m_pumpTimer.moveToThread(thread);
+}
+
+void FileTransfer::setWriteHandler(WriteHandler handler)
+{
+    m_writeHandler = std::move(handler);
+}
+
+void FileTransfer::setPendingWriteHandler(PendingWriteHandler handler)
+{
+    m_pendingWriteHandler = std::move(handler);
+}
+
+void FileTransfer::setLogCallback(LogCallback callback)
+{
+    m_logCallback = std::move(callback);
+}
+
+void FileTransfer::setFinishedCallback(FinishedCallback callback)
+{
+    m_finishedCallback = std::move(callback);
+}
+
+bool FileTransfer::startSend(const TransferOptions &options, const QStringList &paths, QString *errorString)
+{
+    const auto failWith = [errorString](const QString &message) {
+        if (errorString != nullptr) {
+            *errorString = message;
+        }
+        return false;
+    };
+
+    if (isActive()) {
+        return failWith("a transfer is already running");
+    }
+    if (paths.isEmpty()) {
+        return failWith("no files to send");
+    }
+    if ((options.protocol == TransferProtocol::XmodemCrc || options.protocol == TransferProtocol::Xmodem1k)
+        && paths.size() != 1) {
+        return failWith("XMODEM sends one file at a time");
+    }
+    for (const QString &path : paths) {
+        const QFileInfo info(path);
+        if (!info.isFile() || !info.isReadable()) {
+            return failWith(QString("cannot read %1").arg(path));
+        }
+        if (options.protocol == TransferProtocol::Zmodem && info.size() > 0xFFFFFFFFLL) {
+            return failWith(QString("%1 is larger than ZMODEM's 4 GiB limit").arg(path));
+        }
+    }
+
+    resetState(options, Role::Send);
+    m_sendPaths = paths;
+    m_progress.fileCount = paths.size();
+    if (!openNextSendFile()) {
+        return failWith(QString("cannot open %1").arg(paths.first()));
+    }
+
+    if (options.protocol == TransferProtocol::Zmodem) {
+        // "rz\r" starts a receiver on a shell prompt; a receiver that is already running ignores it.
+        write("rz\r");
+        sendZHeader(zHexHeader(ZRQINIT, 0));
+        m_phase = Phase::ZSendWaitInit;
+        startTimer(kBlockTimeoutMs);
+    } else {
+        m_blockNumber = 1;
+        m_phase = Phase::XySendWaitStart;
+        startTimer(kStartTimeoutMs);
+    }
+
+    log(QString("%1 send of %2 file(s), waiting for the receiver").arg(protocolName(options.protocol)).arg(paths.size()));
+    return true;
+}
+
+bool FileTransfer::startReceive(const TransferOptions &options, const QString &target, QString *errorString)
+{
+    const auto failWith = [errorString](const QString &message) {
+        if (errorString != nullptr) {
+            *errorString = message;
+        }
+        return false;
+    };
+
+    if (isActive()) {
+        return failWith("a transfer is already running");
+    }
+
+    const bool xmodem = options.protocol == TransferProtocol::XmodemCrc || options.protocol == TransferProtocol::Xmodem1k;
+    if (!xmodem && !QFileInfo(target).isDir()) {
+        return failWith(QString("%1 is not a directory").arg(target));
+    }
+
+    resetState(options, Role::Receive);
+    m_receiveTarget = target;
+
+    if (xmodem) {
+        m_file.setFileName(target);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            m_role = Role::Idle;
+            return failWith(QString("cannot write %1: %2").arg(target, m_file.errorString()));
+        }
+        m_progress.fileName = QFileInfo(target).fileName();
+        m_progress.fileIndex = 1;
+        m_progress.fileCount = 1;
+        m_blockNumber = 1;
+        m_phase = Phase::XyReceiveWaitData;
+        write(QByteArray(1, kCrcRequest));
+        startTimer(kPollIntervalMs);
+    } else if (options.protocol == TransferProtocol::Ymodem) {
+        m_blockNumber = 0;
+        m_phase = Phase::XyReceiveWaitHeader;
+        write(QByteArray(1, kCrcRequest));
+        startTimer(kPollIntervalMs);
+    } else {
+        m_phase = Phase::ZReceiveWaitFile;
+        sendZReceiverInit();
+        startTimer(kBlockTimeoutMs);
+    }
+
+    log(QString("%1 receive into %2, waiting for the sender").arg(protocolName(options.protocol), target));
+    return true;
+}
+
+void FileTransfer::cancel()
+{
+    if (!isActive()) {
+        return;
+    }
+
+    write(kAbortSequence);
+    finish(false, "Transfer cancelled");
+}
+
+bool FileTransfer::isActive() const
+{
+    return m_role != Role::Idle;
+}
+
+bool FileTransfer::isSending() const
+{
+    return m_role == Role::Send;
+}
+
+TransferOptions FileTransfer::options() const
+{
+    return m_options;
+}
+
+TransferProgress FileTransfer::progress() const
+{
+    TransferProgress progress = m_progress;
+    if (isActive()) {
+        progress.elapsedNs = SerialManager::monotonicNowNs() - m_startNs;
+    }
+    return progress;
+}
+
+void FileTransfer::feed(const QByteArray &data)
+{
+    if (!isActive() || data.isEmpty()) {
+        return;
+    }
+
+    if (m_options.protocol == TransferProtocol::Zmodem) {
+        feedZmodem(data);
+    } else if (m_role == Role::Send) {
+        feedXySend(data);
+    } else {
+        feedXyReceive(data);
+    }
+}
+
+void FileTransfer::writeReady()
+{
+    if (m_role == Role::Send && m_phase == Phase::ZSendStreaming) {
+        pumpZmodem();
+    }
+}
+
+QString FileTransfer::protocolName(TransferProtocol protocol)
+{
+    switch (protocol) {
+    case TransferProtocol::XmodemCrc:
+        return "XMODEM-CRC";
+    case TransferProtocol::Xmodem1k:
+        return "XMODEM-1K";
+    case TransferProtocol::Ymodem:
+        return "YMODEM";
+    case TransferProtocol::Zmodem:
+        return "ZMODEM";
+    }
+    return QString();
+}
+
+// --- common ---------------------------------------------------------------
+
+void FileTransfer::resetState(const TransferOptions &options, Role role)
+{
+    m_timer.stop();
+    m_pumpTimer.stop();
+    m_file.close();
+
+    m_options = options;
+    m_role = role;
+    m_progress = TransferProgress();
+    m_startNs = SerialManager::monotonicNowNs();
+    m_retries = 0;
+    m_cancelCount = 0;
+    m_sendPaths.clear();
+    m_receiveTarget.clear();
+    m_filePos = 0;
+    m_fileSize = -1;
+    m_fileMtime = 0;
+
+    m_rx.clear();
+    m_block.clear();
+    m_blockLength = 0;
+    m_heldBlock.clear();
+    m_blockNumber = 0;
+    m_crcMode = true;
+    m_headerSent = false;
+    m_eotNaked = false;
+    m_purging = false;
+
+    m_zState = ZState::Hunt;
+    m_zExpect = ZSubpacket::None;
+    m_zEscape = false;
+    m_zCrc32 = false;
+    m_zSendCrc32 = false;
+    m_zEscapeControl = false;
+    m_zHeaderLength = 0;
+    m_zHeader.clear();
+    m_zData.clear();
+    m_zCrc.clear();
+    m_zFrameEnd = 0;
+    m_zLastHeader.clear();
+    m_zOut.clear();
+    m_zFrameOpen = false;
+    m_zAckedPos = 0;
+    m_zReceiverBuffer = 0;
+    m_zFrameStart = 0;
+    m_zQueryPos = 0;
+    m_zLastRposPos = -1;
+    m_zRposRepeats = 0;
+    m_zLastByte = 0;
+    m_zFileConversion = 0;
+    m_zFileName.clear();
+    m_zFileSize = -1;
+    m_zCheckLength = 0;
+}
+
+void FileTransfer::write(const QByteArray &data)
+{
+    if (m_writeHandler && !data.isEmpty()) {
+        m_writeHandler(data);
+    }
+}
+
+qint64 FileTransfer::pendingWrite() const
+{
+    return m_pendingWriteHandler ? m_pendingWriteHandler() : 0;
+}
+
+void FileTransfer::log(const QString &message)
+{
+    if (m_logCallback) {
+        m_logCallback(message);
+    }
+}
+
+void FileTransfer::finish(bool ok, const QString &message)
+{
+    m_timer.stop();
+    m_pumpTimer.stop();
+    // A partial download stays on disk; ZMODEM can resume it next time.
+    m_file.close();
+    m_progress.elapsedNs = SerialManager::monotonicNowNs() - m_startNs;
+    m_role = Role::Idle;
+
+    log(message);
+    if (m_finishedCallback) {
+        m_finishedCallback(ok, message);
+    }
+}
+
+void FileTransfer::fail(const QString &message)
+{
+    write(kAbortSequence);
+    finish(false, QString("Transfer failed: %1").arg(message));
+}
+
+void FileTransfer::startTimer(int ms)
+{
+    m_timer.start(ms);
+}
+
+void FileTransfer::handleTimeout()
+{
+    if (!isActive()) {
+        return;
+    }
+
+    switch (m_phase) {
+    case Phase::XySendWaitStart:
+        if (!m_headerSent && m_progress.fileIndex <= 1 && m_progress.bytesMoved == 0) {
+            fail("receiver did not start");
+            return;
+        }
+        break;
+    case Phase::XySendWaitEotAck:
+        // Every block was acknowledged; a receiver that has already exited
+        // won't answer a repeated EOT.
+        if (m_retries >= kEotRetries) {
+            log(QString("Sent %1 (%2 bytes), end of file not acknowledged").arg(m_progress.fileName).arg(m_filePos));
+            finish(m_progress.fileIndex >= m_sendPaths.size(), "Transfer ended without a final ACK");
+            return;
+        }
+        break;
+    case Phase::XySendWaitHeaderAck:
+        // Same for the empty header that closes a YMODEM batch.
+        if (!m_file.isOpen() && m_retries >= kEotRetries) {
+            finish(true, "Batch sent, end of batch not acknowledged");
+            return;
+        }
+        break;
+    case Phase::ZSendWaitFin:
+        // Every file was confirmed with ZRINIT; a receiver that already
+        // exited won't answer ZFIN.
+        if (m_retries >= kEotRetries) {
+            finish(true, "Batch sent, ZFIN not answered");
+            return;
+        }
+        break;
+    case Phase::ZReceiveWaitOver:
+        // "OO" is a courtesy; the sender is done either way.
+        finish(true, "Batch received");
+        return;
+    case Phase::ZReceiveWaitCrc:
+        // A sender that can't answer ZCRC can't vouch for the file we have.
+        log(QString("No ZCRC answer for %1, receiving it as a new file").arg(m_zFileName));
+        acceptZFile(false);
+        return;
+    case Phase::ZSendStreaming:
+        return;
+    default:
+        break;
+    }
+
+    if (++m_retries > kMaxRetries) {
+        fail("timed out");
+        return;
+    }
+
+    switch (m_phase) {
+    case Phase::XySendWaitHeaderAck:
+        if (!m_file.isOpen()) {
+            write(m_block);
+            startTimer(kBlockTimeoutMs);
+            break;
+        }
+        ++m_progress.errors;
+        startTimer(kAckTimeoutMs);
+        break;
+    case Phase::XySendWaitStart:
+    case Phase::XySendWaitBlockAck:
+        ++m_progress.errors;
+        startTimer(kAckTimeoutMs);
+        break;
+    case Phase::XySendWaitEotAck:
+        write(QByteArray(1, kEot));
+        startTimer(kBlockTimeoutMs);
+        break;
+    case Phase::XyReceiveWaitHeader:
+        m_rx.clear();
+        m_purging = false;
+        write(QByteArray(1, kCrcRequest));
+        startTimer(kPollIntervalMs);
+        break;
+    case Phase::XyReceiveWaitData:
+        m_rx.clear();
+        m_purging = false;
+        if (m_blockNumber == 1 && m_heldBlock.isEmpty()) {
+            // Still waiting for the first block. An old XMODEM sender only knows checksums.
+            if (m_options.protocol != TransferProtocol::Ymodem && m_retries > kChecksumFallbackPolls) {
+                m_crcMode = false;
+            }
+            write(QByteArray(1, m_crcMode ? kCrcRequest : kNak));
+            startTimer(kPollIntervalMs);
+        } else {
+            ++m_progress.errors;
+            write(QByteArray(1, kNak));
+            startTimer(kBlockTimeoutMs);
+        }
+        break;
+    case Phase::ZSendWaitInit:
+    case Phase::ZSendWaitPosition:
+    case Phase::ZSendWaitEofAck:
+    case Phase::ZSendWaitFin:
+    case Phase::ZReceiveWaitFile:
+        sendZHeader(m_zLastHeader);
+        startTimer(kBlockTimeoutMs);
+        break;
+    case Phase::ZSendWaitAck:
+        // No ZACK came back; restart from what the receiver has confirmed.
+        ++m_progress.errors;
+        sendZData(m_zAckedPos);
+        break;
+    case Phase::ZReceiveWaitData:
+    case Phase::ZReceiveData:
+        ++m_progress.errors;
+        m_zState = ZState::Hunt;
+        m_phase = Phase::ZReceiveWaitData;
+        sendZHeader(zHexHeader(ZRPOS, m_filePos));
+        startTimer(kBlockTimeoutMs);
+        break;
+    case Phase::ZSendStreaming:
+    case Phase::ZReceiveWaitOver:
+    case Phase::ZReceiveWaitCrc:
+        break;
+    }
+}
+
+bool FileTransfer::openNextSendFile()
+{
+    m_file.close();
+    const QString path = m_sendPaths.value(m_progress.fileIndex);
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        fail(QString("cannot open %1: %2").arg(path, m_file.errorString()));
+        return false;
+    }
+
+    const QFileInfo info(path);
+    ++m_progress.fileIndex;
+    m_progress.fileName = info.fileName();
+    m_progress.fileSize = m_file.size();
+    m_progress.fileOffset = 0;
+    m_progress.resumedFrom = 0;
+    m_fileSize = m_file.size();
+    m_fileMtime = info.lastModified().toSecsSinceEpoch();
+    m_filePos = 0;
+    return true;
+}
+
+QString FileTransfer::receivePath(const QString &name) const
+{
+    // Only the last path component is used, so a sender can't write outside the directory.
+    QString fileName = QFileInfo(QString(name).replace('\\', '/')).fileName();
+    if (fileName.isEmpty() || fileName == "." || fileName == "..") {
+        fileName = "received.bin";
+    }
+    return QDir(m_receiveTarget).filePath(fileName);
+}
+
+// allowResume: an existing file of that name is known to be the start of this one.
+bool FileTransfer::openReceiveFile(const QString &name, qint64 size, bool allowResume, bool *skip)
+{
+    *skip = false;
+
+    QString path = receivePath(name);
+    const QString fileName = QFileInfo(path).fileName();
+    const QDir dir = QFileInfo(path).dir();
+    m_filePos = 0;
+
+    const QFileInfo existing(path);
+    if (existing.exists()) {
+        if (allowResume && size >= 0 && existing.isFile() && existing.size() == size) {
+            *skip = true;
+        } else if (allowResume && size > 0 && existing.isFile() && existing.size() < size) {
+            m_filePos = existing.size();
+        } else {
+            path = uniquePath(dir, fileName);
+        }
+    }
+
+    ++m_progress.fileIndex;
+    m_progress.fileName = QFileInfo(path).fileName();
+    m_progress.fileSize = size;
+    m_progress.fileOffset = m_filePos;
+    m_progress.resumedFrom = m_filePos;
+    m_fileSize = size;
+
+    if (*skip) {
+        log(QString("Skipping %1, already complete").arg(fileName));
+        return true;
+    }
+
+    m_file.setFileName(path);
+    const QIODevice::OpenMode mode = m_filePos > 0 ? QIODevice::WriteOnly | QIODevice::Append
+                                                   : QIODevice::WriteOnly | QIODevice::Truncate;
+    if (!m_file.open(mode)) {
+        fail(QString("cannot write %1: %2").arg(path, m_file.errorString()));
+        return false;
+    }
+
+    if (m_filePos > 0) {
+        log(QString("Resuming %1 at %2 of %3 bytes").arg(m_progress.fileName).arg(m_filePos).arg(size));
+    } else {
+        log(QString("Receiving %1 (%2 bytes)").arg(m_progress.fileName).arg(size < 0 ? QString("?") : QString::number(size)));
+    }
+    return true;
+}
+
+void FileTransfer::closeReceivedFile()
+{
+    if (m_fileMtime > 0) {
+        m_file.setFileTime(QDateTime::fromSecsSinceEpoch(m_fileMtime), QFileDevice::FileModificationTime);
+    }
+    m_file.close();
+    log(QString("Received %1 (%2 bytes)").arg(m_progress.fileName).arg(m_filePos));
+}
+
+// --- XMODEM / YMODEM --------------------------------------------------------
+
+void FileTransfer::feedXySend(const QByteArray &data)
+{
+    for (const char ch : data) {
+        if (!isActive()) {
+            return;
+        }
+
+        if (ch == kCan) {
+            if (++m_cancelCount >= 2) {
+                finish(false, "Transfer cancelled by the receiver");
+                return;
+            }
+            continue;
+        }
+        m_cancelCount = 0;
+
+        switch (m_phase) {
+        case Phase::XySendWaitStart:
+            if (ch == kCrcRequest || ch == kNak) {
+                m_crcMode = ch == kCrcRequest;
+                m_retries = 0;
+                if (m_options.protocol == TransferProtocol::Ymodem && !m_headerSent) {
+                    sendXyHeader();
+                } else {
+                    sendXyBlock();
+                }
+            }
+            break;
+
+        case Phase::XySendWaitHeaderAck:
+            if (ch == kAck) {
+                m_retries = 0;
+                if (!m_file.isOpen()) {
+                    finish(true, "Batch sent");
+                    return;
+                }
+                // The receiver asks for the data with another 'C'.
+                m_headerSent = true;
+                m_phase = Phase::XySendWaitStart;
+                startTimer(kAckTimeoutMs);
+            } else if (ch == kNak || ch == kCrcRequest) {
+                // 'C' is the receiver still polling for block 0.
+                ++m_progress.errors;
+                write(m_block);
+                startTimer(kAckTimeoutMs);
+            }
+            break;
+
+        case Phase::XySendWaitBlockAck:
+            if (ch == kAck) {
+                m_retries = 0;
+                m_filePos += m_blockLength;
+                m_progress.fileOffset = m_filePos;
+                m_progress.bytesMoved += m_blockLength;
+                ++m_blockNumber;
+                sendXyBlock();
+            } else if (ch == kNak || (ch == kCrcRequest && m_filePos == 0)) {
+                // 'C' is a receiver still polling for the first block.
+                ++m_progress.errors;
+                if (++m_retries > kMaxRetries) {
+                    fail(QString("block %1 refused %2 times").arg(m_blockNumber).arg(kMaxRetries));
+                    return;
+                }
+                write(m_block);
+                startTimer(kAckTimeoutMs);
+            }
+            break;
+
+        case Phase::XySendWaitEotAck:
+            // A YMODEM receiver asking for the next header has taken the EOT
+            // even if its ACK got lost.
+            if (ch == kAck || (ch == kCrcRequest && m_options.protocol == TransferProtocol::Ymodem)) {
+                m_retries = 0;
+                log(QString("Sent %1 (%2 bytes)").arg(m_progress.fileName).arg(m_filePos));
+                m_file.close();
+                if (m_options.protocol != TransferProtocol::Ymodem) {
+                    finish(true, "File sent");
+                    return;
+                }
+                // Next header, or the empty one that ends the batch, on the next 'C'.
+                if (m_progress.fileIndex < m_sendPaths.size() && !openNextSendFile()) {
+                    return;
+                }
+                m_headerSent = false;
+                m_phase = Phase::XySendWaitStart;
+                startTimer(kAckTimeoutMs);
+                if (ch == kCrcRequest) {
+                    sendXyHeader();
+                }
+            } else if (ch == kNak) {
+                write(QByteArray(1, kEot));
+                startTimer(kAckTimeoutMs);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void FileTransfer::sendXyHeader()
+{
+    QByteArray payload;
+    if (m_file.isOpen()) {
+        payload = m_progress.fileName.toUtf8();
+        payload.append('\0');
+        payload.append(QString("%1 %2 %3").arg(m_fileSize).arg(m_fileMtime, 0, 8).arg(kFileMode, 0, 8).toLatin1());
+        payload.truncate(1024);
+    }
+
+    m_block = buildXyBlock(0, payload, payload.size() > 128 ? 1024 : 128, '\0');
+    m_blockLength = 0;
+    m_blockNumber = 1;
+    m_filePos = 0;
+    write(m_block);
+    m_phase = Phase::XySendWaitHeaderAck;
+    startTimer(kAckTimeoutMs);
+}
+
+void FileTransfer::sendXyBlock()
+{
+    const qint64 remaining = m_fileSize - m_filePos;
+    // 1K blocks unless the tail fits in a few short ones with less padding.
+    const qsizetype blockSize = m_options.protocol == TransferProtocol::XmodemCrc || remaining <= 896 ? 128 : 1024;
+
+    const QByteArray payload = m_file.read(blockSize);
+    if (m_file.error() != QFileDevice::NoError) {
+        fail(QString("cannot read %1: %2").arg(m_progress.fileName, m_file.errorString()));
+        return;
+    }
+
+    if (payload.isEmpty()) {
+        write(QByteArray(1, kEot));
+        m_phase = Phase::XySendWaitEotAck;
+        startTimer(kAckTimeoutMs);
+        return;
+    }
+
+    m_blockLength = payload.size();
+    m_block = buildXyBlock(m_blockNumber, payload, blockSize, kSub);
+    write(m_block);
+    m_phase = Phase::XySendWaitBlockAck;
+    startTimer(kAckTimeoutMs);
+}
+
+QByteArray FileTransfer::buildXyBlock(quint8 number, const QByteArray &payload, qsizetype blockSize, char pad) const
+{
+    QByteArray block;
+    block.reserve(blockSize + 5);
+    block.append(blockSize == 1024 ? kStx : kSoh);
+    block.append(static_cast<char>(number));
+    block.append(static_cast<char>(0xFF - number));
+    block.append(payload);
+    block.append(blockSize - payload.size(), pad);
+
+    const char *data = block.constData() + 3;
+    if (m_crcMode) {
+        const quint16 crc = crc16Xmodem(data, blockSize);
+        block.append(static_cast<char>(crc >> 8));
+        block.append(static_cast<char>(crc & 0xFF));
+    } else {
+        uchar sum = 0;
+        for (qsizetype i = 0; i < blockSize; ++i) {
+            sum = static_cast<uchar>(sum + static_cast<uchar>(data[i]));
+        }
+        block.append(static_cast<char>(sum));
+    }
+    return block;
+}
+
+void FileTransfer::feedXyReceive(const QByteArray &data)
+{
+    if (m_purging) {
+        startTimer(kPurgeQuietMs);
+        return;
+    }
+
+    m_rx.append(data);
+
+    qsizetype pos = 0;
+    while (isActive() && pos < m_rx.size()) {
+        const char head = m_rx.at(pos);
+
+        if (head == kSoh || head == kStx) {
+            m_cancelCount = 0;
+            const qsizetype blockSize = head == kStx ? 1024 : 128;
+            const qsizetype total = 3 + blockSize + (m_crcMode ? 2 : 1);
+            if (m_rx.size() - pos < total) {
+                break;
+            }
+
+            const auto *block = reinterpret_cast<const uchar *>(m_rx.constData() + pos);
+            const char *payload = m_rx.constData() + pos + 3;
+            bool valid = (block[1] ^ block[2]) == 0xFF;
+            if (valid && m_crcMode) {
+                valid = crc16Xmodem(payload, blockSize) == ((block[3 + blockSize] << 8) | block[4 + blockSize]);
+            } else if (valid) {
+                uchar sum = 0;
+                for (qsizetype i = 0; i < blockSize; ++i) {
+                    sum = static_cast<uchar>(sum + static_cast<uchar>(payload[i]));
+                }
+                valid = sum == block[3 + blockSize];
+            }
+
+            if (!valid) {
+                purgeXyReceive();
+                return;
+            }
+
+            handleXyBlock(block[1], payload, blockSize);
+            pos += total;
+        } else if (head == kEot) {
+            m_cancelCount = 0;
+            ++pos;
+            handleXyEot();
+        } else if (head == kCan) {
+            ++pos;
+            if (++m_cancelCount >= 2) {
+                finish(false, "Transfer cancelled by the sender");
+                return;
+            }
+        } else {
+            purgeXyReceive();
+            return;
+        }
+    }
+
+    m_rx.remove(0, std::min(pos, m_rx.size()));
+}
+
+// Framing can't be trusted after a damaged block or stray bytes, and a 0x04
+// inside the rest of it would pass for EOT. Like classic receivers, drop
+// everything until the line has been quiet for a moment; the timeout then
+// NAKs (or polls) as usual.
+void FileTransfer::purgeXyReceive()
+{
+    m_rx.clear();
+    m_cancelCount = 0;
+    m_purging = true;
+    startTimer(kPurgeQuietMs);
+}
+
+void FileTransfer::handleXyBlock(quint8 number, const char *data, qsizetype size)
+{
+    m_retries = 0;
+
+    if (m_phase == Phase::XyReceiveWaitHeader) {
+        if (number != 0) {
+            write(QByteArray(1, kNak));
+            startTimer(kPollIntervalMs);
+            return;
+        }
+
+        const char *nameEnd = static_cast<const char *>(std::memchr(data, '\0', size));
+        const qsizetype nameLength = nameEnd != nullptr ? nameEnd - data : size;
+        if (nameLength == 0) {
+            write(QByteArray(1, kAck));
+            finish(true, "Batch received");
+            return;
+        }
+
+        const QString name = QString::fromUtf8(data, nameLength);
+        const QByteArray info = nameEnd != nullptr ? QByteArray(nameEnd + 1, qstrnlen(nameEnd + 1, size - nameLength - 1))
+                                                   : QByteArray();
+        const QList<QByteArray> fields = info.simplified().split(' ');
+        bool ok = false;
+        const qint64 fileSize = fields.value(0).toLongLong(&ok);
+        m_fileMtime = fields.value(1).toLongLong(nullptr, 8);
+
+        bool skip = false;
+        if (!openReceiveFile(name, ok ? fileSize : -1, false, &skip)) {
+            return;
+        }
+
+        write(QByteArray(1, kAck));
+        write(QByteArray(1, kCrcRequest));
+        m_blockNumber = 1;
+        m_eotNaked = false;
+        m_phase = Phase::XyReceiveWaitData;
+        startTimer(kBlockTimeoutMs);
+        return;
+    }
+
+    if (number == m_blockNumber) {
+        flushHeldBlock(false);
+        if (!isActive()) {
+            return;
+        }
+        m_heldBlock = QByteArray(data, size);
+        ++m_blockNumber;
+        write(QByteArray(1, kAck));
+        startTimer(kBlockTimeoutMs);
+    } else if (number == static_cast<quint8>(m_blockNumber - 1)) {
+        // Our ACK got lost and the sender repeated the block.
+        write(QByteArray(1, kAck));
+    } else {
+        fail(QString("block %1 out of sequence, expected %2").arg(number).arg(m_blockNumber));
+    }
+}
+
+void FileTransfer::handleXyEot()
+{
+    if (m_phase == Phase::XyReceiveWaitHeader) {
+        // Repeat of the last file's EOT; our ACK got lost.
+        write(QByteArray(1, kAck));
+        return;
+    }
+
+    // YMODEM receivers NAK the first EOT so a noise byte can't end a file early.
+    if (m_options.protocol == TransferProtocol::Ymodem && !m_eotNaked) {
+        m_eotNaked = true;
+        write(QByteArray(1, kNak));
+        startTimer(kBlockTimeoutMs);
+        return;
+    }
+
+    flushHeldBlock(true);
+    if (!isActive()) {
+        return;
+    }
+    closeReceivedFile();
+    write(QByteArray(1, kAck));
+
+    if (m_options.protocol != TransferProtocol::Ymodem) {
+        finish(true, "File received");
+        return;
+    }
+
+    m_blockNumber = 0;
+    m_eotNaked = false;
+    m_phase = Phase::XyReceiveWaitHeader;
+    write(QByteArray(1, kCrcRequest));
+    startTimer(kPollIntervalMs);
+}
+
+void FileTransfer::flushHeldBlock(bool last)
+{
+    if (m_heldBlock.isEmpty()) {
+        return;
+    }
+
+    qsizetype length = m_heldBlock.size();
+    if (m_fileSize >= 0) {
+        length = static_cast<qsizetype>(qBound<qint64>(0, m_fileSize - m_filePos, length));
+    } else if (last) {
+        // XMODEM doesn't carry a size; the last block is padded with SUB.
+        while (length > 0 && m_heldBlock.at(length - 1) == kSub) {
+            --length;
+        }
+    }
+
+    if (m_file.write(m_heldBlock.constData(), length) != length) {
+        fail(QString("cannot write %1: %2").arg(m_progress.fileName, m_file.errorString()));
+        return;
+    }
+
+    m_filePos += length;
+    m_progress.fileOffset = m_filePos;
+    m_progress.bytesMoved += length;
+    m_heldBlock.clear();
+}
+
+// --- ZMODEM -----------------------------------------------------------------
+
+void FileTransfer::feedZmodem(const QByteArray &data)
+{
+    for (const char ch : data) {
+        if (!isActive()) {
+            return;
+        }
+
+        const uchar c = static_cast<uchar>(ch);
+        // Five ZDLEs (CAN) in a row abort the session, whatever we were parsing.
+        if (ch == kZdle) {
+            if (++m_cancelCount >= 5) {
+                finish(false, "Transfer cancelled by the peer");
+                return;
+            }
+        } else {
+            m_cancelCount = 0;
+        }
+
+        switch (m_zState) {
+        case ZState::Hunt:
+            if (ch == kZpad) {
+                m_zState = ZState::Pad;
+            } else if (m_phase == Phase::ZReceiveWaitOver && ch == 'O' && m_zLastByte == 'O') {
+                finish(true, "Batch received");
+                return;
+            }
+            break;
+
+        case ZState::Pad:
+            if (ch == kZdle) {
+                m_zState = ZState::PadZdle;
+            } else if (ch != kZpad) {
+                m_zState = ZState::Hunt;
+            }
+            break;
+
+        case ZState::PadZdle:
+            m_zHeader.clear();
+            m_zEscape = false;
+            if (ch == kZhex) {
+                m_zState = ZState::HexHeader;
+            } else if (ch == kZbin || ch == kZbin32) {
+                m_zCrc32 = ch == kZbin32;
+                m_zHeaderLength = 5 + (m_zCrc32 ? 4 : 2);
+                m_zState = ZState::BinaryHeader;
+            } else {
+                m_zState = ZState::Hunt;
+            }
+            break;
+
+        case ZState::HexHeader: {
+            const int nibble = hexNibble(c & 0x7F);
+            if (nibble < 0) {
+                ++m_progress.errors;
+                m_zState = ZState::Hunt;
+                break;
+            }
+            m_zHeader.append(static_cast<char>(nibble));
+            if (m_zHeader.size() == 14) {
+                QByteArray bytes(7, '\0');
+                for (int i = 0; i < 7; ++i) {
+                    bytes[i] = static_cast<char>((m_zHeader.at(2 * i) << 4) | m_zHeader.at(2 * i + 1));
+                }
+                m_zHeader = bytes;
+                m_zCrc32 = false;
+                finishZHeader();
+            }
+            break;
+        }
+
+        case ZState::BinaryHeader:
+        case ZState::SubpacketCrc: {
+            uchar byte = c;
+            if (m_zEscape) {
+                m_zEscape = false;
+                if (ch == kZrub0) {
+                    byte = 0x7F;
+                } else if (ch == kZrub1) {
+                    byte = 0xFF;
+                } else if ((c & 0x60) == 0x40) {
+                    byte = c ^ 0x40;
+                } else {
+                    zmodemDataError("bad escape");
+                    break;
+                }
+            } else if (ch == kZdle) {
+                m_zEscape = true;
+                break;
+            } else if (isFlowControl(c)) {
+                break;
+            }
+
+            if (m_zState == ZState::BinaryHeader) {
+                m_zHeader.append(static_cast<char>(byte));
+                if (m_zHeader.size() == m_zHeaderLength) {
+                    finishZHeader();
+                }
+            } else {
+                m_zCrc.append(static_cast<char>(byte));
+                if (m_zCrc.size() == (m_zCrc32 ? 4 : 2)) {
+                    finishZSubpacket();
+                }
+            }
+            break;
+        }
+
+        case ZState::Subpacket:
+            if (m_zEscape) {
+                m_zEscape = false;
+                switch (ch) {
+                case kZcrce:
+                case kZcrcg:
+                case kZcrcq:
+                case kZcrcw:
+                    m_zFrameEnd = ch;
+                    m_zCrc.clear();
+                    m_zState = ZState::SubpacketCrc;
+                    break;
+                case kZrub0:
+                    m_zData.append('\x7f');
+                    break;
+                case kZrub1:
+                    m_zData.append('\xff');
+                    break;
+                default:
+                    if ((c & 0x60) == 0x40) {
+                        m_zData.append(static_cast<char>(c ^ 0x40));
+                    } else if (ch == kZdle) {
+                        m_zEscape = true; // probably a cancel; the counter above decides
+                    } else {
+                        zmodemDataError("bad escape");
+                    }
+                    break;
+                }
+            } else if (ch == kZdle) {
+                m_zEscape = true;
+            } else if (!isFlowControl(c)) {
+                m_zData.append(ch);
+                if (m_zData.size() > kZmodemMaxSubpacketBytes) {
+                    zmodemDataError("subpacket too long");
+                }
+            }
+            break;
+        }
+
+        m_zLastByte = ch;
+    }
+}
+
+void FileTransfer::finishZHeader()
+{
+    m_zState = ZState::Hunt;
+
+    const auto *frame = reinterpret_cast<const uchar *>(m_zHeader.constData());
+    bool valid = false;
+    if (m_zCrc32) {
+        valid = crc32(m_zHeader.constData(), 5) == static_cast<quint32>(bytesPosition(frame + 5));
+    } else {
+        valid = crc16Xmodem(m_zHeader.constData(), 5) == ((frame[5] << 8) | frame[6]);
+    }
+
+    if (!valid) {
+        ++m_progress.errors;
+        if (m_phase == Phase::ZReceiveData) {
+            zmodemDataError("bad header CRC");
+        }
+        return;
+    }
+
+    const int type = frame[0];
+    const qint64 position = bytesPosition(frame + 1);
+    if (type == ZABORT || type == ZFERR || type == ZCAN) {
+        finish(false, "Transfer aborted by the peer");
+        return;
+    }
+
+    if (m_role == Role::Send) {
+        handleZSendHeader(type, position, frame + 1);
+    } else {
+        handleZReceiveHeader(type, position, frame + 1);
+    }
+}
+
+void FileTransfer::startZSubpacket(ZSubpacket expect)
+{
+    m_zExpect = expect;
+    m_zData.clear();
+    m_zEscape = false;
+    m_zState = ZState::Subpacket;
+}
+
+void FileTransfer::finishZSubpacket()
+{
+    bool valid = false;
+    if (m_zCrc32) {
+        quint32 crc = crc32(m_zData.constData(), m_zData.size());
+        crc = crc32(&m_zFrameEnd, 1, crc);
+        valid = crc == static_cast<quint32>(bytesPosition(reinterpret_cast<const uchar *>(m_zCrc.constData())));
+    } else {
+        quint16 crc = crc16Xmodem(m_zData.constData(), m_zData.size());
+        crc = crc16Xmodem(&m_zFrameEnd, 1, crc);
+        const auto *bytes = reinterpret_cast<const uchar *>(m_zCrc.constData());
+        valid = crc == ((bytes[0] << 8) | bytes[1]);
+    }
+
+    if (!valid) {
+        zmodemDataError("bad CRC");
+        return;
+    }
+
+    // ZCRCG and ZCRCQ keep the frame open; the others hand back to header hunting.
+    const bool frameContinues = m_zFrameEnd == kZcrcg || m_zFrameEnd == kZcrcq;
+    m_zState = frameContinues ? ZState::Subpacket : ZState::Hunt;
+    handleZSubpacket();
+    m_zData.clear();
+    m_zEscape = false;
+}
+
+void FileTransfer::zmodemDataError(const QString &reason)
+{
+    ++m_progress.errors;
+    m_zState = ZState::Hunt;
+    m_zEscape = false;
+    m_zData.clear();
+
+    if (m_role != Role::Receive) {
+        return;
+    }
+
+    if (m_phase == Phase::ZReceiveData) {
+        // Everything up to here is on disk; ask for the rest and ignore the
+        // stream until a ZDATA header for that position shows up.
+        if (m_progress.errors % 16 == 1) {
+            log(QString("ZMODEM %1 at %2, repositioning").arg(reason).arg(m_filePos));
+        }
+        m_phase = Phase::ZReceiveWaitData;
+        sendZHeader(zHexHeader(ZRPOS, m_filePos));
+        startTimer(kBlockTimeoutMs);
+    } else if (m_zExpect == ZSubpacket::FileInfo) {
+        sendZHeader(zHexHeader(ZNAK, 0));
+    }
+}
+
+void FileTransfer::handleZSendHeader(int type, qint64 position, const uchar *bytes)
+{
+    switch (type) {
+    case ZRINIT:
+        m_zSendCrc32 = (bytes[kZf0] & kCanFc32) != 0;
+        m_zEscapeControl = (bytes[kZf0] & kEscCtl) != 0;
+        m_zReceiverBuffer = bytes[0] | (bytes[1] << 8);
+        if (m_phase == Phase::ZSendWaitInit) {
+            m_retries = 0;
+            sendZFile();
+        } else if (m_phase == Phase::ZSendWaitEofAck) {
+            m_retries = 0;
+            log(QString("Sent %1 (%2 bytes)").arg(m_progress.fileName).arg(m_filePos));
+            nextZFile();
+        }
+        break;
+
+    case ZRPOS:
+        if (m_phase == Phase::ZSendWaitPosition) {
+            m_retries = 0;
+            m_progress.resumedFrom = position;
+            if (position > 0) {
+                log(QString("Receiver resumes %1 at %2 bytes").arg(m_progress.fileName).arg(position));
+            }
+        } else if (m_phase == Phase::ZSendStreaming || m_phase == Phase::ZSendWaitAck
+                   || m_phase == Phase::ZSendWaitEofAck) {
+            ++m_progress.errors;
+            if (position == m_zLastRposPos) {
+                if (++m_zRposRepeats > kMaxRetries) {
+                    fail(QString("receiver keeps asking for offset %1").arg(position));
+                    return;
+                }
+            } else {
+                m_zLastRposPos = position;
+                m_zRposRepeats = 0;
+            }
+        } else {
+            break;
+        }
+        if (position > m_fileSize) {
+            fail(QString("receiver asked for offset %1 past the end").arg(position));
+            return;
+        }
+        m_zOut.clear();
+        sendZData(position);
+        break;
+
+    case ZSKIP:
+        if (m_phase == Phase::ZSendWaitPosition || m_phase == Phase::ZSendStreaming
+            || m_phase == Phase::ZSendWaitAck || m_phase == Phase::ZSendWaitEofAck) {
+            log(QString("Receiver skipped %1").arg(m_progress.fileName));
+            m_zOut.clear();
+            nextZFile();
+        }
+        break;
+
+    case ZACK:
+        if ((m_phase == Phase::ZSendStreaming || m_phase == Phase::ZSendWaitAck) && position > m_zAckedPos
+            && position <= m_filePos) {
+            m_retries = 0;
+            m_zAckedPos = position;
+            if (m_phase == Phase::ZSendWaitAck) {
+                if (m_zFrameOpen) {
+                    m_phase = Phase::ZSendStreaming;
+                    m_timer.stop();
+                    pumpZmodem();
+                } else {
+                    sendZData(m_filePos);
+                }
+            }
+        }
+        break;
+
+    case ZNAK:
+        if (++m_retries > kMaxRetries) {
+            fail("receiver keeps rejecting our headers");
+            return;
+        }
+        sendZHeader(m_zLastHeader);
+        break;
+
+    case ZCRC: {
+        // The receiver checks a file it already has against ours before resuming.
+        const qint64 length = position > 0 ? std::min(position, m_fileSize) : m_fileSize;
+        sendZHeader(zHexHeader(ZCRC, fileCrc32(m_file, length)));
+        break;
+    }
+
+    case ZCHALLENGE: {
+        sendZHeader(zHexHeader(ZACK, position));
+        break;
+    }
+
+    case ZFIN:
+        if (m_phase == Phase::ZSendWaitFin) {
+            write("OO");
+            finish(true, "Batch sent");
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void FileTransfer::handleZReceiveHeader(int type, qint64 position, const uchar *bytes)
+{
+    switch (type) {
+    case ZRQINIT:
+        if (m_phase == Phase::ZReceiveWaitFile) {
+            sendZReceiverInit();
+        }
+        break;
+
+    case ZSINIT:
+        startZSubpacket(ZSubpacket::Attention);
+        break;
+
+    case ZFILE:
+        m_zFileConversion = bytes[kZf0];
+        startZSubpacket(ZSubpacket::FileInfo);
+        break;
+
+    case ZCRC:
+        if (m_phase == Phase::ZReceiveWaitCrc) {
+            QFile existing(receivePath(m_zFileName));
+            const bool matches = existing.open(QIODevice::ReadOnly)
+                                 && fileCrc32(existing, m_zCheckLength) == static_cast<quint32>(position);
+            if (!matches) {
+                log(QString("%1 differs from the sender's, receiving it as a new file").arg(m_zFileName));
+            }
+            acceptZFile(matches);
+        }
+        break;
+
+    case ZDATA:
+        if (m_phase != Phase::ZReceiveWaitData && m_phase != Phase::ZReceiveData) {
+            break;
+        }
+        if (position != m_filePos) {
+            ++m_progress.errors;
+            m_phase = Phase::ZReceiveWaitData;
+            sendZHeader(zHexHeader(ZRPOS, m_filePos));
+            startTimer(kBlockTimeoutMs);
+            break;
+        }
+        m_retries = 0;
+        m_phase = Phase::ZReceiveData;
+        startZSubpacket(ZSubpacket::FileData);
+        startTimer(kBlockTimeoutMs);
+        break;
+
+    case ZEOF:
+        // A ZEOF for another offset is stale, sent before our last ZRPOS got through.
+        if ((m_phase == Phase::ZReceiveWaitData || m_phase == Phase::ZReceiveData) && position == m_filePos) {
+            closeReceivedFile();
+            m_phase = Phase::ZReceiveWaitFile;
+            sendZReceiverInit();
+            startTimer(kBlockTimeoutMs);
+        }
+        break;
+
+    case ZFIN:
+        sendZHeader(zHexHeader(ZFIN, 0));
+        m_phase = Phase::ZReceiveWaitOver;
+        startTimer(kOverTimeoutMs);
+        break;
+
+    case ZNAK:
+        sendZHeader(m_zLastHeader);
+        break;
+
+    case ZFREECNT:
+        sendZHeader(zHexHeader(ZACK, 0));
+        break;
+
+    case ZCOMMAND:
+        log("Ignoring a ZMODEM remote command");
+        break;
+
+    default:
+        break;
+    }
+}
+
+void FileTransfer::handleZSubpacket()
+{
+    switch (m_zExpect) {
+    case ZSubpacket::Attention:
+        sendZHeader(zHexHeader(ZACK, 0));
+        m_zExpect = ZSubpacket::None;
+        break;
+
+    case ZSubpacket::FileInfo: {
+        m_zExpect = ZSubpacket::None;
+        if (m_phase == Phase::ZReceiveWaitCrc) {
+            // A repeated ZFILE: our ZCRC got lost.
+            sendZHeader(zHexHeader(ZCRC, m_zCheckLength));
+            break;
+        }
+        if (m_phase != Phase::ZReceiveWaitFile) {
+            // A repeated ZFILE: our ZRPOS got lost.
+            sendZHeader(zHexHeader(ZRPOS, m_filePos));
+            break;
+        }
+
+        const qsizetype nameLength = qstrnlen(m_zData.constData(), m_zData.size());
+        const QString name = QString::fromUtf8(m_zData.constData(), nameLength);
+        const QList<QByteArray> fields = m_zData.mid(nameLength + 1).replace('\0', ' ').simplified().split(' ');
+        bool ok = false;
+        const qint64 size = fields.value(0).toLongLong(&ok);
+        m_fileMtime = fields.value(1).toLongLong(nullptr, 8);
+        bool filesLeftOk = false;
+        const int filesLeft = fields.value(4).toInt(&filesLeftOk);
+
+        if (filesLeftOk && filesLeft > 0) {
+            m_progress.fileCount = m_progress.fileIndex + filesLeft;
+        }
+        m_zFileName = name;
+        m_zFileSize = ok ? size : -1;
+
+        // Only data the sender vouches for is kept: an existing file is
+        // continued or skipped after its CRC matches the sender's copy, or
+        // straight away when the sender asked for crash recovery.
+        const QFileInfo existing(receivePath(name));
+        if (!m_options.resume || !existing.isFile() || m_zFileSize <= 0 || existing.size() == 0
+            || existing.size() > m_zFileSize) {
+            acceptZFile(false);
+        } else if (m_zFileConversion == kZcrecov && existing.size() < m_zFileSize) {
+            acceptZFile(true);
+        } else {
+            m_zCheckLength = existing.size();
+            m_phase = Phase::ZReceiveWaitCrc;
+            sendZHeader(zHexHeader(ZCRC, m_zCheckLength));
+            startTimer(kBlockTimeoutMs);
+        }
+        break;
+    }
+
+    case ZSubpacket::FileData:
+        if (!m_zData.isEmpty() && m_file.write(m_zData) != m_zData.size()) {
+            fail(QString("cannot write %1: %2").arg(m_progress.fileName, m_file.errorString()));
+            return;
+        }
+        m_filePos += m_zData.size();
+        m_progress.fileOffset = m_filePos;
+        m_progress.bytesMoved += m_zData.size();
+        m_retries = 0;
+
+        if (m_zFrameEnd == kZcrcq || m_zFrameEnd == kZcrcw) {
+            sendZHeader(zHexHeader(ZACK, m_filePos));
+        }
+        if (m_zFrameEnd == kZcrce || m_zFrameEnd == kZcrcw) {
+            m_phase = Phase::ZReceiveWaitData;
+        }
+        startTimer(kBlockTimeoutMs);
+        break;
+
+    case ZSubpacket::None:
+        break;
+    }
+}
+
+QByteArray FileTransfer::zHexHeader(int type, qint64 position) const
+{
+    uchar bytes[4];
+    positionBytes(position, bytes);
+    return zHexHeader(type, bytes);
+}
+
+QByteArray FileTransfer::zHexHeader(int type, const uchar (&bytes)[4]) const
+{
+    static const char kDigits[] = "0123456789abcdef";
+
+    char frame[5] = {static_cast<char>(type)};
+    std::memcpy(frame + 1, bytes, 4);
+    const quint16 crc = crc16Xmodem(frame, 5);
+    const uchar raw[7] = {static_cast<uchar>(type), bytes[0], bytes[1], bytes[2], bytes[3],
+                          static_cast<uchar>(crc >> 8), static_cast<uchar>(crc & 0xFF)};
+
+    QByteArray header;
+    header.reserve(22);
+    header.append(kZpad);
+    header.append(kZpad);
+    header.append(kZdle);
+    header.append(kZhex);
+    for (const uchar byte : raw) {
+        header.append(kDigits[byte >> 4]);
+        header.append(kDigits[byte & 0x0F]);
+    }
+    header.append('\r');
+    header.append(static_cast<char>(0x8A));
+    if (type != ZFIN && type != ZACK) {
+        header.append(kXon);
+    }
+    return header;
+}
+
+QByteArray FileTransfer::zBinaryHeader(int type, qint64 position) const
+{
+    uchar bytes[4];
+    positionBytes(position, bytes);
+    return zBinaryHeader(type, bytes);
+}
+
+QByteArray FileTransfer::zBinaryHeader(int type, const uchar (&bytes)[4]) const
+{
+    char frame[5] = {static_cast<char>(type)};
+    std::memcpy(frame + 1, bytes, 4);
+
+    QByteArray header;
+    header.reserve(24);
+    header.append(kZpad);
+    header.append(kZdle);
+    header.append(m_zSendCrc32 ? kZbin32 : kZbin);
+    appendZEscaped(header, frame, 5);
+
+    if (m_zSendCrc32) {
+        uchar crc[4];
+        positionBytes(crc32(frame, 5), crc);
+        appendZEscaped(header, reinterpret_cast<const char *>(crc), 4);
+    } else {
+        const quint16 crc = crc16Xmodem(frame, 5);
+        const char crcBytes[2] = {static_cast<char>(crc >> 8), static_cast<char>(crc & 0xFF)};
+        appendZEscaped(header, crcBytes, 2);
+    }
+    return header;
+}
+
+void FileTransfer::sendZHeader(const QByteArray &header)
+{
+    m_zLastHeader = header;
+    write(header);
+}
+
+void FileTransfer::appendZEscaped(QByteArray &out, const char *data, qsizetype size) const
+{
+    const std::array<bool, 256> &escape = m_zEscapeControl ? kZEscapeControl : kZEscape;
+    qsizetype runStart = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        const uchar c = static_cast<uchar>(data[i]);
+        if (escape[c]) {
+            out.append(data + runStart, i - runStart);
+            out.append(kZdle);
+            out.append(static_cast<char>(c ^ 0x40));
+            runStart = i + 1;
+        }
+    }
+    out.append(data + runStart, size - runStart);
+}
+
+void FileTransfer::appendZSubpacket(QByteArray &out, const char *data, qsizetype size, char frameEnd) const
+{
+    appendZEscaped(out, data, size);
+    out.append(kZdle);
+    out.append(frameEnd);
+
+    if (m_zSendCrc32) {
+        quint32 crc = crc32(data, size);
+        crc = crc32(&frameEnd, 1, crc);
+        uchar bytes[4];
+        positionBytes(crc, bytes);
+        appendZEscaped(out, reinterpret_cast<const char *>(bytes), 4);
+    } else {
+        quint16 crc = crc16Xmodem(data, size);
+        crc = crc16Xmodem(&frameEnd, 1, crc);
+        const char bytes[2] = {static_cast<char>(crc >> 8), static_cast<char>(crc & 0xFF)};
+        appendZEscaped(out, bytes, 2);
+    }
+
+    if (frameEnd == kZcrcw) {
+        out.append(kXon);
+    }
+}
+
+void FileTransfer::sendZReceiverInit()
+{
+    const uchar flags[4] = {0, 0, 0, kCanFdx | kCanOvio | kCanFc32};
+    sendZHeader(zHexHeader(ZRINIT, flags));
+}
+
+void FileTransfer::acceptZFile(bool existingMatches)
+{
+    bool skip = false;
+    if (!openReceiveFile(m_zFileName, m_zFileSize, existingMatches, &skip)) {
+        return;
+    }
+
+    if (skip) {
+        m_phase = Phase::ZReceiveWaitFile;
+        sendZHeader(zHexHeader(ZSKIP, 0));
+        startTimer(kBlockTimeoutMs);
+        return;
+    }
+
+    m_phase = Phase::ZReceiveWaitData;
+    sendZHeader(zHexHeader(ZRPOS, m_filePos));
+    startTimer(kBlockTimeoutMs);
+}
+
+void FileTransfer::sendZFile()
+{
+    qint64 bytesLeft = 0;
+    for (qsizetype i = m_progress.fileIndex - 1; i < m_sendPaths.size(); ++i) {
+        bytesLeft += QFileInfo(m_sendPaths.at(i)).size();
+    }
+    const int filesLeft = static_cast<int>(m_sendPaths.size() - m_progress.fileIndex + 1);
+
+    QByteArray info = m_progress.fileName.toUtf8();
+    info.append('\0');
+    info.append(QString("%1 %2 %3 0 %4 %5")
+                    .arg(m_fileSize)
+                    .arg(m_fileMtime, 0, 8)
+                    .arg(kFileMode, 0, 8)
+                    .arg(filesLeft)
+                    .arg(bytesLeft)
+                    .toLatin1());
+    info.append('\0');
+
+    const uchar flags[4] = {0, 0, 0, kZcbin};
+    QByteArray frame = zBinaryHeader(ZFILE, flags);
+    appendZSubpacket(frame, info.constData(), info.size(), kZcrcw);
+    sendZHeader(frame);
+    m_phase = Phase::ZSendWaitPosition;
+    startTimer(kBlockTimeoutMs);
+}
+
+void FileTransfer::nextZFile()
+{
+    m_file.close();
+    if (m_progress.fileIndex < m_sendPaths.size()) {
+        if (!openNextSendFile()) {
+            return;
+        }
+        sendZFile();
+        return;
+    }
+
+    sendZHeader(zHexHeader(ZFIN, 0));
+    m_phase = Phase::ZSendWaitFin;
+    startTimer(kBlockTimeoutMs);
+}
+
+void FileTransfer::sendZData(qint64 position)
+{
+    if (!m_file.seek(position)) {
+        fail(QString("cannot seek %1 to %2").arg(m_progress.fileName).arg(position));
+        return;
+    }
+
+    m_filePos = position;
+    m_zAckedPos = position; // a ZRPOS or ZDATA restart implies everything before it arrived
+    m_zFrameStart = position;
+    m_zQueryPos = position + std::max<qint64>(m_options.zmodemWindowBytes / 4, kZmodemSubpacketBytes);
+    m_progress.fileOffset = position;
+
+    m_zOut.append(zBinaryHeader(ZDATA, position));
+    m_zFrameOpen = true;
+    m_phase = Phase::ZSendStreaming;
+    m_timer.stop();
+    pumpZmodem();
+}
+
+// Streams subpackets while the port queue has room and the window allows.
+// ZCRCG needs no answer; a ZCRCQ every quarter window brings ZACKs back
+// while data keeps flowing, so the window only closes when acks stall.
+void FileTransfer::pumpZmodem()
+{
+    const qint64 window = m_options.zmodemWindowBytes;
+    char chunk[kZmodemSubpacketBytes];
+
+    while (m_phase == Phase::ZSendStreaming) {
+        if (pendingWrite() + m_zOut.size() >= kMaxQueuedBytes) {
+            m_pumpTimer.start(kPumpRetryMs);
+            break;
+        }
+        if (window > 0 && m_filePos - m_zAckedPos >= window) {
+            m_phase = Phase::ZSendWaitAck;
+            startTimer(kBlockTimeoutMs);
+            break;
+        }
+
+        const qint64 read = m_file.read(chunk, sizeof(chunk));
+        if (read < 0) {
+            fail(QString("cannot read %1: %2").arg(m_progress.fileName, m_file.errorString()));
+            return;
+        }
+        const bool last = m_file.atEnd();
+        const qint64 next = m_filePos + read;
+
+        char frameEnd = kZcrcg;
+        if (last) {
+            frameEnd = kZcrce;
+        } else if (m_zReceiverBuffer > 0 && next - m_zFrameStart >= m_zReceiverBuffer) {
+            frameEnd = kZcrcw;
+        } else if (window > 0 && next >= m_zQueryPos) {
+            frameEnd = kZcrcq;
+            m_zQueryPos = next + std::max<qint64>(window / 4, kZmodemSubpacketBytes);
+        }
+
+        appendZSubpacket(m_zOut, chunk, read, frameEnd);
+        m_filePos = next;
+        m_progress.fileOffset = next;
+        m_progress.bytesMoved += read;
+
+        if (last) {
+            m_zFrameOpen = false;
+            const QByteArray eof = zBinaryHeader(ZEOF, m_filePos);
+            m_zOut.append(eof);
+            m_zLastHeader = eof;
+            m_phase = Phase::ZSendWaitEofAck;
+            startTimer(kBlockTimeoutMs);
+        } else if (frameEnd == kZcrcw) {
+            // The receiver's buffer is full; wait for its ZACK, then open a new frame.
+            m_zFrameOpen = false;
+            m_phase = Phase::ZSendWaitAck;
+            startTimer(kBlockTimeoutMs);
+        }
+    }
+
+    if (!m_zOut.isEmpty()) {
+        write(m_zOut);
+        m_zOut.clear();
+    }
+}
@@ -0,0 +1,135 @@
+#include "GapHistogram.h"
+
+#include <QStringList>
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+void GapHistogram::add(qint64 gapNs)
+{
+    gapNs = std::max<qint64>(gapNs, 0);
+
+    if (m_count == 0) {
+        m_minNs = gapNs;
+        m_maxNs = gapNs;
+    } else {
+        m_minNs = std::min(m_minNs, gapNs);
+        m_maxNs = std::max(m_maxNs, gapNs);
+    }
+
+    ++m_buckets[bucketForGap(gapNs)];
+    ++m_count;
+    m_sumNs += gapNs;
+}
+
+void GapHistogram::clear()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_minNs = 0;
+    m_maxNs = 0;
+    m_sumNs = 0;
+}
+
+quint64 GapHistogram::count() const
+{
+    return m_count;
+}
+
+quint64 GapHistogram::bucket(int index) const
+{
+    return m_buckets.at(index);
+}
+
+qint64 GapHistogram::minNs() const
+{
+    return m_minNs;
+}
+
+qint64 GapHistogram::maxNs() const
+{
+    return m_maxNs;
+}
+
+qint64 GapHistogram::meanNs() const
+{
+    return m_count == 0 ? 0 : static_cast<qint64>(m_sumNs / m_count);
+}
+
+qint64 GapHistogram::percentileNs(double percentile) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+
+    const quint64 target = static_cast<quint64>(std::clamp(percentile, 0.0, 1.0) * (m_count - 1));
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen > target) {
+            // Bucket resolution only; clamp to the observed range so p0/p100 stay exact.
+            return std::clamp(bucketLowerBoundNs(i), m_minNs, m_maxNs);
+        }
+    }
+
+    return m_maxNs;
+}
+
+qint64 GapHistogram::bucketLowerBoundNs(int index)
+{
+    return index <= 0 ? 0 : (qint64(1) << index);
+}
+
+int GapHistogram::bucketForGap(qint64 gapNs)
+{
+    if (gapNs <= 1) {
+        return 0;
+    }
+
+    const int index = 63 - static_cast<int>(qCountLeadingZeroBits(static_cast<quint64>(gapNs)));
+    return std::min(index, kBucketCount - 1);
+}
+
+QString GapHistogram::formatDuration(qint64 ns)
+{
+    if (ns < 1000) {
+        return QString("%1 ns").arg(ns);
+    }
+    if (ns < 1000000) {
+        return QString("%1 us").arg(ns / 1000.0, 0, 'f', 1);
+    }
+    if (ns < 1000000000) {
+        return QString("%1 ms").arg(ns / 1000000.0, 0, 'f', 3);
+    }
+    return QString("%1 s").arg(ns / 1000000000.0, 0, 'f', 3);
+}
+
+QString GapHistogram::toText(int barWidth) const
+{
+    QStringList lines;
+    lines.append(QString("gaps: %1  min %2  mean %3  p50 %4  p99 %5  max %6")
+                     .arg(m_count)
+                     .arg(formatDuration(m_minNs),
+                          formatDuration(meanNs()),
+                          formatDuration(percentileNs(0.50)),
+                          formatDuration(percentileNs(0.99)),
+                          formatDuration(m_maxNs)));
+
+    if (m_count == 0) {
+        return lines.join('\n');
+    }
+
+    const int first = bucketForGap(m_minNs);
+    const int last = bucketForGap(m_maxNs);
+    const quint64 peak = *std::max_element(m_buckets.cbegin(), m_buckets.cend());
+
+    for (int i = first; i <= last; ++i) {
+        const int width = peak == 0 ? 0 : static_cast<int>((m_buckets[i] * barWidth + peak - 1) / peak);
+        lines.append(QString(">= %1 | %2 %3")
+                         .arg(formatDuration(bucketLowerBoundNs(i)), 10)
+                         .arg(QString(width, '#'), -barWidth)
+                         .arg(m_buckets[i]));
+    }
+
+    return lines.join('\n');
+}
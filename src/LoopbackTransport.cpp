@@ -0,0 +1,230 @@
+#include "LoopbackTransport.h"
+
+#include <QObject>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+constexpr quint64 kNoBitError = std::numeric_limits<quint64>::max();
+constexpr double kMaxBitErrorRate = 0.5;
+} // namespace
+
+LoopbackTransport::LoopbackTransport()
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&m_timer, &QTimer::timeout, [this]() {
+        deliverDue();
+    });
+}
+
+void LoopbackTransport::moveToThread(QThread *thread)
+{
+    m_timer.moveToThread(thread);
+}
+
+bool LoopbackTransport::open(const LoopbackConfig &config)
+{
+    close();
+
+    m_config = config;
+    m_config.baudRate = std::max(m_config.baudRate, 1);
+    m_config.bitsPerCharacter = std::max(m_config.bitsPerCharacter, 1);
+    m_config.latencyUs = std::max<qint64>(m_config.latencyUs, 0);
+    m_config.maxFragmentBytes = std::max(m_config.maxFragmentBytes, 0);
+    m_config.bitErrorRate = std::clamp(m_config.bitErrorRate, 0.0, kMaxBitErrorRate);
+
+    // splitmix64 of the seed so nearby seeds still give unrelated streams; xorshift must not start at 0.
+    quint64 state = m_config.seed + 0x9e3779b97f4a7c15ULL;
+    state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    state = (state ^ (state >> 27)) * 0x94d049bb133111ebULL;
+    m_rngState = (state ^ (state >> 31)) | 1;
+    m_nextBitError = drawBitErrorGap();
+
+    m_clock.start();
+    m_lineFreeNs = 0;
+    m_bytesWritten = 0;
+    m_bytesDelivered = 0;
+    m_bitsFlipped = 0;
+    m_open = true;
+    return true;
+}
+
+void LoopbackTransport::close()
+{
+    m_open = false;
+    m_timer.stop();
+    m_pending.clear();
+    m_pendingBytes = 0;
+}
+
+bool LoopbackTransport::isOpen() const
+{
+    return m_open;
+}
+
+const LoopbackConfig &LoopbackTransport::config() const
+{
+    return m_config;
+}
+
+qint64 LoopbackTransport::write(const QByteArray &data)
+{
+    if (!m_open) {
+        return -1;
+    }
+
+    if (data.isEmpty()) {
+        return 0;
+    }
+
+    const qint64 nowNs = m_clock.nsecsElapsed();
+    const qint64 latencyNs = m_config.latencyUs * 1000;
+    const double characterNs = m_config.paceToBaud
+                                   ? 1e9 * m_config.bitsPerCharacter / m_config.baudRate
+                                   : 0.0;
+
+    // Bytes queue behind whatever is still on the simulated wire.
+    qint64 lineNs = std::max(nowNs, m_lineFreeNs);
+    qsizetype offset = 0;
+    while (offset < data.size()) {
+        qsizetype length = data.size() - offset;
+        if (m_config.maxFragmentBytes > 0) {
+            length = std::min<qsizetype>(length, 1 + nextRandom() % m_config.maxFragmentBytes);
+        }
+
+        Fragment fragment;
+        fragment.data = data.mid(offset, length);
+        corrupt(fragment.data);
+        lineNs += std::llround(length * characterNs);
+        fragment.dueNs = lineNs + latencyNs;
+
+        m_pendingBytes += length;
+        m_pending.push_back(std::move(fragment));
+        offset += length;
+    }
+
+    m_lineFreeNs = lineNs;
+    m_bytesWritten += data.size();
+
+    // Due times only grow, so an already armed timer is still for the front fragment.
+    if (!m_timer.isActive()) {
+        scheduleNext();
+    }
+
+    return data.size();
+}
+
+void LoopbackTransport::setDeliverCallback(DeliverCallback callback)
+{
+    m_deliverCallback = std::move(callback);
+}
+
+qint64 LoopbackTransport::bytesPending() const
+{
+    return m_pendingBytes;
+}
+
+quint64 LoopbackTransport::bytesWritten() const
+{
+    return m_bytesWritten;
+}
+
+quint64 LoopbackTransport::bytesDelivered() const
+{
+    return m_bytesDelivered;
+}
+
+quint64 LoopbackTransport::bitsFlipped() const
+{
+    return m_bitsFlipped;
+}
+
+int LoopbackTransport::bitsPerCharacter(int dataBits, bool parity, int stopBits)
+{
+    return 1 + dataBits + (parity ? 1 : 0) + stopBits;
+}
+
+quint64 LoopbackTransport::nextRandom()
+{
+    // xorshift64*
+    m_rngState ^= m_rngState >> 12;
+    m_rngState ^= m_rngState << 25;
+    m_rngState ^= m_rngState >> 27;
+    return m_rngState * 0x2545f4914f6cdd1dULL;
+}
+
+double LoopbackTransport::nextUniform()
+{
+    return static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+quint64 LoopbackTransport::drawBitErrorGap()
+{
+    if (m_config.bitErrorRate <= 0.0) {
+        return kNoBitError;
+    }
+
+    // Geometric gap between errors, so clean bits cost nothing to simulate.
+    const double uniform = 1.0 - nextUniform();
+    const double gap = std::floor(std::log(uniform) / std::log1p(-m_config.bitErrorRate));
+    return gap >= static_cast<double>(kNoBitError) ? kNoBitError : static_cast<quint64>(gap);
+}
+
+void LoopbackTransport::corrupt(QByteArray &data)
+{
+    // Only data bits are flipped; framing and parity errors are not modelled.
+    const quint64 totalBits = static_cast<quint64>(data.size()) * 8;
+    quint64 bit = 0;
+
+    while (m_nextBitError < totalBits - bit) {
+        bit += m_nextBitError;
+        data[static_cast<qsizetype>(bit / 8)] ^= static_cast<char>(1 << (bit % 8));
+        ++m_bitsFlipped;
+        ++bit;
+        m_nextBitError = drawBitErrorGap();
+    }
+
+    if (m_nextBitError != kNoBitError) {
+        m_nextBitError -= totalBits - bit;
+    }
+}
+
+void LoopbackTransport::scheduleNext()
+{
+    if (m_pending.empty()) {
+        return;
+    }
+
+    const qint64 delayNs = m_pending.front().dueNs - m_clock.nsecsElapsed();
+    m_timer.start(static_cast<int>(std::max<qint64>(0, (delayNs + 999999) / 1000000)));
+}
+
+void LoopbackTransport::deliverDue()
+{
+    const qint64 nowNs = m_clock.nsecsElapsed();
+
+    // The callback may write (echo replies) or close the transport. A fragment it
+    // queues with no latency can be due at exactly nowNs, so only the fragments
+    // already queued on entry are delivered here; the rest wait for the timer.
+    size_t dueCount = m_pending.size();
+    while (m_open && dueCount > 0 && !m_pending.empty() && m_pending.front().dueNs <= nowNs) {
+        --dueCount;
+        const QByteArray data = std::move(m_pending.front().data);
+        const qint64 lateNs = nowNs - m_pending.front().dueNs;
+        m_pending.pop_front();
+        m_pendingBytes -= data.size();
+        m_bytesDelivered += data.size();
+        if (m_deliverCallback) {
+            m_deliverCallback(data, lateNs);
+        }
+    }
+
+    if (m_open && !m_timer.isActive()) {
+        scheduleNext();
+    }
+}
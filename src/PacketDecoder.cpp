@@ -0,0 +1,881 @@
+#include "PacketDecoder.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "TxEncoder.h"
+
+namespace
+{
+constexpr qsizetype kCompactThreshold = 64 * 1024;
+
+template <typename T>
+using RawBits = std::conditional_t<sizeof(T) == 1, quint8,
+                std::conditional_t<sizeof(T) == 2, quint16,
+                std::conditional_t<sizeof(T) == 4, quint32, quint64>>>;
+
+template <typename T, bool BigEndian>
+T loadAs(const uchar *data)
+{
+    RawBits<T> raw;
+    std::memcpy(&raw, data, sizeof(raw));
+    raw = BigEndian ? qFromBigEndian(raw) : qFromLittleEndian(raw);
+
+    T value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+template <typename T, bool BigEndian>
+double loadField(const uchar *data, const PacketDecodeOp &op)
+{
+    return static_cast<double>(loadAs<T, BigEndian>(data)) * op.scale + op.bias;
+}
+
+template <typename T, bool BigEndian>
+double loadBitfield(const uchar *data, const PacketDecodeOp &op)
+{
+    const quint64 raw = loadAs<RawBits<T>, BigEndian>(data);
+    const quint64 bits = (raw >> op.shift) & (~0ULL >> (64 - op.width));
+
+    qint64 value = static_cast<qint64>(bits);
+    if (std::is_signed_v<T> && op.width < 64 && ((bits >> (op.width - 1)) & 1) != 0) {
+        value = static_cast<qint64>(bits | (~0ULL << op.width));
+    }
+    return static_cast<double>(value) * op.scale + op.bias;
+}
+
+// Indexed by [PacketFieldType][bigEndian].
+const PacketFieldLoader kFieldLoaders[][2] = {
+    {loadField<quint8, false>, loadField<quint8, true>},
+    {loadField<qint8, false>, loadField<qint8, true>},
+    {loadField<quint16, false>, loadField<quint16, true>},
+    {loadField<qint16, false>, loadField<qint16, true>},
+    {loadField<quint32, false>, loadField<quint32, true>},
+    {loadField<qint32, false>, loadField<qint32, true>},
+    {loadField<quint64, false>, loadField<quint64, true>},
+    {loadField<qint64, false>, loadField<qint64, true>},
+    {loadField<float, false>, loadField<float, true>},
+    {loadField<double, false>, loadField<double, true>},
+};
+
+// Integer types only; floats cannot hold bitfields.
+const PacketFieldLoader kBitfieldLoaders[][2] = {
+    {loadBitfield<quint8, false>, loadBitfield<quint8, true>},
+    {loadBitfield<qint8, false>, loadBitfield<qint8, true>},
+    {loadBitfield<quint16, false>, loadBitfield<quint16, true>},
+    {loadBitfield<qint16, false>, loadBitfield<qint16, true>},
+    {loadBitfield<quint32, false>, loadBitfield<quint32, true>},
+    {loadBitfield<qint32, false>, loadBitfield<qint32, true>},
+    {loadBitfield<quint64, false>, loadBitfield<quint64, true>},
+    {loadBitfield<qint64, false>, loadBitfield<qint64, true>},
+};
+
+const QHash<QString, PacketFieldType> kFieldTypes = {
+    {"u8", PacketFieldType::U8},
+    {"i8", PacketFieldType::I8},
+    {"u16", PacketFieldType::U16},
+    {"i16", PacketFieldType::I16},
+    {"u32", PacketFieldType::U32},
+    {"i32", PacketFieldType::I32},
+    {"u64", PacketFieldType::U64},
+    {"i64", PacketFieldType::I64},
+    {"f32", PacketFieldType::F32},
+    {"f64", PacketFieldType::F64},
+};
+
+bool isFloatType(PacketFieldType type)
+{
+    return type == PacketFieldType::F32 || type == PacketFieldType::F64;
+}
+
+bool isSignedType(PacketFieldType type)
+{
+    return type == PacketFieldType::I8 || type == PacketFieldType::I16 || type == PacketFieldType::I32
+           || type == PacketFieldType::I64;
+}
+
+// The id as readRaw() returns it for a discriminator of this type: for a u8,
+// 255 and -1 are the same byte and read back as 255; an i8 reads it as -1.
+qint64 normalizeId(qint64 id, PacketFieldType type)
+{
+    const int bits = 8 * PacketSchema::typeSize(type);
+    if (bits >= 64) {
+        return id;
+    }
+    const quint64 mask = (quint64(1) << bits) - 1;
+    quint64 raw = static_cast<quint64>(id) & mask;
+    if (isSignedType(type) && (raw >> (bits - 1)) != 0) {
+        raw |= ~mask;
+    }
+    return static_cast<qint64>(raw);
+}
+
+// A top-level field as laid out in the packet, kept so the header's
+// discriminator and length fields can be found by name.
+struct PlacedField
+{
+    QString name;
+    PacketFieldType type = PacketFieldType::U8;
+    bool bigEndian = false;
+    quint32 offset = 0;
+};
+
+class FieldCompiler
+{
+private:
+    QList<PacketDecodeOp> &m_ops;
+    QList<PacketColumn> &m_columns;
+    QList<PlacedField> &m_placed;
+    QString *m_errorString;
+
+    bool fail(const QString &where, const QString &message)
+    {
+        if (m_errorString != nullptr) {
+            *m_errorString = QString("%1: %2").arg(where, message);
+        }
+        return false;
+    }
+
+    bool parseEnum(const QJsonValue &value, PacketColumn &column, const QString &where)
+    {
+        if (value.isUndefined()) {
+            return true;
+        }
+        if (!value.isObject()) {
+            return fail(where, "\"enum\" must be an object");
+        }
+
+        const QJsonObject names = value.toObject();
+        for (auto it = names.begin(); it != names.end(); ++it) {
+            bool ok = false;
+            const qint64 key = it.key().toLongLong(&ok, 0);
+            if (!ok) {
+                return fail(where, QString("enum key \"%1\" is not a number").arg(it.key()));
+            }
+            column.enumNames.insert(key, it.value().toString());
+        }
+        return true;
+    }
+
+    bool addColumn(const QJsonObject &field,
+                   const QString &where,
+                   PacketDecodeOp op,
+                   bool floatSource)
+    {
+        PacketColumn column;
+        column.name = field.value("name").toString();
+        if (column.name.isEmpty()) {
+            return fail(where, "field needs a \"name\"");
+        }
+        for (const PacketColumn &existing : m_columns) {
+            if (existing.name == column.name) {
+                return fail(where, QString("duplicate field \"%1\"").arg(column.name));
+            }
+        }
+
+        op.scale = field.value("scale").toDouble(1.0);
+        op.bias = field.value("bias").toDouble(0.0);
+        column.integral = !floatSource && op.scale == 1.0 && op.bias == 0.0;
+        if (!parseEnum(field.value("enum"), column, where)) {
+            return false;
+        }
+
+        op.column = static_cast<quint32>(m_columns.size());
+        m_columns.append(column);
+        m_ops.append(op);
+        return true;
+    }
+
+public:
+    FieldCompiler(QList<PacketDecodeOp> &ops,
+                  QList<PacketColumn> &columns,
+                  QList<PlacedField> &placed,
+                  QString *errorString)
+        : m_ops(ops)
+        , m_columns(columns)
+        , m_placed(placed)
+        , m_errorString(errorString)
+    {
+    }
+
+    bool compile(const QJsonValue &value, const QString &where, bool defaultBigEndian, int &offset)
+    {
+        if (value.isUndefined()) {
+            return true;
+        }
+        if (!value.isArray()) {
+            return fail(where, "fields must be an array");
+        }
+
+        const QJsonArray fields = value.toArray();
+        for (int index = 0; index < fields.size(); ++index) {
+            const QJsonObject field = fields.at(index).toObject();
+            const QString fieldWhere = QString("%1 field %2").arg(where).arg(index + 1);
+            const QString typeName = field.value("type").toString();
+
+            if (typeName == "pad") {
+                const int size = field.value("size").toInt(0);
+                if (size <= 0 || size > PacketSchema::kMaxPacketSize) {
+                    return fail(fieldWhere, "pad needs a positive \"size\"");
+                }
+                offset += size;
+                if (offset > PacketSchema::kMaxPacketSize) {
+                    return fail(fieldWhere, QString("packet is larger than %1 bytes").arg(PacketSchema::kMaxPacketSize));
+                }
+                continue;
+            }
+
+            const auto type = kFieldTypes.constFind(typeName);
+            if (type == kFieldTypes.constEnd()) {
+                return fail(fieldWhere, QString("unknown type \"%1\"").arg(typeName));
+            }
+
+            bool bigEndian = defaultBigEndian;
+            const QString endian = field.value("endian").toString();
+            if (endian == "big") {
+                bigEndian = true;
+            } else if (endian == "little") {
+                bigEndian = false;
+            } else if (!endian.isEmpty()) {
+                return fail(fieldWhere, QString("unknown endian \"%1\"").arg(endian));
+            }
+
+            const int typeIndex = static_cast<int>(type.value());
+            const int size = PacketSchema::typeSize(type.value());
+            PacketDecodeOp op;
+            op.offset = static_cast<quint32>(offset);
+
+            if (field.contains("bits")) {
+                if (isFloatType(type.value())) {
+                    return fail(fieldWhere, "bitfields need an integer type");
+                }
+
+                const QJsonArray bits = field.value("bits").toArray();
+                for (int bitIndex = 0; bitIndex < bits.size(); ++bitIndex) {
+                    const QJsonObject bitfield = bits.at(bitIndex).toObject();
+                    const QString bitWhere = QString("%1 bitfield %2").arg(fieldWhere).arg(bitIndex + 1);
+                    const int shift = bitfield.value("offset").toInt(-1);
+                    const int width = bitfield.value("width").toInt(1);
+                    if (shift < 0 || width < 1 || shift + width > size * 8) {
+                        return fail(bitWhere, QString("bits %1..%2 do not fit in %3")
+                                                  .arg(shift)
+                                                  .arg(shift + width - 1)
+                                                  .arg(typeName));
+                    }
+
+                    op.load = kBitfieldLoaders[typeIndex][bigEndian ? 1 : 0];
+                    op.shift = static_cast<quint8>(shift);
+                    op.width = static_cast<quint8>(width);
+                    if (!addColumn(bitfield, bitWhere, op, false)) {
+                        return false;
+                    }
+                }
+            } else {
+                op.load = kFieldLoaders[typeIndex][bigEndian ? 1 : 0];
+                if (!addColumn(field, fieldWhere, op, isFloatType(type.value()))) {
+                    return false;
+                }
+                m_placed.append({field.value("name").toString(), type.value(), bigEndian, op.offset});
+            }
+
+            offset += size;
+            if (offset > PacketSchema::kMaxPacketSize) {
+                return fail(fieldWhere, QString("packet is larger than %1 bytes").arg(PacketSchema::kMaxPacketSize));
+            }
+        }
+        return true;
+    }
+};
+
+bool setError(QString *errorString, const QString &message)
+{
+    if (errorString != nullptr) {
+        *errorString = message;
+    }
+    return false;
+}
+} // namespace
+
+bool PacketSchema::isValid() const
+{
+    return !m_layouts.isEmpty();
+}
+
+const QList<PacketLayout> &PacketSchema::layouts() const
+{
+    return m_layouts;
+}
+
+const QList<PacketDecodeOp> &PacketSchema::ops() const
+{
+    return m_ops;
+}
+
+const QByteArray &PacketSchema::sync() const
+{
+    return m_sync;
+}
+
+int PacketSchema::headerSize() const
+{
+    return m_headerSize;
+}
+
+int PacketSchema::headerColumnCount() const
+{
+    return m_headerColumnCount;
+}
+
+int PacketSchema::maxColumnCount() const
+{
+    int columns = 0;
+    for (const PacketLayout &layout : m_layouts) {
+        columns = std::max(columns, static_cast<int>(layout.columns.size()));
+    }
+    return columns;
+}
+
+qint64 PacketSchema::readRaw(const uchar *data, const RawField &field)
+{
+    data += field.offset;
+    switch (field.type) {
+    case PacketFieldType::U8:
+        return *data;
+    case PacketFieldType::I8:
+        return static_cast<qint8>(*data);
+    case PacketFieldType::U16:
+        return field.bigEndian ? loadAs<quint16, true>(data) : loadAs<quint16, false>(data);
+    case PacketFieldType::I16:
+        return field.bigEndian ? loadAs<qint16, true>(data) : loadAs<qint16, false>(data);
+    case PacketFieldType::U32:
+        return field.bigEndian ? loadAs<quint32, true>(data) : loadAs<quint32, false>(data);
+    case PacketFieldType::I32:
+        return field.bigEndian ? loadAs<qint32, true>(data) : loadAs<qint32, false>(data);
+    case PacketFieldType::U64:
+    case PacketFieldType::I64:
+        return field.bigEndian ? loadAs<qint64, true>(data) : loadAs<qint64, false>(data);
+    case PacketFieldType::F32:
+    case PacketFieldType::F64:
+        break;
+    }
+    return 0;
+}
+
+int PacketSchema::layoutFor(const uchar *header) const
+{
+    if (!m_hasDiscriminator) {
+        return 0;
+    }
+
+    const qint64 id = readRaw(header, m_discriminator);
+    if (!m_layoutByDiscriminator.isEmpty()) {
+        return m_layoutByDiscriminator.at(static_cast<qsizetype>(id & (m_layoutByDiscriminator.size() - 1)));
+    }
+    return m_layoutById.value(id, -1);
+}
+
+qint64 PacketSchema::packetSize(const uchar *header, int layoutIndex) const
+{
+    const int fixedSize = m_layouts.at(layoutIndex).size;
+    if (!m_hasLength) {
+        return fixedSize;
+    }
+
+    const qint64 size = readRaw(header, m_length) + m_lengthAdjust;
+    return size < fixedSize || size > kMaxPacketSize ? -1 : size;
+}
+
+void PacketSchema::decode(const uchar *packet, int layoutIndex, double *values) const
+{
+    const PacketLayout &layout = m_layouts.at(layoutIndex);
+    const PacketDecodeOp *op = m_ops.constData() + layout.firstOp;
+    const PacketDecodeOp *end = op + layout.opCount;
+    for (; op != end; ++op) {
+        values[op->column] = op->load(packet + op->offset, *op);
+    }
+}
+
+int PacketSchema::typeSize(PacketFieldType type)
+{
+    switch (type) {
+    case PacketFieldType::U8:
+    case PacketFieldType::I8:
+        return 1;
+    case PacketFieldType::U16:
+    case PacketFieldType::I16:
+        return 2;
+    case PacketFieldType::U32:
+    case PacketFieldType::I32:
+    case PacketFieldType::F32:
+        return 4;
+    case PacketFieldType::U64:
+    case PacketFieldType::I64:
+    case PacketFieldType::F64:
+        return 8;
+    }
+    return 1;
+}
+
+bool PacketSchema::compile(const QByteArray &json, PacketSchema &schema, QString *errorString)
+{
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        return setError(errorString, QString("JSON error at offset %1: %2")
+                                         .arg(parseError.offset)
+                                         .arg(parseError.errorString()));
+    }
+    if (!document.isObject()) {
+        return setError(errorString, "schema must be a JSON object");
+    }
+
+    const QJsonObject root = document.object();
+    PacketSchema compiled;
+
+    const QString endian = root.value("endian").toString("little");
+    if (endian != "little" && endian != "big") {
+        return setError(errorString, QString("unknown endian \"%1\"").arg(endian));
+    }
+    const bool bigEndian = endian == "big";
+
+    if (root.contains("sync")) {
+        QString error;
+        if (!TxEncoder::encode(root.value("sync").toString(), {TxFormat::Hex}, compiled.m_sync, &error)) {
+            return setError(errorString, QString("\"sync\": %1").arg(error));
+        }
+        if (compiled.m_sync.isEmpty()) {
+            return setError(errorString, "\"sync\" must be hex bytes");
+        }
+    }
+
+    QList<PacketDecodeOp> headerOps;
+    QList<PacketColumn> headerColumns;
+    QList<PlacedField> headerFields;
+    FieldCompiler headerCompiler(headerOps, headerColumns, headerFields, errorString);
+    if (!headerCompiler.compile(root.value("header"), "header", bigEndian, compiled.m_headerSize)) {
+        return false;
+    }
+    compiled.m_headerColumnCount = static_cast<int>(headerColumns.size());
+    if (compiled.m_sync.size() > compiled.m_headerSize) {
+        return setError(errorString, "sync bytes must be covered by header fields");
+    }
+
+    const auto findHeaderField = [&headerFields](const QString &name) -> const PlacedField * {
+        for (const PlacedField &field : headerFields) {
+            if (field.name == name) {
+                return &field;
+            }
+        }
+        return nullptr;
+    };
+
+    const QString discriminatorName = root.value("discriminator").toString();
+    if (!discriminatorName.isEmpty()) {
+        const PlacedField *field = findHeaderField(discriminatorName);
+        if (field == nullptr || isFloatType(field->type)) {
+            return setError(errorString, QString("discriminator \"%1\" is not an integer header field")
+                                             .arg(discriminatorName));
+        }
+        compiled.m_hasDiscriminator = true;
+        compiled.m_discriminator = {field->type, field->bigEndian, field->offset};
+    }
+
+    if (root.contains("length")) {
+        const QJsonObject length = root.value("length").toObject();
+        const QString lengthName = length.value("field").toString();
+        const PlacedField *field = findHeaderField(lengthName);
+        if (field == nullptr || isFloatType(field->type)) {
+            return setError(errorString, QString("length \"%1\" is not an integer header field").arg(lengthName));
+        }
+        compiled.m_hasLength = true;
+        compiled.m_length = {field->type, field->bigEndian, field->offset};
+        compiled.m_lengthAdjust = length.value("adjust").toInteger(0);
+    }
+
+    const QJsonArray packets = root.value("packets").toArray();
+    if (packets.isEmpty()) {
+        return setError(errorString, "schema has no \"packets\"");
+    }
+    if (!compiled.m_hasDiscriminator && packets.size() > 1) {
+        return setError(errorString, "several packet types need a \"discriminator\"");
+    }
+
+    for (int index = 0; index < packets.size(); ++index) {
+        const QJsonObject packet = packets.at(index).toObject();
+        PacketLayout layout;
+        layout.name = packet.value("name").toString(QString("packet%1").arg(index + 1));
+        layout.firstOp = static_cast<int>(compiled.m_ops.size());
+        layout.columns = headerColumns;
+
+        if (compiled.m_hasDiscriminator) {
+            const QJsonValue id = packet.value("id");
+            bool ok = id.isDouble();
+            layout.id = ok ? id.toInteger() : id.toString().toLongLong(&ok, 0);
+            if (!ok) {
+                return setError(errorString, QString("packet \"%1\" needs a numeric \"id\"").arg(layout.name));
+            }
+            const int idBits = 8 * PacketSchema::typeSize(compiled.m_discriminator.type);
+            if (idBits < 64 && (layout.id < -(qint64(1) << (idBits - 1)) || layout.id >= (qint64(1) << idBits))) {
+                return setError(errorString, QString("packet \"%1\" id %2 does not fit the discriminator")
+                                                 .arg(layout.name)
+                                                 .arg(layout.id));
+            }
+            layout.id = normalizeId(layout.id, compiled.m_discriminator.type);
+            for (const PacketLayout &existing : compiled.m_layouts) {
+                if (existing.id == layout.id) {
+                    return setError(errorString, QString("packets \"%1\" and \"%2\" share id %3")
+                                                     .arg(existing.name, layout.name)
+                                                     .arg(layout.id));
+                }
+            }
+        }
+
+        // Header ops are repeated in every packet type so one run decodes the row.
+        QList<PlacedField> placed;
+        compiled.m_ops.append(headerOps);
+        layout.size = compiled.m_headerSize;
+        FieldCompiler packetCompiler(compiled.m_ops, layout.columns, placed, errorString);
+        if (!packetCompiler.compile(packet.value("fields"), QString("packet \"%1\"").arg(layout.name), bigEndian, layout.size)) {
+            return false;
+        }
+        if (layout.size == 0) {
+            return setError(errorString, QString("packet \"%1\" is empty").arg(layout.name));
+        }
+
+        layout.opCount = static_cast<int>(compiled.m_ops.size()) - layout.firstOp;
+        compiled.m_layouts.append(layout);
+    }
+
+    if (compiled.m_hasDiscriminator && PacketSchema::typeSize(compiled.m_discriminator.type) <= 2) {
+        compiled.m_layoutByDiscriminator.fill(-1, qsizetype(1) << (8 * PacketSchema::typeSize(compiled.m_discriminator.type)));
+        for (int index = 0; index < compiled.m_layouts.size(); ++index) {
+            const qint64 id = compiled.m_layouts.at(index).id;
+            compiled.m_layoutByDiscriminator[id & (compiled.m_layoutByDiscriminator.size() - 1)] = static_cast<qint16>(index);
+        }
+    } else if (compiled.m_hasDiscriminator) {
+        for (int index = 0; index < compiled.m_layouts.size(); ++index) {
+            compiled.m_layoutById.insert(compiled.m_layouts.at(index).id, index);
+        }
+    }
+
+    schema = compiled;
+    return true;
+}
+
+void PacketTable::reset(const PacketSchema &schema)
+{
+    m_columnCounts.clear();
+    for (const PacketLayout &layout : schema.layouts()) {
+        m_columnCounts.append(static_cast<int>(layout.columns.size()));
+    }
+    m_scratch.fill(0.0, std::max(1, schema.maxColumnCount()));
+    clear();
+}
+
+void PacketTable::clear()
+{
+    m_rows.clear();
+    m_rows.resize(m_columnCounts.size());
+    m_order.clear();
+    m_orderHead = 0;
+    m_rowCount = 0;
+    m_rowsEvicted = 0;
+}
+
+void PacketTable::setCapacity(qsizetype rows)
+{
+    m_capacity = std::max<qsizetype>(rows, 0);
+    clear();
+}
+
+double *PacketTable::appendRow(int layoutIndex, qint64 timestampNs)
+{
+    if (m_capacity == 0) {
+        ++m_rows[layoutIndex].evicted;
+        ++m_rowsEvicted;
+        return m_scratch.data();
+    }
+
+    if (m_rowCount < m_capacity) {
+        m_order.append(layoutIndex);
+    } else {
+        // Rows of one type are in arrival order, so the oldest row overall is
+        // the front row of the type m_order recorded first. QList drops its
+        // front without moving the rest.
+        Rows &oldest = m_rows[m_order.at(m_orderHead)];
+        oldest.timestampsNs.removeFirst();
+        oldest.values.remove(0, m_columnCounts.at(m_order.at(m_orderHead)));
+        ++oldest.evicted;
+        ++m_rowsEvicted;
+        --m_rowCount;
+        m_order[m_orderHead] = layoutIndex;
+        m_orderHead = m_orderHead + 1 == m_capacity ? 0 : m_orderHead + 1;
+    }
+
+    Rows &rows = m_rows[layoutIndex];
+    const qsizetype start = rows.values.size();
+    rows.timestampsNs.append(timestampNs);
+    rows.values.resize(start + m_columnCounts.at(layoutIndex));
+    ++m_rowCount;
+    return rows.values.data() + start;
+}
+
+int PacketTable::layoutCount() const
+{
+    return static_cast<int>(m_columnCounts.size());
+}
+
+int PacketTable::columnCount(int layoutIndex) const
+{
+    return m_columnCounts.at(layoutIndex);
+}
+
+qsizetype PacketTable::rowCount() const
+{
+    return m_rowCount;
+}
+
+qsizetype PacketTable::rowCount(int layoutIndex) const
+{
+    return m_rows.at(layoutIndex).timestampsNs.size();
+}
+
+quint64 PacketTable::rowsEvicted() const
+{
+    return m_rowsEvicted;
+}
+
+quint64 PacketTable::rowsEvicted(int layoutIndex) const
+{
+    return m_rows.at(layoutIndex).evicted;
+}
+
+qint64 PacketTable::timestampNs(int layoutIndex, qsizetype row) const
+{
+    return m_rows.at(layoutIndex).timestampsNs.at(row);
+}
+
+double PacketTable::value(int layoutIndex, qsizetype row, int column) const
+{
+    return m_rows.at(layoutIndex).values.at(row * m_columnCounts.at(layoutIndex) + column);
+}
+
+const double *PacketTable::row(int layoutIndex, qsizetype row) const
+{
+    return m_rows.at(layoutIndex).values.constData() + row * m_columnCounts.at(layoutIndex);
+}
+
+bool PacketTable::writeCsv(const QString &path,
+                           const PacketSchema &schema,
+                           int layoutIndex,
+                           qint64 wallClockOffsetNs,
+                           QString *errorString) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return setError(errorString, file.errorString());
+    }
+
+    const PacketLayout &layout = schema.layouts().at(layoutIndex);
+    QByteArray out = "time,timestamp_ns";
+    for (const PacketColumn &column : layout.columns) {
+        out.append(',');
+        out.append(column.name.toUtf8());
+    }
+    out.append('\n');
+
+    // Rows are time ordered, so the date part is only rebuilt when the second changes.
+    qint64 lastSecond = std::numeric_limits<qint64>::min();
+    QByteArray secondPrefix;
+    const qsizetype rows = rowCount(layoutIndex);
+    for (qsizetype rowIndex = 0; rowIndex < rows; ++rowIndex) {
+        const qint64 wallNs = timestampNs(layoutIndex, rowIndex) + wallClockOffsetNs;
+        const qint64 second = wallNs >= 0 ? wallNs / 1000000000 : (wallNs - 999999999) / 1000000000;
+        if (second != lastSecond) {
+            lastSecond = second;
+            secondPrefix = QDateTime::fromSecsSinceEpoch(second, Qt::UTC)
+                               .toString("yyyy-MM-dd'T'HH:mm:ss")
+                               .toLatin1();
+        }
+        out.append(secondPrefix);
+        out.append(QByteArray::number((wallNs - second * 1000000000) / 1000 + 1000000).replace(0, 1, "."));
+        out.append("Z,");
+        out.append(QByteArray::number(timestampNs(layoutIndex, rowIndex)));
+
+        const double *values = row(layoutIndex, rowIndex);
+        for (int column = 0; column < layout.columns.size(); ++column) {
+            out.append(',');
+            // Enum labels would need quoting and lose the value; export the number.
+            if (layout.columns.at(column).integral) {
+                out.append(QByteArray::number(static_cast<qint64>(values[column])));
+            } else {
+                out.append(QByteArray::number(values[column], 'g', 17));
+            }
+        }
+        out.append('\n');
+
+        if (out.size() >= 1024 * 1024) {
+            if (file.write(out) != out.size()) {
+                return setError(errorString, file.errorString());
+            }
+            out.clear();
+        }
+    }
+
+    if (file.write(out) != out.size() || !file.flush()) {
+        return setError(errorString, file.errorString());
+    }
+    return true;
+}
+
+QString PacketTable::formatValue(const PacketColumn &column, double value)
+{
+    if (!column.enumNames.isEmpty()) {
+        const auto name = column.enumNames.constFind(static_cast<qint64>(value));
+        if (name != column.enumNames.constEnd()) {
+            return name.value();
+        }
+    }
+
+    if (column.integral) {
+        return QString::number(static_cast<qint64>(value));
+    }
+    return QString::number(value, 'g', 7);
+}
+
+void PacketDecoder::setSchema(const PacketSchema &schema)
+{
+    m_schema = schema;
+    reset();
+    resetStatistics();
+}
+
+const PacketSchema &PacketDecoder::schema() const
+{
+    return m_schema;
+}
+
+void PacketDecoder::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    reset();
+}
+
+bool PacketDecoder::isEnabled() const
+{
+    return m_enabled;
+}
+
+void PacketDecoder::reset()
+{
+    m_buffer.clear();
+    m_readPos = 0;
+    m_streamOffset = 0;
+    m_chunks.clear();
+}
+
+void PacketDecoder::feed(const QByteArray &data, qint64 timestampNs, PacketTable &table)
+{
+    if (!m_enabled || !m_schema.isValid() || data.isEmpty()) {
+        return;
+    }
+
+    m_chunks.push_back({m_streamOffset + m_buffer.size(), timestampNs});
+    m_buffer.append(data);
+
+    const QByteArray &sync = m_schema.sync();
+    const qsizetype headerSize = m_schema.headerSize();
+    const qsizetype size = m_buffer.size();
+    const auto *base = reinterpret_cast<const uchar *>(m_buffer.constData());
+    qsizetype pos = m_readPos;
+
+    for (;;) {
+        if (!sync.isEmpty()) {
+            const qsizetype syncPos = m_buffer.indexOf(sync, pos);
+            if (syncPos < 0) {
+                // Keep a tail that could still grow into a sync.
+                const qsizetype keep = std::max(pos, size - sync.size() + 1);
+                m_bytesSkipped += keep - pos;
+                pos = keep;
+                break;
+            }
+            m_bytesSkipped += syncPos - pos;
+            pos = syncPos;
+        }
+
+        if (size - pos < std::max<qsizetype>(headerSize, 1)) {
+            break;
+        }
+
+        const uchar *packet = base + pos;
+        const int layoutIndex = m_schema.layoutFor(packet);
+        const qint64 packetSize = layoutIndex < 0 ? -1 : m_schema.packetSize(packet, layoutIndex);
+        if (packetSize < 0) {
+            ++m_bytesSkipped;
+            ++pos;
+            continue;
+        }
+        if (size - pos < packetSize) {
+            break;
+        }
+
+        m_schema.decode(packet, layoutIndex, table.appendRow(layoutIndex, timestampAt(m_streamOffset + pos)));
+        ++m_packetsDecoded;
+        pos += packetSize;
+    }
+
+    m_readPos = pos;
+    compact();
+}
+
+qint64 PacketDecoder::timestampAt(qint64 streamOffset)
+{
+    while (m_chunks.size() > 1 && m_chunks[1].streamOffset <= streamOffset) {
+        m_chunks.pop_front();
+    }
+    return m_chunks.front().timestampNs;
+}
+
+void PacketDecoder::compact()
+{
+    // Chunk stamps are only needed from the read position on.
+    const qint64 readOffset = m_streamOffset + m_readPos;
+    while (m_chunks.size() > 1 && m_chunks[1].streamOffset <= readOffset) {
+        m_chunks.pop_front();
+    }
+
+    // Drop consumed bytes only once they add up, so the buffer isn't shifted per packet.
+    if (m_readPos < kCompactThreshold && m_readPos < m_buffer.size()) {
+        return;
+    }
+
+    m_buffer.remove(0, m_readPos);
+    m_streamOffset += m_readPos;
+    m_readPos = 0;
+}
+
+quint64 PacketDecoder::packetsDecoded() const
+{
+    return m_packetsDecoded;
+}
+
+quint64 PacketDecoder::bytesSkipped() const
+{
+    return m_bytesSkipped;
+}
+
+void PacketDecoder::resetStatistics()
+{
+    m_packetsDecoded = 0;
+    m_bytesSkipped = 0;
+}
@@ -0,0 +1,348 @@
+#include "Responder.h"
+
+#include <QStringList>
+
+#include "TxEncoder.h"
+
+namespace
+{
+quint64 prefixEdgeKey(qint32 node, unsigned char byte)
+{
+    return (static_cast<quint64>(node) << 8) | byte;
+}
+
+void appendCapture(QByteArray &out, const QRegularExpressionMatch *match, const QString &group)
+{
+    if (match == nullptr) {
+        return;
+    }
+
+    bool isNumber = false;
+    const int index = group.toInt(&isNumber);
+    out.append((isNumber ? match->captured(index) : match->captured(group)).toLatin1());
+}
+
+// Responses use the Send panel's Escaped and HEX syntax.
+bool encodeBytes(const QString &text, TxFormat format, QByteArray &bytes, const QString &what, QString &error)
+{
+    QString encodeError;
+    if (!TxEncoder::encode(text, {format}, bytes, &encodeError)) {
+        error = QString("invalid %1 \"%2\": %3").arg(what, text.trimmed(), encodeError);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+Responder::Responder()
+{
+    setRules({});
+}
+
+void Responder::setRules(const QList<ResponderRule> &rules)
+{
+    m_rules = rules;
+    m_exactIndex.clear();
+    m_prefixEdges.clear();
+    m_prefixRuleAtNode = {-1};
+    m_regexRules.clear();
+
+    for (int ruleIndex = 0; ruleIndex < m_rules.size(); ++ruleIndex) {
+        const ResponderRule &rule = m_rules.at(ruleIndex);
+
+        switch (rule.kind) {
+        case ResponderRule::Exact:
+            // First rule wins, same as the order the user reads them in.
+            if (!m_exactIndex.contains(rule.match)) {
+                m_exactIndex.insert(rule.match, ruleIndex);
+            }
+            break;
+        case ResponderRule::Prefix: {
+            qint32 node = 0;
+            for (const char rawByte : rule.match) {
+                const quint64 key = prefixEdgeKey(node, static_cast<unsigned char>(rawByte));
+                auto it = m_prefixEdges.constFind(key);
+                if (it == m_prefixEdges.constEnd()) {
+                    const qint32 child = static_cast<qint32>(m_prefixRuleAtNode.size());
+                    m_prefixRuleAtNode.append(-1);
+                    m_prefixEdges.insert(key, child);
+                    node = child;
+                } else {
+                    node = it.value();
+                }
+            }
+            if (m_prefixRuleAtNode.at(node) < 0) {
+                m_prefixRuleAtNode[node] = ruleIndex;
+            }
+            break;
+        }
+        case ResponderRule::Regex:
+            m_regexRules.append(ruleIndex);
+            break;
+        }
+    }
+}
+
+const QList<ResponderRule> &Responder::rules() const
+{
+    return m_rules;
+}
+
+void Responder::setDelimiter(const QByteArray &delimiter)
+{
+    m_delimiter = delimiter.isEmpty() ? QByteArray("\n") : delimiter;
+    m_frameBuffer.clear();
+}
+
+QByteArray Responder::delimiter() const
+{
+    return m_delimiter;
+}
+
+void Responder::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_frameBuffer.clear();
+}
+
+bool Responder::isEnabled() const
+{
+    return m_enabled;
+}
+
+void Responder::reset()
+{
+    m_frameBuffer.clear();
+}
+
+void Responder::feed(const QByteArray &data, const SendCallback &send)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    m_frameBuffer.append(data);
+
+    qsizetype start = 0;
+    qsizetype delimiterIndex = m_frameBuffer.indexOf(m_delimiter);
+    while (delimiterIndex >= 0) {
+        QByteArray frame = m_frameBuffer.mid(start, delimiterIndex - start);
+        if (m_delimiter == "\n" && frame.endsWith('\r')) {
+            frame.chop(1);
+        }
+        start = delimiterIndex + m_delimiter.size();
+
+        ++m_framesSeen;
+        QByteArray response;
+        const int ruleIndex = respond(frame, response);
+        if (ruleIndex >= 0) {
+            ++m_framesAnswered;
+            send(response, ruleIndex);
+        }
+
+        delimiterIndex = m_frameBuffer.indexOf(m_delimiter, start);
+    }
+
+    m_frameBuffer.remove(0, start);
+    if (m_frameBuffer.size() > kMaxFrameSize) {
+        // No delimiter in sight; drop rather than buffer a binary stream forever.
+        m_frameBuffer.clear();
+    }
+}
+
+int Responder::respond(const QByteArray &frame, QByteArray &response) const
+{
+    const auto exact = m_exactIndex.constFind(frame);
+    if (exact != m_exactIndex.constEnd()) {
+        response = buildResponse(m_rules.at(exact.value()), frame, nullptr);
+        return exact.value();
+    }
+
+    int prefixRule = m_prefixRuleAtNode.at(0);
+    qint32 node = 0;
+    for (const char rawByte : frame) {
+        const auto it = m_prefixEdges.constFind(prefixEdgeKey(node, static_cast<unsigned char>(rawByte)));
+        if (it == m_prefixEdges.constEnd()) {
+            break;
+        }
+        node = it.value();
+        if (m_prefixRuleAtNode.at(node) >= 0) {
+            prefixRule = m_prefixRuleAtNode.at(node);
+        }
+    }
+
+    if (prefixRule >= 0) {
+        response = buildResponse(m_rules.at(prefixRule), frame, nullptr);
+        return prefixRule;
+    }
+
+    if (m_regexRules.isEmpty()) {
+        return -1;
+    }
+
+    const QString frameText = QString::fromLatin1(frame);
+    for (const int ruleIndex : m_regexRules) {
+        const ResponderRule &rule = m_rules.at(ruleIndex);
+        const QRegularExpressionMatch match = rule.regex.match(frameText);
+        if (match.hasMatch()) {
+            response = buildResponse(rule, frame, &match);
+            return ruleIndex;
+        }
+    }
+
+    return -1;
+}
+
+QByteArray Responder::buildResponse(const ResponderRule &rule,
+                                    const QByteArray &frame,
+                                    const QRegularExpressionMatch *match) const
+{
+    if (!rule.substitute) {
+        return rule.response;
+    }
+
+    const QByteArray &tmpl = rule.response;
+    QByteArray out;
+    out.reserve(tmpl.size() + frame.size());
+
+    for (qsizetype i = 0; i < tmpl.size(); ++i) {
+        const char ch = tmpl.at(i);
+        if (ch != '$' || i + 1 >= tmpl.size()) {
+            out.append(ch);
+            continue;
+        }
+
+        const char next = tmpl.at(i + 1);
+        if (next == '$') {
+            out.append('$');
+            ++i;
+        } else if (next == '0' && match == nullptr) {
+            out.append(frame);
+            ++i;
+        } else if (next >= '0' && next <= '9') {
+            appendCapture(out, match, QString(QChar(next)));
+            ++i;
+        } else if (next == '{') {
+            const qsizetype close = tmpl.indexOf('}', i + 2);
+            if (close < 0) {
+                out.append(ch);
+                continue;
+            }
+            const QString group = QString::fromLatin1(tmpl.mid(i + 2, close - i - 2));
+            if (group == "0" && match == nullptr) {
+                out.append(frame);
+            } else {
+                appendCapture(out, match, group);
+            }
+            i = close;
+        } else {
+            out.append(ch);
+        }
+    }
+
+    return out;
+}
+
+quint64 Responder::framesSeen() const
+{
+    return m_framesSeen;
+}
+
+quint64 Responder::framesAnswered() const
+{
+    return m_framesAnswered;
+}
+
+GapHistogram &Responder::latency()
+{
+    return m_latency;
+}
+
+const GapHistogram &Responder::latency() const
+{
+    return m_latency;
+}
+
+void Responder::resetStatistics()
+{
+    m_framesSeen = 0;
+    m_framesAnswered = 0;
+    m_latency.clear();
+}
+
+bool Responder::parseRules(const QString &text, QList<ResponderRule> &rules, QString *errorString)
+{
+    QStringList errors;
+    QList<ResponderRule> parsed;
+    const QStringList lines = text.split('\n');
+
+    for (int lineIndex = 0; lineIndex < lines.size(); ++lineIndex) {
+        const QString line = lines.at(lineIndex).trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QString error;
+        const qsizetype arrow = line.indexOf("=>");
+        const QString matchPart = arrow < 0 ? line : line.left(arrow).trimmed();
+        const QString responsePart = arrow < 0 ? QString() : line.mid(arrow + 2).trimmed();
+        const qsizetype colon = matchPart.indexOf(':');
+        const QString kind = colon < 0 ? QString() : matchPart.left(colon).trimmed().toLower();
+        const QString matchText = colon < 0 ? QString() : matchPart.mid(colon + 1);
+
+        ResponderRule rule;
+        rule.source = line;
+
+        if (arrow < 0) {
+            error = "missing \"=>\"";
+        } else if (kind == "exact") {
+            rule.kind = ResponderRule::Exact;
+            rule.match = TxEncoder::unescape(matchText);
+        } else if (kind == "hex") {
+            // Matches describe received bytes, so no placeholders here.
+            rule.kind = ResponderRule::Exact;
+            QString hexError;
+            if (!TxEncoder::decodeHex(matchText, rule.match, &hexError)) {
+                error = QString("invalid hex \"%1\": %2").arg(matchText.trimmed(), hexError);
+            } else if (rule.match.isEmpty()) {
+                error = "empty hex match";
+            }
+        } else if (kind == "prefix") {
+            rule.kind = ResponderRule::Prefix;
+            rule.match = TxEncoder::unescape(matchText);
+        } else if (kind == "regex") {
+            rule.kind = ResponderRule::Regex;
+            rule.regex.setPattern(matchText);
+            rule.regex.optimize();
+            if (!rule.regex.isValid()) {
+                error = QString("invalid regex: %1").arg(rule.regex.errorString());
+            }
+        } else {
+            error = "expected exact:, prefix:, regex: or hex:";
+        }
+
+        if (error.isEmpty()) {
+            if (responsePart.startsWith("hex:", Qt::CaseInsensitive)) {
+                encodeBytes(responsePart.mid(4), TxFormat::Hex, rule.response, "response hex", error);
+            } else {
+                // ${name} is a capture reference here, not a TxEncoder placeholder.
+                const QString text = QString(responsePart).replace("${", "$\\{");
+                encodeBytes(text, TxFormat::Escaped, rule.response, "response", error);
+                rule.substitute = rule.response.contains('$');
+            }
+        }
+
+        if (!error.isEmpty()) {
+            errors.append(QString("Line %1: %2").arg(lineIndex + 1).arg(error));
+            continue;
+        }
+
+        parsed.append(rule);
+    }
+
+    rules = parsed;
+    if (errorString != nullptr) {
+        *errorString = errors.join('\n');
+    }
+    return errors.isEmpty();
+}
@@ -0,0 +1,225 @@
+#include "SerialBridge.h"
+
+#include <QObject>
+#include <QtNetwork/QLocalSocket>
+#include <QtNetwork/QTcpSocket>
+
+#include <utility>
+
+SerialBridge::SerialBridge()
+{
+    QObject::connect(&m_tcpServer, &QTcpServer::newConnection, [this]() {
+        acceptTcpClients(m_tcpServer, false);
+    });
+    QObject::connect(&m_observerServer, &QTcpServer::newConnection, [this]() {
+        acceptTcpClients(m_observerServer, true);
+    });
+    QObject::connect(&m_localServer, &QLocalServer::newConnection, [this]() {
+        acceptLocalClients();
+    });
+}
+
+SerialBridge::~SerialBridge()
+{
+    stop();
+}
+
+void SerialBridge::moveToThread(QThread *thread)
+{
+    m_tcpServer.moveToThread(thread);
+    m_observerServer.moveToThread(thread);
+    m_localServer.moveToThread(thread);
+}
+
+bool SerialBridge::start(const BridgeConfig &config)
+{
+    stop();
+    m_config = config;
+    m_lastError.clear();
+
+    const QHostAddress address = config.localhostOnly ? QHostAddress::LocalHost : QHostAddress::Any;
+
+    if (config.tcpPort != 0 && !m_tcpServer.listen(address, config.tcpPort)) {
+        m_lastError = QString("TCP %1: %2").arg(config.tcpPort).arg(m_tcpServer.errorString());
+        stop();
+        return false;
+    }
+
+    if (config.observerTcpPort != 0 && !m_observerServer.listen(address, config.observerTcpPort)) {
+        m_lastError = QString("TCP %1: %2").arg(config.observerTcpPort).arg(m_observerServer.errorString());
+        stop();
+        return false;
+    }
+
+    const QString socketName = config.localSocketName.trimmed();
+    if (!socketName.isEmpty()) {
+        // A crashed previous run leaves the socket file behind and listen() would fail on it.
+        QLocalServer::removeServer(socketName);
+        m_localServer.setSocketOptions(QLocalServer::UserAccessOption);
+        if (!m_localServer.listen(socketName)) {
+            m_lastError = QString("%1: %2").arg(socketName, m_localServer.errorString());
+            stop();
+            return false;
+        }
+    }
+
+    if (!isActive()) {
+        m_lastError = "No listening endpoint configured";
+        return false;
+    }
+
+    return true;
+}
+
+void SerialBridge::stop()
+{
+    m_tcpServer.close();
+    m_observerServer.close();
+    m_localServer.close();
+
+    const QList<Client> clients = std::exchange(m_clients, {});
+    for (const Client &client : clients) {
+        QObject::disconnect(client.device, nullptr, nullptr, nullptr);
+        client.device->close();
+        client.device->deleteLater();
+    }
+
+    if (!clients.isEmpty()) {
+        notifyClientsChanged();
+    }
+}
+
+bool SerialBridge::isActive() const
+{
+    return m_tcpServer.isListening()
+        || m_observerServer.isListening()
+        || m_localServer.isListening();
+}
+
+void SerialBridge::acceptTcpClients(QTcpServer &server, bool readOnly)
+{
+    while (QTcpSocket *socket = server.nextPendingConnection()) {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        QObject::connect(socket, &QTcpSocket::disconnected, [this, socket]() {
+            removeClient(socket);
+        });
+        addClient(socket, readOnly);
+    }
+}
+
+void SerialBridge::acceptLocalClients()
+{
+    while (QLocalSocket *socket = m_localServer.nextPendingConnection()) {
+        QObject::connect(socket, &QLocalSocket::disconnected, [this, socket]() {
+            removeClient(socket);
+        });
+        addClient(socket, false);
+    }
+}
+
+void SerialBridge::addClient(QIODevice *device, bool readOnly)
+{
+    QObject::connect(device, &QIODevice::readyRead, [this, device, readOnly]() {
+        handleClientReadyRead(device, readOnly);
+    });
+
+    Client client;
+    client.device = device;
+    client.readOnly = readOnly;
+    m_clients.append(client);
+    notifyClientsChanged();
+}
+
+void SerialBridge::removeClient(QIODevice *device)
+{
+    for (qsizetype i = 0; i < m_clients.size(); ++i) {
+        if (m_clients.at(i).device == device) {
+            m_clients.removeAt(i);
+            QObject::disconnect(device, nullptr, nullptr, nullptr);
+            device->deleteLater();
+            notifyClientsChanged();
+            return;
+        }
+    }
+}
+
+void SerialBridge::handleClientReadyRead(QIODevice *device, bool readOnly)
+{
+    const QByteArray data = device->readAll();
+    if (data.isEmpty() || readOnly || !m_writeHandler) {
+        return;
+    }
+
+    m_writeHandler(data);
+}
+
+void SerialBridge::forwardToClients(const QByteArray &data)
+{
+    if (data.isEmpty() || m_clients.isEmpty()) {
+        return;
+    }
+
+    // Every client gets the same implicitly shared buffer. The socket write buffer
+    // only keeps a reference for writes of at least 4 KiB (QRingBuffer's chunk
+    // size); smaller chunks, the usual case for serial RX, are copied per client.
+    // A client that stops draining is dropped so one stalled observer can't grow
+    // memory without bound.
+    QList<QIODevice *> stalled;
+    const QList<Client> clients = m_clients;
+    for (const Client &client : clients) {
+        if (client.device->bytesToWrite() > m_config.maxPendingBytes) {
+            stalled.append(client.device);
+            continue;
+        }
+
+        if (client.device->write(data) < 0) {
+            stalled.append(client.device);
+        }
+    }
+
+    for (QIODevice *device : stalled) {
+        device->close();
+        removeClient(device);
+    }
+}
+
+void SerialBridge::setWriteHandler(WriteHandler handler)
+{
+    m_writeHandler = std::move(handler);
+}
+
+void SerialBridge::setClientsChangedCallback(ClientsChangedCallback callback)
+{
+    m_clientsChangedCallback = std::move(callback);
+}
+
+void SerialBridge::notifyClientsChanged()
+{
+    if (m_clientsChangedCallback) {
+        m_clientsChangedCallback(clientCount(), observerCount());
+    }
+}
+
+int SerialBridge::clientCount() const
+{
+    int count = 0;
+    for (const Client &client : m_clients) {
+        count += client.readOnly ? 0 : 1;
+    }
+    return count;
+}
+
+int SerialBridge::observerCount() const
+{
+    return static_cast<int>(m_clients.size()) - clientCount();
+}
+
+QString SerialBridge::lastError() const
+{
+    return m_lastError;
+}
+
+BridgeConfig SerialBridge::getConfig() const
+{
+    return m_config;
+}
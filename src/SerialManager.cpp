@@ -1,49 +1,120 @@
 #include "SerialManager.h"
 
+#include <QFile>
 #include <QIODevice>
+#include <QMetaObject>
 #include <QObject>
 
+#include <chrono>
 #include <utility>
 
+#if defined(Q_OS_UNIX)
+#include <time.h>
+#endif
+
 namespace
 {
-QByteArray normalizeHexString(const QString &hexText)
+constexpr qint64 kSendFileChunkBytes = 64 * 1024;
+} // namespace
+
+SerialManager::SerialManager()
 {
-    QByteArray normalized;
-    normalized.reserve(hexText.size());
+    m_ioThread.setObjectName("serial-io");
+    m_ioContext.moveToThread(&m_ioThread);
+    m_serial.moveToThread(&m_ioThread);
+    m_loopback.moveToThread(&m_ioThread);
+    m_bridge.moveToThread(&m_ioThread);
+    m_fileTransfer.moveToThread(&m_ioThread);
 
-    for (int i = 0; i < hexText.size(); ++i) {
-        const QChar ch = hexText.at(i);
+    QObject::connect(&m_serial, &QSerialPort::readyRead, [this]() {
+        handleReadyRead();
+    });
 
-        if (ch.isSpace()) {
-            continue;
-        }
+    // Stamped when the simulated wire would have delivered it, so a late timer
+    // counts as receive-path delay (e.g. in responder latency) like on a real port.
+    m_loopback.setDeliverCallback([this](const QByteArray &data, qint64 lateNs) {
+        processReceivedData(data, monotonicNowNs() - lateNs);
+    });
+
+    QObject::connect(&m_serial, &QSerialPort::bytesWritten, [this](qint64) {
+        m_fileTransfer.writeReady();
+    });
 
-        if (ch == '0' && i + 1 < hexText.size()) {
-            const QChar next = hexText.at(i + 1);
-            if (next == 'x' || next == 'X') {
-                ++i;
-                continue;
+    m_fileTransfer.setWriteHandler([this](const QByteArray &data) {
+        return writeToPort(data);
+    });
+    m_fileTransfer.setPendingWriteHandler([this]() {
+        return m_loopback.isOpen() ? m_loopback.bytesPending() : m_serial.bytesToWrite();
+    });
+    m_fileTransfer.setLogCallback([this](const QString &message) {
+        postToOwner([this, message]() {
+            if (m_transferLogCallback) {
+                m_transferLogCallback(message);
             }
-        }
+        });
+    });
+    m_fileTransfer.setFinishedCallback([this](bool ok, const QString &message) {
+        postToOwner([this, ok, message]() {
+            if (m_transferFinishedCallback) {
+                m_transferFinishedCallback(ok, message);
+            }
+        });
+    });
 
-        normalized.append(ch.toLatin1());
-    }
+    m_bridge.setWriteHandler([this](const QByteArray &data) {
+        const qint64 written = sendBytes(data);
+        const qint64 timestampNs = m_lastTransmitTimestampNs;
+        postToOwner([this, data, written, timestampNs]() {
+            if (m_bridgeTransmitCallback) {
+                m_bridgeTransmitCallback(data, written, timestampNs);
+            }
+        });
+        return written;
+    });
+    m_bridge.setClientsChangedCallback([this](int clients, int observers) {
+        postToOwner([this, clients, observers]() {
+            if (m_bridgeClientsChangedCallback) {
+                m_bridgeClientsChangedCallback(clients, observers);
+            }
+        });
+    });
 
-    return normalized;
+    m_ioThread.start(QThread::TimeCriticalPriority);
 }
-} // namespace
 
-SerialManager::SerialManager()
+SerialManager::~SerialManager()
 {
-    QObject::connect(&m_serial, &QSerialPort::readyRead, [this]() {
-        handleReadyRead();
+    // Anything these post back is dropped with m_ownerContext. The objects come
+    // back to this thread so their timers and notifiers die where they live.
+    QThread *owner = QThread::currentThread();
+    runOnIoThread([this, owner]() {
+        m_bridge.stop();
+        m_shmPublisher.close();
+        closePort();
+        m_serial.moveToThread(owner);
+        m_loopback.moveToThread(owner);
+        m_bridge.moveToThread(owner);
+        m_fileTransfer.moveToThread(owner);
     });
+    m_ioThread.quit();
+    m_ioThread.wait();
 }
 
-SerialManager::~SerialManager()
+void SerialManager::runOnIoThread(const std::function<void()> &task) const
 {
-    disconnectPort();
+    if (QThread::currentThread() == &m_ioThread) {
+        task();
+        return;
+    }
+
+    QMetaObject::invokeMethod(&m_ioContext, [&task]() {
+        task();
+    }, Qt::BlockingQueuedConnection);
+}
+
+void SerialManager::postToOwner(std::function<void()> task)
+{
+    QMetaObject::invokeMethod(&m_ownerContext, std::move(task), Qt::QueuedConnection);
 }
 
 QList<QSerialPortInfo> SerialManager::getAvailablePorts()
@@ -53,42 +124,85 @@ QList<QSerialPortInfo> SerialManager::getAvailablePorts()
 
 bool SerialManager::connectPort()
 {
-    return connectPort(m_config);
+    return connectPort(getConfig());
 }
 
 bool SerialManager::connectPort(const QString &portName)
 {
-    SerialConfig config = m_config;
+    SerialConfig config = getConfig();
     config.portName = portName;
     return connectPort(config);
 }
 
 bool SerialManager::connectPort(const SerialConfig &config)
 {
-    if (config.portName.trimmed().isEmpty()) {
-        return false;
-    }
+    bool ok = false;
+    runOnIoThread([this, &config, &ok]() {
+        if (config.mode == SerialMode::Loopback) {
+            closePort();
+            m_config = config;
+            resetReceiveState();
+
+            const bool hasParity = config.parity != QSerialPort::NoParity;
+            const int stopBits = config.stopBits == QSerialPort::OneStop ? 1 : 2;
+            LoopbackConfig loopback = config.loopback;
+            loopback.baudRate = config.baudRate;
+            loopback.bitsPerCharacter = LoopbackTransport::bitsPerCharacter(config.dataBits, hasParity, stopBits);
+            ok = m_loopback.open(loopback);
+            m_loopbackOpen = ok;
+            m_connected = ok;
+            return;
+        }
 
-    disconnectPort();
-    m_serial.setPortName(config.portName.trimmed());
+        if (config.portName.trimmed().isEmpty()) {
+            return;
+        }
 
-    if (!applyConfig(config)) {
-        return false;
-    }
+        closePort();
+        m_serial.setPortName(config.portName.trimmed());
 
-    return m_serial.open(QIODevice::ReadWrite);
+        if (!applyConfig(config)) {
+            return;
+        }
+
+        resetReceiveState();
+        ok = m_serial.open(QIODevice::ReadWrite);
+        m_connected = ok;
+    });
+    return ok;
 }
 
 void SerialManager::disconnectPort()
 {
+    runOnIoThread([this]() {
+        closePort();
+    });
+}
+
+void SerialManager::closePort()
+{
+    m_fileTransfer.cancel();
     if (m_serial.isOpen()) {
         m_serial.close();
     }
+    m_loopback.close();
+    m_connected = false;
+    m_loopbackOpen = false;
 }
 
 bool SerialManager::isConnected() const
 {
-    return m_serial.isOpen();
+    return m_connected;
+}
+
+bool SerialManager::isLoopback() const
+{
+    return m_loopbackOpen;
+}
+
+LoopbackTransport &SerialManager::loopback()
+{
+    return m_loopback;
 }
 
 qint64 SerialManager::sendText(const QString &text)
@@ -98,25 +212,140 @@ qint64 SerialManager::sendText(const QString &text)
 
 qint64 SerialManager::sendHex(const QString &hexText)
 {
-    const QByteArray normalized = normalizeHexString(hexText);
-    if (normalized.isEmpty() && !hexText.trimmed().isEmpty()) {
+    TxEncodeOptions options;
+    options.format = TxFormat::Hex;
+    return sendEncoded(hexText, options);
+}
+
+qint64 SerialManager::sendEncoded(QStringView text,
+                                  const TxEncodeOptions &options,
+                                  QString *errorString,
+                                  qint64 *errorPosition)
+{
+    if (errorPosition != nullptr) {
+        *errorPosition = -1;
+    }
+    if (!isConnected()) {
+        if (errorString != nullptr) {
+            *errorString = "port is not open";
+        }
         return -1;
     }
 
-    if (normalized.size() % 2 != 0) {
+    QByteArray bytes;
+    if (!TxEncoder::encode(text, options, bytes, errorString, errorPosition)) {
         return -1;
     }
 
-    return sendBytes(QByteArray::fromHex(normalized));
+    return sendBytes(bytes);
+}
+
+qint64 SerialManager::sendFile(const QString &path,
+                               const TxEncodeOptions &options,
+                               QString *errorString,
+                               qint64 *errorPosition)
+{
+    const auto failWith = [errorString](const QString &message) {
+        if (errorString != nullptr) {
+            *errorString = message;
+        }
+        return qint64(-1);
+    };
+
+    if (errorPosition != nullptr) {
+        *errorPosition = -1;
+    }
+    if (!isConnected()) {
+        return failWith("port is not open");
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return failWith(file.errorString());
+    }
+
+    // Check the whole file before the first byte goes out so a typo near the end
+    // doesn't leave the device with half a payload. Both passes stream in chunks.
+    TxEncoder encoder(options);
+    QByteArray chunk(kSendFileChunkBytes, Qt::Uninitialized);
+    for (int pass = 0; pass < 2; ++pass) {
+        encoder.reset(options);
+        if (!file.seek(0)) {
+            return failWith(file.errorString());
+        }
+
+        qint64 written = 0;
+        for (;;) {
+            const qint64 read = file.read(chunk.data(), chunk.size());
+            if (read < 0) {
+                return failWith(file.errorString());
+            }
+
+            const bool ok = read > 0 ? encoder.feed(QByteArrayView(chunk.constData(), read)) : encoder.finish();
+            if (!ok) {
+                if (errorPosition != nullptr) {
+                    *errorPosition = encoder.errorPosition();
+                }
+                return failWith(encoder.errorString());
+            }
+
+            const QByteArray bytes = encoder.takeOutput();
+            if (pass == 1 && !bytes.isEmpty()) {
+                const qint64 sent = sendBytes(bytes);
+                if (sent < 0) {
+                    return failWith(QString("write failed after %1 bytes").arg(written));
+                }
+                written += sent;
+            }
+
+            if (read == 0) {
+                if (pass == 1) {
+                    return written;
+                }
+                break;
+            }
+        }
+    }
+
+    return -1;
 }
 
 qint64 SerialManager::sendBytes(const QByteArray &data)
+{
+    qint64 written = -1;
+    runOnIoThread([this, &data, &written]() {
+        // A running transfer owns the line; it writes through writeToPort().
+        if (m_fileTransfer.isActive()) {
+            return;
+        }
+        written = writeToPort(data);
+        if (written < 0) {
+            return;
+        }
+
+        const QByteArray sent = written == data.size() ? data : data.left(written);
+        const qint64 timestampNs = m_lastTransmitTimestampNs;
+        postToOwner([this, sent, timestampNs]() {
+            if (m_transmitCallback) {
+                m_transmitCallback(sent, timestampNs);
+            }
+        });
+    });
+
+    return written;
+}
+
+qint64 SerialManager::writeToPort(const QByteArray &data)
 {
     if (!isConnected()) {
         return -1;
     }
 
-    return m_serial.write(data);
+    const qint64 written = m_loopback.isOpen() ? m_loopback.write(data) : m_serial.write(data);
+    if (written >= 0) {
+        m_lastTransmitTimestampNs = monotonicNowNs();
+    }
+    return written;
 }
 
 void SerialManager::setReceiveCallback(ReceiveCallback callback)
@@ -124,32 +353,274 @@ void SerialManager::setReceiveCallback(ReceiveCallback callback)
     m_receiveCallback = std::move(callback);
 }
 
+void SerialManager::setTransmitCallback(TransmitCallback callback)
+{
+    m_transmitCallback = std::move(callback);
+}
+
+void SerialManager::setTriggerRules(const QList<TriggerRule> &rules)
+{
+    runOnIoThread([this, &rules]() {
+        m_triggers.setRules(rules);
+    });
+}
+
+const TriggerEngine &SerialManager::triggers() const
+{
+    return m_triggers;
+}
+
+void SerialManager::setTriggerCallback(TriggerCallback callback)
+{
+    m_triggerCallback = std::move(callback);
+}
+
+Responder &SerialManager::responder()
+{
+    return m_responder;
+}
+
+void SerialManager::setResponderCallback(ResponderCallback callback)
+{
+    m_responderCallback = std::move(callback);
+}
+
+FileTransfer &SerialManager::fileTransfer()
+{
+    return m_fileTransfer;
+}
+
+void SerialManager::setTransferLogCallback(TransferLogCallback callback)
+{
+    m_transferLogCallback = std::move(callback);
+}
+
+void SerialManager::setTransferFinishedCallback(TransferFinishedCallback callback)
+{
+    m_transferFinishedCallback = std::move(callback);
+}
+
+qint64 SerialManager::monotonicNowNs()
+{
+#if defined(Q_OS_UNIX)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+qint64 SerialManager::wallClockOffsetNs()
+{
+#if defined(Q_OS_UNIX)
+    timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    const qint64 realtimeNs = static_cast<qint64>(realtime.tv_sec) * 1000000000 + realtime.tv_nsec;
+#else
+    const qint64 realtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch())
+                                  .count();
+#endif
+    return realtimeNs - monotonicNowNs();
+}
+
+qint64 SerialManager::lastTransmitTimestampNs() const
+{
+    return m_lastTransmitTimestampNs;
+}
+
+const GapHistogram &SerialManager::gapHistogram() const
+{
+    return m_gapHistogram;
+}
+
+void SerialManager::resetGapHistogram()
+{
+    runOnIoThread([this]() {
+        m_gapHistogram.clear();
+        m_lastReceiveTimestampNs = -1;
+    });
+}
+
+bool SerialManager::startBridge(const BridgeConfig &config)
+{
+    bool ok = false;
+    runOnIoThread([this, &config, &ok]() {
+        ok = m_bridge.start(config);
+    });
+    return ok;
+}
+
+void SerialManager::stopBridge()
+{
+    runOnIoThread([this]() {
+        m_bridge.stop();
+    });
+}
+
+bool SerialManager::isBridgeActive() const
+{
+    bool active = false;
+    runOnIoThread([this, &active]() {
+        active = m_bridge.isActive();
+    });
+    return active;
+}
+
+SerialBridge &SerialManager::bridge()
+{
+    return m_bridge;
+}
+
+void SerialManager::setBridgeTransmitCallback(BridgeTransmitCallback callback)
+{
+    m_bridgeTransmitCallback = std::move(callback);
+}
+
+void SerialManager::setBridgeClientsChangedCallback(BridgeClientsChangedCallback callback)
+{
+    m_bridgeClientsChangedCallback = std::move(callback);
+}
+
+bool SerialManager::startSharedMemoryPublisher(const QString &name, qint64 capacity)
+{
+    bool ok = false;
+    runOnIoThread([this, &name, capacity, &ok]() {
+        ok = m_shmPublisher.open(name, capacity);
+    });
+    return ok;
+}
+
+void SerialManager::stopSharedMemoryPublisher()
+{
+    runOnIoThread([this]() {
+        m_shmPublisher.close();
+    });
+}
+
+bool SerialManager::isSharedMemoryPublishing() const
+{
+    bool open = false;
+    runOnIoThread([this, &open]() {
+        open = m_shmPublisher.isOpen();
+    });
+    return open;
+}
+
+ShmPublisher &SerialManager::sharedMemoryPublisher()
+{
+    return m_shmPublisher;
+}
+
 void SerialManager::handleReadyRead()
 {
+    // Runs on the I/O thread as soon as the driver reports data, so GUI load
+    // doesn't show up in the stamp; driver and event-dispatch latency still do.
+    const qint64 timestampNs = monotonicNowNs();
     const QByteArray data = m_serial.readAll();
-    if (data.isEmpty() || !m_receiveCallback) {
+    processReceivedData(data, timestampNs);
+}
+
+void SerialManager::resetReceiveState()
+{
+    m_lastReceiveTimestampNs = -1;
+    m_gapHistogram.clear();
+    m_triggers.reset();
+    m_responder.reset();
+}
+
+void SerialManager::processReceivedData(const QByteArray &data, qint64 timestampNs)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+
+    if (m_lastReceiveTimestampNs >= 0) {
+        m_gapHistogram.add(timestampNs - m_lastReceiveTimestampNs);
+    }
+    m_lastReceiveTimestampNs = timestampNs;
+
+    m_shmPublisher.publish(data, timestampNs);
+
+    // A running transfer owns the line; protocol bytes would only trip
+    // triggers, confuse bridge clients and flood the terminal.
+    if (m_fileTransfer.isActive()) {
+        m_fileTransfer.feed(data);
         return;
     }
 
-    m_receiveCallback(data);
+    m_bridge.forwardToClients(data);
+
+    // Triggers run here, ahead of the display path; canned replies go straight out.
+    m_triggers.feed(data, [this, timestampNs](const TriggerMatch &match) {
+        const TriggerRule &rule = m_triggers.rules().at(match.ruleIndex);
+        if ((rule.actions & TriggerReply) && !rule.reply.isEmpty()) {
+            sendBytes(rule.reply);
+        }
+        postToOwner([this, rule, match, timestampNs]() {
+            if (m_triggerCallback) {
+                m_triggerCallback(rule, match, timestampNs);
+            }
+        });
+    });
+
+    // Emulator replies are written and flushed right here, no GUI round-trip;
+    // latency runs from the chunk's arrival stamp to the reply leaving the driver,
+    // so time spent queued behind earlier chunks or a late loopback timer counts.
+    m_responder.feed(data, [this, timestampNs](const QByteArray &response, int ruleIndex) {
+        qint64 written = 0;
+        if (!response.isEmpty()) {
+            written = sendBytes(response);
+            if (m_serial.isOpen()) {
+                m_serial.flush();
+            }
+        }
+
+        const qint64 latencyNs = monotonicNowNs() - timestampNs;
+        m_responder.latency().add(latencyNs);
+        const ResponderRule rule = m_responder.rules().at(ruleIndex);
+        const qint64 sentNs = m_lastTransmitTimestampNs;
+        postToOwner([this, rule, response, written, latencyNs, sentNs]() {
+            if (m_responderCallback) {
+                m_responderCallback(rule, response, written, latencyNs, sentNs);
+            }
+        });
+    });
+
+    postToOwner([this, data, timestampNs]() {
+        if (m_receiveCallback) {
+            m_receiveCallback(data, timestampNs);
+        }
+    });
 }
 
 bool SerialManager::applyConfig(const SerialConfig &config)
 {
-    m_config = config;
+    bool ok = false;
+    runOnIoThread([this, &config, &ok]() {
+        m_config = config;
 
-    if (!config.portName.trimmed().isEmpty()) {
-        m_serial.setPortName(config.portName.trimmed());
-    }
+        if (!config.portName.trimmed().isEmpty()) {
+            m_serial.setPortName(config.portName.trimmed());
+        }
 
-    return m_serial.setBaudRate(config.baudRate)
-        && m_serial.setDataBits(config.dataBits)
-        && m_serial.setParity(config.parity)
-        && m_serial.setStopBits(config.stopBits)
-        && m_serial.setFlowControl(config.flowControl);
+        ok = m_serial.setBaudRate(config.baudRate)
+            && m_serial.setDataBits(config.dataBits)
+            && m_serial.setParity(config.parity)
+            && m_serial.setStopBits(config.stopBits)
+            && m_serial.setFlowControl(config.flowControl);
+    });
+    return ok;
 }
 
 SerialConfig SerialManager::getConfig() const
 {
-    return m_config;
+    SerialConfig config;
+    runOnIoThread([this, &config]() {
+        config = m_config;
+    });
+    return config;
 }
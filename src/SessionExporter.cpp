@@ -0,0 +1,533 @@
+#include "SessionExporter.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtEndian>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace
+{
+constexpr int kBatchSize = 64 * 1024;
+constexpr int kSliceSize = 4 * 1024;
+const char kHexDigits[] = "0123456789ABCDEF";
+
+class RecordListSource : public ExportSource
+{
+private:
+    QList<CaptureRecord> m_records;
+    qsizetype m_next = 0;
+    qint64 m_wallClockOffsetNs = 0;
+
+public:
+    RecordListSource(QList<CaptureRecord> records, qint64 wallClockOffsetNs)
+        : m_records(std::move(records))
+        , m_wallClockOffsetNs(wallClockOffsetNs)
+    {
+    }
+
+    bool readBatch(QList<CaptureRecord> &batch, int maxRecords) override
+    {
+        const qsizetype count = std::min<qsizetype>(maxRecords, m_records.size() - m_next);
+        batch.append(m_records.mid(m_next, count));
+        m_next += count;
+        return count > 0;
+    }
+
+    double progress() const override
+    {
+        return m_records.isEmpty() ? 1.0 : static_cast<double>(m_next) / m_records.size();
+    }
+
+    qint64 wallClockOffsetNs() const override
+    {
+        return m_wallClockOffsetNs;
+    }
+};
+
+class CaptureFileSource : public ExportSource
+{
+private:
+    CaptureFileReader m_reader;
+
+public:
+    bool open(const QString &path, qint64 length)
+    {
+        return m_reader.open(path, length);
+    }
+
+    bool readBatch(QList<CaptureRecord> &batch, int maxRecords) override
+    {
+        return m_reader.readBatch(batch, maxRecords);
+    }
+
+    double progress() const override
+    {
+        return m_reader.progress();
+    }
+
+    qint64 wallClockOffsetNs() const override
+    {
+        return m_reader.wallClockOffsetNs();
+    }
+
+    QString errorString() const override
+    {
+        return m_reader.errorString();
+    }
+};
+
+// QDateTime formatting is far too slow per record; records are time ordered, so
+// the date/time prefix only needs rebuilding when the second changes.
+class UtcTimeFormatter
+{
+private:
+    qint64 m_second = std::numeric_limits<qint64>::min();
+    QByteArray m_prefix;
+
+public:
+    void append(QByteArray &out, qint64 wallNs)
+    {
+        const qint64 second = wallNs >= 0 ? wallNs / 1000000000 : (wallNs - 999999999) / 1000000000;
+        if (second != m_second) {
+            m_second = second;
+            m_prefix = QDateTime::fromSecsSinceEpoch(second, Qt::UTC)
+                           .toString("yyyy-MM-dd'T'HH:mm:ss")
+                           .toLatin1();
+        }
+
+        qint64 micros = (wallNs - second * 1000000000) / 1000;
+        char fraction[8] = {'.', '0', '0', '0', '0', '0', '0', 'Z'};
+        for (int i = 6; i >= 1; --i) {
+            fraction[i] = static_cast<char>('0' + micros % 10);
+            micros /= 10;
+        }
+
+        out.append(m_prefix);
+        out.append(fraction, sizeof(fraction));
+    }
+};
+
+void appendHex(QByteArray &out, const QByteArray &data)
+{
+    const qsizetype start = out.size();
+    out.resize(start + data.size() * 2);
+    char *dst = out.data() + start;
+    for (const char rawByte : data) {
+        const auto byte = static_cast<unsigned char>(rawByte);
+        *dst++ = kHexDigits[byte >> 4];
+        *dst++ = kHexDigits[byte & 0x0f];
+    }
+}
+
+void appendCsvText(QByteArray &out, const QByteArray &data)
+{
+    out.append('"');
+    for (const char rawByte : data) {
+        const auto byte = static_cast<unsigned char>(rawByte);
+        if (byte == '"') {
+            out.append("\"\"", 2);
+        } else if (byte >= 0x20 && byte < 0x7f) {
+            out.append(rawByte);
+        } else {
+            out.append('.');
+        }
+    }
+    out.append('"');
+}
+
+void appendJsonText(QByteArray &out, const QByteArray &data)
+{
+    out.append('"');
+    for (const char rawByte : data) {
+        const auto byte = static_cast<unsigned char>(rawByte);
+        switch (byte) {
+        case '"':
+            out.append("\\\"", 2);
+            break;
+        case '\\':
+            out.append("\\\\", 2);
+            break;
+        case '\n':
+            out.append("\\n", 2);
+            break;
+        case '\r':
+            out.append("\\r", 2);
+            break;
+        case '\t':
+            out.append("\\t", 2);
+            break;
+        default:
+            if (byte >= 0x20 && byte < 0x7f) {
+                out.append(rawByte);
+            } else {
+                // Bytes are not guaranteed to be UTF-8, so map them 1:1 to U+0000..U+00FF.
+                const char escaped[6] = {'\\', 'u', '0', '0', kHexDigits[byte >> 4], kHexDigits[byte & 0x0f]};
+                out.append(escaped, sizeof(escaped));
+            }
+            break;
+        }
+    }
+    out.append('"');
+}
+
+template <typename T>
+void appendLittleEndian(QByteArray &out, T value)
+{
+    char raw[sizeof(T)];
+    qToLittleEndian(value, raw);
+    out.append(raw, sizeof(T));
+}
+
+void appendPadding(QByteArray &out, qsizetype length)
+{
+    const qsizetype padding = (4 - (length % 4)) % 4;
+    out.append(padding, '\0');
+}
+
+void appendPcapngOption(QByteArray &out, quint16 code, const QByteArray &value)
+{
+    appendLittleEndian<quint16>(out, code);
+    appendLittleEndian<quint16>(out, static_cast<quint16>(value.size()));
+    out.append(value);
+    appendPadding(out, value.size());
+}
+
+void appendPcapngBlock(QByteArray &out, quint32 type, const QByteArray &body)
+{
+    const quint32 totalLength = static_cast<quint32>(12 + body.size());
+    appendLittleEndian<quint32>(out, type);
+    appendLittleEndian<quint32>(out, totalLength);
+    out.append(body);
+    appendLittleEndian<quint32>(out, totalLength);
+}
+
+void appendPcapngPacket(QByteArray &out, const CaptureRecord &record, qint64 wallNs)
+{
+    const quint32 length = static_cast<quint32>(record.data.size());
+    const quint32 paddedLength = (length + 3) & ~quint32(3);
+    // body: 20 bytes fixed + data + epb_flags option (8) + opt_endofopt (4)
+    const quint32 totalLength = 12 + 20 + paddedLength + 8 + 4;
+    const quint64 timestamp = static_cast<quint64>(std::max<qint64>(wallNs, 0));
+
+    appendLittleEndian<quint32>(out, 6);
+    appendLittleEndian<quint32>(out, totalLength);
+    appendLittleEndian<quint32>(out, record.channel);
+    appendLittleEndian<quint32>(out, static_cast<quint32>(timestamp >> 32));
+    appendLittleEndian<quint32>(out, static_cast<quint32>(timestamp));
+    appendLittleEndian<quint32>(out, length);
+    appendLittleEndian<quint32>(out, length);
+    out.append(record.data);
+    out.append(static_cast<qsizetype>(paddedLength - length), '\0');
+
+    appendLittleEndian<quint16>(out, 2);
+    appendLittleEndian<quint16>(out, 4);
+    appendLittleEndian<quint32>(out, record.direction == CaptureDirection::Rx ? 1 : 2);
+    appendLittleEndian<quint32>(out, 0);
+
+    appendLittleEndian<quint32>(out, totalLength);
+}
+} // namespace
+
+QString ExportSource::errorString() const
+{
+    return QString();
+}
+
+QStringList ExportSource::channelNames() const
+{
+    return {"serial"};
+}
+
+std::unique_ptr<ExportSource> ExportSource::fromRecords(QList<CaptureRecord> records,
+                                                        qint64 wallClockOffsetNs)
+{
+    return std::make_unique<RecordListSource>(std::move(records), wallClockOffsetNs);
+}
+
+std::unique_ptr<ExportSource> ExportSource::fromCaptureFile(const QString &path,
+                                                            QString *errorString,
+                                                            qint64 length)
+{
+    auto source = std::make_unique<CaptureFileSource>();
+    if (!source->open(path, length)) {
+        if (errorString != nullptr) {
+            *errorString = source->errorString();
+        }
+        return nullptr;
+    }
+
+    return source;
+}
+
+SessionExporter::SessionExporter() = default;
+
+SessionExporter::~SessionExporter()
+{
+    cancel();
+    wait();
+    delete m_thread;
+}
+
+bool SessionExporter::start(const QString &path, ExportFormat format, std::unique_ptr<ExportSource> source)
+{
+    if (isRunning() || source == nullptr) {
+        return false;
+    }
+
+    if (m_thread != nullptr) {
+        m_thread->wait();
+        delete m_thread;
+    }
+
+    m_cancelRequested = false;
+    m_finished = false;
+    m_recordsWritten = 0;
+    m_progressPermille = 0;
+    m_succeeded = false;
+    m_errorString.clear();
+
+    // The exporter waits on pool futures, so it gets its own thread rather than
+    // occupying a pool slot the formatting jobs need.
+    std::shared_ptr<ExportSource> sharedSource(std::move(source));
+    m_thread = QThread::create([this, path, format, sharedSource]() {
+        run(path, format, *sharedSource);
+        m_finished.store(true, std::memory_order_release);
+    });
+    m_thread->start(QThread::LowPriority);
+    return true;
+}
+
+void SessionExporter::cancel()
+{
+    m_cancelRequested = true;
+}
+
+bool SessionExporter::wait()
+{
+    if (m_thread != nullptr) {
+        m_thread->wait();
+    }
+
+    return m_succeeded;
+}
+
+bool SessionExporter::isRunning() const
+{
+    return m_thread != nullptr && !m_finished.load(std::memory_order_acquire);
+}
+
+bool SessionExporter::isFinished() const
+{
+    return m_finished.load(std::memory_order_acquire);
+}
+
+bool SessionExporter::succeeded() const
+{
+    return isFinished() && m_succeeded;
+}
+
+bool SessionExporter::wasCancelled() const
+{
+    return m_cancelRequested.load();
+}
+
+QString SessionExporter::errorString() const
+{
+    return isFinished() ? m_errorString : QString();
+}
+
+qint64 SessionExporter::recordsWritten() const
+{
+    return m_recordsWritten.load();
+}
+
+int SessionExporter::progressPermille() const
+{
+    return m_progressPermille.load();
+}
+
+ExportFormat SessionExporter::formatForPath(const QString &path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "jsonl" || suffix == "json" || suffix == "ndjson") {
+        return ExportFormat::JsonLines;
+    }
+    if (suffix == "pcapng" || suffix == "pcap") {
+        return ExportFormat::Pcapng;
+    }
+    return ExportFormat::Csv;
+}
+
+QByteArray SessionExporter::fileHeader(ExportFormat format, const QStringList &channelNames)
+{
+    QByteArray out;
+
+    if (format == ExportFormat::Csv) {
+        out = "timestamp_ns,time_utc,direction,length,hex,text,channel\n";
+    } else if (format == ExportFormat::Pcapng) {
+        QByteArray sectionHeader;
+        appendLittleEndian<quint32>(sectionHeader, 0x1A2B3C4D);
+        appendLittleEndian<quint16>(sectionHeader, 1);
+        appendLittleEndian<quint16>(sectionHeader, 0);
+        appendLittleEndian<qint64>(sectionHeader, -1);
+        appendPcapngBlock(out, 0x0A0D0D0A, sectionHeader);
+
+        // One interface per channel, so packets' interface id is their channel.
+        for (const QString &name : channelNames) {
+            QByteArray interface;
+            appendLittleEndian<quint16>(interface, kPcapLinkType);
+            appendLittleEndian<quint16>(interface, 0);
+            appendLittleEndian<quint32>(interface, 0);
+            appendPcapngOption(interface, 2, name.toUtf8());
+            appendPcapngOption(interface, 9, QByteArray(1, char(9))); // nanosecond timestamps
+            appendLittleEndian<quint32>(interface, 0);
+            appendPcapngBlock(out, 1, interface);
+        }
+    }
+
+    return out;
+}
+
+QByteArray SessionExporter::formatRecords(const CaptureRecord *records,
+                                          qsizetype count,
+                                          ExportFormat format,
+                                          qint64 wallClockOffsetNs)
+{
+    QByteArray out;
+    qsizetype estimate = 0;
+    for (qsizetype i = 0; i < count; ++i) {
+        estimate += records[i].data.size();
+    }
+    out.reserve(estimate * (format == ExportFormat::Pcapng ? 1 : 3) + count * 80);
+
+    UtcTimeFormatter timeFormatter;
+    for (qsizetype i = 0; i < count; ++i) {
+        const CaptureRecord &record = records[i];
+        const qint64 wallNs = record.timestampNs + wallClockOffsetNs;
+        const bool isRx = record.direction == CaptureDirection::Rx;
+
+        switch (format) {
+        case ExportFormat::Csv:
+            out.append(QByteArray::number(record.timestampNs));
+            out.append(',');
+            timeFormatter.append(out, wallNs);
+            out.append(isRx ? ",rx," : ",tx,");
+            out.append(QByteArray::number(record.data.size()));
+            out.append(',');
+            appendHex(out, record.data);
+            out.append(',');
+            appendCsvText(out, record.data);
+            out.append(',');
+            out.append(QByteArray::number(record.channel));
+            out.append('\n');
+            break;
+        case ExportFormat::JsonLines:
+            out.append("{\"ts_ns\":");
+            out.append(QByteArray::number(record.timestampNs));
+            out.append(",\"time\":\"");
+            timeFormatter.append(out, wallNs);
+            out.append(isRx ? "\",\"dir\":\"rx\",\"len\":" : "\",\"dir\":\"tx\",\"len\":");
+            out.append(QByteArray::number(record.data.size()));
+            out.append(",\"hex\":\"");
+            appendHex(out, record.data);
+            out.append("\",\"text\":");
+            appendJsonText(out, record.data);
+            out.append(",\"ch\":");
+            out.append(QByteArray::number(record.channel));
+            out.append("}\n");
+            break;
+        case ExportFormat::Pcapng:
+            appendPcapngPacket(out, record, wallNs);
+            break;
+        }
+    }
+
+    return out;
+}
+
+void SessionExporter::run(const QString &path, ExportFormat format, ExportSource &source)
+{
+    struct PendingSlice
+    {
+        QFuture<QByteArray> text;
+        qsizetype count = 0;
+    };
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = file.errorString();
+        return;
+    }
+
+    const qint64 wallClockOffsetNs = source.wallClockOffsetNs();
+    const int maxInFlight = std::max(2, QThreadPool::globalInstance()->maxThreadCount() * 2);
+    QList<PendingSlice> pending;
+    bool writeFailed = file.write(fileHeader(format, source.channelNames())) < 0;
+
+    auto writeFront = [&]() {
+        PendingSlice slice = pending.takeFirst();
+        const QByteArray text = slice.text.result();
+        if (!writeFailed && file.write(text) != text.size()) {
+            writeFailed = true;
+        }
+        m_recordsWritten.fetch_add(slice.count);
+    };
+
+    bool more = true;
+    while (more && !writeFailed && !m_cancelRequested.load()) {
+        QList<CaptureRecord> batch;
+        batch.reserve(kBatchSize);
+        more = source.readBatch(batch, kBatchSize);
+
+        for (qsizetype start = 0; start < batch.size() && !m_cancelRequested.load(); start += kSliceSize) {
+            while (pending.size() >= maxInFlight) {
+                writeFront();
+            }
+
+            PendingSlice slice;
+            slice.count = std::min<qsizetype>(kSliceSize, batch.size() - start);
+            slice.text = QtConcurrent::run(QThreadPool::globalInstance(),
+                                           [batch, start, count = slice.count, format, wallClockOffsetNs]() {
+                                               return formatRecords(batch.constData() + start,
+                                                                    count,
+                                                                    format,
+                                                                    wallClockOffsetNs);
+                                           });
+            pending.append(slice);
+        }
+
+        m_progressPermille = static_cast<int>(std::clamp(source.progress(), 0.0, 1.0) * 1000);
+    }
+
+    while (!pending.isEmpty()) {
+        writeFront();
+    }
+
+    file.close();
+
+    if (m_cancelRequested.load()) {
+        file.remove();
+        m_errorString = "Export cancelled";
+        return;
+    }
+
+    if (writeFailed) {
+        m_errorString = file.errorString();
+        return;
+    }
+
+    if (!source.errorString().isEmpty()) {
+        m_errorString = source.errorString();
+        return;
+    }
+
+    m_progressPermille = 1000;
+    m_succeeded = true;
+}
@@ -0,0 +1,291 @@
+#include "SessionSpool.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+// Reads the segments back to back. All of them are opened up front, so one the
+// spool deletes while the export runs is still readable on POSIX systems.
+class SpoolSource : public ExportSource
+{
+private:
+    std::vector<std::unique_ptr<CaptureFileReader>> m_readers;
+    std::vector<qint64> m_lengths;
+    qint64 m_totalLength = 0;
+    qint64 m_doneLength = 0;
+    size_t m_current = 0;
+    qint64 m_wallClockOffsetNs = 0;
+    QString m_errorString;
+
+public:
+    explicit SpoolSource(qint64 wallClockOffsetNs)
+        : m_wallClockOffsetNs(wallClockOffsetNs)
+    {
+    }
+
+    bool add(const QString &path, qint64 length)
+    {
+        auto reader = std::make_unique<CaptureFileReader>();
+        if (!reader->open(path, length)) {
+            m_errorString = reader->errorString();
+            return false;
+        }
+        m_readers.push_back(std::move(reader));
+        m_lengths.push_back(length);
+        m_totalLength += length;
+        return true;
+    }
+
+    bool readBatch(QList<CaptureRecord> &batch, int maxRecords) override
+    {
+        const qsizetype start = batch.size();
+        while (m_current < m_readers.size() && batch.size() - start < maxRecords) {
+            CaptureFileReader &reader = *m_readers[m_current];
+            reader.readBatch(batch, maxRecords - static_cast<int>(batch.size() - start));
+            if (!reader.errorString().isEmpty()) {
+                m_errorString = reader.errorString();
+                return false;
+            }
+            if (reader.atEnd()) {
+                m_doneLength += m_lengths[m_current];
+                reader.close();
+                ++m_current;
+            }
+        }
+        return batch.size() > start;
+    }
+
+    double progress() const override
+    {
+        if (m_current >= m_readers.size() || m_totalLength <= 0) {
+            return 1.0;
+        }
+        const double current = m_readers[m_current]->progress() * static_cast<double>(m_lengths[m_current]);
+        return (static_cast<double>(m_doneLength) + current) / static_cast<double>(m_totalLength);
+    }
+
+    qint64 wallClockOffsetNs() const override
+    {
+        return m_wallClockOffsetNs;
+    }
+
+    QString errorString() const override
+    {
+        return m_errorString;
+    }
+};
+} // namespace
+
+SessionSpool::SessionSpool() = default;
+
+SessionSpool::~SessionSpool()
+{
+    close();
+}
+
+void SessionSpool::setDirectory(const QString &directory)
+{
+    m_directory = directory.trimmed();
+}
+
+QString SessionSpool::directory() const
+{
+    return m_directory.isEmpty() ? defaultDirectory() : m_directory;
+}
+
+QString SessionSpool::defaultDirectory()
+{
+    const QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return cache.isEmpty() ? QDir::tempPath() : QDir(cache).filePath("spool");
+}
+
+void SessionSpool::setMaxBytes(qint64 maxBytes)
+{
+    m_maxBytes = std::max(maxBytes, kMinMaxBytes);
+    trim();
+}
+
+qint64 SessionSpool::maxBytes() const
+{
+    return m_maxBytes;
+}
+
+bool SessionSpool::open(qint64 wallClockOffsetNs)
+{
+    close();
+    m_wallClockOffsetNs = wallClockOffsetNs;
+    m_droppedRecords = 0;
+    return QDir().mkpath(directory()) && openSegment();
+}
+
+bool SessionSpool::openSegment()
+{
+    // QTemporaryFile only picks the name; the writer owns the file from here.
+    QTemporaryFile file(QDir(directory()).filePath("desktop_serial-session-XXXXXX.dscap"));
+    file.setAutoRemove(false);
+    if (!file.open()) {
+        return false;
+    }
+    m_path = file.fileName();
+    file.close();
+
+    if (!m_writer.open(m_path, m_wallClockOffsetNs)) {
+        QFile::remove(m_path);
+        m_path.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool SessionSpool::rotate()
+{
+    Segment segment;
+    segment.path = m_path;
+    segment.size = m_writer.size();
+    segment.records = m_writer.recordCount();
+    const bool closed = m_writer.close();
+    m_path.clear();
+    if (!closed) {
+        QFile::remove(segment.path);
+        return false;
+    }
+
+    m_segments.append(segment);
+    m_segmentBytes += segment.size;
+    m_segmentRecords += segment.records;
+    trim();
+    return openSegment();
+}
+
+void SessionSpool::trim()
+{
+    // A reader that already opened a segment keeps reading it on POSIX systems.
+    while (!m_segments.isEmpty() && m_segmentBytes + m_writer.size() > m_maxBytes) {
+        const Segment oldest = m_segments.takeFirst();
+        QFile::remove(oldest.path);
+        m_segmentBytes -= oldest.size;
+        m_segmentRecords -= oldest.records;
+        m_droppedRecords += oldest.records;
+    }
+}
+
+void SessionSpool::close()
+{
+    m_writer.close();
+    removeFiles();
+}
+
+void SessionSpool::removeFiles()
+{
+    for (const Segment &segment : std::as_const(m_segments)) {
+        QFile::remove(segment.path);
+    }
+    m_segments.clear();
+    m_segmentBytes = 0;
+    m_segmentRecords = 0;
+
+    if (!m_path.isEmpty()) {
+        QFile::remove(m_path);
+        m_path.clear();
+    }
+}
+
+bool SessionSpool::isOpen() const
+{
+    return m_writer.isOpen();
+}
+
+bool SessionSpool::append(const CaptureRecord &record)
+{
+    if (!m_writer.write(record)) {
+        return false;
+    }
+    // Segments are a fraction of the cap, so trimming drops the oldest part only.
+    return m_writer.size() < m_maxBytes / kSegmentsPerSpool || rotate();
+}
+
+bool SessionSpool::isEmpty() const
+{
+    return recordCount() == 0;
+}
+
+qint64 SessionSpool::recordCount() const
+{
+    return m_segmentRecords + m_writer.recordCount();
+}
+
+qint64 SessionSpool::droppedRecords() const
+{
+    return m_droppedRecords;
+}
+
+qint64 SessionSpool::sizeOnDisk() const
+{
+    return m_segmentBytes + m_writer.size();
+}
+
+qint64 SessionSpool::wallClockOffsetNs() const
+{
+    return m_wallClockOffsetNs;
+}
+
+QString SessionSpool::fileName() const
+{
+    return m_path;
+}
+
+std::unique_ptr<ExportSource> SessionSpool::exportSource(QString *errorString)
+{
+    if (!m_writer.flush()) {
+        if (errorString != nullptr) {
+            *errorString = "Session spool is not writable";
+        }
+        return nullptr;
+    }
+
+    auto source = std::make_unique<SpoolSource>(m_wallClockOffsetNs);
+    bool opened = true;
+    for (const Segment &segment : std::as_const(m_segments)) {
+        opened = opened && source->add(segment.path, segment.size);
+    }
+    opened = opened && source->add(m_path, m_writer.size());
+    if (!opened) {
+        if (errorString != nullptr) {
+            *errorString = source->errorString();
+        }
+        return nullptr;
+    }
+
+    return source;
+}
+
+QFuture<bool> SessionSpool::saveSnapshot(const QString &path)
+{
+    // Opened here, not on the pool, so a segment trimmed meanwhile still copies.
+    QList<std::shared_ptr<QFile>> sources;
+    QList<qint64> lengths;
+    bool opened = m_writer.flush();
+    const auto addSource = [&](const QString &sourcePath, qint64 length) {
+        auto file = std::make_shared<QFile>(sourcePath);
+        opened = opened && file->open(QIODevice::ReadOnly);
+        sources.append(file);
+        lengths.append(length);
+    };
+    for (const Segment &segment : std::as_const(m_segments)) {
+        addSource(segment.path, segment.size);
+    }
+    addSource(m_path, m_writer.size());
+
+    return QtConcurrent::run(QThreadPool::globalInstance(), [opened, sources, lengths, path]() {
+        return opened && copyCaptureSegments(sources, lengths, path);
+    });
+}
@@ -0,0 +1,83 @@
+#include "ShmPublisher.h"
+
+#include <cstring>
+
+ShmPublisher::ShmPublisher() = default;
+
+ShmPublisher::~ShmPublisher()
+{
+    close();
+}
+
+bool ShmPublisher::open(const QString &name, qint64 capacity)
+{
+    close();
+    m_lastError.clear();
+
+#if defined(__linux__)
+    QString shmName = name.trimmed();
+    if (!shmName.startsWith('/')) {
+        shmName.prepend('/');
+    }
+
+    const int result = ds_shm_writer_open(&m_writer,
+                                          shmName.toLocal8Bit().constData(),
+                                          static_cast<uint64_t>(capacity));
+    if (result != 0) {
+        m_lastError = QString("%1: %2").arg(shmName, QString::fromLocal8Bit(std::strerror(-result)));
+        return false;
+    }
+
+    m_name = shmName;
+    m_open = true;
+    return true;
+#else
+    Q_UNUSED(name);
+    Q_UNUSED(capacity);
+    m_lastError = "Shared-memory publishing is only available on Linux";
+    return false;
+#endif
+}
+
+void ShmPublisher::close()
+{
+    if (!m_open) {
+        return;
+    }
+
+#if defined(__linux__)
+    ds_shm_writer_close(&m_writer);
+#endif
+    m_open = false;
+}
+
+bool ShmPublisher::isOpen() const
+{
+    return m_open;
+}
+
+void ShmPublisher::publish(const QByteArray &data, qint64 timestampNs)
+{
+    if (!m_open || data.isEmpty()) {
+        return;
+    }
+
+#if defined(__linux__)
+    ds_shm_writer_publish(&m_writer,
+                          data.constData(),
+                          static_cast<size_t>(data.size()),
+                          static_cast<uint64_t>(timestampNs));
+#else
+    Q_UNUSED(timestampNs);
+#endif
+}
+
+QString ShmPublisher::name() const
+{
+    return m_name;
+}
+
+QString ShmPublisher::lastError() const
+{
+    return m_lastError;
+}
@@ -0,0 +1,748 @@
+#include "TerminalGrid.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+constexpr int kTabWidth = 8;
+
+// DEC special graphics for 0x5f..0x7e, selected with ESC ( 0.
+constexpr char32_t kDecGraphics[32] = {
+    0x0020, 0x25c6, 0x2592, 0x2409, 0x240c, 0x240d, 0x240a, 0x00b0,
+    0x00b1, 0x2424, 0x240b, 0x2518, 0x2510, 0x250c, 0x2514, 0x253c,
+    0x23ba, 0x23bb, 0x2500, 0x23bc, 0x23bd, 0x251c, 0x2524, 0x2534,
+    0x252c, 0x2502, 0x2264, 0x2265, 0x03c0, 0x2260, 0x00a3, 0x00b7,
+};
+} // namespace
+
+TerminalGrid::TerminalGrid()
+{
+    reset();
+}
+
+qsizetype TerminalGrid::ringCapacity() const
+{
+    return static_cast<qsizetype>(m_scrollbackLimit) + m_rows;
+}
+
+QList<TerminalLine> TerminalGrid::takePrimaryLines()
+{
+    const qsizetype capacity = m_lines.size();
+    QList<TerminalLine> lines;
+    lines.reserve(m_lineCount);
+    for (qsizetype i = 0; i < m_lineCount; ++i) {
+        lines.append(std::move(m_lines[(m_ringStart + i) % capacity]));
+    }
+    return lines;
+}
+
+void TerminalGrid::setPrimaryLines(QList<TerminalLine> lines)
+{
+    const qsizetype capacity = ringCapacity();
+    if (lines.size() > capacity) {
+        lines.remove(0, lines.size() - capacity);
+    }
+
+    for (qsizetype i = lines.size() - m_rows; i < lines.size(); ++i) {
+        lines[i].resize(m_columns, TerminalCell());
+    }
+
+    m_lineCount = lines.size();
+    m_ringStart = 0;
+    m_lines = std::move(lines);
+    m_lines.resize(capacity);
+}
+
+TerminalLine &TerminalGrid::screenLine(int row)
+{
+    if (m_altActive) {
+        return m_altScreen[row];
+    }
+    return m_lines[(m_ringStart + m_lineCount - m_rows + row) % m_lines.size()];
+}
+
+TerminalCell TerminalGrid::blankCell() const
+{
+    // Erased cells keep the current background, like xterm's bce.
+    TerminalCell cell;
+    cell.bg = m_pen.bg;
+    return cell;
+}
+
+TerminalLine TerminalGrid::blankLine() const
+{
+    return TerminalLine(m_columns, blankCell());
+}
+
+void TerminalGrid::damage(int row, int firstColumn, int lastColumn)
+{
+    m_damageFirst[row] = std::min(m_damageFirst.at(row), firstColumn);
+    m_damageLast[row] = std::max(m_damageLast.at(row), lastColumn);
+}
+
+void TerminalGrid::damageRows(int firstRow, int lastRow)
+{
+    for (int row = firstRow; row <= lastRow; ++row) {
+        m_damageFirst[row] = 0;
+        m_damageLast[row] = m_columns - 1;
+    }
+}
+
+void TerminalGrid::damageAll()
+{
+    m_fullDamage = true;
+}
+
+void TerminalGrid::scrollRegionUp(int top, int bottom, int count, bool keepHistory)
+{
+    count = std::min(count, bottom - top + 1);
+    if (count <= 0) {
+        return;
+    }
+
+    if (keepHistory && !m_altActive && top == 0 && bottom == m_rows - 1) {
+        // The screen window slides down the ring; the top line becomes history.
+        const qsizetype capacity = m_lines.size();
+        for (int i = 0; i < count; ++i) {
+            if (m_lineCount < capacity) {
+                ++m_lineCount;
+            } else {
+                m_ringStart = (m_ringStart + 1) % capacity;
+            }
+            screenLine(m_rows - 1) = blankLine();
+        }
+
+        // Pending damage moves with its rows so a blit plus the leftovers stays correct.
+        for (int row = 0; row < m_rows - count; ++row) {
+            m_damageFirst[row] = m_damageFirst.at(row + count);
+            m_damageLast[row] = m_damageLast.at(row + count);
+        }
+        damageRows(m_rows - count, m_rows - 1);
+        m_scrolledLines += count;
+        return;
+    }
+
+    for (int row = top; row <= bottom - count; ++row) {
+        std::swap(screenLine(row), screenLine(row + count));
+    }
+    for (int row = bottom - count + 1; row <= bottom; ++row) {
+        screenLine(row) = blankLine();
+    }
+    damageRows(top, bottom);
+}
+
+void TerminalGrid::scrollRegionDown(int top, int bottom, int count)
+{
+    count = std::min(count, bottom - top + 1);
+    if (count <= 0) {
+        return;
+    }
+
+    for (int row = bottom; row >= top + count; --row) {
+        std::swap(screenLine(row), screenLine(row - count));
+    }
+    for (int row = top; row < top + count; ++row) {
+        screenLine(row) = blankLine();
+    }
+    damageRows(top, bottom);
+}
+
+void TerminalGrid::resetTabStops()
+{
+    m_tabStops.fill(false, m_columns);
+    for (int column = kTabWidth; column < m_columns; column += kTabWidth) {
+        m_tabStops[column] = true;
+    }
+}
+
+void TerminalGrid::clampCursor()
+{
+    m_cursorRow = std::clamp(m_cursorRow, 0, m_rows - 1);
+    m_cursorColumn = std::clamp(m_cursorColumn, 0, m_columns - 1);
+}
+
+int TerminalGrid::columns() const
+{
+    return m_columns;
+}
+
+int TerminalGrid::rows() const
+{
+    return m_rows;
+}
+
+void TerminalGrid::resize(int columns, int rows)
+{
+    columns = std::max(columns, 2);
+    rows = std::max(rows, 2);
+    if (columns == m_columns && rows == m_rows) {
+        return;
+    }
+
+    QList<TerminalLine> lines = takePrimaryLines();
+    int primaryCursorRow = m_altActive ? m_savedCursor.row : m_cursorRow;
+
+    if (rows < m_rows) {
+        // Drop blank space below the cursor first, then push the top into history.
+        const int trim = std::min(m_rows - rows, m_rows - 1 - primaryCursorRow);
+        lines.resize(lines.size() - trim);
+        primaryCursorRow -= m_rows - rows - trim;
+    } else if (rows > m_rows) {
+        const int pull = static_cast<int>(std::min<qsizetype>(rows - m_rows, lines.size() - m_rows));
+        primaryCursorRow += pull;
+        lines.resize(lines.size() + rows - m_rows - pull);
+    }
+
+    m_columns = columns;
+    m_rows = rows;
+    setPrimaryLines(std::move(lines));
+
+    m_altScreen.resize(m_rows);
+    for (TerminalLine &line : m_altScreen) {
+        line.resize(m_columns, TerminalCell());
+    }
+
+    if (m_altActive) {
+        m_savedCursor.row = std::clamp(primaryCursorRow, 0, m_rows - 1);
+    } else {
+        m_cursorRow = primaryCursorRow;
+    }
+
+    m_scrollTop = 0;
+    m_scrollBottom = m_rows - 1;
+    m_wrapPending = false;
+    clampCursor();
+    resetTabStops();
+    m_damageFirst.fill(m_columns, m_rows);
+    m_damageLast.fill(-1, m_rows);
+    m_scrolledLines = 0;
+    damageAll();
+}
+
+void TerminalGrid::setScrollbackLimit(int lines)
+{
+    m_scrollbackLimit = std::max(lines, 0);
+    setPrimaryLines(takePrimaryLines());
+    damageAll();
+}
+
+int TerminalGrid::scrollbackSize() const
+{
+    return m_altActive ? 0 : static_cast<int>(m_lineCount - m_rows);
+}
+
+const TerminalLine &TerminalGrid::lineAt(int row) const
+{
+    if (row >= 0 && m_altActive) {
+        return m_altScreen.at(row);
+    }
+    return m_lines.at((m_ringStart + m_lineCount - m_rows + row) % m_lines.size());
+}
+
+int TerminalGrid::cursorRow() const
+{
+    return m_cursorRow;
+}
+
+int TerminalGrid::cursorColumn() const
+{
+    return m_cursorColumn;
+}
+
+bool TerminalGrid::isCursorVisible() const
+{
+    return m_cursorVisible;
+}
+
+bool TerminalGrid::applicationCursorKeys() const
+{
+    return m_applicationCursorKeys;
+}
+
+bool TerminalGrid::isAlternateScreen() const
+{
+    return m_altActive;
+}
+
+void TerminalGrid::takeDamage(TerminalDamage &damage)
+{
+    damage.full = m_fullDamage || m_scrolledLines >= m_rows;
+    damage.scrolledLines = damage.full ? 0 : m_scrolledLines;
+    damage.rows.clear();
+
+    for (int row = 0; row < m_rows; ++row) {
+        if (!damage.full && m_damageFirst.at(row) <= m_damageLast.at(row)) {
+            TerminalRowDamage rowDamage;
+            rowDamage.row = row;
+            rowDamage.firstColumn = m_damageFirst.at(row);
+            rowDamage.lastColumn = std::min(m_damageLast.at(row), m_columns - 1);
+            damage.rows.append(rowDamage);
+        }
+        m_damageFirst[row] = m_columns;
+        m_damageLast[row] = -1;
+    }
+
+    m_fullDamage = false;
+    m_scrolledLines = 0;
+}
+
+void TerminalGrid::reset()
+{
+    m_pen = TerminalCell();
+    m_altActive = false;
+    m_lines.clear();
+    m_lineCount = 0;
+    m_lines.resize(ringCapacity());
+    m_ringStart = 0;
+    m_lineCount = m_rows;
+    for (int row = 0; row < m_rows; ++row) {
+        screenLine(row) = blankLine();
+    }
+    m_altScreen.fill(blankLine(), m_rows);
+
+    m_cursorRow = 0;
+    m_cursorColumn = 0;
+    m_wrapPending = false;
+    m_savedCursor = SavedCursor();
+    m_savedAltCursor = SavedCursor();
+    m_scrollTop = 0;
+    m_scrollBottom = m_rows - 1;
+    resetTabStops();
+
+    m_autoWrap = true;
+    m_originMode = false;
+    m_insertMode = false;
+    m_cursorVisible = true;
+    m_applicationCursorKeys = false;
+    m_charsetGraphics[0] = false;
+    m_charsetGraphics[1] = false;
+    m_activeCharset = 0;
+    m_decGraphics = false;
+    m_lastPrinted = U' ';
+
+    m_damageFirst.fill(m_columns, m_rows);
+    m_damageLast.fill(-1, m_rows);
+    m_scrolledLines = 0;
+    damageAll();
+}
+
+void TerminalGrid::clearScrollback()
+{
+    QList<TerminalLine> lines = takePrimaryLines();
+    lines.remove(0, lines.size() - m_rows);
+    setPrimaryLines(std::move(lines));
+    damageAll();
+}
+
+TerminalCell &TerminalGrid::pen()
+{
+    return m_pen;
+}
+
+void TerminalGrid::print(char32_t ch)
+{
+    if (m_decGraphics && ch >= 0x5f && ch <= 0x7e) {
+        ch = kDecGraphics[ch - 0x5f];
+    }
+
+    if (m_wrapPending) {
+        m_cursorColumn = 0;
+        lineFeed();
+    }
+
+    TerminalCell cell = m_pen;
+    cell.ch = ch;
+    TerminalLine &line = screenLine(m_cursorRow);
+    if (m_insertMode) {
+        line.insert(m_cursorColumn, cell);
+        line.removeLast();
+        damage(m_cursorRow, m_cursorColumn, m_columns - 1);
+    } else {
+        line[m_cursorColumn] = cell;
+        damage(m_cursorRow, m_cursorColumn, m_cursorColumn);
+    }
+
+    m_lastPrinted = ch;
+    if (m_cursorColumn == m_columns - 1) {
+        m_wrapPending = m_autoWrap;
+    } else {
+        ++m_cursorColumn;
+    }
+}
+
+void TerminalGrid::printAscii(const char *text, qsizetype length)
+{
+    if (length <= 0) {
+        return;
+    }
+
+    if (m_insertMode || m_decGraphics) {
+        for (qsizetype i = 0; i < length; ++i) {
+            print(static_cast<unsigned char>(text[i]));
+        }
+        return;
+    }
+
+    // Fast path for plain text: fill whole row segments with one damage update each.
+    TerminalCell cell = m_pen;
+    qsizetype i = 0;
+    while (i < length) {
+        if (m_wrapPending) {
+            m_cursorColumn = 0;
+            lineFeed();
+        }
+
+        TerminalCell *cells = screenLine(m_cursorRow).data();
+        const int first = m_cursorColumn;
+        const int count = static_cast<int>(std::min<qsizetype>(m_columns - first, length - i));
+        for (int k = 0; k < count; ++k) {
+            cell.ch = static_cast<unsigned char>(text[i + k]);
+            cells[first + k] = cell;
+        }
+        damage(m_cursorRow, first, first + count - 1);
+
+        i += count;
+        m_cursorColumn += count;
+        if (m_cursorColumn >= m_columns) {
+            m_cursorColumn = m_columns - 1;
+            m_wrapPending = m_autoWrap;
+        }
+    }
+
+    m_lastPrinted = static_cast<unsigned char>(text[length - 1]);
+}
+
+void TerminalGrid::repeatLastCharacter(int count)
+{
+    count = std::min(count, m_rows * m_columns);
+    for (int i = 0; i < count; ++i) {
+        print(m_lastPrinted);
+    }
+}
+
+void TerminalGrid::designateCharset(int slot, bool decGraphics)
+{
+    m_charsetGraphics[slot & 1] = decGraphics;
+    m_decGraphics = m_charsetGraphics[m_activeCharset];
+}
+
+void TerminalGrid::selectCharset(int slot)
+{
+    m_activeCharset = slot & 1;
+    m_decGraphics = m_charsetGraphics[m_activeCharset];
+}
+
+void TerminalGrid::carriageReturn()
+{
+    m_cursorColumn = 0;
+    m_wrapPending = false;
+}
+
+void TerminalGrid::lineFeed()
+{
+    m_wrapPending = false;
+    if (m_cursorRow == m_scrollBottom) {
+        scrollRegionUp(m_scrollTop, m_scrollBottom, 1, true);
+    } else if (m_cursorRow < m_rows - 1) {
+        ++m_cursorRow;
+    }
+}
+
+void TerminalGrid::reverseLineFeed()
+{
+    m_wrapPending = false;
+    if (m_cursorRow == m_scrollTop) {
+        scrollRegionDown(m_scrollTop, m_scrollBottom, 1);
+    } else if (m_cursorRow > 0) {
+        --m_cursorRow;
+    }
+}
+
+void TerminalGrid::backspace()
+{
+    if (m_cursorColumn > 0) {
+        --m_cursorColumn;
+    }
+    m_wrapPending = false;
+}
+
+void TerminalGrid::tab(int count)
+{
+    for (int i = 0; i < count && m_cursorColumn < m_columns - 1; ++i) {
+        do {
+            ++m_cursorColumn;
+        } while (m_cursorColumn < m_columns - 1 && !m_tabStops.at(m_cursorColumn));
+    }
+    m_wrapPending = false;
+}
+
+void TerminalGrid::backTab(int count)
+{
+    for (int i = 0; i < count && m_cursorColumn > 0; ++i) {
+        do {
+            --m_cursorColumn;
+        } while (m_cursorColumn > 0 && !m_tabStops.at(m_cursorColumn));
+    }
+    m_wrapPending = false;
+}
+
+void TerminalGrid::setTabStop()
+{
+    m_tabStops[m_cursorColumn] = true;
+}
+
+void TerminalGrid::clearTabStop(bool all)
+{
+    if (all) {
+        m_tabStops.fill(false);
+    } else {
+        m_tabStops[m_cursorColumn] = false;
+    }
+}
+
+void TerminalGrid::moveCursorTo(int row, int column)
+{
+    if (m_originMode) {
+        m_cursorRow = std::clamp(row + m_scrollTop, m_scrollTop, m_scrollBottom);
+    } else {
+        m_cursorRow = std::clamp(row, 0, m_rows - 1);
+    }
+    m_cursorColumn = std::clamp(column, 0, m_columns - 1);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::moveCursorBy(int rows, int columns)
+{
+    // Relative moves stop at the margins when they start inside the region.
+    const int top = m_cursorRow >= m_scrollTop ? m_scrollTop : 0;
+    const int bottom = m_cursorRow <= m_scrollBottom ? m_scrollBottom : m_rows - 1;
+    m_cursorRow = std::clamp(m_cursorRow + rows, top, bottom);
+    m_cursorColumn = std::clamp(m_cursorColumn + columns, 0, m_columns - 1);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::setCursorColumn(int column)
+{
+    m_cursorColumn = std::clamp(column, 0, m_columns - 1);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::setCursorRow(int row)
+{
+    moveCursorTo(row, m_cursorColumn);
+}
+
+void TerminalGrid::saveCursor()
+{
+    SavedCursor &saved = m_altActive ? m_savedAltCursor : m_savedCursor;
+    saved.row = m_cursorRow;
+    saved.column = m_cursorColumn;
+    saved.pen = m_pen;
+    saved.originMode = m_originMode;
+    saved.charsetGraphics[0] = m_charsetGraphics[0];
+    saved.charsetGraphics[1] = m_charsetGraphics[1];
+    saved.activeCharset = m_activeCharset;
+}
+
+void TerminalGrid::restoreCursor()
+{
+    const SavedCursor &saved = m_altActive ? m_savedAltCursor : m_savedCursor;
+    m_cursorRow = saved.row;
+    m_cursorColumn = saved.column;
+    m_pen = saved.pen;
+    m_originMode = saved.originMode;
+    m_charsetGraphics[0] = saved.charsetGraphics[0];
+    m_charsetGraphics[1] = saved.charsetGraphics[1];
+    m_activeCharset = saved.activeCharset;
+    m_decGraphics = m_charsetGraphics[m_activeCharset];
+    m_wrapPending = false;
+    clampCursor();
+}
+
+void TerminalGrid::eraseInDisplay(int mode)
+{
+    switch (mode) {
+    case 0:
+        eraseInLine(0);
+        for (int row = m_cursorRow + 1; row < m_rows; ++row) {
+            screenLine(row) = blankLine();
+        }
+        damageRows(m_cursorRow + 1, m_rows - 1);
+        break;
+    case 1:
+        eraseInLine(1);
+        for (int row = 0; row < m_cursorRow; ++row) {
+            screenLine(row) = blankLine();
+        }
+        damageRows(0, m_cursorRow - 1);
+        break;
+    case 2:
+        for (int row = 0; row < m_rows; ++row) {
+            screenLine(row) = blankLine();
+        }
+        damageRows(0, m_rows - 1);
+        break;
+    case 3:
+        clearScrollback();
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalGrid::eraseInLine(int mode)
+{
+    int first = 0;
+    int last = m_columns - 1;
+    if (mode == 0) {
+        first = m_cursorColumn;
+    } else if (mode == 1) {
+        last = m_cursorColumn;
+    } else if (mode != 2) {
+        return;
+    }
+
+    TerminalCell *cells = screenLine(m_cursorRow).data();
+    std::fill(cells + first, cells + last + 1, blankCell());
+    damage(m_cursorRow, first, last);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::eraseCharacters(int count)
+{
+    const int last = std::min(m_cursorColumn + std::max(count, 1), m_columns) - 1;
+    TerminalCell *cells = screenLine(m_cursorRow).data();
+    std::fill(cells + m_cursorColumn, cells + last + 1, blankCell());
+    damage(m_cursorRow, m_cursorColumn, last);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::insertCharacters(int count)
+{
+    count = std::clamp(count, 1, m_columns - m_cursorColumn);
+    TerminalLine &line = screenLine(m_cursorRow);
+    line.insert(m_cursorColumn, count, blankCell());
+    line.resize(m_columns);
+    damage(m_cursorRow, m_cursorColumn, m_columns - 1);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::deleteCharacters(int count)
+{
+    count = std::clamp(count, 1, m_columns - m_cursorColumn);
+    TerminalLine &line = screenLine(m_cursorRow);
+    line.remove(m_cursorColumn, count);
+    line.resize(m_columns, blankCell());
+    damage(m_cursorRow, m_cursorColumn, m_columns - 1);
+    m_wrapPending = false;
+}
+
+void TerminalGrid::insertLines(int count)
+{
+    if (m_cursorRow < m_scrollTop || m_cursorRow > m_scrollBottom) {
+        return;
+    }
+    scrollRegionDown(m_cursorRow, m_scrollBottom, std::max(count, 1));
+    m_cursorColumn = 0;
+    m_wrapPending = false;
+}
+
+void TerminalGrid::deleteLines(int count)
+{
+    if (m_cursorRow < m_scrollTop || m_cursorRow > m_scrollBottom) {
+        return;
+    }
+    scrollRegionUp(m_cursorRow, m_scrollBottom, std::max(count, 1), false);
+    m_cursorColumn = 0;
+    m_wrapPending = false;
+}
+
+void TerminalGrid::scrollUp(int count)
+{
+    scrollRegionUp(m_scrollTop, m_scrollBottom, std::max(count, 1), true);
+}
+
+void TerminalGrid::scrollDown(int count)
+{
+    scrollRegionDown(m_scrollTop, m_scrollBottom, std::max(count, 1));
+}
+
+void TerminalGrid::setScrollRegion(int top, int bottom)
+{
+    if (bottom < 0 || bottom >= m_rows) {
+        bottom = m_rows - 1;
+    }
+    top = std::max(top, 0);
+    if (top >= bottom) {
+        return;
+    }
+
+    m_scrollTop = top;
+    m_scrollBottom = bottom;
+    moveCursorTo(0, 0);
+}
+
+void TerminalGrid::fillWithE()
+{
+    TerminalCell cell;
+    cell.ch = U'E';
+    for (int row = 0; row < m_rows; ++row) {
+        screenLine(row).fill(cell, m_columns);
+    }
+    m_scrollTop = 0;
+    m_scrollBottom = m_rows - 1;
+    m_originMode = false;
+    moveCursorTo(0, 0);
+    damageRows(0, m_rows - 1);
+}
+
+void TerminalGrid::setAutoWrap(bool enabled)
+{
+    m_autoWrap = enabled;
+    m_wrapPending = false;
+}
+
+void TerminalGrid::setOriginMode(bool enabled)
+{
+    m_originMode = enabled;
+    moveCursorTo(0, 0);
+}
+
+void TerminalGrid::setInsertMode(bool enabled)
+{
+    m_insertMode = enabled;
+}
+
+void TerminalGrid::setCursorVisible(bool visible)
+{
+    m_cursorVisible = visible;
+}
+
+void TerminalGrid::setApplicationCursorKeys(bool enabled)
+{
+    m_applicationCursorKeys = enabled;
+}
+
+void TerminalGrid::setAlternateScreen(bool enabled, bool saveAndClear)
+{
+    if (enabled == m_altActive) {
+        return;
+    }
+
+    if (enabled) {
+        if (saveAndClear) {
+            saveCursor();
+        }
+        m_altActive = true;
+        m_altScreen.fill(blankLine(), m_rows);
+    } else {
+        m_altActive = false;
+        if (saveAndClear) {
+            restoreCursor();
+        }
+    }
+
+    m_wrapPending = false;
+    damageAll();
+}
@@ -0,0 +1,333 @@
+#include "TimelineMerger.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+#include <utility>
+
+#include "SerialManager.h"
+
+namespace
+{
+using HeapOrder = std::greater<TimelineHead>;
+} // namespace
+
+bool TimelineMerger::addSource(std::unique_ptr<ExportSource> source, const QString &name)
+{
+    if (m_started || source == nullptr || sourceCount() >= kMaxSources) {
+        return false;
+    }
+
+    Cursor cursor;
+    cursor.rebaseNs = m_cursors.empty() ? 0 : source->wallClockOffsetNs() - wallClockOffsetNs();
+    cursor.source = std::move(source);
+    cursor.name = name;
+    m_cursors.push_back(std::move(cursor));
+    return true;
+}
+
+int TimelineMerger::sourceCount() const
+{
+    return static_cast<int>(m_cursors.size());
+}
+
+bool TimelineMerger::refill(int channel)
+{
+    Cursor &cursor = m_cursors[channel];
+    cursor.batch.clear();
+    cursor.next = 0;
+    if (cursor.exhausted) {
+        return false;
+    }
+
+    if (!cursor.source->readBatch(cursor.batch, kSourceBatchRecords)) {
+        cursor.exhausted = true;
+    }
+
+    const QString error = cursor.source->errorString();
+    if (!error.isEmpty()) {
+        m_errorString = QString("%1: %2").arg(cursor.name, error);
+        cursor.exhausted = true;
+        cursor.batch.clear();
+        return false;
+    }
+
+    return !cursor.batch.isEmpty();
+}
+
+void TimelineMerger::pushHead(int channel)
+{
+    const Cursor &cursor = m_cursors[channel];
+    m_heap.push_back({cursor.batch.at(cursor.next).timestampNs + cursor.rebaseNs, channel});
+    std::push_heap(m_heap.begin(), m_heap.end(), HeapOrder());
+}
+
+bool TimelineMerger::readBatch(QList<CaptureRecord> &batch, int maxRecords)
+{
+    if (!m_started) {
+        m_started = true;
+        for (int channel = 0; channel < sourceCount(); ++channel) {
+            if (refill(channel)) {
+                pushHead(channel);
+            }
+        }
+    }
+
+    while (m_errorString.isEmpty() && !m_heap.empty() && batch.size() < maxRecords) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), HeapOrder());
+        const TimelineHead head = m_heap.back();
+        m_heap.pop_back();
+
+        Cursor &cursor = m_cursors[head.channel];
+        CaptureRecord record = std::move(cursor.batch[cursor.next++]);
+        record.timestampNs = head.timestampNs;
+        record.channel = static_cast<quint8>(head.channel);
+        batch.append(std::move(record));
+
+        if (cursor.next < cursor.batch.size() || refill(head.channel)) {
+            pushHead(head.channel);
+        }
+    }
+
+    return m_errorString.isEmpty() && !m_heap.empty();
+}
+
+double TimelineMerger::progress() const
+{
+    if (m_cursors.empty()) {
+        return 1.0;
+    }
+
+    double total = 0.0;
+    for (const Cursor &cursor : m_cursors) {
+        total += cursor.exhausted && cursor.next >= cursor.batch.size() ? 1.0 : cursor.source->progress();
+    }
+    return total / static_cast<double>(m_cursors.size());
+}
+
+qint64 TimelineMerger::wallClockOffsetNs() const
+{
+    return m_cursors.empty() ? 0 : m_cursors.front().source->wallClockOffsetNs();
+}
+
+QString TimelineMerger::errorString() const
+{
+    return m_errorString;
+}
+
+QStringList TimelineMerger::channelNames() const
+{
+    QStringList names;
+    for (const Cursor &cursor : m_cursors) {
+        names.append(cursor.name);
+    }
+    return names;
+}
+
+std::unique_ptr<TimelineMerger> TimelineMerger::fromCaptureFiles(const QStringList &paths, QString *errorString)
+{
+    if (paths.size() > kMaxSources) {
+        if (errorString != nullptr) {
+            *errorString = QString("At most %1 capture files can be merged").arg(kMaxSources);
+        }
+        return nullptr;
+    }
+
+    auto merger = std::make_unique<TimelineMerger>();
+    for (const QString &path : paths) {
+        QString error;
+        std::unique_ptr<ExportSource> source = ExportSource::fromCaptureFile(path, &error);
+        if (source == nullptr) {
+            if (errorString != nullptr) {
+                *errorString = QString("%1: %2").arg(path, error);
+            }
+            return nullptr;
+        }
+        merger->addSource(std::move(source), QFileInfo(path).completeBaseName());
+    }
+    return merger;
+}
+
+LiveTimelineMerger::LiveTimelineMerger()
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&m_timer, &QTimer::timeout, [this]() {
+        releaseDue();
+    });
+}
+
+int LiveTimelineMerger::addChannel(const QString &name)
+{
+    if (channelCount() >= TimelineMerger::kMaxSources) {
+        return -1;
+    }
+
+    Channel channel;
+    channel.name = name;
+    m_channels.push_back(std::move(channel));
+    return channelCount() - 1;
+}
+
+void LiveTimelineMerger::setChannelActive(int channel, bool active)
+{
+    if (channel < 0 || channel >= channelCount()) {
+        return;
+    }
+
+    m_channels[channel].active = active;
+    // A channel that went quiet for good should not hold the others back.
+    releaseDue();
+}
+
+bool LiveTimelineMerger::isChannelActive(int channel) const
+{
+    return channel >= 0 && channel < channelCount() && m_channels[channel].active;
+}
+
+int LiveTimelineMerger::channelCount() const
+{
+    return static_cast<int>(m_channels.size());
+}
+
+QStringList LiveTimelineMerger::channelNames() const
+{
+    QStringList names;
+    for (const Channel &channel : m_channels) {
+        names.append(channel.name);
+    }
+    return names;
+}
+
+void LiveTimelineMerger::setHoldNs(qint64 holdNs)
+{
+    m_holdNs = std::max<qint64>(holdNs, 0);
+    releaseDue();
+}
+
+qint64 LiveTimelineMerger::holdNs() const
+{
+    return m_holdNs;
+}
+
+void LiveTimelineMerger::setOutputCallback(OutputCallback callback)
+{
+    m_outputCallback = std::move(callback);
+}
+
+void LiveTimelineMerger::push(int channel, CaptureDirection direction, const QByteArray &data, qint64 timestampNs)
+{
+    if (channel < 0 || channel >= channelCount() || data.isEmpty()) {
+        return;
+    }
+
+    Channel &state = m_channels[channel];
+    if (timestampNs < m_lastEmittedNs) {
+        // Older than something already released; it goes out now, out of order.
+        ++m_lateRecords;
+    }
+    timestampNs = std::max(timestampNs, state.lastTimestampNs);
+    state.lastTimestampNs = timestampNs;
+
+    CaptureRecord record;
+    record.timestampNs = timestampNs;
+    record.direction = direction;
+    record.channel = static_cast<quint8>(channel);
+    record.data = data;
+
+    if (state.pending.empty()) {
+        m_heap.push_back({timestampNs, channel});
+        std::push_heap(m_heap.begin(), m_heap.end(), HeapOrder());
+    }
+    state.pending.push_back(std::move(record));
+    ++m_pendingRecords;
+
+    releaseDue();
+}
+
+void LiveTimelineMerger::releaseDue()
+{
+    // Nothing earlier can still come from a channel already seen past the
+    // watermark, and anything older than the hold time is released regardless.
+    qint64 seenNs = std::numeric_limits<qint64>::max();
+    for (const Channel &channel : m_channels) {
+        if (channel.active) {
+            seenNs = std::min(seenNs, channel.lastTimestampNs);
+        }
+    }
+
+    release(std::max(seenNs, SerialManager::monotonicNowNs() - m_holdNs));
+    scheduleRelease();
+}
+
+void LiveTimelineMerger::release(qint64 watermarkNs)
+{
+    while (!m_heap.empty() && m_heap.front().timestampNs <= watermarkNs) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), HeapOrder());
+        const int channel = m_heap.back().channel;
+        m_heap.pop_back();
+
+        Channel &state = m_channels[channel];
+        const CaptureRecord record = std::move(state.pending.front());
+        state.pending.pop_front();
+        --m_pendingRecords;
+        if (!state.pending.empty()) {
+            m_heap.push_back({state.pending.front().timestampNs, channel});
+            std::push_heap(m_heap.begin(), m_heap.end(), HeapOrder());
+        }
+
+        m_lastEmittedNs = std::max(m_lastEmittedNs, record.timestampNs);
+        ++m_recordsMerged;
+        if (m_outputCallback) {
+            m_outputCallback(record);
+        }
+    }
+}
+
+void LiveTimelineMerger::scheduleRelease()
+{
+    if (m_heap.empty()) {
+        m_timer.stop();
+        return;
+    }
+
+    const qint64 delayNs = m_heap.front().timestampNs + m_holdNs - SerialManager::monotonicNowNs();
+    m_timer.start(static_cast<int>(std::max<qint64>(0, (delayNs + 999999) / 1000000)));
+}
+
+void LiveTimelineMerger::flush()
+{
+    release(std::numeric_limits<qint64>::max());
+    scheduleRelease();
+}
+
+void LiveTimelineMerger::clear()
+{
+    for (Channel &channel : m_channels) {
+        channel.pending.clear();
+        channel.lastTimestampNs = std::numeric_limits<qint64>::min();
+    }
+    m_heap.clear();
+    m_timer.stop();
+    // Otherwise everything after a clear that is older than the last record
+    // released before it counts as late.
+    m_lastEmittedNs = std::numeric_limits<qint64>::min();
+    m_pendingRecords = 0;
+    m_recordsMerged = 0;
+    m_lateRecords = 0;
+}
+
+qint64 LiveTimelineMerger::pendingRecords() const
+{
+    return m_pendingRecords;
+}
+
+quint64 LiveTimelineMerger::recordsMerged() const
+{
+    return m_recordsMerged;
+}
+
+quint64 LiveTimelineMerger::lateRecords() const
+{
+    return m_lateRecords;
+}
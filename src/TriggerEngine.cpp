@@ -0,0 +1,267 @@
+#include "TriggerEngine.h"
+
+#include <QStringList>
+
+#include "TxEncoder.h"
+
+namespace
+{
+constexpr int kAlphabetSize = 256;
+
+// Replies use the Send panel's Escaped and HEX syntax, {crc16} included.
+bool encodeBytes(const QString &text, TxFormat format, QByteArray &bytes, const QString &what, QString *errorString)
+{
+    QString error;
+    if (!TxEncoder::encode(text, {format}, bytes, &error)) {
+        *errorString = QString("invalid %1 \"%2\": %3").arg(what, text.trimmed(), error);
+        return false;
+    }
+    if (bytes.isEmpty()) {
+        *errorString = QString("empty %1").arg(what);
+        return false;
+    }
+    return true;
+}
+
+// Patterns describe received bytes: escapes only, so '{' is literal.
+bool decodePattern(const QString &text, bool hex, QByteArray &bytes, QString *errorString)
+{
+    if (hex) {
+        QString error;
+        if (!TxEncoder::decodeHex(text, bytes, &error)) {
+            *errorString = QString("invalid hex pattern \"%1\": %2").arg(text.trimmed(), error);
+            return false;
+        }
+    } else {
+        bytes = TxEncoder::unescape(text);
+    }
+    if (bytes.isEmpty()) {
+        *errorString = "empty pattern";
+        return false;
+    }
+    return true;
+}
+
+bool parseActions(const QString &text, TriggerRule &rule, QString *errorString)
+{
+    rule.actions = 0;
+    QString remaining = text.trimmed();
+
+    while (!remaining.isEmpty()) {
+        if (remaining.startsWith("replyhex:", Qt::CaseInsensitive)) {
+            if (!encodeBytes(remaining.mid(9), TxFormat::Hex, rule.reply, "reply hex", errorString)) {
+                return false;
+            }
+            rule.actions |= TriggerReply;
+            return true;
+        }
+
+        if (remaining.startsWith("reply:", Qt::CaseInsensitive)) {
+            // Reply text runs to the end of the line so it may contain commas.
+            if (!encodeBytes(remaining.mid(6), TxFormat::Escaped, rule.reply, "reply", errorString)) {
+                return false;
+            }
+            rule.actions |= TriggerReply;
+            return true;
+        }
+
+        const qsizetype comma = remaining.indexOf(',');
+        const QString action = (comma < 0 ? remaining : remaining.left(comma)).trimmed().toLower();
+        remaining = comma < 0 ? QString() : remaining.mid(comma + 1).trimmed();
+
+        if (action == "highlight") {
+            rule.actions |= TriggerHighlight;
+        } else if (action == "notify") {
+            rule.actions |= TriggerNotify;
+        } else if (action == "stop") {
+            rule.actions |= TriggerStopCapture;
+        } else if (action == "snapshot") {
+            rule.actions |= TriggerSnapshotCapture;
+        } else if (!action.isEmpty()) {
+            *errorString = QString("unknown action \"%1\"").arg(action);
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace
+
+TriggerEngine::TriggerEngine()
+{
+    setRules({});
+}
+
+void TriggerEngine::setRules(const QList<TriggerRule> &rules)
+{
+    m_rules = rules;
+    m_transitions.fill(-1, kAlphabetSize);
+    m_outputOffsets.clear();
+    m_outputs.clear();
+    m_state = 0;
+
+    // 1. Trie over all patterns; -1 marks a missing edge.
+    QList<QList<qint32>> outputsPerState(1);
+    for (int ruleIndex = 0; ruleIndex < m_rules.size(); ++ruleIndex) {
+        const QByteArray &pattern = m_rules.at(ruleIndex).pattern;
+        if (pattern.isEmpty()) {
+            continue;
+        }
+
+        qint32 state = 0;
+        for (const char rawByte : pattern) {
+            const int byte = static_cast<unsigned char>(rawByte);
+            qint32 next = m_transitions.at(state * kAlphabetSize + byte);
+            if (next < 0) {
+                next = static_cast<qint32>(outputsPerState.size());
+                m_transitions[state * kAlphabetSize + byte] = next;
+                m_transitions.resize(m_transitions.size() + kAlphabetSize, -1);
+                outputsPerState.append(QList<qint32>());
+            }
+            state = next;
+        }
+        outputsPerState[state].append(ruleIndex);
+    }
+
+    // 2. Breadth-first pass turns the trie into a DFA: missing edges take the
+    //    failure state's edge, and each state inherits its failure state's outputs.
+    const qint32 stateCount = static_cast<qint32>(outputsPerState.size());
+    QList<qint32> failure(stateCount, 0);
+    QList<qint32> queue;
+    queue.reserve(stateCount);
+
+    for (int byte = 0; byte < kAlphabetSize; ++byte) {
+        qint32 &next = m_transitions[byte];
+        if (next < 0) {
+            next = 0;
+        } else {
+            failure[next] = 0;
+            queue.append(next);
+        }
+    }
+
+    for (qsizetype head = 0; head < queue.size(); ++head) {
+        const qint32 state = queue.at(head);
+        const qint32 fail = failure.at(state);
+        outputsPerState[state].append(outputsPerState.at(fail));
+
+        for (int byte = 0; byte < kAlphabetSize; ++byte) {
+            const qint32 next = m_transitions.at(state * kAlphabetSize + byte);
+            const qint32 fallback = m_transitions.at(fail * kAlphabetSize + byte);
+            if (next < 0) {
+                m_transitions[state * kAlphabetSize + byte] = fallback;
+            } else {
+                failure[next] = fallback;
+                queue.append(next);
+            }
+        }
+    }
+
+    // 3. Flatten outputs so the hot loop only compares two offsets per byte.
+    m_outputOffsets.reserve(stateCount + 1);
+    for (const QList<qint32> &outputs : outputsPerState) {
+        m_outputOffsets.append(static_cast<qint32>(m_outputs.size()));
+        m_outputs.append(outputs);
+    }
+    m_outputOffsets.append(static_cast<qint32>(m_outputs.size()));
+}
+
+const QList<TriggerRule> &TriggerEngine::rules() const
+{
+    return m_rules;
+}
+
+bool TriggerEngine::isEmpty() const
+{
+    return m_outputs.isEmpty();
+}
+
+int TriggerEngine::stateCount() const
+{
+    return static_cast<int>(m_outputOffsets.size()) - 1;
+}
+
+void TriggerEngine::reset()
+{
+    m_state = 0;
+}
+
+void TriggerEngine::feed(const QByteArray &data, const MatchCallback &callback)
+{
+    if (isEmpty()) {
+        return;
+    }
+
+    const qint32 *transitions = m_transitions.constData();
+    const qint32 *outputOffsets = m_outputOffsets.constData();
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data.constData());
+    const qsizetype size = data.size();
+    qint32 state = m_state;
+
+    for (qsizetype i = 0; i < size; ++i) {
+        state = transitions[state * kAlphabetSize + bytes[i]];
+
+        const qint32 first = outputOffsets[state];
+        const qint32 last = outputOffsets[state + 1];
+        if (first == last) {
+            continue;
+        }
+
+        m_state = state;
+        for (qint32 output = first; output < last; ++output) {
+            TriggerMatch match;
+            match.ruleIndex = m_outputs.at(output);
+            match.endInChunk = i + 1;
+            callback(match);
+        }
+    }
+
+    m_state = state;
+}
+
+bool TriggerEngine::parseRules(const QString &text, QList<TriggerRule> &rules, QString *errorString)
+{
+    QStringList errors;
+    QList<TriggerRule> parsed;
+    const QStringList lines = text.split('\n');
+
+    for (int lineIndex = 0; lineIndex < lines.size(); ++lineIndex) {
+        const QString line = lines.at(lineIndex).trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        const qsizetype arrow = line.indexOf("=>");
+        const QString patternPart = (arrow < 0 ? line : line.left(arrow)).trimmed();
+        const QString actionPart = arrow < 0 ? QString("highlight") : line.mid(arrow + 2);
+
+        TriggerRule rule;
+        rule.source = line;
+
+        QString error;
+        if (patternPart.startsWith("hex:", Qt::CaseInsensitive)) {
+            decodePattern(patternPart.mid(4), true, rule.pattern, &error);
+        } else if (patternPart.startsWith("text:", Qt::CaseInsensitive)) {
+            decodePattern(patternPart.mid(5), false, rule.pattern, &error);
+        } else {
+            decodePattern(patternPart, false, rule.pattern, &error);
+        }
+
+        if (error.isEmpty()) {
+            parseActions(actionPart, rule, &error);
+        }
+
+        if (!error.isEmpty()) {
+            errors.append(QString("Line %1: %2").arg(lineIndex + 1).arg(error));
+            continue;
+        }
+
+        parsed.append(rule);
+    }
+
+    rules = parsed;
+    if (errorString != nullptr) {
+        *errorString = errors.join('\n');
+    }
+    return errors.isEmpty();
+}
@@ -0,0 +1,727 @@
+#include "TxEncoder.h"
+
+#include "Crc.h"
+
+#include <QChar>
+
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TX_ENCODER_SSE2 1
+#endif
+
+namespace
+{
+constexpr qsizetype kUtf16Block = 4096;
+
+constexpr std::array<qint8, 256> makeHexTable()
+{
+    std::array<qint8, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        table[i] = -1;
+    }
+    for (int i = 0; i < 10; ++i) {
+        table['0' + i] = static_cast<qint8>(i);
+    }
+    for (int i = 0; i < 6; ++i) {
+        table['a' + i] = static_cast<qint8>(10 + i);
+        table['A' + i] = static_cast<qint8>(10 + i);
+    }
+    return table;
+}
+
+constexpr std::array<qint8, 256> kHexValue = makeHexTable();
+
+inline char32_t unit(char ch)
+{
+    return static_cast<uchar>(ch);
+}
+
+inline char32_t unit(char16_t ch)
+{
+    return ch;
+}
+
+inline int hexValue(char32_t ch)
+{
+    return ch < 256 ? kHexValue[ch] : -1;
+}
+
+inline bool isHexSeparator(char32_t ch)
+{
+    switch (ch) {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+    case '\v':
+    case '\f':
+    case ',':
+    case ':':
+        return true;
+    default:
+        return ch >= 0x80 && QChar::isSpace(ch);
+    }
+}
+
+void appendUtf8(QByteArray &out, char32_t codePoint)
+{
+    if (codePoint < 0x80) {
+        out.append(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out.append(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.append(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.append(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.append(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+#ifdef TX_ENCODER_SSE2
+inline __m128i load16(const char *data)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+// Anything outside 0..0x7FFF saturates to 0 or 0xFF, neither of which is a hex digit.
+inline __m128i load16(const char16_t *data)
+{
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 8));
+    return _mm_packus_epi16(low, high);
+}
+
+// Sixteen hex digits to eight bytes. Returns false, writing nothing, if any
+// of the characters is not a hex digit.
+inline bool decodeHex16(__m128i chars, char *out)
+{
+    const __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                          _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                          _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF) {
+        return false;
+    }
+
+    const __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                                         _mm_and_si128(isAlpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    // Even characters are the high nibble and sit in the low byte of each 16-bit lane.
+    const __m128i high = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4);
+    const __m128i low = _mm_srli_epi16(nibbles, 8);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out),
+                     _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128()));
+    return true;
+}
+#endif
+} // namespace
+
+TxEncoder::TxEncoder()
+{
+    reset(TxEncodeOptions());
+}
+
+TxEncoder::TxEncoder(const TxEncodeOptions &options)
+{
+    reset(options);
+}
+
+void TxEncoder::reset(const TxEncodeOptions &options)
+{
+    m_options = options;
+    m_state = State::Normal;
+    m_output.clear();
+    m_token.clear();
+    m_position = 0;
+    m_tokenPosition = -1;
+    m_pendingNibble = -1;
+    m_nibblePosition = -1;
+    m_highSurrogate = 0;
+    m_lenOffset = -1;
+    m_lenPosition = -1;
+    m_crcFolded = 0;
+    m_crcModbus = kCrc16ModbusInit;
+    m_crcXmodem = kCrc16XmodemInit;
+    m_finished = false;
+    m_errorPosition = -1;
+    m_errorString.clear();
+}
+
+const TxEncodeOptions &TxEncoder::options() const
+{
+    return m_options;
+}
+
+bool TxEncoder::feed(QStringView text)
+{
+    return feedChars(text.utf16(), text.size());
+}
+
+bool TxEncoder::feed(QByteArrayView utf8)
+{
+    return feedChars(utf8.data(), utf8.size());
+}
+
+template <typename Char>
+bool TxEncoder::feedChars(const Char *data, qsizetype size)
+{
+    if (hasError()) {
+        return false;
+    }
+    if (m_finished) {
+        return fail(m_position, "payload is already finished");
+    }
+
+    const qint64 start = m_position;
+    qsizetype i = 0;
+    if (m_options.format == TxFormat::Hex) {
+        m_output.reserve(m_output.size() + size / 2 + 8);
+        while (i < size) {
+            if (m_state == State::Normal && m_pendingNibble < 0) {
+                i += feedHexRun(data + i, size - i);
+                if (i >= size) {
+                    break;
+                }
+            }
+            if (!consumeHex(unit(data[i]), start + i)) {
+                return false;
+            }
+            ++i;
+        }
+    } else {
+        m_output.reserve(m_output.size() + std::min(size, kUtf16Block * 64) + 8);
+        while (i < size) {
+            if (m_state == State::Normal && m_highSurrogate == 0) {
+                i += feedTextRun(data + i, size - i);
+                if (i >= size) {
+                    break;
+                }
+            }
+            if (!consumeText(unit(data[i]), start + i)) {
+                return false;
+            }
+            ++i;
+        }
+    }
+
+    m_position = start + size;
+    // Nothing after an open {len} can be released, so stop before buffering a whole file.
+    if (m_lenOffset >= 0 && m_output.size() - m_lenOffset - 1 > kMaxLenSpan) {
+        return fail(m_lenPosition, QString("{len} covers more than %1 bytes").arg(kMaxLenSpan));
+    }
+    return true;
+}
+
+// Decodes the longest prefix that is hex pairs and plain separators, which is
+// nearly all of a pasted dump. Called only with no nibble or token pending.
+template <typename Char>
+qsizetype TxEncoder::feedHexRun(const Char *data, qsizetype size)
+{
+    const qsizetype base = m_output.size();
+    m_output.resize(base + size / 2);
+    char *out = m_output.data() + base;
+
+    qsizetype i = 0;
+#ifdef TX_ENCODER_SSE2
+    // Spaced dumps never fill a whole vector; after a miss go scalar for a while.
+    qsizetype vectorRetry = 0;
+#endif
+    while (i + 1 < size) {
+#ifdef TX_ENCODER_SSE2
+        if (i >= vectorRetry && i + 16 <= size) {
+            if (decodeHex16(load16(data + i), out)) {
+                i += 16;
+                out += 8;
+                continue;
+            }
+            vectorRetry = i + 16;
+        }
+#endif
+        const char32_t ch = unit(data[i]);
+        if (ch == ' ' || ch == ',' || ch == ':') {
+            ++i;
+            continue;
+        }
+        const int high = hexValue(ch);
+        const int low = hexValue(unit(data[i + 1]));
+        if ((high | low) < 0) {
+            break;
+        }
+        *out++ = static_cast<char>((high << 4) | low);
+        i += 2;
+    }
+
+    m_output.resize(out - m_output.constData());
+    return i;
+}
+
+// Copies characters that need no escape or placeholder handling, converting
+// UTF-16 to UTF-8 on the way. Surrogates are left to consumeText().
+template <typename Char>
+qsizetype TxEncoder::feedTextRun(const Char *data, qsizetype size)
+{
+    const bool escaped = m_options.format == TxFormat::Escaped;
+
+    if constexpr (sizeof(Char) == 1) {
+        if (!escaped) {
+            m_output.append(data, size);
+            return size;
+        }
+        qsizetype i = 0;
+        while (i < size && data[i] != '\\' && data[i] != '{') {
+            ++i;
+        }
+        m_output.append(data, i);
+        return i;
+    } else {
+        qsizetype i = 0;
+        while (i < size) {
+            const qsizetype block = std::min(size - i, kUtf16Block);
+            const qsizetype base = m_output.size();
+            m_output.resize(base + block * 3);
+            char *out = m_output.data() + base;
+
+            qsizetype j = 0;
+            for (; j < block; ++j) {
+                const char16_t ch = data[i + j];
+                if (ch < 0x80) {
+                    if (escaped && (ch == '\\' || ch == '{')) {
+                        break;
+                    }
+                    *out++ = static_cast<char>(ch);
+                } else if (ch < 0x800) {
+                    *out++ = static_cast<char>(0xC0 | (ch >> 6));
+                    *out++ = static_cast<char>(0x80 | (ch & 0x3F));
+                } else if (QChar::isSurrogate(ch)) {
+                    break;
+                } else {
+                    *out++ = static_cast<char>(0xE0 | (ch >> 12));
+                    *out++ = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+                    *out++ = static_cast<char>(0x80 | (ch & 0x3F));
+                }
+            }
+
+            m_output.resize(out - m_output.constData());
+            i += j;
+            if (j < block) {
+                break;
+            }
+        }
+        return i;
+    }
+}
+
+bool TxEncoder::consumeHex(char32_t ch, qint64 position)
+{
+    if (m_state == State::Placeholder) {
+        return consumePlaceholder(ch);
+    }
+
+    const int value = hexValue(ch);
+    if (value >= 0) {
+        if (m_pendingNibble < 0) {
+            m_pendingNibble = value;
+            m_nibblePosition = position;
+        } else {
+            m_output.append(static_cast<char>((m_pendingNibble << 4) | value));
+            m_pendingNibble = -1;
+        }
+        return true;
+    }
+
+    // "0x" prefix: the '0' was taken as a nibble one character ago.
+    if ((ch == 'x' || ch == 'X') && m_pendingNibble == 0 && m_nibblePosition == position - 1) {
+        m_pendingNibble = -1;
+        return true;
+    }
+
+    if (ch == '{') {
+        if (m_pendingNibble >= 0) {
+            return fail(m_nibblePosition, "odd number of hex digits");
+        }
+        m_state = State::Placeholder;
+        m_token.clear();
+        m_tokenPosition = position;
+        return true;
+    }
+
+    if (isHexSeparator(ch)) {
+        return true;
+    }
+
+    return fail(position, QString("invalid hex character '%1'").arg(QChar(static_cast<char16_t>(ch))));
+}
+
+bool TxEncoder::consumeText(char32_t ch, qint64 position)
+{
+    if (m_highSurrogate != 0 && !QChar::isLowSurrogate(ch)) {
+        m_highSurrogate = 0;
+        appendUtf8(m_output, QChar::ReplacementCharacter);
+    }
+
+    switch (m_state) {
+    case State::Normal:
+        if (m_options.format == TxFormat::Escaped && (ch == '\\' || ch == '{')) {
+            m_state = ch == '\\' ? State::Escape : State::Placeholder;
+            m_token.clear();
+            m_tokenPosition = position;
+            return true;
+        }
+        appendCodeUnit(ch);
+        return true;
+
+    case State::Escape:
+        m_state = State::Normal;
+        switch (ch) {
+        case 'r':
+            m_output.append('\r');
+            return true;
+        case 'n':
+            m_output.append('\n');
+            return true;
+        case 't':
+            m_output.append('\t');
+            return true;
+        case '0':
+            m_output.append('\0');
+            return true;
+        case 'e':
+            m_output.append('\x1b');
+            return true;
+        case '\\':
+        case '{':
+        case '}':
+        case '"':
+        case '\'':
+            m_output.append(static_cast<char>(ch));
+            return true;
+        case 'x':
+            m_state = State::EscapeHex;
+            return true;
+        default:
+            return fail(m_tokenPosition, QString("unknown escape \\%1").arg(QChar(static_cast<char16_t>(ch))));
+        }
+
+    case State::EscapeHex: {
+        const int value = hexValue(ch);
+        if (value < 0) {
+            return fail(m_tokenPosition, "\\x needs two hex digits");
+        }
+        m_token.append(static_cast<char>(value));
+        if (m_token.size() == 2) {
+            m_output.append(static_cast<char>((m_token.at(0) << 4) | m_token.at(1)));
+            m_state = State::Normal;
+        }
+        return true;
+    }
+
+    case State::Placeholder:
+        return consumePlaceholder(ch);
+    }
+
+    return true;
+}
+
+bool TxEncoder::consumePlaceholder(char32_t ch)
+{
+    if (ch == '}') {
+        m_state = State::Normal;
+        return resolvePlaceholder(m_token, m_tokenPosition);
+    }
+
+    if (ch <= ' ' || ch > '~' || m_token.size() >= kMaxPlaceholderLength) {
+        return fail(m_tokenPosition, "unterminated placeholder");
+    }
+
+    m_token.append(static_cast<char>(ch));
+    return true;
+}
+
+bool TxEncoder::resolvePlaceholder(const QByteArray &name, qint64 position)
+{
+    const QByteArray key = name.toLower();
+
+    if (key == "len") {
+        if (m_lenOffset >= 0) {
+            return fail(position, "{len} is already open in this frame");
+        }
+        m_lenOffset = m_output.size();
+        m_lenPosition = position;
+        m_output.append('\0');
+        return true;
+    }
+
+    if (key == "crc16" || key == "crc16:modbus" || key == "crc16:xmodem") {
+        if (!closeLen()) {
+            return false;
+        }
+        foldCrc(m_output.size());
+        if (key == "crc16:xmodem") {
+            m_output.append(static_cast<char>(m_crcXmodem >> 8));
+            m_output.append(static_cast<char>(m_crcXmodem & 0xFF));
+        } else {
+            m_output.append(static_cast<char>(m_crcModbus & 0xFF));
+            m_output.append(static_cast<char>(m_crcModbus >> 8));
+        }
+        m_crcModbus = kCrc16ModbusInit;
+        m_crcXmodem = kCrc16XmodemInit;
+        m_crcFolded = m_output.size();
+        return true;
+    }
+
+    return fail(position, QString("unknown placeholder {%1}").arg(QString::fromLatin1(name)));
+}
+
+// Only reached with UTF-16 code units; UTF-8 input never leaves feedTextRun()
+// with a non-ASCII byte in the Normal state.
+void TxEncoder::appendCodeUnit(char32_t ch)
+{
+    if (m_highSurrogate != 0) {
+        const char16_t high = m_highSurrogate;
+        m_highSurrogate = 0;
+        appendUtf8(m_output, QChar::surrogateToUcs4(high, static_cast<char16_t>(ch)));
+        return;
+    }
+
+    if (QChar::isHighSurrogate(ch)) {
+        m_highSurrogate = static_cast<char16_t>(ch);
+        return;
+    }
+
+    appendUtf8(m_output, QChar::isLowSurrogate(ch) ? char32_t(QChar::ReplacementCharacter) : ch);
+}
+
+bool TxEncoder::closeLen()
+{
+    if (m_lenOffset < 0) {
+        return true;
+    }
+
+    const qsizetype span = m_output.size() - m_lenOffset - 1;
+    if (span > kMaxLenSpan) {
+        return fail(m_lenPosition, QString("{len} covers more than %1 bytes").arg(kMaxLenSpan));
+    }
+
+    m_output[m_lenOffset] = static_cast<char>(span);
+    m_lenOffset = -1;
+    return true;
+}
+
+void TxEncoder::foldCrc(qsizetype end)
+{
+    if (end <= m_crcFolded) {
+        return;
+    }
+
+    const char *data = m_output.constData() + m_crcFolded;
+    m_crcModbus = crc16Modbus(data, end - m_crcFolded, m_crcModbus);
+    m_crcXmodem = crc16Xmodem(data, end - m_crcFolded, m_crcXmodem);
+    m_crcFolded = end;
+}
+
+bool TxEncoder::fail(qint64 position, const QString &message)
+{
+    m_errorPosition = position;
+    m_errorString = QString("%1 at character %2").arg(message).arg(position + 1);
+    return false;
+}
+
+bool TxEncoder::finish()
+{
+    if (hasError()) {
+        return false;
+    }
+    if (m_finished) {
+        return true;
+    }
+
+    switch (m_state) {
+    case State::Escape:
+    case State::EscapeHex:
+        return fail(m_tokenPosition, "incomplete escape");
+    case State::Placeholder:
+        return fail(m_tokenPosition, "unterminated placeholder");
+    case State::Normal:
+        break;
+    }
+
+    if (m_pendingNibble >= 0) {
+        return fail(m_nibblePosition, "odd number of hex digits");
+    }
+
+    if (m_highSurrogate != 0) {
+        m_highSurrogate = 0;
+        appendUtf8(m_output, QChar::ReplacementCharacter);
+    }
+
+    if (!closeLen()) {
+        return false;
+    }
+
+    m_output.append(lineEndingBytes(m_options.lineEnding));
+    m_finished = true;
+    return true;
+}
+
+QByteArray TxEncoder::takeOutput()
+{
+    const qsizetype ready = m_lenOffset >= 0 ? m_lenOffset : m_output.size();
+    // A later {crc16} still needs these bytes in its running CRC.
+    if (m_options.format != TxFormat::Text && !m_finished) {
+        foldCrc(ready);
+    }
+
+    QByteArray bytes;
+    if (ready == m_output.size()) {
+        bytes.swap(m_output);
+    } else {
+        bytes = m_output.left(ready);
+        m_output.remove(0, ready);
+    }
+
+    m_crcFolded = std::max<qsizetype>(0, m_crcFolded - ready);
+    if (m_lenOffset >= 0) {
+        m_lenOffset -= ready;
+    }
+    return bytes;
+}
+
+qsizetype TxEncoder::outputSize() const
+{
+    return m_output.size();
+}
+
+qint64 TxEncoder::inputPosition() const
+{
+    return m_position;
+}
+
+bool TxEncoder::hasError() const
+{
+    return m_errorPosition >= 0;
+}
+
+qint64 TxEncoder::errorPosition() const
+{
+    return m_errorPosition;
+}
+
+QString TxEncoder::errorString() const
+{
+    return m_errorString;
+}
+
+bool TxEncoder::encode(QStringView text,
+                       const TxEncodeOptions &options,
+                       QByteArray &bytes,
+                       QString *errorString,
+                       qint64 *errorPosition)
+{
+    TxEncoder encoder(options);
+    if (!encoder.feed(text) || !encoder.finish()) {
+        if (errorString != nullptr) {
+            *errorString = encoder.errorString();
+        }
+        if (errorPosition != nullptr) {
+            *errorPosition = encoder.errorPosition();
+        }
+        return false;
+    }
+
+    bytes = encoder.takeOutput();
+    return true;
+}
+
+QByteArray TxEncoder::lineEndingBytes(TxLineEnding lineEnding)
+{
+    switch (lineEnding) {
+    case TxLineEnding::Lf:
+        return QByteArrayLiteral("\n");
+    case TxLineEnding::Cr:
+        return QByteArrayLiteral("\r");
+    case TxLineEnding::CrLf:
+        return QByteArrayLiteral("\r\n");
+    case TxLineEnding::None:
+        break;
+    }
+    return QByteArray();
+}
+
+QByteArray TxEncoder::unescape(QStringView text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    QByteArray result;
+    result.reserve(utf8.size());
+
+    for (qsizetype i = 0; i < utf8.size(); ++i) {
+        const char ch = utf8.at(i);
+        if (ch != '\\' || i + 1 >= utf8.size()) {
+            result.append(ch);
+            continue;
+        }
+
+        const char next = utf8.at(i + 1);
+        switch (next) {
+        case 'r':
+            result.append('\r');
+            break;
+        case 'n':
+            result.append('\n');
+            break;
+        case 't':
+            result.append('\t');
+            break;
+        case '0':
+            result.append('\0');
+            break;
+        case 'e':
+            result.append('\x1b');
+            break;
+        case '\\':
+        case '{':
+        case '}':
+        case '"':
+        case '\'':
+            result.append(next);
+            break;
+        case 'x': {
+            const int high = i + 2 < utf8.size() ? hexValue(unit(utf8.at(i + 2))) : -1;
+            const int low = i + 3 < utf8.size() ? hexValue(unit(utf8.at(i + 3))) : -1;
+            if ((high | low) < 0) {
+                result.append("\\x");
+                break;
+            }
+            result.append(static_cast<char>((high << 4) | low));
+            i += 2;
+            break;
+        }
+        default:
+            result.append(ch);
+            result.append(next);
+            break;
+        }
+        ++i;
+    }
+
+    return result;
+}
+
+bool TxEncoder::decodeHex(QStringView text, QByteArray &bytes, QString *errorString)
+{
+    const qsizetype brace = text.indexOf(u'{');
+    if (brace >= 0) {
+        if (errorString != nullptr) {
+            *errorString = QString("placeholders are not allowed here at character %1").arg(brace + 1);
+        }
+        return false;
+    }
+    return encode(text, {TxFormat::Hex}, bytes, errorString);
+}
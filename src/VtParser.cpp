@@ -0,0 +1,657 @@
+#include "VtParser.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "TerminalGrid.h"
+
+namespace
+{
+constexpr char32_t kReplacementCharacter = 0xFFFD;
+constexpr int kMaxParameterValue = 65535;
+
+bool isPrintableAscii(unsigned char byte)
+{
+    return byte >= 0x20 && byte < 0x7f;
+}
+
+quint32 rgbColor(const int *rgb)
+{
+    return kTerminalRgbColor | (static_cast<quint32>(std::min(rgb[0], 255)) << 16)
+           | (static_cast<quint32>(std::min(rgb[1], 255)) << 8) | static_cast<quint32>(std::min(rgb[2], 255));
+}
+} // namespace
+
+VtParser::VtParser(TerminalGrid &grid)
+    : m_grid(grid)
+{
+}
+
+void VtParser::setReplyCallback(ReplyCallback callback)
+{
+    m_replyCallback = std::move(callback);
+}
+
+void VtParser::reset()
+{
+    m_state = State::Ground;
+    clearSequence();
+    m_string.clear();
+    m_stringEscape = false;
+    m_title.clear();
+    m_codepoint = 0;
+    m_utf8Remaining = 0;
+}
+
+QString VtParser::title() const
+{
+    return m_title;
+}
+
+void VtParser::feed(const QByteArray &data)
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data.constData());
+    const qsizetype size = data.size();
+
+    for (qsizetype i = 0; i < size; ++i) {
+        const unsigned char byte = bytes[i];
+
+        if (m_state == State::Ground && m_utf8Remaining == 0 && isPrintableAscii(byte)) {
+            qsizetype end = i + 1;
+            while (end < size && isPrintableAscii(bytes[end])) {
+                ++end;
+            }
+            m_grid.printAscii(data.constData() + i, end - i);
+            i = end - 1;
+            continue;
+        }
+
+        // OSC/DCS/APC payloads run until BEL or ST (ESC \).
+        if (m_state == State::OscString || m_state == State::StringIgnore) {
+            if (m_stringEscape) {
+                m_stringEscape = false;
+                if (byte == '\\') {
+                    if (m_state == State::OscString) {
+                        dispatchOsc();
+                    }
+                    m_state = State::Ground;
+                    continue;
+                }
+                // Unterminated string: the ESC starts a new sequence.
+                m_state = State::Escape;
+                clearSequence();
+            } else if (byte == 0x07) {
+                if (m_state == State::OscString) {
+                    dispatchOsc();
+                }
+                m_state = State::Ground;
+                continue;
+            } else if (byte == 0x1b) {
+                m_stringEscape = true;
+                continue;
+            } else if (byte == 0x18 || byte == 0x1a) {
+                m_state = State::Ground;
+                continue;
+            } else {
+                if (m_state == State::OscString && m_string.size() < kMaxStringLength) {
+                    m_string.append(static_cast<char>(byte));
+                }
+                continue;
+            }
+        }
+
+        if (byte == 0x1b) {
+            flushIncompleteUtf8();
+            m_state = State::Escape;
+            clearSequence();
+            continue;
+        }
+
+        if (byte == 0x18 || byte == 0x1a) {
+            m_state = State::Ground;
+            continue;
+        }
+
+        // C0 controls act immediately, even in the middle of a sequence.
+        if (byte < 0x20) {
+            flushIncompleteUtf8();
+            execute(byte);
+            continue;
+        }
+
+        if (byte == 0x7f) {
+            continue;
+        }
+
+        switch (m_state) {
+        case State::Ground:
+            printUtf8(byte);
+            break;
+        case State::Escape:
+            if (byte == '[') {
+                m_state = State::Csi;
+            } else if (byte == ']') {
+                m_state = State::OscString;
+                m_string.clear();
+            } else if (byte == 'P' || byte == 'X' || byte == '^' || byte == '_') {
+                m_state = State::StringIgnore;
+            } else if (byte >= 0x20 && byte <= 0x2f) {
+                m_intermediate = static_cast<char>(byte);
+                m_state = State::EscapeIntermediate;
+            } else {
+                m_state = State::Ground;
+                dispatchEscape(byte);
+            }
+            break;
+        case State::EscapeIntermediate:
+            if (byte >= 0x20 && byte <= 0x2f) {
+                m_intermediate = static_cast<char>(byte);
+            } else {
+                m_state = State::Ground;
+                dispatchEscape(byte);
+            }
+            break;
+        case State::Csi:
+            if (byte >= '0' && byte <= '9') {
+                if (m_paramCount == 0) {
+                    m_paramCount = 1;
+                }
+                int &value = m_params[m_paramCount - 1];
+                value = std::min(value * 10 + (byte - '0'), kMaxParameterValue);
+            } else if (byte == ';' || byte == ':') {
+                // Sub-parameters (38:2::r:g:b) stay in m_params, marked so SGR can group them.
+                if (m_paramCount == 0) {
+                    m_paramCount = 1;
+                }
+                if (m_paramCount < kMaxParameters) {
+                    ++m_paramCount;
+                    if (byte == ':') {
+                        m_subParameters |= 1u << (m_paramCount - 1);
+                    }
+                }
+            } else if (byte >= '<' && byte <= '?') {
+                if (m_paramCount == 0 && m_privateMarker == 0) {
+                    m_privateMarker = static_cast<char>(byte);
+                } else {
+                    m_state = State::CsiIgnore;
+                }
+            } else if (byte >= 0x20 && byte <= 0x2f) {
+                m_intermediate = static_cast<char>(byte);
+            } else if (byte >= 0x40 && byte <= 0x7e) {
+                m_state = State::Ground;
+                dispatchCsi(byte);
+            } else {
+                m_state = State::CsiIgnore;
+            }
+            break;
+        case State::CsiIgnore:
+            if (byte >= 0x40 && byte <= 0x7e) {
+                m_state = State::Ground;
+            }
+            break;
+        case State::OscString:
+        case State::StringIgnore:
+            break;
+        }
+    }
+}
+
+void VtParser::clearSequence()
+{
+    std::fill(std::begin(m_params), std::end(m_params), 0);
+    m_paramCount = 0;
+    m_subParameters = 0;
+    m_privateMarker = 0;
+    m_intermediate = 0;
+    m_stringEscape = false;
+}
+
+int VtParser::param(int index, int defaultValue) const
+{
+    if (index >= m_paramCount || m_params[index] == 0) {
+        return defaultValue;
+    }
+    return m_params[index];
+}
+
+bool VtParser::isSubParameter(int index) const
+{
+    return index < m_paramCount && (m_subParameters & (1u << index)) != 0;
+}
+
+void VtParser::reply(const QByteArray &data)
+{
+    if (m_replyCallback) {
+        m_replyCallback(data);
+    }
+}
+
+void VtParser::execute(unsigned char byte)
+{
+    switch (byte) {
+    case 0x08:
+        m_grid.backspace();
+        break;
+    case 0x09:
+        m_grid.tab();
+        break;
+    case 0x0a:
+    case 0x0b:
+    case 0x0c:
+        m_grid.lineFeed();
+        break;
+    case 0x0d:
+        m_grid.carriageReturn();
+        break;
+    case 0x0e:
+        m_grid.selectCharset(1);
+        break;
+    case 0x0f:
+        m_grid.selectCharset(0);
+        break;
+    default:
+        break;
+    }
+}
+
+void VtParser::printUtf8(unsigned char byte)
+{
+    if (m_utf8Remaining > 0) {
+        if ((byte & 0xc0) == 0x80) {
+            m_codepoint = (m_codepoint << 6) | (byte & 0x3f);
+            if (--m_utf8Remaining == 0) {
+                m_grid.print(m_codepoint);
+            }
+            return;
+        }
+        flushIncompleteUtf8();
+    }
+
+    if (byte < 0x80) {
+        m_grid.print(byte);
+    } else if (byte >= 0xc2 && byte <= 0xdf) {
+        m_codepoint = byte & 0x1f;
+        m_utf8Remaining = 1;
+    } else if (byte >= 0xe0 && byte <= 0xef) {
+        m_codepoint = byte & 0x0f;
+        m_utf8Remaining = 2;
+    } else if (byte >= 0xf0 && byte <= 0xf4) {
+        m_codepoint = byte & 0x07;
+        m_utf8Remaining = 3;
+    } else {
+        m_grid.print(kReplacementCharacter);
+    }
+}
+
+void VtParser::flushIncompleteUtf8()
+{
+    if (m_utf8Remaining > 0) {
+        m_utf8Remaining = 0;
+        m_grid.print(kReplacementCharacter);
+    }
+}
+
+void VtParser::dispatchEscape(unsigned char final)
+{
+    if (m_intermediate == '(' || m_intermediate == ')') {
+        // G0/G1 live in the grid so DECSC/DECRC carry them with the cursor.
+        m_grid.designateCharset(m_intermediate == '(' ? 0 : 1, final == '0');
+        return;
+    }
+
+    if (m_intermediate == '#') {
+        if (final == '8') {
+            m_grid.fillWithE();
+        }
+        return;
+    }
+
+    if (m_intermediate != 0) {
+        return;
+    }
+
+    switch (final) {
+    case '7':
+        m_grid.saveCursor();
+        break;
+    case '8':
+        m_grid.restoreCursor();
+        break;
+    case 'D':
+        m_grid.lineFeed();
+        break;
+    case 'E':
+        m_grid.carriageReturn();
+        m_grid.lineFeed();
+        break;
+    case 'H':
+        m_grid.setTabStop();
+        break;
+    case 'M':
+        m_grid.reverseLineFeed();
+        break;
+    case 'c':
+        m_grid.reset();
+        reset();
+        break;
+    default:
+        break;
+    }
+}
+
+void VtParser::dispatchCsi(unsigned char final)
+{
+    if (m_privateMarker == '?') {
+        if (final == 'h' || final == 'l') {
+            dispatchPrivateMode(final == 'h');
+        } else if (final == 'J') {
+            m_grid.eraseInDisplay(param(0, 0));
+        } else if (final == 'K') {
+            m_grid.eraseInLine(param(0, 0));
+        }
+        return;
+    }
+
+    if (m_privateMarker == '>') {
+        if (final == 'c') {
+            reply("\x1b[>0;10;1c");
+        }
+        return;
+    }
+
+    if (m_privateMarker != 0 || m_intermediate != 0) {
+        return;
+    }
+
+    const int count = param(0, 1);
+    switch (final) {
+    case '@':
+        m_grid.insertCharacters(count);
+        break;
+    case 'A':
+        m_grid.moveCursorBy(-count, 0);
+        break;
+    case 'B':
+    case 'e':
+        m_grid.moveCursorBy(count, 0);
+        break;
+    case 'C':
+    case 'a':
+        m_grid.moveCursorBy(0, count);
+        break;
+    case 'D':
+        m_grid.moveCursorBy(0, -count);
+        break;
+    case 'E':
+        m_grid.moveCursorBy(count, 0);
+        m_grid.setCursorColumn(0);
+        break;
+    case 'F':
+        m_grid.moveCursorBy(-count, 0);
+        m_grid.setCursorColumn(0);
+        break;
+    case 'G':
+    case '`':
+        m_grid.setCursorColumn(count - 1);
+        break;
+    case 'H':
+    case 'f':
+        m_grid.moveCursorTo(param(0, 1) - 1, param(1, 1) - 1);
+        break;
+    case 'I':
+        m_grid.tab(count);
+        break;
+    case 'J':
+        m_grid.eraseInDisplay(param(0, 0));
+        break;
+    case 'K':
+        m_grid.eraseInLine(param(0, 0));
+        break;
+    case 'L':
+        m_grid.insertLines(count);
+        break;
+    case 'M':
+        m_grid.deleteLines(count);
+        break;
+    case 'P':
+        m_grid.deleteCharacters(count);
+        break;
+    case 'S':
+        m_grid.scrollUp(count);
+        break;
+    case 'T':
+        if (m_paramCount <= 1) {
+            m_grid.scrollDown(count);
+        }
+        break;
+    case 'X':
+        m_grid.eraseCharacters(count);
+        break;
+    case 'Z':
+        m_grid.backTab(count);
+        break;
+    case 'b':
+        m_grid.repeatLastCharacter(count);
+        break;
+    case 'c':
+        if (param(0, 0) == 0) {
+            reply("\x1b[?1;2c");
+        }
+        break;
+    case 'd':
+        m_grid.setCursorRow(count - 1);
+        break;
+    case 'g':
+        if (param(0, 0) == 0) {
+            m_grid.clearTabStop(false);
+        } else if (param(0, 0) == 3) {
+            m_grid.clearTabStop(true);
+        }
+        break;
+    case 'h':
+    case 'l':
+        for (int i = 0; i < m_paramCount; ++i) {
+            if (m_params[i] == 4) {
+                m_grid.setInsertMode(final == 'h');
+            }
+        }
+        break;
+    case 'm':
+        selectGraphicRendition();
+        break;
+    case 'n':
+        if (param(0, 0) == 5) {
+            reply("\x1b[0n");
+        } else if (param(0, 0) == 6) {
+            reply(QByteArray("\x1b[") + QByteArray::number(m_grid.cursorRow() + 1) + ';'
+                  + QByteArray::number(m_grid.cursorColumn() + 1) + 'R');
+        }
+        break;
+    case 'r':
+        m_grid.setScrollRegion(param(0, 1) - 1, param(1, 0) - 1);
+        break;
+    case 's':
+        m_grid.saveCursor();
+        break;
+    case 'u':
+        m_grid.restoreCursor();
+        break;
+    default:
+        break;
+    }
+}
+
+void VtParser::dispatchPrivateMode(bool enabled)
+{
+    for (int i = 0; i < m_paramCount; ++i) {
+        switch (m_params[i]) {
+        case 1:
+            m_grid.setApplicationCursorKeys(enabled);
+            break;
+        case 6:
+            m_grid.setOriginMode(enabled);
+            break;
+        case 7:
+            m_grid.setAutoWrap(enabled);
+            break;
+        case 25:
+            m_grid.setCursorVisible(enabled);
+            break;
+        case 47:
+        case 1047:
+            m_grid.setAlternateScreen(enabled, false);
+            break;
+        case 1048:
+            if (enabled) {
+                m_grid.saveCursor();
+            } else {
+                m_grid.restoreCursor();
+            }
+            break;
+        case 1049:
+            m_grid.setAlternateScreen(enabled, true);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void VtParser::dispatchOsc()
+{
+    const qsizetype separator = m_string.indexOf(';');
+    if (separator < 0) {
+        return;
+    }
+
+    const QByteArray code = m_string.left(separator);
+    if (code == "0" || code == "2") {
+        m_title = QString::fromUtf8(m_string.mid(separator + 1));
+    }
+}
+
+void VtParser::selectGraphicRendition()
+{
+    TerminalCell &pen = m_grid.pen();
+    const int paramCount = std::max(m_paramCount, 1);
+
+    for (int i = 0; i < paramCount; ++i) {
+        const int code = m_params[i];
+
+        if ((code == 38 || code == 48) && isSubParameter(i + 1)) {
+            // ITU T.416 form: 38:5:n or 38:2:<colour space>:r:g:b, the colour
+            // space often left empty or dropped altogether.
+            int end = i + 1;
+            while (isSubParameter(end)) {
+                ++end;
+            }
+            const int *group = m_params + i + 1;
+            const int groupSize = end - i - 1;
+            if (group[0] == 5 && groupSize >= 2) {
+                (code == 38 ? pen.fg : pen.bg) = static_cast<quint32>(std::min(group[1], 255));
+            } else if (group[0] == 2 && groupSize >= 4) {
+                (code == 38 ? pen.fg : pen.bg) = rgbColor(group + (groupSize >= 5 ? 2 : 1));
+            }
+            i = end - 1;
+            continue;
+        }
+
+        if (code == 38 || code == 48) {
+            quint32 color = kTerminalDefaultColor;
+            if (i + 2 < m_paramCount && m_params[i + 1] == 5) {
+                color = static_cast<quint32>(std::min(m_params[i + 2], 255));
+                i += 2;
+            } else if (i + 4 < m_paramCount && m_params[i + 1] == 2) {
+                color = rgbColor(m_params + i + 2);
+                i += 4;
+            } else {
+                return;
+            }
+            (code == 38 ? pen.fg : pen.bg) = color;
+            continue;
+        }
+
+        // The only other sub-parameter in use is the underline style, where
+        // 4:0 means off; the rest are skipped.
+        const int subParameter = isSubParameter(i + 1) ? m_params[i + 1] : -1;
+        while (isSubParameter(i + 1)) {
+            ++i;
+        }
+        if (code == 4 && subParameter == 0) {
+            pen.attrs &= ~TerminalUnderline;
+            continue;
+        }
+
+        switch (code) {
+        case 0:
+            pen.fg = kTerminalDefaultColor;
+            pen.bg = kTerminalDefaultColor;
+            pen.attrs = 0;
+            break;
+        case 1:
+            pen.attrs |= TerminalBold;
+            break;
+        case 2:
+            pen.attrs |= TerminalDim;
+            break;
+        case 3:
+            pen.attrs |= TerminalItalic;
+            break;
+        case 4:
+        case 21:
+            pen.attrs |= TerminalUnderline;
+            break;
+        case 5:
+        case 6:
+            pen.attrs |= TerminalBlink;
+            break;
+        case 7:
+            pen.attrs |= TerminalInverse;
+            break;
+        case 8:
+            pen.attrs |= TerminalHidden;
+            break;
+        case 9:
+            pen.attrs |= TerminalStrike;
+            break;
+        case 22:
+            pen.attrs &= ~(TerminalBold | TerminalDim);
+            break;
+        case 23:
+            pen.attrs &= ~TerminalItalic;
+            break;
+        case 24:
+            pen.attrs &= ~TerminalUnderline;
+            break;
+        case 25:
+            pen.attrs &= ~TerminalBlink;
+            break;
+        case 27:
+            pen.attrs &= ~TerminalInverse;
+            break;
+        case 28:
+            pen.attrs &= ~TerminalHidden;
+            break;
+        case 29:
+            pen.attrs &= ~TerminalStrike;
+            break;
+        case 39:
+            pen.fg = kTerminalDefaultColor;
+            break;
+        case 49:
+            pen.bg = kTerminalDefaultColor;
+            break;
+        default:
+            if (code >= 30 && code <= 37) {
+                pen.fg = code - 30;
+            } else if (code >= 40 && code <= 47) {
+                pen.bg = code - 40;
+            } else if (code >= 90 && code <= 97) {
+                pen.fg = code - 90 + 8;
+            } else if (code >= 100 && code <= 107) {
+                pen.bg = code - 100 + 8;
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#include <QtEndian>
+#include <QtTest/QtTest>
+
+#include "CaptureArchive.h"
+
+namespace
+{
+constexpr int kBlockSize = 4 * 1024;
+constexpr int kIndexEntrySize = 24;
+constexpr int kTrailerSize = 24;
+
+// Offset of the rawSize field of the given block's index entry.
+qint64 rawSizeOffset(const QByteArray &archive, int block)
+{
+    const qint64 indexOffset = qFromLittleEndian<quint64>(archive.constData() + archive.size() - kTrailerSize);
+    return indexOffset + static_cast<qint64>(block) * kIndexEntrySize + 20;
+}
+} // namespace
+
+// Archives come from disk and may be damaged or crafted; the reader must
+// refuse them before inflating anything.
+class TestArchive : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir m_directory;
+    QByteArray m_raw;
+    QByteArray m_archive;
+
+    QString writeArchive(const QByteArray &bytes);
+
+private slots:
+    void initTestCase();
+    void roundTrips();
+    void rejectsOversizedBlock();
+    void rejectsEmptyBlock();
+    void rejectsBadBlockSize();
+    void rejectsMismatchedCompressedSize();
+};
+
+QString TestArchive::writeArchive(const QByteArray &bytes)
+{
+    const QString path = m_directory.filePath("damaged.dsca");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(bytes) != bytes.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void TestArchive::initTestCase()
+{
+    for (int i = 0; i < 3 * kBlockSize + 100; ++i) {
+        m_raw.append(static_cast<char>(i * 7));
+    }
+
+    const QString rawPath = m_directory.filePath("raw.bin");
+    QFile raw(rawPath);
+    QVERIFY(raw.open(QIODevice::WriteOnly));
+    QCOMPARE(raw.write(m_raw), m_raw.size());
+    raw.close();
+
+    const QString archivePath = m_directory.filePath("raw.dsca");
+    QVERIFY(packCaptureArchive(rawPath, archivePath, nullptr, kBlockSize));
+    QFile archive(archivePath);
+    QVERIFY(archive.open(QIODevice::ReadOnly));
+    m_archive = archive.readAll();
+}
+
+void TestArchive::roundTrips()
+{
+    CaptureArchiveReader reader;
+    QVERIFY(reader.open(writeArchive(m_archive)));
+    QCOMPARE(reader.blockCount(), 4);
+    QCOMPARE(reader.read(0, m_raw.size()), m_raw);
+}
+
+void TestArchive::rejectsOversizedBlock()
+{
+    QByteArray damaged = m_archive;
+    qToLittleEndian<quint32>(0x7fffffff, damaged.data() + rawSizeOffset(damaged, 1));
+
+    CaptureArchiveReader reader;
+    QVERIFY(!reader.open(writeArchive(damaged)));
+    QCOMPARE(reader.errorString(), QString("Corrupt archive block 1"));
+
+    CaptureArchiveDevice device;
+    QVERIFY(!device.openArchive(writeArchive(damaged)));
+    QCOMPARE(device.errorString(), QString("Corrupt archive block 1"));
+}
+
+void TestArchive::rejectsEmptyBlock()
+{
+    QByteArray damaged = m_archive;
+    qToLittleEndian<quint32>(0, damaged.data() + rawSizeOffset(damaged, 3));
+
+    CaptureArchiveReader reader;
+    QVERIFY(!reader.open(writeArchive(damaged)));
+    QCOMPARE(reader.errorString(), QString("Corrupt archive block 3"));
+}
+
+void TestArchive::rejectsBadBlockSize()
+{
+    QByteArray damaged = m_archive;
+    qToLittleEndian<quint32>(0xffffffffu, damaged.data() + 8);
+
+    CaptureArchiveReader reader;
+    QVERIFY(!reader.open(writeArchive(damaged)));
+    QVERIFY(reader.errorString().startsWith("Corrupt archive"));
+}
+
+void TestArchive::rejectsMismatchedCompressedSize()
+{
+    // The index is fine, but the size qUncompress would trust is not.
+    QByteArray damaged = m_archive;
+    const qint64 entry = rawSizeOffset(damaged, 0) - 20;
+    const qint64 fileOffset = qFromLittleEndian<quint64>(damaged.constData() + entry);
+    qToBigEndian<quint32>(0x7fffffff, damaged.data() + fileOffset);
+
+    CaptureArchiveReader reader;
+    QVERIFY(reader.open(writeArchive(damaged)));
+    QVERIFY(reader.readBlock(0).isEmpty());
+    QCOMPARE(reader.readBlock(1), m_raw.mid(kBlockSize, kBlockSize));
+}
+
+QTEST_GUILESS_MAIN(TestArchive)
+#include "tst_archive.moc"
@@ -0,0 +1,130 @@
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtTest/QtTest>
+
+#include <memory>
+
+#include "SerialManager.h"
+
+namespace
+{
+quint16 freeTcpPort()
+{
+    QTcpServer server;
+    return server.listen(QHostAddress::LocalHost, 0) ? server.serverPort() : 0;
+}
+
+std::unique_ptr<QTcpSocket> connectTo(quint16 port)
+{
+    auto socket = std::make_unique<QTcpSocket>();
+    socket->connectToHost(QHostAddress::LocalHost, port);
+    return socket->waitForConnected(2000) ? std::move(socket) : nullptr;
+}
+} // namespace
+
+// The bridge over a loopback port: whatever a client sends goes out on the
+// port, comes back as RX and is forwarded to every client.
+class TestBridge : public QObject
+{
+    Q_OBJECT
+
+private:
+    std::unique_ptr<SerialManager> m_serial;
+    std::unique_ptr<QTcpSocket> m_client;
+    std::unique_ptr<QTcpSocket> m_observer;
+    QByteArray m_bridgeTransmitted;
+    int m_clients = 0;
+    int m_observers = 0;
+
+private slots:
+    void init();
+    void cleanup();
+    void clientWritesReachPortAndEveryoneSeesRx();
+    void observerWritesAreDropped();
+    void disconnectedClientsAreCounted();
+};
+
+void TestBridge::init()
+{
+    m_serial = std::make_unique<SerialManager>();
+    m_bridgeTransmitted.clear();
+    m_clients = 0;
+    m_observers = 0;
+    m_serial->setBridgeTransmitCallback([this](const QByteArray &data, qint64 written, qint64) {
+        if (written > 0) {
+            m_bridgeTransmitted.append(data.left(written));
+        }
+    });
+    m_serial->setBridgeClientsChangedCallback([this](int clients, int observers) {
+        m_clients = clients;
+        m_observers = observers;
+    });
+
+    SerialConfig config;
+    config.mode = SerialMode::Loopback;
+    QVERIFY(m_serial->connectPort(config));
+
+    BridgeConfig bridge;
+    bridge.tcpPort = freeTcpPort();
+    bridge.observerTcpPort = freeTcpPort();
+    QVERIFY(bridge.tcpPort != 0 && bridge.observerTcpPort != 0);
+    QVERIFY(m_serial->startBridge(bridge));
+
+    m_client = connectTo(bridge.tcpPort);
+    m_observer = connectTo(bridge.observerTcpPort);
+    QVERIFY(m_client != nullptr && m_observer != nullptr);
+    QTRY_COMPARE(m_clients, 1);
+    QTRY_COMPARE(m_observers, 1);
+}
+
+void TestBridge::cleanup()
+{
+    m_client.reset();
+    m_observer.reset();
+    m_serial.reset();
+}
+
+void TestBridge::clientWritesReachPortAndEveryoneSeesRx()
+{
+    const QByteArray command = "read temp\r\n";
+    m_client->write(command);
+
+    QByteArray clientRx;
+    QByteArray observerRx;
+    QTRY_VERIFY((clientRx += m_client->readAll()).size() >= command.size()
+                && (observerRx += m_observer->readAll()).size() >= command.size());
+    QCOMPARE(clientRx, command);
+    QCOMPARE(observerRx, command);
+    QCOMPARE(m_bridgeTransmitted, command);
+}
+
+void TestBridge::observerWritesAreDropped()
+{
+    m_observer->write("reboot\r\n");
+    m_observer->flush();
+    // Once the control client's marker is echoed back, the observer's bytes
+    // would have gone out too.
+    m_client->write("marker\n");
+
+    QByteArray clientRx;
+    QTRY_VERIFY((clientRx += m_client->readAll()).contains("marker\n"));
+    // The two sockets aren't ordered against each other; give a late one time to land.
+    QTest::qWait(50);
+    clientRx += m_client->readAll();
+    QCOMPARE(clientRx, QByteArray("marker\n"));
+    QCOMPARE(m_bridgeTransmitted, QByteArray("marker\n"));
+}
+
+void TestBridge::disconnectedClientsAreCounted()
+{
+    m_observer->disconnectFromHost();
+    QTRY_COMPARE(m_observers, 0);
+    QCOMPARE(m_clients, 1);
+
+    m_serial->stopBridge();
+    QTRY_COMPARE(m_clients, 0);
+    QVERIFY(!m_serial->isBridgeActive());
+}
+
+QTEST_GUILESS_MAIN(TestBridge)
+#include "tst_bridge.moc"
@@ -0,0 +1,196 @@
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtTest/QtTest>
+
+#include <algorithm>
+
+#include "LoopbackTransport.h"
+
+namespace
+{
+QByteArray testPattern(qsizetype size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    quint32 value = 12345;
+    for (qsizetype i = 0; i < size; ++i) {
+        value = value * 1103515245 + 12345;
+        data[i] = static_cast<char>(value >> 16);
+    }
+    return data;
+}
+
+// Writes data and collects every delivered fragment until all of it is back.
+QList<QByteArray> loop(const LoopbackConfig &config, const QByteArray &data, LoopbackTransport *used = nullptr)
+{
+    LoopbackTransport local;
+    LoopbackTransport &transport = used != nullptr ? *used : local;
+    QList<QByteArray> fragments;
+    qint64 delivered = 0;
+    transport.setDeliverCallback([&](const QByteArray &fragment, qint64) {
+        fragments.append(fragment);
+        delivered += fragment.size();
+    });
+
+    if (!transport.open(config) || transport.write(data) != data.size()) {
+        return {};
+    }
+    QTest::qWaitFor([&]() { return delivered >= data.size(); }, 5000);
+    transport.setDeliverCallback(nullptr);
+    return fragments;
+}
+
+int countBitDifferences(const QByteArray &a, const QByteArray &b)
+{
+    int bits = 0;
+    for (qsizetype i = 0; i < std::min(a.size(), b.size()); ++i) {
+        bits += qPopulationCount(static_cast<quint8>(a.at(i) ^ b.at(i)));
+    }
+    return bits;
+}
+} // namespace
+
+class TestLoopback : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanLoopIsLossless();
+    void sameSeedSameStream();
+    void differentSeedDifferentStream();
+    void bitErrorsAreCounted();
+    void pacingTakesWireTime();
+    void echoFromCallbackKeepsEventLoopRunning();
+    void closeDropsPending();
+};
+
+void TestLoopback::cleanLoopIsLossless()
+{
+    LoopbackConfig config;
+    config.maxFragmentBytes = 17;
+    config.seed = 7;
+
+    const QByteArray data = testPattern(64 * 1024);
+    LoopbackTransport transport;
+    const QList<QByteArray> fragments = loop(config, data, &transport);
+
+    QVERIFY(fragments.size() > 1);
+    QByteArray joined;
+    for (const QByteArray &fragment : fragments) {
+        QVERIFY(fragment.size() >= 1 && fragment.size() <= config.maxFragmentBytes);
+        joined.append(fragment);
+    }
+    QCOMPARE(joined, data);
+    QCOMPARE(transport.bytesWritten(), quint64(data.size()));
+    QCOMPARE(transport.bytesDelivered(), quint64(data.size()));
+    QCOMPARE(transport.bitsFlipped(), quint64(0));
+    QCOMPARE(transport.bytesPending(), qint64(0));
+}
+
+void TestLoopback::sameSeedSameStream()
+{
+    LoopbackConfig config;
+    config.maxFragmentBytes = 33;
+    config.bitErrorRate = 1e-3;
+    config.seed = 42;
+
+    const QByteArray data = testPattern(32 * 1024);
+    const QList<QByteArray> first = loop(config, data);
+    const QList<QByteArray> second = loop(config, data);
+    QVERIFY(!first.isEmpty());
+    QCOMPARE(first, second);
+}
+
+void TestLoopback::differentSeedDifferentStream()
+{
+    LoopbackConfig config;
+    config.maxFragmentBytes = 33;
+    config.bitErrorRate = 1e-3;
+    config.seed = 42;
+
+    const QByteArray data = testPattern(32 * 1024);
+    const QList<QByteArray> first = loop(config, data);
+    config.seed = 43;
+    const QList<QByteArray> second = loop(config, data);
+    QVERIFY(!first.isEmpty());
+    QVERIFY(first != second);
+}
+
+void TestLoopback::bitErrorsAreCounted()
+{
+    LoopbackConfig config;
+    config.bitErrorRate = 1e-3;
+    config.seed = 3;
+
+    const QByteArray data = testPattern(128 * 1024);
+    LoopbackTransport transport;
+    const QList<QByteArray> fragments = loop(config, data, &transport);
+    QCOMPARE(fragments.size(), 1);
+
+    // 1 Mbit at 1e-3: about a thousand flips; the exact count follows from the seed.
+    const int flipped = countBitDifferences(fragments.first(), data);
+    QCOMPARE(quint64(flipped), transport.bitsFlipped());
+    QVERIFY(flipped > 800 && flipped < 1200);
+}
+
+void TestLoopback::pacingTakesWireTime()
+{
+    LoopbackConfig config;
+    config.paceToBaud = true;
+    config.baudRate = 115200;
+    config.bitsPerCharacter = 10;
+    config.maxFragmentBytes = 64;
+
+    // 1152 bytes at 11520 characters per second is 100 ms on the wire.
+    const QByteArray data = testPattern(1152);
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const QList<QByteArray> fragments = loop(config, data);
+    QVERIFY(!fragments.isEmpty());
+    QVERIFY2(elapsed.elapsed() >= 95, qPrintable(QString("took %1 ms").arg(elapsed.elapsed())));
+}
+
+void TestLoopback::echoFromCallbackKeepsEventLoopRunning()
+{
+    // Every delivery writes straight back with no latency, so a new fragment can
+    // be due the same nanosecond it was queued. Delivery must still yield to the
+    // event loop instead of spinning on it.
+    LoopbackTransport transport;
+    qint64 echoes = 0;
+    transport.setDeliverCallback([&](const QByteArray &data, qint64) {
+        ++echoes;
+        transport.write(data);
+    });
+    QVERIFY(transport.open(LoopbackConfig()));
+    transport.write("x");
+
+    bool timerFired = false;
+    QTimer::singleShot(20, [&]() {
+        timerFired = true;
+    });
+    QVERIFY(QTest::qWaitFor([&]() { return timerFired; }, 2000));
+    QVERIFY(echoes > 0);
+    transport.close();
+}
+
+void TestLoopback::closeDropsPending()
+{
+    LoopbackConfig config;
+    config.latencyUs = 100000;
+
+    LoopbackTransport transport;
+    qint64 delivered = 0;
+    transport.setDeliverCallback([&](const QByteArray &data, qint64) {
+        delivered += data.size();
+    });
+    QVERIFY(transport.open(config));
+    QCOMPARE(transport.write(testPattern(100)), qint64(100));
+    QCOMPARE(transport.bytesPending(), qint64(100));
+    transport.close();
+    QCOMPARE(transport.bytesPending(), qint64(0));
+    QCOMPARE(transport.write("x"), qint64(-1));
+    QTest::qWait(150);
+    QCOMPARE(delivered, qint64(0));
+}
+
+QTEST_GUILESS_MAIN(TestLoopback)
+#include "tst_loopback.moc"
@@ -0,0 +1,139 @@
+#include <QtTest/QtTest>
+
+#include <memory>
+
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "SerialManager.h"
+
+namespace
+{
+// Reads from the pty master until `size` bytes arrived or the timeout ran out.
+QByteArray readMaster(int fd, qsizetype size, int timeoutMs)
+{
+    QByteArray data;
+    QDeadlineTimer deadline(timeoutMs);
+    while (data.size() < size && !deadline.hasExpired()) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 10) <= 0) {
+            // The reply is written from the I/O thread but this thread has to
+            // keep spinning for the owner-side callbacks.
+            QCoreApplication::processEvents();
+            continue;
+        }
+        char buffer[256];
+        const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            data.append(buffer, n);
+        }
+    }
+    return data;
+}
+} // namespace
+
+// The responder against a real tty: a frame written on the pty master goes
+// through the driver, the I/O thread answers it, and the reply comes back on
+// the master with its latency recorded.
+class TestResponder : public QObject
+{
+    Q_OBJECT
+
+private:
+    std::unique_ptr<SerialManager> m_serial;
+    int m_master = -1;
+    int m_replies = 0;
+    qint64 m_lastLatencyNs = -1;
+
+private slots:
+    void init();
+    void cleanup();
+    void framesAreAnsweredOverPty();
+    void unmatchedFramesGetNoReply();
+};
+
+void TestResponder::init()
+{
+    int slave = -1;
+    char slaveName[128] = {};
+    QVERIFY(::openpty(&m_master, &slave, slaveName, nullptr, nullptr) == 0);
+    // QSerialPort opens the slave by name; this end only has to keep it alive until then.
+    termios raw = {};
+    ::tcgetattr(slave, &raw);
+    ::cfmakeraw(&raw);
+    ::tcsetattr(slave, TCSANOW, &raw);
+
+    m_replies = 0;
+    m_lastLatencyNs = -1;
+    m_serial = std::make_unique<SerialManager>();
+    m_serial->setResponderCallback([this](const ResponderRule &, const QByteArray &, qint64 written, qint64 latencyNs, qint64) {
+        if (written > 0) {
+            ++m_replies;
+            m_lastLatencyNs = latencyNs;
+        }
+    });
+
+    SerialConfig config;
+    config.portName = QString::fromLocal8Bit(slaveName);
+    const bool opened = m_serial->connectPort(config);
+    ::close(slave);
+    QVERIFY(opened);
+
+    QList<ResponderRule> rules;
+    QString error;
+    QVERIFY2(Responder::parseRules("exact:PING => PONG\\n\nprefix:GET  => VAL 42\\n\n", rules, &error), qPrintable(error));
+    m_serial->runOnIoThread([this, rules]() {
+        m_serial->responder().setRules(rules);
+        m_serial->responder().setDelimiter("\n");
+        m_serial->responder().setEnabled(true);
+    });
+}
+
+void TestResponder::cleanup()
+{
+    m_serial.reset();
+    if (m_master >= 0) {
+        ::close(m_master);
+        m_master = -1;
+    }
+}
+
+void TestResponder::framesAreAnsweredOverPty()
+{
+    const QByteArray request = "PING\nGET temp\n";
+    QCOMPARE(::write(m_master, request.constData(), request.size()), ssize_t(request.size()));
+
+    const QByteArray expected = "PONG\nVAL 42\n";
+    QCOMPARE(readMaster(m_master, expected.size(), 2000), expected);
+    QTRY_COMPARE(m_replies, 2);
+    QVERIFY(m_lastLatencyNs >= 0);
+
+    quint64 latencySamples = 0;
+    quint64 answered = 0;
+    m_serial->runOnIoThread([this, &latencySamples, &answered]() {
+        latencySamples = m_serial->responder().latency().count();
+        answered = m_serial->responder().framesAnswered();
+    });
+    QCOMPARE(latencySamples, quint64(2));
+    QCOMPARE(answered, quint64(2));
+}
+
+void TestResponder::unmatchedFramesGetNoReply()
+{
+    const QByteArray request = "REBOOT\nPING\n";
+    QCOMPARE(::write(m_master, request.constData(), request.size()), ssize_t(request.size()));
+
+    QCOMPARE(readMaster(m_master, 5, 2000), QByteArray("PONG\n"));
+    QTRY_COMPARE(m_replies, 1);
+
+    quint64 seen = 0;
+    m_serial->runOnIoThread([this, &seen]() {
+        seen = m_serial->responder().framesSeen();
+    });
+    QCOMPARE(seen, quint64(2));
+}
+
+QTEST_GUILESS_MAIN(TestResponder)
+#include "tst_responder.moc"
@@ -0,0 +1,139 @@
+#include <QtTest/QtTest>
+
+#include "Responder.h"
+#include "TriggerEngine.h"
+#include "TxEncoder.h"
+
+// Rule text as it comes back from settings: patterns may hold a literal '{'
+// and escapes the decoder does not know, and one bad line must not cost the
+// others.
+class TestRules : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void unescapeKeepsBracesAndUnknownEscapes();
+    void hexPatternRejectsPlaceholders();
+    void triggerRulesLoadWithBracesAndUnknownEscapes();
+    void triggerBadLineSkipsOnlyThatRule();
+    void responderRulesLoadWithBracesAndUnknownEscapes();
+    void responderBadLineSkipsOnlyThatRule();
+};
+
+void TestRules::unescapeKeepsBracesAndUnknownEscapes()
+{
+    QCOMPARE(TxEncoder::unescape(u"{\"status\":\\r\\n"), QByteArray("{\"status\":\r\n"));
+    QCOMPARE(TxEncoder::unescape(u"{crc16}"), QByteArray("{crc16}"));
+    QCOMPARE(TxEncoder::unescape(u"a\\qb\\d"), QByteArray("a\\qb\\d"));
+    QCOMPARE(TxEncoder::unescape(u"\\x4"), QByteArray("\\x4"));
+    QCOMPARE(TxEncoder::unescape(u"\\x41\\\\\\{"), QByteArray("A\\{"));
+    QCOMPARE(TxEncoder::unescape(u"end\\"), QByteArray("end\\"));
+    QCOMPARE(TxEncoder::unescape(u"\u00e9"), QByteArray("\xc3\xa9"));
+}
+
+void TestRules::hexPatternRejectsPlaceholders()
+{
+    QByteArray bytes;
+    QVERIFY(TxEncoder::decodeHex(u"0x01 03, AA:55", bytes));
+    QCOMPARE(bytes, QByteArray("\x01\x03\xaa\x55", 4));
+
+    QString error;
+    QVERIFY(!TxEncoder::decodeHex(u"01 03 {crc16}", bytes, &error));
+    QVERIFY(error.contains("placeholders"));
+}
+
+void TestRules::triggerRulesLoadWithBracesAndUnknownEscapes()
+{
+    const QString saved = "text:{\"status\":\"fail\" => highlight, reply:ack\\r\\n\n"
+                          "text:C:\\temp\\q => notify\n"
+                          "hex:7B 22 => stop\n";
+    QList<TriggerRule> rules;
+    QString error;
+    QVERIFY2(TriggerEngine::parseRules(saved, rules, &error), qPrintable(error));
+    QCOMPARE(rules.size(), 3);
+    QCOMPARE(rules.at(0).pattern, QByteArray("{\"status\":\"fail\""));
+    QCOMPARE(rules.at(0).reply, QByteArray("ack\r\n"));
+    QCOMPARE(rules.at(1).pattern, QByteArray("C:\temp\\q"));
+    QCOMPARE(rules.at(2).pattern, QByteArray("{\""));
+
+    TriggerEngine engine;
+    engine.setRules(rules);
+    QList<int> matched;
+    engine.feed("log {\"status\":\"fail\"}", [&matched](const TriggerMatch &match) {
+        matched.append(match.ruleIndex);
+    });
+    QCOMPARE(matched, QList<int>({2, 0}));
+}
+
+void TestRules::triggerBadLineSkipsOnlyThatRule()
+{
+    const QString saved = "text:OK => highlight\n"
+                          "hex:01 {len} => stop\n"
+                          "text:BOOT => reply:{nope}\n"
+                          "text:ERR => explode\n"
+                          "text:FAIL => notify\n";
+    QList<TriggerRule> rules;
+    QString error;
+    QVERIFY(!TriggerEngine::parseRules(saved, rules, &error));
+    QCOMPARE(rules.size(), 2);
+    QCOMPARE(rules.at(0).pattern, QByteArray("OK"));
+    QCOMPARE(rules.at(1).pattern, QByteArray("FAIL"));
+
+    const QStringList errors = error.split('\n');
+    QCOMPARE(errors.size(), 3);
+    QVERIFY(errors.at(0).startsWith("Line 2:"));
+    QVERIFY(errors.at(1).startsWith("Line 3:"));
+    QVERIFY(errors.at(2).startsWith("Line 4:"));
+}
+
+void TestRules::responderRulesLoadWithBracesAndUnknownEscapes()
+{
+    const QString saved = "exact:{\"get\":\"temp\"} => {\"temp\":21}\\r\\n\n"
+                          "prefix:\\q{ => hex:06\n"
+                          "regex:^SET (?<key>\\w+)$ => OK ${key}\\r\\n\n";
+    QList<ResponderRule> rules;
+    QString error;
+    QVERIFY2(!Responder::parseRules(saved, rules, &error), "a raw '{' in a response is still a placeholder");
+    QCOMPARE(rules.size(), 2);
+    QVERIFY(error.startsWith("Line 1:"));
+
+    const QString fixed = QString(saved).replace("=> {\"temp\":21}", "=> \\{\"temp\":21\\}");
+    QVERIFY2(Responder::parseRules(fixed, rules, &error), qPrintable(error));
+    QCOMPARE(rules.size(), 3);
+    QCOMPARE(rules.at(0).match, QByteArray("{\"get\":\"temp\"}"));
+    QCOMPARE(rules.at(1).match, QByteArray("\\q{"));
+
+    Responder responder;
+    responder.setRules(rules);
+    QByteArray response;
+    QCOMPARE(responder.respond("{\"get\":\"temp\"}", response), 0);
+    QCOMPARE(response, QByteArray("{\"temp\":21}\r\n"));
+    QCOMPARE(responder.respond("\\q{xyz", response), 1);
+    QCOMPARE(response, QByteArray("\x06"));
+    QCOMPARE(responder.respond("SET mode", response), 2);
+    QCOMPARE(response, QByteArray("OK mode\r\n"));
+}
+
+void TestRules::responderBadLineSkipsOnlyThatRule()
+{
+    const QString saved = "exact:PING => PONG\n"
+                          "regex:([ => nope\n"
+                          "hex:AA {crc16} => bad\n"
+                          "exact:ID => DEV1\n";
+    QList<ResponderRule> rules;
+    QString error;
+    QVERIFY(!Responder::parseRules(saved, rules, &error));
+    QCOMPARE(rules.size(), 2);
+    QCOMPARE(error.split('\n').size(), 2);
+
+    Responder responder;
+    responder.setRules(rules);
+    QByteArray response;
+    QCOMPARE(responder.respond("PING", response), 0);
+    QCOMPARE(response, QByteArray("PONG"));
+    QCOMPARE(responder.respond("ID", response), 1);
+    QCOMPARE(response, QByteArray("DEV1"));
+}
+
+QTEST_GUILESS_MAIN(TestRules)
+#include "tst_rules.moc"
@@ -0,0 +1,139 @@
+#include <QtTest/QtTest>
+
+#include "SessionSpool.h"
+
+namespace
+{
+constexpr qsizetype kRecordBytes = 64 * 1024;
+
+CaptureRecord makeRecord(qint64 index)
+{
+    CaptureRecord record;
+    record.timestampNs = index * 1000;
+    record.direction = index % 2 == 0 ? CaptureDirection::Rx : CaptureDirection::Tx;
+    record.data = QByteArray(kRecordBytes, static_cast<char>(index));
+    return record;
+}
+
+// Every record read back must be the next one in sequence, ending at last.
+bool readsSequence(ExportSource &source, qint64 first, qint64 last)
+{
+    qint64 expected = first;
+    QList<CaptureRecord> batch;
+    while (source.readBatch(batch, 100)) {
+        for (const CaptureRecord &record : std::as_const(batch)) {
+            if (record.timestampNs != expected * 1000 || record.data != makeRecord(expected).data) {
+                return false;
+            }
+            ++expected;
+        }
+        batch.clear();
+    }
+    return source.errorString().isEmpty() && expected == last + 1;
+}
+} // namespace
+
+class TestSpool : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir m_directory;
+
+private slots:
+    void staysUnderTheCap();
+    void exportsAcrossSegments();
+    void snapshotJoinsSegments();
+    void closeRemovesFiles();
+};
+
+void TestSpool::staysUnderTheCap()
+{
+    SessionSpool spool;
+    spool.setDirectory(m_directory.path());
+    spool.setMaxBytes(SessionSpool::kMinMaxBytes);
+    QVERIFY(spool.open(42));
+
+    const qint64 total = 3 * SessionSpool::kMinMaxBytes / kRecordBytes;
+    for (qint64 i = 0; i < total; ++i) {
+        QVERIFY(spool.append(makeRecord(i)));
+        QVERIFY(spool.sizeOnDisk() <= spool.maxBytes() + spool.maxBytes() / SessionSpool::kSegmentsPerSpool);
+    }
+
+    QVERIFY(spool.droppedRecords() > 0);
+    QCOMPARE(spool.recordCount() + spool.droppedRecords(), total);
+    QVERIFY(spool.recordCount() * kRecordBytes >= spool.maxBytes() / 2);
+}
+
+void TestSpool::exportsAcrossSegments()
+{
+    SessionSpool spool;
+    spool.setDirectory(m_directory.path());
+    spool.setMaxBytes(SessionSpool::kMinMaxBytes);
+    QVERIFY(spool.open(42));
+
+    const qint64 total = 2 * SessionSpool::kMinMaxBytes / kRecordBytes;
+    for (qint64 i = 0; i < total; ++i) {
+        QVERIFY(spool.append(makeRecord(i)));
+    }
+
+    const qint64 first = spool.droppedRecords();
+    QVERIFY(first > 0);
+
+    QString error;
+    std::unique_ptr<ExportSource> source = spool.exportSource(&error);
+    QVERIFY2(source != nullptr, qPrintable(error));
+    QCOMPARE(source->wallClockOffsetNs(), qint64(42));
+
+    // Appends after the export started, and the segments they trim, don't
+    // change what the reader sees.
+    for (qint64 i = total; i < total + 200; ++i) {
+        QVERIFY(spool.append(makeRecord(i)));
+    }
+    QVERIFY(spool.droppedRecords() > first);
+    QVERIFY(readsSequence(*source, first, total - 1));
+}
+
+void TestSpool::snapshotJoinsSegments()
+{
+    SessionSpool spool;
+    spool.setDirectory(m_directory.path());
+    spool.setMaxBytes(SessionSpool::kMinMaxBytes);
+    QVERIFY(spool.open(7));
+
+    const qint64 total = 2 * SessionSpool::kMinMaxBytes / kRecordBytes;
+    for (qint64 i = 0; i < total; ++i) {
+        QVERIFY(spool.append(makeRecord(i)));
+    }
+    const qint64 first = spool.droppedRecords();
+
+    const QString path = m_directory.filePath("snapshot.dscap");
+    QFuture<bool> saved = spool.saveSnapshot(path);
+    saved.waitForFinished();
+    QVERIFY(saved.result());
+
+    QString error;
+    std::unique_ptr<ExportSource> source = ExportSource::fromCaptureFile(path, &error);
+    QVERIFY2(source != nullptr, qPrintable(error));
+    QCOMPARE(source->wallClockOffsetNs(), qint64(7));
+    QVERIFY(readsSequence(*source, first, total - 1));
+}
+
+void TestSpool::closeRemovesFiles()
+{
+    QTemporaryDir directory;
+    SessionSpool spool;
+    spool.setDirectory(directory.path());
+    spool.setMaxBytes(SessionSpool::kMinMaxBytes);
+    QVERIFY(spool.open(0));
+    for (qint64 i = 0; i < 100; ++i) {
+        QVERIFY(spool.append(makeRecord(i)));
+    }
+    QVERIFY(!QDir(directory.path()).isEmpty());
+
+    spool.close();
+    QVERIFY(QDir(directory.path()).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestSpool)
+#include "tst_spool.moc"
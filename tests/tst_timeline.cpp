@@ -0,0 +1,161 @@
+#include <QtTest/QtTest>
+
+#include <memory>
+
+#include "SerialManager.h"
+#include "TimelineMerger.h"
+
+namespace
+{
+constexpr qint64 kLongHoldNs = 60LL * 1000 * 1000 * 1000;
+
+struct Released
+{
+    int channel = -1;
+    qint64 timestampNs = 0;
+
+    bool operator==(const Released &other) const
+    {
+        return channel == other.channel && timestampNs == other.timestampNs;
+    }
+};
+} // namespace
+
+// LiveTimelineMerger against the monotonic clock. Offsets from "now" keep the
+// hold time out of the way unless a test is about it.
+class TestTimeline : public QObject
+{
+    Q_OBJECT
+
+private:
+    std::unique_ptr<LiveTimelineMerger> m_merger;
+    QList<Released> m_released;
+    qint64 m_base = 0;
+
+    void setUpChannels(int count, qint64 holdNs);
+
+private slots:
+    void init();
+    void releasesBehindTheWatermark();
+    void inactiveChannelDoesNotHoldBack();
+    void holdWindowReleasesIdleChannels();
+    void countsLateRecords();
+    void clearResetsTheWatermark();
+};
+
+void TestTimeline::setUpChannels(int count, qint64 holdNs)
+{
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(m_merger->addChannel(QString("ch%1").arg(i)), i);
+    }
+    m_merger->setHoldNs(holdNs);
+}
+
+void TestTimeline::init()
+{
+    m_merger = std::make_unique<LiveTimelineMerger>();
+    m_released.clear();
+    m_merger->setOutputCallback([this](const CaptureRecord &record) {
+        m_released.append({record.channel, record.timestampNs - m_base});
+    });
+    m_base = SerialManager::monotonicNowNs();
+}
+
+void TestTimeline::releasesBehindTheWatermark()
+{
+    setUpChannels(2, kLongHoldNs);
+
+    m_merger->push(0, CaptureDirection::Rx, "a", m_base + 100);
+    QVERIFY(m_released.isEmpty());
+    QCOMPARE(m_merger->pendingRecords(), qint64(1));
+
+    // Channel 1 has now been seen at 50, so its chunk is the earliest anyone can send.
+    m_merger->push(1, CaptureDirection::Rx, "b", m_base + 50);
+    QCOMPARE(m_released, QList<Released>({{1, 50}}));
+
+    m_merger->push(1, CaptureDirection::Rx, "c", m_base + 200);
+    QCOMPARE(m_released, QList<Released>({{1, 50}, {0, 100}}));
+    QCOMPARE(m_merger->pendingRecords(), qint64(1));
+
+    m_merger->flush();
+    QCOMPARE(m_released, QList<Released>({{1, 50}, {0, 100}, {1, 200}}));
+    QCOMPARE(m_merger->recordsMerged(), quint64(3));
+    QCOMPARE(m_merger->lateRecords(), quint64(0));
+}
+
+void TestTimeline::inactiveChannelDoesNotHoldBack()
+{
+    setUpChannels(3, kLongHoldNs);
+
+    m_merger->push(0, CaptureDirection::Rx, "a", m_base + 100);
+    m_merger->push(1, CaptureDirection::Tx, "b", m_base + 150);
+    QVERIFY(m_released.isEmpty());
+
+    m_merger->setChannelActive(2, false);
+    QCOMPARE(m_released, QList<Released>({{0, 100}}));
+}
+
+void TestTimeline::holdWindowReleasesIdleChannels()
+{
+    constexpr qint64 holdNs = 30 * 1000 * 1000;
+    setUpChannels(2, holdNs);
+
+    const qint64 stampNs = SerialManager::monotonicNowNs();
+    m_merger->push(0, CaptureDirection::Rx, "a", stampNs);
+    QVERIFY(m_released.isEmpty());
+
+    // Channel 1 never speaks; the hold time alone lets the chunk out.
+    QTRY_COMPARE_WITH_TIMEOUT(m_released.size(), 1, 5000);
+    QVERIFY(SerialManager::monotonicNowNs() - stampNs >= holdNs);
+    QCOMPARE(m_merger->pendingRecords(), qint64(0));
+}
+
+void TestTimeline::countsLateRecords()
+{
+    setUpChannels(3, kLongHoldNs);
+    m_merger->setChannelActive(2, false);
+
+    m_merger->push(0, CaptureDirection::Rx, "a", m_base + 100);
+    m_merger->push(1, CaptureDirection::Rx, "b", m_base + 150);
+    QCOMPARE(m_released, QList<Released>({{0, 100}}));
+
+    // Channel 2 comes back with a chunk from before what was already released.
+    m_merger->setChannelActive(2, true);
+    m_merger->push(2, CaptureDirection::Rx, "c", m_base + 80);
+    QCOMPARE(m_merger->lateRecords(), quint64(1));
+    QCOMPARE(m_released, QList<Released>({{0, 100}, {2, 80}}));
+
+    m_merger->push(2, CaptureDirection::Rx, "d", m_base + 120);
+    QCOMPARE(m_merger->lateRecords(), quint64(1));
+}
+
+void TestTimeline::clearResetsTheWatermark()
+{
+    setUpChannels(2, kLongHoldNs);
+
+    m_merger->push(0, CaptureDirection::Rx, "a", m_base + 1000);
+    m_merger->push(1, CaptureDirection::Rx, "b", m_base + 1000);
+    m_merger->push(0, CaptureDirection::Rx, "c", m_base + 2000);
+    QCOMPARE(m_released.size(), 2);
+    QCOMPARE(m_merger->pendingRecords(), qint64(1));
+
+    m_merger->clear();
+    QCOMPARE(m_merger->pendingRecords(), qint64(0));
+    QCOMPARE(m_merger->recordsMerged(), quint64(0));
+    QCOMPARE(m_merger->lateRecords(), quint64(0));
+
+    // Earlier than everything released before the clear, yet not late, and
+    // held for channel 1 like on a fresh merger.
+    m_released.clear();
+    m_merger->push(0, CaptureDirection::Rx, "d", m_base + 10);
+    QVERIFY(m_released.isEmpty());
+    m_merger->push(1, CaptureDirection::Rx, "e", m_base + 20);
+    QCOMPARE(m_released, QList<Released>({{0, 10}}));
+    QCOMPARE(m_merger->lateRecords(), quint64(0));
+
+    m_merger->flush();
+    QCOMPARE(m_released, QList<Released>({{0, 10}, {1, 20}}));
+}
+
+QTEST_GUILESS_MAIN(TestTimeline)
+#include "tst_timeline.moc"
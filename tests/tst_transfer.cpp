@@ -0,0 +1,320 @@
+#include <QtTest/QtTest>
+
+#include <memory>
+
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "SerialManager.h"
+
+namespace
+{
+QByteArray testPayload(qsizetype size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (qsizetype i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = static_cast<char>(seed >> 16);
+    }
+    return data;
+}
+
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// XMODEM has no length; the last block is padded with SUB.
+bool matchesPadded(const QByteArray &received, const QByteArray &expected)
+{
+    if (!received.startsWith(expected)) {
+        return false;
+    }
+    for (qsizetype i = expected.size(); i < received.size(); ++i) {
+        if (received.at(i) != 0x1a) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+// Transfers against lrzsz over a pseudo-terminal: SerialManager has the slave,
+// sz/rz run with the master as stdin and stdout.
+class TestTransfer : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString m_sz;
+    QString m_rz;
+    std::unique_ptr<QTemporaryDir> m_local;  // this side's files
+    std::unique_ptr<QTemporaryDir> m_remote; // lrzsz's working directory
+    std::unique_ptr<SerialManager> m_serial;
+    std::unique_ptr<QProcess> m_peer;
+    int m_master = -1;
+    bool m_finished = false;
+    bool m_ok = false;
+    QString m_message;
+    QStringList m_log;
+
+    void startPeer(const QString &program, const QStringList &arguments);
+    bool startSend(TransferProtocol protocol, const QStringList &paths);
+    bool startReceive(TransferProtocol protocol, const QString &target, bool resume = false);
+    void waitForTransfer();
+    bool logContains(const QString &text) const;
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void xmodemCrcSend();
+    void xmodem1kReceive();
+    void ymodemBatchSend();
+    void ymodemBatchReceive();
+    void zmodemSendResumesAtZrpos();
+    void zmodemReceiveRecovers();
+    void zmodemReceiveKeepsUnverifiedFile();
+};
+
+void TestTransfer::initTestCase()
+{
+    for (const QString &name : {QString("sz"), QString("lsz")}) {
+        if (m_sz.isEmpty()) {
+            m_sz = QStandardPaths::findExecutable(name);
+        }
+    }
+    for (const QString &name : {QString("rz"), QString("lrz")}) {
+        if (m_rz.isEmpty()) {
+            m_rz = QStandardPaths::findExecutable(name);
+        }
+    }
+    if (m_sz.isEmpty() || m_rz.isEmpty()) {
+        QSKIP("lrzsz (sz/rz) is not installed");
+    }
+}
+
+void TestTransfer::init()
+{
+    m_local = std::make_unique<QTemporaryDir>();
+    m_remote = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_local->isValid() && m_remote->isValid());
+
+    int slave = -1;
+    char slaveName[128] = {};
+    QVERIFY(::openpty(&m_master, &slave, slaveName, nullptr, nullptr) == 0);
+    termios raw = {};
+    ::tcgetattr(slave, &raw);
+    ::cfmakeraw(&raw);
+    ::tcsetattr(slave, TCSANOW, &raw);
+
+    m_finished = false;
+    m_ok = false;
+    m_message.clear();
+    m_log.clear();
+    m_serial = std::make_unique<SerialManager>();
+    m_serial->setTransferLogCallback([this](const QString &message) {
+        m_log.append(message);
+    });
+    m_serial->setTransferFinishedCallback([this](bool ok, const QString &message) {
+        m_finished = true;
+        m_ok = ok;
+        m_message = message;
+    });
+
+    SerialConfig config;
+    config.portName = QString::fromLocal8Bit(slaveName);
+    const bool opened = m_serial->connectPort(config);
+    ::close(slave);
+    QVERIFY(opened);
+}
+
+void TestTransfer::cleanup()
+{
+    if (m_peer) {
+        m_peer->kill();
+        m_peer->waitForFinished(2000);
+        m_peer.reset();
+    }
+    m_serial.reset();
+    if (m_master >= 0) {
+        ::close(m_master);
+        m_master = -1;
+    }
+}
+
+void TestTransfer::startPeer(const QString &program, const QStringList &arguments)
+{
+    m_peer = std::make_unique<QProcess>();
+    m_peer->setWorkingDirectory(m_remote->path());
+    m_peer->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    const int master = m_master;
+    m_peer->setChildProcessModifier([master]() {
+        ::dup2(master, STDIN_FILENO);
+        ::dup2(master, STDOUT_FILENO);
+    });
+    m_peer->start(program, arguments);
+    QVERIFY2(m_peer->waitForStarted(), qPrintable(m_peer->errorString()));
+}
+
+bool TestTransfer::startSend(TransferProtocol protocol, const QStringList &paths)
+{
+    TransferOptions options;
+    options.protocol = protocol;
+    bool ok = false;
+    QString error;
+    m_serial->runOnIoThread([this, &options, &paths, &ok, &error]() {
+        ok = m_serial->fileTransfer().startSend(options, paths, &error);
+    });
+    if (!ok) {
+        qWarning() << error;
+    }
+    return ok;
+}
+
+bool TestTransfer::startReceive(TransferProtocol protocol, const QString &target, bool resume)
+{
+    TransferOptions options;
+    options.protocol = protocol;
+    options.resume = resume;
+    bool ok = false;
+    QString error;
+    m_serial->runOnIoThread([this, &options, &target, &ok, &error]() {
+        ok = m_serial->fileTransfer().startReceive(options, target, &error);
+    });
+    if (!ok) {
+        qWarning() << error;
+    }
+    return ok;
+}
+
+void TestTransfer::waitForTransfer()
+{
+    // The line belongs to the transfer until it ends.
+    if (!m_finished) {
+        QCOMPARE(m_serial->sendBytes("stray"), qint64(-1));
+    }
+    QTRY_VERIFY_WITH_TIMEOUT(m_finished, 60000);
+    QVERIFY2(m_ok, qPrintable(m_message + "\n" + m_log.join('\n')));
+    QVERIFY(m_peer->waitForFinished(10000));
+    QCOMPARE(m_peer->exitStatus(), QProcess::NormalExit);
+    QCOMPARE(m_peer->exitCode(), 0);
+}
+
+bool TestTransfer::logContains(const QString &text) const
+{
+    for (const QString &line : m_log) {
+        if (line.contains(text)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TestTransfer::xmodemCrcSend()
+{
+    const QByteArray data = testPayload(10000, 1);
+    const QString source = m_local->filePath("x.bin");
+    QVERIFY(writeFile(source, data));
+
+    // -c asks with 'C', so the CRC variant is what gets exercised.
+    startPeer(m_rz, {"--xmodem", "-c", "x.bin"});
+    QVERIFY(startSend(TransferProtocol::XmodemCrc, {source}));
+    waitForTransfer();
+    QVERIFY(matchesPadded(readFile(m_remote->filePath("x.bin")), data));
+}
+
+void TestTransfer::xmodem1kReceive()
+{
+    const QByteArray data = testPayload(50000, 2);
+    QVERIFY(writeFile(m_remote->filePath("x1k.bin"), data));
+
+    const QString target = m_local->filePath("x1k.bin");
+    QVERIFY(startReceive(TransferProtocol::Xmodem1k, target));
+    startPeer(m_sz, {"--xmodem", "-k", "x1k.bin"});
+    waitForTransfer();
+    QVERIFY(matchesPadded(readFile(target), data));
+}
+
+void TestTransfer::ymodemBatchSend()
+{
+    const QByteArray first = testPayload(3000, 3);
+    const QByteArray second = testPayload(70000, 4);
+    QVERIFY(writeFile(m_local->filePath("a.bin"), first));
+    QVERIFY(writeFile(m_local->filePath("b.bin"), second));
+
+    startPeer(m_rz, {"--ymodem"});
+    QVERIFY(startSend(TransferProtocol::Ymodem, {m_local->filePath("a.bin"), m_local->filePath("b.bin")}));
+    waitForTransfer();
+    QCOMPARE(readFile(m_remote->filePath("a.bin")), first);
+    QCOMPARE(readFile(m_remote->filePath("b.bin")), second);
+}
+
+void TestTransfer::ymodemBatchReceive()
+{
+    const QByteArray first = testPayload(1, 5);
+    const QByteArray second = testPayload(40000, 6);
+    QVERIFY(writeFile(m_remote->filePath("c.bin"), first));
+    QVERIFY(writeFile(m_remote->filePath("d.bin"), second));
+
+    QVERIFY(startReceive(TransferProtocol::Ymodem, m_local->path()));
+    startPeer(m_sz, {"--ymodem", "c.bin", "d.bin"});
+    waitForTransfer();
+    QCOMPARE(readFile(m_local->filePath("c.bin")), first);
+    QCOMPARE(readFile(m_local->filePath("d.bin")), second);
+}
+
+void TestTransfer::zmodemSendResumesAtZrpos()
+{
+    const QByteArray data = testPayload(300000, 7);
+    QVERIFY(writeFile(m_local->filePath("z.bin"), data));
+    // rz -r answers ZFILE with a ZRPOS at the end of what it already has.
+    QVERIFY(writeFile(m_remote->filePath("z.bin"), data.left(120000)));
+
+    startPeer(m_rz, {"--zmodem", "-r"});
+    QVERIFY(startSend(TransferProtocol::Zmodem, {m_local->filePath("z.bin")}));
+    waitForTransfer();
+    QCOMPARE(readFile(m_remote->filePath("z.bin")), data);
+    QVERIFY2(logContains("resumes z.bin at 120000"), qPrintable(m_log.join('\n')));
+}
+
+void TestTransfer::zmodemReceiveRecovers()
+{
+    const QByteArray data = testPayload(200000, 8);
+    QVERIFY(writeFile(m_remote->filePath("r.bin"), data));
+    QVERIFY(writeFile(m_local->filePath("r.bin"), data.left(50000)));
+
+    // sz -r sends ZCRECOV, which is taken at its word.
+    QVERIFY(startReceive(TransferProtocol::Zmodem, m_local->path(), true));
+    startPeer(m_sz, {"--zmodem", "-r", "r.bin"});
+    waitForTransfer();
+    QCOMPARE(readFile(m_local->filePath("r.bin")), data);
+    QVERIFY2(logContains("Resuming r.bin at 50000"), qPrintable(m_log.join('\n')));
+}
+
+void TestTransfer::zmodemReceiveKeepsUnverifiedFile()
+{
+    const QByteArray data = testPayload(100000, 9);
+    QByteArray stale = data.left(30000);
+    stale[100] = static_cast<char>(stale.at(100) ^ 0xff);
+    QVERIFY(writeFile(m_remote->filePath("u.bin"), data));
+    QVERIFY(writeFile(m_local->filePath("u.bin"), stale));
+
+    // Without ZCRECOV the existing prefix has to pass ZCRC; this one can't.
+    QVERIFY(startReceive(TransferProtocol::Zmodem, m_local->path(), true));
+    startPeer(m_sz, {"--zmodem", "u.bin"});
+    waitForTransfer();
+    QCOMPARE(readFile(m_local->filePath("u.bin")), stale);
+    QCOMPARE(readFile(m_local->filePath("u (1).bin")), data);
+}
+
+QTEST_GUILESS_MAIN(TestTransfer)
+#include "tst_transfer.moc"
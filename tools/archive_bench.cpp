@@ -0,0 +1,190 @@
+/*
+ * Capture archive pack/unpack throughput on synthetic sessions.
+ *
+ *   archive_bench [MiB] [block-KiB] [level]
+ *
+ * Writes an ASCII session (log lines from a chatty device) and a binary one
+ * (framed sensor packets with noisy samples) as capture files, packs each,
+ * unpacks it again, reads the records straight out of the archive, and checks
+ * both round trips reproduce the capture byte for byte.
+ */
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include "CaptureArchive.h"
+#include "CaptureFile.h"
+#include "SerialManager.h"
+
+namespace
+{
+class SyntheticSession
+{
+private:
+    quint32 m_state = 12345;
+    qint64 m_timestampNs = 0;
+    qint64 m_sequence = 0;
+
+    quint32 next()
+    {
+        m_state = m_state * 1103515245 + 12345;
+        return m_state >> 8;
+    }
+
+public:
+    CaptureRecord asciiRecord()
+    {
+        static const char *const kLevels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN"};
+        static const char *const kTags[] = {"adc", "uart", "pwm", "ctrl", "net"};
+        const quint32 value = next();
+
+        CaptureRecord record;
+        m_timestampNs += 200000 + value % 5000000;
+        record.timestampNs = m_timestampNs;
+        record.direction = value % 11 == 0 ? CaptureDirection::Tx : CaptureDirection::Rx;
+        record.data = QString("[%1] %2 %3: seq=%4 value=%5 temp=%6.%7\r\n")
+                          .arg(m_timestampNs / 1000000, 10)
+                          .arg(kLevels[value % 5])
+                          .arg(kTags[(value >> 3) % 5])
+                          .arg(++m_sequence)
+                          .arg(value % 4096)
+                          .arg(20 + (value >> 12) % 15)
+                          .arg((value >> 16) % 10)
+                          .toLatin1();
+        return record;
+    }
+
+    CaptureRecord binaryRecord()
+    {
+        CaptureRecord record;
+        m_timestampNs += 1000000 + next() % 200000;
+        record.timestampNs = m_timestampNs;
+
+        // AA 55 | seq | len | 24 x i16 samples (slow signal + noise) | xor
+        QByteArray &packet = record.data;
+        packet.reserve(52);
+        packet.append('\xAA');
+        packet.append('\x55');
+        packet.append(static_cast<char>(++m_sequence));
+        packet.append(static_cast<char>(48));
+        for (int i = 0; i < 24; ++i) {
+            const qint16 sample = static_cast<qint16>(((m_sequence + i) % 512) * 16 + next() % 64);
+            packet.append(static_cast<char>(sample & 0xff));
+            packet.append(static_cast<char>(sample >> 8));
+        }
+        char check = 0;
+        for (char byte : packet) {
+            check ^= byte;
+        }
+        packet.append(check);
+        return record;
+    }
+};
+
+bool writeSession(const QString &path, bool ascii, qint64 totalBytes, qint64 *records)
+{
+    CaptureFileWriter writer;
+    if (!writer.open(path, 0)) {
+        return false;
+    }
+
+    SyntheticSession session;
+    qint64 written = 0;
+    while (written < totalBytes) {
+        const CaptureRecord record = ascii ? session.asciiRecord() : session.binaryRecord();
+        if (!writer.write(record)) {
+            return false;
+        }
+        written += record.data.size() + 16;
+    }
+
+    *records = writer.recordCount();
+    return writer.close();
+}
+
+bool sameContents(const QString &left, const QString &right)
+{
+    QFile a(left);
+    QFile b(right);
+    if (!a.open(QIODevice::ReadOnly) || !b.open(QIODevice::ReadOnly) || a.size() != b.size()) {
+        return false;
+    }
+
+    while (!a.atEnd()) {
+        if (a.read(1 << 20) != b.read(1 << 20)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString formatStats(const CaptureArchiveStats &stats)
+{
+    return QString("%1 MiB/s").arg(stats.throughputMBps(), 0, 'f', 1);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 totalBytes = (args.size() > 1 ? std::max(1LL, args.at(1).toLongLong()) : 64LL) * 1024 * 1024;
+    const int blockSize = (args.size() > 2 ? std::max(4, args.at(2).toInt()) : 1024) * 1024;
+    const int level = args.size() > 3 ? args.at(3).toInt() : CaptureArchiveWriter::kDefaultCompressionLevel;
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        QTextStream(stderr) << "cannot create a temporary directory\n";
+        return 1;
+    }
+
+    bool ok = true;
+    for (const bool ascii : {true, false}) {
+        const QString name = ascii ? "ascii" : "binary";
+        const QString capturePath = dir.filePath(name + ".dscap");
+        const QString archivePath = dir.filePath(name + ".dsca");
+        const QString restoredPath = dir.filePath(name + "-restored.dscap");
+
+        qint64 records = 0;
+        if (!writeSession(capturePath, ascii, totalBytes, &records)) {
+            QTextStream(stderr) << name << ": cannot write the capture\n";
+            return 1;
+        }
+
+        CaptureArchiveStats packStats;
+        CaptureArchiveStats unpackStats;
+        if (!packCaptureArchive(capturePath, archivePath, &packStats, blockSize, level)
+            || !unpackCaptureArchive(archivePath, restoredPath, &unpackStats)) {
+            QTextStream(stderr) << name << ": pack or unpack failed\n";
+            return 1;
+        }
+
+        // Same path the exporter and the merger take for an archive.
+        CaptureFileReader reader;
+        qint64 readRecords = 0;
+        const qint64 readStartNs = SerialManager::monotonicNowNs();
+        if (reader.open(archivePath)) {
+            QList<CaptureRecord> batch;
+            while (reader.readBatch(batch, 4096)) {
+                readRecords += batch.size();
+                batch.clear();
+            }
+        }
+        const double readSeconds = (SerialManager::monotonicNowNs() - readStartNs) / 1e9;
+
+        const bool roundTrip = sameContents(capturePath, restoredPath) && readRecords == records;
+        ok = ok && roundTrip;
+        QTextStream(stdout) << name << ": " << packStats.rawBytes << " bytes, " << records << " records, "
+                            << packStats.blockCount << " blocks, ratio "
+                            << QString::number(packStats.ratio(), 'f', 2) << ", pack " << formatStats(packStats)
+                            << ", unpack " << formatStats(unpackStats) << ", record read "
+                            << QString::number(packStats.rawBytes / (1024.0 * 1024.0) / readSeconds, 'f', 1)
+                            << " MiB/s, " << (roundTrip ? "round trip ok" : "ROUND TRIP MISMATCH") << "\n";
+    }
+
+    return ok ? 0 : 1;
+}
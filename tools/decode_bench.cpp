@@ -0,0 +1,114 @@
+/*
+ * Packet decoder throughput.
+ *
+ *   decode_bench [million-packets] [chunk-bytes]
+ *
+ * Frames and decodes a synthetic RX stream into a PacketTable the size the GUI uses.
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include "PacketDecoder.h"
+#include "SerialManager.h"
+
+namespace
+{
+// Three packet types behind a sync word and a length byte, a mix of widths,
+// byte orders, scaling and bitfields.
+const char kBenchmarkSchema[] = R"({
+    "endian": "little",
+    "sync": "AA 55",
+    "header": [
+        {"type": "pad", "size": 2},
+        {"name": "type", "type": "u8"},
+        {"name": "length", "type": "u8"}
+    ],
+    "discriminator": "type",
+    "length": {"field": "length", "adjust": 4},
+    "packets": [
+        {"id": 1, "name": "imu", "fields": [
+            {"name": "ax", "type": "i16", "scale": 0.001},
+            {"name": "ay", "type": "i16", "scale": 0.001},
+            {"name": "az", "type": "i16", "scale": 0.001},
+            {"name": "gx", "type": "i16"},
+            {"name": "gy", "type": "i16"},
+            {"name": "gz", "type": "i16"},
+            {"name": "tick", "type": "u32", "endian": "big"}
+        ]},
+        {"id": 2, "name": "status", "fields": [
+            {"type": "u16", "bits": [
+                {"name": "mode", "offset": 0, "width": 3, "enum": {"0": "idle", "1": "run", "2": "fault"}},
+                {"name": "armed", "offset": 3, "width": 1},
+                {"name": "rssi", "offset": 8, "width": 8}
+            ]},
+            {"name": "battery", "type": "u16", "scale": 0.01},
+            {"name": "temperature", "type": "f32"}
+        ]},
+        {"id": 3, "name": "position", "fields": [
+            {"name": "lat", "type": "f64"},
+            {"name": "lon", "type": "f64"},
+            {"name": "alt", "type": "i32", "scale": 0.01}
+        ]}
+    ]
+})";
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 totalPackets = (args.size() > 1 ? std::max(1LL, args.at(1).toLongLong()) : 10LL) * 1000000;
+    const qsizetype chunkBytes = args.size() > 2 ? std::max(1, args.at(2).toInt()) : 4096;
+
+    PacketSchema schema;
+    QString error;
+    if (!PacketSchema::compile(kBenchmarkSchema, schema, &error)) {
+        QTextStream(stderr) << "benchmark schema: " << error << "\n";
+        return 1;
+    }
+
+    // A few thousand distinct packets, replayed; enough that values change row to row.
+    QByteArray pattern;
+    int patternPackets = 0;
+    quint32 value = 12345;
+    for (; patternPackets < 3000; ++patternPackets) {
+        const PacketLayout &layout = schema.layouts().at(patternPackets % schema.layouts().size());
+        QByteArray packet(layout.size, Qt::Uninitialized);
+        for (qsizetype i = 4; i < packet.size(); ++i) {
+            value = value * 1103515245 + 12345;
+            packet[i] = static_cast<char>(value >> 16);
+        }
+        packet[0] = static_cast<char>(0xAA);
+        packet[1] = static_cast<char>(0x55);
+        packet[2] = static_cast<char>(layout.id);
+        packet[3] = static_cast<char>(layout.size - 4);
+        pattern.append(packet);
+    }
+
+    PacketDecoder decoder;
+    decoder.setSchema(schema);
+    decoder.setEnabled(true);
+    PacketTable table;
+    table.reset(schema);
+
+    const qint64 startNs = SerialManager::monotonicNowNs();
+    qint64 bytes = 0;
+    for (qint64 fed = 0; fed < totalPackets; fed += patternPackets) {
+        for (qsizetype offset = 0; offset < pattern.size(); offset += chunkBytes) {
+            decoder.feed(pattern.mid(offset, chunkBytes), SerialManager::monotonicNowNs(), table);
+        }
+        bytes += pattern.size();
+    }
+    const double seconds = (SerialManager::monotonicNowNs() - startNs) / 1e9;
+
+    QTextStream(stdout) << "decoded " << decoder.packetsDecoded() << " packets (" << bytes << " bytes) in "
+                        << QString::number(seconds, 'f', 2) << " s, "
+                        << QString::number(decoder.packetsDecoded() / seconds / 1e6, 'f', 2) << " M packets/s, "
+                        << QString::number(bytes / (1024.0 * 1024.0) / seconds, 'f', 1) << " MiB/s, "
+                        << decoder.bytesSkipped() << " bytes skipped, "
+                        << table.rowCount() << " rows kept\n";
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * TX encoder throughput.
+ *
+ *   encode_bench [MiB]
+ *
+ * Streams hex dumps, packed and spaced, through the TX encoder both as UTF-8
+ * bytes (the way "File..." on a send row does) and as QString (typed text),
+ * and checks every decoded byte.
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstring>
+
+#include "SerialManager.h"
+#include "TxEncoder.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 totalBytes = (args.size() > 1 ? std::max(1LL, args.at(1).toLongLong()) : 64LL) * 1024 * 1024;
+    constexpr qsizetype kChunkBytes = 64 * 1024;
+
+    QByteArray expected(4096, Qt::Uninitialized);
+    quint32 value = 12345;
+    for (qsizetype i = 0; i < expected.size(); ++i) {
+        value = value * 1103515245 + 12345;
+        expected[i] = static_cast<char>(value >> 16);
+    }
+
+    // Every output byte is compared, so a slip anywhere in a chunk is caught.
+    const auto matchesExpected = [&expected](const QByteArray &bytes, qint64 offset) {
+        qsizetype done = 0;
+        while (done < bytes.size()) {
+            const qsizetype at = static_cast<qsizetype>((offset + done) % expected.size());
+            const qsizetype length = std::min(bytes.size() - done, expected.size() - at);
+            if (std::memcmp(bytes.constData() + done, expected.constData() + at, length) != 0) {
+                return false;
+            }
+            done += length;
+        }
+        return true;
+    };
+
+    const QByteArray patterns[] = {expected.toHex(), expected.toHex(' ') + ' '};
+    for (const QByteArray &pattern : patterns) {
+        // Whole patterns per chunk, so every chunk decodes to copies of expected.
+        QByteArray input;
+        while (input.size() < kChunkBytes) {
+            input.append(pattern);
+        }
+        // The Send row path: typed or pasted text arrives as QString.
+        const QString text = QString::fromLatin1(input);
+
+        for (const bool utf16 : {false, true}) {
+            TxEncodeOptions options;
+            options.format = TxFormat::Hex;
+            TxEncoder encoder(options);
+
+            const qint64 startNs = SerialManager::monotonicNowNs();
+            qint64 consumed = 0;
+            qint64 produced = 0;
+            bool matches = true;
+            while (consumed < totalBytes) {
+                const bool fed = utf16 ? encoder.feed(QStringView(text))
+                                       : encoder.feed(QByteArrayView(input.constData(), input.size()));
+                if (!fed) {
+                    QTextStream(stderr) << encoder.errorString() << "\n";
+                    return 1;
+                }
+                const QByteArray bytes = encoder.takeOutput();
+                matches = matches && matchesExpected(bytes, produced);
+                produced += bytes.size();
+                consumed += input.size();
+            }
+            encoder.finish();
+            const QByteArray tail = encoder.takeOutput();
+            matches = matches && matchesExpected(tail, produced);
+            produced += tail.size();
+            matches = matches && produced == consumed / pattern.size() * expected.size();
+            const double seconds = (SerialManager::monotonicNowNs() - startNs) / 1e9;
+
+            QTextStream(stdout) << (&pattern == &patterns[0] ? "packed" : "spaced") << (utf16 ? " QString" : " UTF-8")
+                                << ": " << consumed << " chars to " << produced << " bytes in "
+                                << QString::number(seconds, 'f', 2) << " s, "
+                                << QString::number(consumed / (1024.0 * 1024.0) / seconds, 'f', 1) << " MiB/s"
+                                << (matches ? "" : ", MISMATCH") << "\n";
+            if (!matches) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
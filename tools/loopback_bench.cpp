@@ -0,0 +1,91 @@
+/*
+ * Receive path throughput through the in-memory loopback transport.
+ *
+ *   loopback_bench [MiB] [max-fragment]
+ *
+ * Pushes data through SerialManager's loopback transport and the full receive
+ * path (histogram, triggers, responder) with nothing painting on top of it.
+ * The receive path runs on the manager's I/O thread; this thread only counts.
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "SerialManager.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 totalBytes = (args.size() > 1 ? std::max(1LL, args.at(1).toLongLong()) : 256LL) * 1024 * 1024;
+
+    SerialConfig config;
+    config.mode = SerialMode::Loopback;
+    config.loopback.maxFragmentBytes = args.size() > 2 ? args.at(2).toInt() : 0;
+
+    SerialManager serial;
+    if (!serial.connectPort(config)) {
+        QTextStream(stderr) << "failed to open loopback\n";
+        return 1;
+    }
+
+    QByteArray block(64 * 1024, Qt::Uninitialized);
+    for (qsizetype i = 0; i < block.size(); ++i) {
+        block[i] = static_cast<char>(i * 31);
+    }
+
+    qint64 sent = 0;
+    qint64 received = 0;
+    bool failed = false;
+    const auto bytesPending = [&serial]() {
+        qint64 pending = 0;
+        serial.runOnIoThread([&serial, &pending]() {
+            pending = serial.loopback().bytesPending();
+        });
+        return pending;
+    };
+
+    // Keep a few blocks in flight so the receive side never waits on the sender.
+    const auto pump = [&]() {
+        while (!failed && sent < totalBytes && bytesPending() < 4 * block.size()) {
+            const qint64 written = serial.sendBytes(block.left(std::min<qint64>(block.size(), totalBytes - sent)));
+            if (written < 0) {
+                QTextStream(stderr) << "write failed after " << sent << " bytes\n";
+                failed = true;
+                app.quit();
+                return;
+            }
+            sent += written;
+        }
+    };
+
+    serial.setReceiveCallback([&](const QByteArray &data, qint64) {
+        received += data.size();
+        if (received >= totalBytes) {
+            app.quit();
+        } else {
+            pump();
+        }
+    });
+
+    const qint64 startNs = SerialManager::monotonicNowNs();
+    QTimer::singleShot(0, &app, pump);
+    app.exec();
+    const double seconds = (SerialManager::monotonicNowNs() - startNs) / 1e9;
+    if (failed) {
+        return 1;
+    }
+
+    GapHistogram gaps;
+    serial.runOnIoThread([&serial, &gaps]() {
+        gaps = serial.gapHistogram();
+    });
+    QTextStream(stdout) << "looped " << received << " bytes in " << gaps.count() + 1 << " chunks, "
+                        << QString::number(received / (1024.0 * 1024.0) / seconds, 'f', 1) << " MiB/s, "
+                        << "gap p50 " << GapHistogram::formatDuration(gaps.percentileNs(0.50))
+                        << " p99 " << GapHistogram::formatDuration(gaps.percentileNs(0.99)) << "\n";
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Timeline merge throughput.
+ *
+ *   merge_bench [million-records] [sources]
+ *
+ * Merges interleaved in-memory sources the way "Merge capture files..." does and
+ * checks the result is in timestamp order.
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "SerialManager.h"
+#include "TimelineMerger.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 totalRecords = (args.size() > 1 ? std::max(1LL, args.at(1).toLongLong()) : 4LL) * 1000000;
+    const int sourceCount = args.size() > 2 ? std::clamp(args.at(2).toInt(), 1, TimelineMerger::kMaxSources) : 8;
+
+    std::vector<QList<CaptureRecord>> sources(sourceCount);
+    const QByteArray payload(16, 'x');
+    quint32 value = 12345;
+    for (qint64 i = 0; i < totalRecords; ++i) {
+        value = value * 1103515245 + 12345;
+        QList<CaptureRecord> &records = sources[i % sourceCount];
+        CaptureRecord record;
+        record.timestampNs = (records.isEmpty() ? 0 : records.last().timestampNs) + (value >> 20);
+        record.data = payload;
+        records.append(record);
+    }
+
+    TimelineMerger merger;
+    for (int i = 0; i < sourceCount; ++i) {
+        merger.addSource(ExportSource::fromRecords(std::move(sources[i]), 0), QString("source%1").arg(i));
+    }
+
+    const qint64 startNs = SerialManager::monotonicNowNs();
+    qint64 merged = 0;
+    qint64 outOfOrder = 0;
+    qint64 lastNs = std::numeric_limits<qint64>::min();
+    bool more = true;
+    while (more) {
+        QList<CaptureRecord> batch;
+        more = merger.readBatch(batch, 4096);
+        for (const CaptureRecord &record : batch) {
+            outOfOrder += record.timestampNs < lastNs ? 1 : 0;
+            lastNs = record.timestampNs;
+        }
+        merged += batch.size();
+    }
+    const double seconds = (SerialManager::monotonicNowNs() - startNs) / 1e9;
+
+    QTextStream(stdout) << "merged " << merged << " records from " << sourceCount << " sources in "
+                        << QString::number(seconds, 'f', 2) << " s, "
+                        << QString::number(merged / seconds / 1e6, 'f', 2) << " M records/s, "
+                        << outOfOrder << " out of order\n";
+    return outOfOrder == 0 && merged == totalRecords ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+/*
+ * Capture archive packer (see inc/CaptureArchive.h).
+ *
+ *   pack <capture> <archive>            compress a .dscap into block archive
+ *   pack --unpack <archive> <capture>   restore the original capture
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "CaptureArchive.h"
+
+namespace
+{
+void printArchiveStats(const char *action, const CaptureArchiveStats &stats)
+{
+    QTextStream out(stdout);
+    out << action << ": " << stats.rawBytes << " raw bytes, "
+        << stats.archiveBytes << " archive bytes, "
+        << stats.blockCount << " blocks, ratio "
+        << QString::number(stats.ratio(), 'f', 2) << ", "
+        << QString::number(stats.throughputMBps(), 'f', 1) << " MiB/s\n";
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    const bool unpack = args.size() > 1 && args.at(1) == "--unpack";
+    if (unpack) {
+        args.removeAt(1);
+    }
+
+    if (args.size() != 3) {
+        QTextStream(stderr) << "usage: " << args.first()
+                            << " <capture> <archive> | --unpack <archive> <capture>\n";
+        return 2;
+    }
+
+    CaptureArchiveStats stats;
+    if (!unpack) {
+        if (!packCaptureArchive(args.at(1), args.at(2), &stats)) {
+            QTextStream(stderr) << "failed to pack " << args.at(1) << "\n";
+            return 1;
+        }
+        printArchiveStats("packed", stats);
+        return 0;
+    }
+
+    if (!unpackCaptureArchive(args.at(1), args.at(2), &stats)) {
+        QTextStream(stderr) << "failed to unpack " << args.at(1) << "\n";
+        return 1;
+    }
+    printArchiveStats("unpacked", stats);
+    return 0;
+}
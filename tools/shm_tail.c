@@ -0,0 +1,271 @@
+/*
+ * Reader for the desktop_serial shared-memory RX ring (see inc/ShmRing.h).
+ *
+ *   shm_tail [name]              copy the live RX stream to stdout
+ *   shm_tail --latency [name]    report publish-to-read latency once per second
+ *   shm_tail --bench [n] [size]  self-contained writer/reader latency benchmark
+ *
+ * Follows the ring across app restarts and port reopens: when the writer
+ * retires it, the reader reopens by name.
+ */
+
+/* usleep, shm_open and friends are not in strict C. */
+#define _GNU_SOURCE
+
+#include "ShmRing.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_signal(int signo)
+{
+    (void)signo;
+    g_stop = 1;
+}
+
+static int compare_u64(const void *lhs, const void *rhs)
+{
+    const uint64_t a = *(const uint64_t *)lhs;
+    const uint64_t b = *(const uint64_t *)rhs;
+    return (a > b) - (a < b);
+}
+
+static void print_latency(const char *label, uint64_t *samples, size_t count, const ds_shm_reader *reader)
+{
+    uint64_t sum = 0;
+    size_t i;
+
+    if (count == 0) {
+        fprintf(stderr, "%s: no records (overruns %llu)\n", label, (unsigned long long)reader->overruns);
+        return;
+    }
+
+    qsort(samples, count, sizeof(samples[0]), compare_u64);
+    for (i = 0; i < count; ++i) {
+        sum += samples[i];
+    }
+
+    fprintf(stderr,
+            "%s: %zu records, latency us min %.1f avg %.1f p50 %.1f p99 %.1f max %.1f, overruns %llu, lost %llu\n",
+            label,
+            count,
+            samples[0] / 1000.0,
+            (double)sum / (double)count / 1000.0,
+            samples[count / 2] / 1000.0,
+            samples[(count * 99) / 100] / 1000.0,
+            samples[count - 1] / 1000.0,
+            (unsigned long long)reader->overruns,
+            (unsigned long long)reader->lost_records);
+}
+
+static int open_reader(ds_shm_reader *reader, const char *name)
+{
+    int result;
+
+    while ((result = ds_shm_reader_open(reader, name)) != 0) {
+        if (g_stop) {
+            return -1;
+        }
+        if (result != -ENOENT && result != -EAGAIN) {
+            fprintf(stderr, "shm_open %s: %s\n", name, strerror(-result));
+            return -1;
+        }
+        usleep(200000);
+    }
+
+    return 0;
+}
+
+/* Once the ring is drained and retired, swaps in the one now under name. */
+static int reattach_if_closed(ds_shm_reader *reader, const char *name)
+{
+    if (!ds_shm_reader_closed(reader)) {
+        return 0;
+    }
+
+    ds_shm_reader_close(reader);
+    fprintf(stderr, "ring %s closed, reattaching\n", name);
+    return open_reader(reader, name) == 0 ? 1 : -1;
+}
+
+static int run_tail(const char *name)
+{
+    ds_shm_reader reader;
+    const ds_shm_ring_record *record;
+    const uint8_t *payload;
+
+    if (open_reader(&reader, name) != 0) {
+        return 1;
+    }
+
+    while (!g_stop) {
+        const int result = ds_shm_reader_peek(&reader, &record, &payload);
+        if (result == 0) {
+            const int reattached = reattach_if_closed(&reader, name);
+            if (reattached < 0) {
+                return g_stop ? 0 : 1;
+            }
+            if (reattached == 0) {
+                ds_shm_reader_wait(&reader, 500);
+            }
+            continue;
+        }
+        if (result < 0) {
+            fprintf(stderr, "overrun, resynchronised\n");
+            continue;
+        }
+
+        /* Writing straight from the mapping; a failed consume means the bytes were torn. */
+        fwrite(payload, 1, record->length, stdout);
+        if (ds_shm_reader_consume(&reader, record) != 0) {
+            fprintf(stderr, "\noverrun while writing, output may be corrupt\n");
+        }
+        fflush(stdout);
+    }
+
+    ds_shm_reader_close(&reader);
+    return 0;
+}
+
+static int run_latency(const char *name)
+{
+    enum { kMaxSamples = 1 << 20 };
+    ds_shm_reader reader;
+    const ds_shm_ring_record *record;
+    const uint8_t *payload;
+    uint64_t *samples = malloc(sizeof(uint64_t) * kMaxSamples);
+    size_t count = 0;
+    uint64_t window_start = ds_shm_monotonic_ns();
+
+    if (samples == NULL || open_reader(&reader, name) != 0) {
+        free(samples);
+        return 1;
+    }
+
+    while (!g_stop) {
+        const int result = ds_shm_reader_peek(&reader, &record, &payload);
+        if (result > 0) {
+            const uint64_t latency = ds_shm_monotonic_ns() - record->timestamp_ns;
+            if (ds_shm_reader_consume(&reader, record) == 0 && count < kMaxSamples) {
+                samples[count++] = latency;
+            }
+            continue;
+        }
+
+        if (result == 0) {
+            const int reattached = reattach_if_closed(&reader, name);
+            if (reattached < 0) {
+                free(samples);
+                return g_stop ? 0 : 1;
+            }
+            if (reattached == 0) {
+                ds_shm_reader_wait(&reader, 100);
+            }
+        }
+
+        if (ds_shm_monotonic_ns() - window_start >= 1000000000ull) {
+            print_latency("1s", samples, count, &reader);
+            count = 0;
+            window_start = ds_shm_monotonic_ns();
+        }
+    }
+
+    ds_shm_reader_close(&reader);
+    free(samples);
+    return 0;
+}
+
+static int run_bench(size_t records, size_t size)
+{
+    char name[64];
+    ds_shm_writer writer;
+    uint8_t *payload = calloc(1, size > 0 ? size : 1);
+    pid_t child;
+    int status = 0;
+    size_t i;
+
+    snprintf(name, sizeof(name), "/ds_shm_bench_%d", (int)getpid());
+    if (payload == NULL || ds_shm_writer_open(&writer, name, 1u << 20) != 0) {
+        fprintf(stderr, "cannot create %s\n", name);
+        free(payload);
+        return 1;
+    }
+
+    child = fork();
+    if (child == 0) {
+        ds_shm_reader reader;
+        const ds_shm_ring_record *record;
+        const uint8_t *data;
+        uint64_t *samples = malloc(sizeof(uint64_t) * records);
+        size_t count = 0;
+
+        if (samples == NULL || ds_shm_reader_open(&reader, name) != 0) {
+            _exit(1);
+        }
+
+        /* Reader opened after the fork, so start from the beginning of the ring. */
+        reader.read_pos = 0;
+        reader.last_seq = 0;
+
+        while (count < records) {
+            const int result = ds_shm_reader_peek(&reader, &record, &data);
+            if (result > 0) {
+                const uint64_t latency = ds_shm_monotonic_ns() - record->timestamp_ns;
+                if (ds_shm_reader_consume(&reader, record) == 0) {
+                    samples[count++] = latency;
+                }
+            } else if (result == 0) {
+                ds_shm_reader_wait(&reader, 1000);
+            } else if (reader.lost_records + count >= records) {
+                break;
+            }
+        }
+
+        print_latency("bench", samples, count, &reader);
+        ds_shm_reader_close(&reader);
+        free(samples);
+        _exit(0);
+    }
+
+    if (child < 0) {
+        ds_shm_writer_close(&writer);
+        free(payload);
+        return 1;
+    }
+
+    usleep(100000);
+    for (i = 0; i < records; ++i) {
+        /* Pace like a fast UART so the reader is mostly parked in the futex. */
+        const uint64_t deadline = ds_shm_monotonic_ns() + 20000;
+        while (ds_shm_monotonic_ns() < deadline) {
+        }
+        ds_shm_writer_publish(&writer, payload, size, ds_shm_monotonic_ns());
+    }
+
+    waitpid(child, &status, 0);
+    ds_shm_writer_close(&writer);
+    free(payload);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        const size_t records = argc > 2 ? (size_t)strtoull(argv[2], NULL, 10) : 100000;
+        const size_t size = argc > 3 ? (size_t)strtoull(argv[3], NULL, 10) : 64;
+        return run_bench(records, size);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--latency") == 0) {
+        return run_latency(argc > 2 ? argv[2] : DS_SHM_RING_DEFAULT_NAME);
+    }
+
+    return run_tail(argc > 1 ? argv[1] : DS_SHM_RING_DEFAULT_NAME);
+}
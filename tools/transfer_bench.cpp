@@ -0,0 +1,122 @@
+/*
+ * ZMODEM throughput in memory.
+ *
+ *   transfer_bench [MiB] [window-KiB]
+ *
+ * Runs a ZMODEM sender and receiver against each other in memory, each side's
+ * output handed to the other from the event loop, and checks the copy.
+ */
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+#include <utility>
+
+#include "FileTransfer.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 totalBytes = (args.size() > 1 ? std::max(1LL, args.at(1).toLongLong()) : 64LL) * 1024 * 1024;
+
+    TransferOptions options;
+    options.protocol = TransferProtocol::Zmodem;
+    if (args.size() > 2) {
+        options.zmodemWindowBytes = std::max(0LL, args.at(2).toLongLong()) * 1024;
+    }
+
+    QTemporaryDir dir;
+    const QString sourcePath = dir.filePath("source.bin");
+    const QString receivePath = dir.filePath("received");
+    QFile source(sourcePath);
+    if (!dir.isValid() || !QDir().mkpath(receivePath) || !source.open(QIODevice::WriteOnly)) {
+        QTextStream(stderr) << "cannot create benchmark files\n";
+        return 1;
+    }
+
+    // Every byte value, so the escaped ones (ZDLE, XON, XOFF) get their share.
+    QByteArray block(64 * 1024, Qt::Uninitialized);
+    quint32 value = 12345;
+    for (qsizetype i = 0; i < block.size(); ++i) {
+        value = value * 1103515245 + 12345;
+        block[i] = static_cast<char>(value >> 16);
+    }
+    for (qint64 written = 0; written < totalBytes; written += block.size()) {
+        source.write(block.constData(), std::min<qint64>(block.size(), totalBytes - written));
+    }
+    source.close();
+
+    FileTransfer sender;
+    FileTransfer receiver;
+    QByteArray toReceiver;
+    QByteArray toSender;
+    QTimer deliverTimer;
+    deliverTimer.setSingleShot(true);
+    deliverTimer.setInterval(0);
+    QObject::connect(&deliverTimer, &QTimer::timeout, [&]() {
+        receiver.feed(std::exchange(toReceiver, QByteArray()));
+        sender.feed(std::exchange(toSender, QByteArray()));
+        sender.writeReady();
+    });
+
+    sender.setWriteHandler([&](const QByteArray &data) {
+        toReceiver.append(data);
+        deliverTimer.start();
+        return static_cast<qint64>(data.size());
+    });
+    sender.setPendingWriteHandler([&]() {
+        return static_cast<qint64>(toReceiver.size());
+    });
+    receiver.setWriteHandler([&](const QByteArray &data) {
+        toSender.append(data);
+        deliverTimer.start();
+        return static_cast<qint64>(data.size());
+    });
+
+    int finished = 0;
+    bool ok = true;
+    const auto onFinished = [&](bool success, const QString &message) {
+        if (!success) {
+            QTextStream(stderr) << message << "\n";
+        }
+        ok = ok && success;
+        if (++finished == 2 || !success) {
+            app.quit();
+        }
+    };
+    sender.setFinishedCallback(onFinished);
+    receiver.setFinishedCallback(onFinished);
+
+    QString error;
+    if (!receiver.startReceive(options, receivePath, &error) || !sender.startSend(options, {sourcePath}, &error)) {
+        QTextStream(stderr) << error << "\n";
+        return 1;
+    }
+    app.exec();
+
+    QFile original(sourcePath);
+    QFile copy(QDir(receivePath).filePath("source.bin"));
+    if (ok && original.open(QIODevice::ReadOnly) && copy.open(QIODevice::ReadOnly)) {
+        while (ok && !original.atEnd()) {
+            ok = original.read(block.size()) == copy.read(block.size());
+        }
+        ok = ok && copy.atEnd();
+    } else {
+        ok = false;
+    }
+
+    const TransferProgress progress = sender.progress();
+    QTextStream(stdout) << "zmodem: " << progress.bytesMoved << " bytes in "
+                        << QString::number(progress.elapsedNs / 1e9, 'f', 2) << " s, "
+                        << QString::number(progress.bytesPerSecond() / (1024.0 * 1024.0), 'f', 1) << " MiB/s, window "
+                        << (options.zmodemWindowBytes > 0 ? QString("%1 KiB").arg(options.zmodemWindowBytes / 1024)
+                                                          : QString("unlimited"))
+                        << (ok ? "" : ", MISMATCH") << "\n";
+    return ok ? 0 : 1;
+}
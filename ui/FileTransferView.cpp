@@ -0,0 +1,313 @@
+#include "FileTransferView.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QMessageBox>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+#include <utility>
+
+namespace
+{
+constexpr int kStatusIntervalMs = 250;
+
+QString formatBytes(qint64 bytes)
+{
+    if (bytes < 1024) {
+        return QString("%1 B").arg(bytes);
+    }
+    if (bytes < 1024 * 1024) {
+        return QString("%1 KiB").arg(bytes / 1024.0, 0, 'f', 1);
+    }
+    return QString("%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 2);
+}
+} // namespace
+
+FileTransferView::FileTransferView(SerialManager &serial, AppSettings &settings, QWidget *parent)
+    : QWidget(parent, Qt::Window)
+    , m_serial(serial)
+    , m_settings(settings)
+{
+    setWindowTitle("File transfer");
+    resize(560, 200);
+
+    auto *layout = new QVBoxLayout(this);
+
+    auto *optionsRow = new QHBoxLayout;
+    m_protocolCombo = new QComboBox;
+    for (const TransferProtocol protocol : {TransferProtocol::XmodemCrc, TransferProtocol::Xmodem1k,
+                                            TransferProtocol::Ymodem, TransferProtocol::Zmodem}) {
+        m_protocolCombo->addItem(FileTransfer::protocolName(protocol), static_cast<int>(protocol));
+    }
+    m_protocolCombo->setCurrentIndex(
+        m_protocolCombo->findData(m_settings.read("transfer/protocol", static_cast<int>(TransferProtocol::Zmodem)).toInt()));
+
+    m_windowSpin = new QSpinBox;
+    m_windowSpin->setRange(0, 1024);
+    m_windowSpin->setSuffix(" KiB");
+    m_windowSpin->setSpecialValueText("unlimited");
+    m_windowSpin->setValue(m_settings.read("transfer/windowKiB", 64).toInt());
+    m_windowSpin->setToolTip("ZMODEM send: data allowed in flight past the receiver's last acknowledgement");
+
+    m_resumeCheck = new QCheckBox("Resume");
+    m_resumeCheck->setChecked(m_settings.read("transfer/resume", false).toBool());
+    m_resumeCheck->setToolTip("ZMODEM receive: continue a shorter file of the same name, skip a complete one,\n"
+                              "once the sender's CRC confirms it (sz -r is trusted without the check)");
+
+    optionsRow->addWidget(new QLabel("Protocol"));
+    optionsRow->addWidget(m_protocolCombo);
+    optionsRow->addWidget(new QLabel("Window"));
+    optionsRow->addWidget(m_windowSpin);
+    optionsRow->addWidget(m_resumeCheck);
+    optionsRow->addStretch(1);
+    layout->addLayout(optionsRow);
+
+    auto *buttonRow = new QHBoxLayout;
+    m_sendButton = new QPushButton("Send files...");
+    m_receiveButton = new QPushButton("Receive...");
+    m_cancelButton = new QPushButton("Cancel");
+    buttonRow->addWidget(m_sendButton);
+    buttonRow->addWidget(m_receiveButton);
+    buttonRow->addStretch(1);
+    buttonRow->addWidget(m_cancelButton);
+    layout->addLayout(buttonRow);
+
+    m_progressBar = new QProgressBar;
+    m_progressBar->setRange(0, 1000);
+    m_progressBar->setTextVisible(false);
+    layout->addWidget(m_progressBar);
+
+    m_statusLabel = new QLabel;
+    m_statusLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(m_statusLabel);
+    layout->addStretch(1);
+
+    connect(m_protocolCombo, &QComboBox::currentIndexChanged, this, [this]() {
+        m_settings.write("transfer/protocol", m_protocolCombo->currentData().toInt());
+        updateControls();
+    });
+    connect(m_windowSpin, &QSpinBox::valueChanged, this, [this](int value) {
+        m_settings.write("transfer/windowKiB", value);
+    });
+    connect(m_resumeCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        m_settings.write("transfer/resume", checked);
+    });
+    connect(m_sendButton, &QPushButton::clicked, this, [this]() {
+        sendFiles();
+    });
+    connect(m_receiveButton, &QPushButton::clicked, this, [this]() {
+        receiveFiles();
+    });
+    connect(m_cancelButton, &QPushButton::clicked, this, [this]() {
+        m_serial.runOnIoThread([this]() {
+            m_serial.fileTransfer().cancel();
+        });
+    });
+
+    m_serial.setTransferLogCallback([this](const QString &message) {
+        log(message);
+    });
+    m_serial.setTransferFinishedCallback([this](bool, const QString &) {
+        const TransferProgress progress = transferProgress();
+        log(QString("%1 moved in %2 s, %3/s, %4 errors")
+                .arg(formatBytes(progress.bytesMoved))
+                .arg(progress.elapsedNs / 1e9, 0, 'f', 1)
+                .arg(formatBytes(static_cast<qint64>(progress.bytesPerSecond())))
+                .arg(progress.errors));
+        updateStatus();
+        updateControls();
+        if (m_activeChangedCallback) {
+            m_activeChangedCallback(false);
+        }
+    });
+
+    m_statusTimer.setInterval(kStatusIntervalMs);
+    connect(&m_statusTimer, &QTimer::timeout, this, [this]() {
+        updateStatus();
+    });
+
+    updateControls();
+    updateStatus();
+}
+
+void FileTransferView::setLogCallback(LogCallback callback)
+{
+    m_logCallback = std::move(callback);
+}
+
+void FileTransferView::setActiveChangedCallback(ActiveChangedCallback callback)
+{
+    m_activeChangedCallback = std::move(callback);
+}
+
+void FileTransferView::updateControls()
+{
+    const bool active = isTransferActive();
+    const bool idle = m_serial.isConnected() && !active;
+    const auto protocol = static_cast<TransferProtocol>(m_protocolCombo->currentData().toInt());
+
+    m_protocolCombo->setEnabled(!active);
+    m_windowSpin->setEnabled(!active && protocol == TransferProtocol::Zmodem);
+    m_resumeCheck->setEnabled(!active && protocol == TransferProtocol::Zmodem);
+    m_sendButton->setEnabled(idle);
+    m_receiveButton->setEnabled(idle);
+    m_cancelButton->setEnabled(active);
+}
+
+void FileTransferView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    updateControls();
+    updateStatus();
+    m_statusTimer.start();
+}
+
+void FileTransferView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_statusTimer.stop();
+}
+
+TransferOptions FileTransferView::buildOptions() const
+{
+    TransferOptions options;
+    options.protocol = static_cast<TransferProtocol>(m_protocolCombo->currentData().toInt());
+    options.zmodemWindowBytes = static_cast<qint64>(m_windowSpin->value()) * 1024;
+    options.resume = m_resumeCheck->isChecked();
+    return options;
+}
+
+bool FileTransferView::isTransferActive() const
+{
+    bool active = false;
+    m_serial.runOnIoThread([this, &active]() {
+        active = m_serial.fileTransfer().isActive();
+    });
+    return active;
+}
+
+TransferProgress FileTransferView::transferProgress() const
+{
+    TransferProgress progress;
+    m_serial.runOnIoThread([this, &progress]() {
+        progress = m_serial.fileTransfer().progress();
+    });
+    return progress;
+}
+
+void FileTransferView::sendFiles()
+{
+    const TransferOptions options = buildOptions();
+    const QString lastDir = m_settings.read("transfer/lastDir").toString();
+    QStringList paths;
+    if (options.protocol == TransferProtocol::XmodemCrc || options.protocol == TransferProtocol::Xmodem1k) {
+        const QString path = QFileDialog::getOpenFileName(this, "Send file", lastDir);
+        if (!path.isEmpty()) {
+            paths.append(path);
+        }
+    } else {
+        paths = QFileDialog::getOpenFileNames(this, "Send files", lastDir);
+    }
+    if (paths.isEmpty()) {
+        return;
+    }
+
+    m_settings.write("transfer/lastDir", QFileInfo(paths.first()).absolutePath());
+    QString error;
+    bool ok = false;
+    m_serial.runOnIoThread([this, &options, &paths, &error, &ok]() {
+        ok = m_serial.fileTransfer().startSend(options, paths, &error);
+    });
+    handleStarted(ok, error);
+}
+
+void FileTransferView::receiveFiles()
+{
+    const TransferOptions options = buildOptions();
+    const QString lastDir = m_settings.read("transfer/lastDir").toString();
+    QString target;
+    if (options.protocol == TransferProtocol::XmodemCrc || options.protocol == TransferProtocol::Xmodem1k) {
+        // XMODEM carries no file name.
+        target = QFileDialog::getSaveFileName(this, "Receive into", lastDir);
+        if (!target.isEmpty()) {
+            m_settings.write("transfer/lastDir", QFileInfo(target).absolutePath());
+        }
+    } else {
+        target = QFileDialog::getExistingDirectory(this, "Receive into folder", lastDir);
+        if (!target.isEmpty()) {
+            m_settings.write("transfer/lastDir", target);
+        }
+    }
+    if (target.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    bool ok = false;
+    m_serial.runOnIoThread([this, &options, &target, &error, &ok]() {
+        ok = m_serial.fileTransfer().startReceive(options, target, &error);
+    });
+    handleStarted(ok, error);
+}
+
+void FileTransferView::handleStarted(bool ok, const QString &error)
+{
+    if (!ok) {
+        QMessageBox::warning(this, "File transfer", error);
+        return;
+    }
+
+    m_statusTimer.start();
+    updateStatus();
+    updateControls();
+    if (m_activeChangedCallback) {
+        m_activeChangedCallback(true);
+    }
+}
+
+void FileTransferView::updateStatus()
+{
+    const TransferProgress progress = transferProgress();
+    const bool active = isTransferActive();
+
+    if (progress.fileSize > 0) {
+        m_progressBar->setRange(0, 1000);
+        m_progressBar->setValue(static_cast<int>(progress.fileOffset * 1000 / progress.fileSize));
+    } else if (active) {
+        m_progressBar->setRange(0, 0);
+    } else {
+        m_progressBar->setRange(0, 1000);
+        m_progressBar->setValue(0);
+    }
+
+    if (progress.fileIndex == 0) {
+        m_statusLabel->setText(active ? "Waiting for the other side" : "Idle");
+        return;
+    }
+
+    QString text = progress.fileCount > 0 ? QString("File %1/%2 %3").arg(progress.fileIndex).arg(progress.fileCount).arg(progress.fileName)
+                                          : QString("File %1 %2").arg(progress.fileIndex).arg(progress.fileName);
+    text += QString(", %1").arg(formatBytes(progress.fileOffset));
+    if (progress.fileSize >= 0) {
+        text += QString(" of %1").arg(formatBytes(progress.fileSize));
+    }
+    if (progress.resumedFrom > 0) {
+        text += QString(" (resumed at %1)").arg(formatBytes(progress.resumedFrom));
+    }
+    text += QString(", %1/s, %2 errors").arg(formatBytes(static_cast<qint64>(progress.bytesPerSecond()))).arg(progress.errors);
+    m_statusLabel->setText(text);
+}
+
+void FileTransferView::log(const QString &message)
+{
+    if (m_logCallback) {
+        m_logCallback(message);
+    }
+}
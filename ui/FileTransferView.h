@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QtCore/QTimer>
+#include <QtWidgets/QWidget>
+
+#include <functional>
+
+#include "AppSettings.h"
+#include "SerialManager.h"
+
+class QCheckBox;
+class QComboBox;
+class QHideEvent;
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QShowEvent;
+class QSpinBox;
+
+// X/Y/ZMODEM send and receive over the main port. The protocol runs inside
+// SerialManager on its I/O thread; this window only starts it and polls its
+// progress.
+class FileTransferView : public QWidget
+{
+public:
+    using LogCallback = std::function<void(const QString &message)>;
+    using ActiveChangedCallback = std::function<void(bool active)>;
+
+    FileTransferView(SerialManager &serial, AppSettings &settings, QWidget *parent = nullptr);
+
+    void setLogCallback(LogCallback callback);
+    void setActiveChangedCallback(ActiveChangedCallback callback);
+    void updateControls();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    SerialManager &m_serial;
+    AppSettings &m_settings;
+    LogCallback m_logCallback;
+    ActiveChangedCallback m_activeChangedCallback;
+    QComboBox *m_protocolCombo = nullptr;
+    QSpinBox *m_windowSpin = nullptr;
+    QCheckBox *m_resumeCheck = nullptr;
+    QPushButton *m_sendButton = nullptr;
+    QPushButton *m_receiveButton = nullptr;
+    QPushButton *m_cancelButton = nullptr;
+    QProgressBar *m_progressBar = nullptr;
+    QLabel *m_statusLabel = nullptr;
+    QTimer m_statusTimer;
+
+    TransferOptions buildOptions() const;
+    bool isTransferActive() const;
+    TransferProgress transferProgress() const;
+    void sendFiles();
+    void receiveFiles();
+    void handleStarted(bool ok, const QString &error);
+    void updateStatus();
+    void log(const QString &message);
+};
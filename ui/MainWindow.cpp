@@ -1,14 +1,57 @@
 #include "MainWindow.h"
 #include "config.h"
 #include <QDateTime>
+#include <QDialog>
+#include <QApplication>
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
+#include <QDir>
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QFutureWatcher>
+#include <QFormLayout>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QProgressDialog>
+#include <QTimer>
+#include <QSignalBlocker>
+#include <QStackedWidget>
+#include <QStandardPaths>
+#include <QTextBlockFormat>
+#include <QTextCursor>
 #include <qdebug.h>
 #include <qhashfunctions.h>
 #include <qlist.h>
 #include <qpushbutton.h>
 #include <qserialportinfo.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace
 {
+constexpr int kSendRowCount = 3;
+constexpr int kMaxLoggedSendChars = 200;
+// Smaller moves of the wall-clock offset are sampling jitter or NTP slewing.
+constexpr qint64 kClockStepNs = 50 * 1000000LL;
+constexpr qint64 kMebibyte = 1024 * 1024;
+
+enum TimeMode {
+    TimeModeWallClock = 0,
+    TimeModeSincePrevious,
+    TimeModeSinceTransmit,
+};
+
+QString formatRelativeTime(qint64 deltaNs)
+{
+    const QChar sign = deltaNs < 0 ? QChar('-') : QChar('+');
+    const qint64 micros = qAbs(deltaNs) / 1000;
+    return QString("%1%2.%3")
+        .arg(sign)
+        .arg(micros / 1000000)
+        .arg(micros % 1000000, 6, 10, QChar('0'));
+}
+
 QComboBox *createComboBox(const QStringList &items)
 {
     auto *combo = new QComboBox;
@@ -56,6 +99,13 @@ MainWindow::MainWindow(QWidget *parent)
     resize(840, 900);
     setMinimumSize(840, 900);
 
+    m_recordClockOffsetNs = SerialManager::wallClockOffsetNs();
+    loadSpoolSettings();
+    if (!m_sessionSpool.open(m_recordClockOffsetNs)) {
+        qWarning() << "Cannot create the session spool in" << m_sessionSpool.directory()
+                   << "; session export is disabled";
+    }
+
     auto *central = new QWidget(this);
     setCentralWidget(central);
 
@@ -85,7 +135,42 @@ MainWindow::MainWindow(QWidget *parent)
     receivePalette.setColor(QPalette::Base, Qt::white);
     receivePalette.setColor(QPalette::Text, Qt::black);
     m_receiveView->setPalette(receivePalette);
-    receiveLayout->addWidget(m_receiveView);
+
+    m_terminalView = new TerminalView;
+    m_terminalView->setMinimumSize(470, 310);
+    m_terminalView->setSendCallback([this](const QByteArray &data) {
+        if (m_serial.sendBytes(data) < 0) {
+            appendLogMessage(QString("TX failed (terminal): %1").arg(formatReceivedData(data)));
+        }
+    });
+    m_terminalView->setContextMenuCallback([this](QMenu &menu) {
+        addSessionMenuActions(menu);
+    });
+
+    m_receiveStack = new QStackedWidget;
+    m_receiveStack->addWidget(m_receiveView);
+    m_receiveStack->addWidget(m_terminalView);
+    receiveLayout->addWidget(m_receiveStack);
+
+    auto *timeRow = new QHBoxLayout;
+    m_timeModeCombo = createComboBox({"Clock", "Delta previous line", "Delta last TX"});
+    m_timeModeCombo->setCurrentIndex(m_appSettings.read("view/timeMode", TimeModeWallClock).toInt());
+    connect(m_timeModeCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        m_appSettings.write("view/timeMode", index);
+    });
+    m_displayModeCombo = createComboBox({"Log", "Terminal"});
+    connect(m_displayModeCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        m_appSettings.write("view/display", index);
+        setTerminalMode(index == 1);
+    });
+    timeRow->addWidget(new QLabel("View"));
+    timeRow->addWidget(m_displayModeCombo);
+    timeRow->addSpacing(12);
+    timeRow->addWidget(new QLabel("Time"));
+    timeRow->addWidget(m_timeModeCombo);
+    timeRow->addStretch(1);
+    receiveLayout->addLayout(timeRow);
+
     topRow->addWidget(receiveGroup, 1);
     connect(m_receiveView, &QWidget::customContextMenuRequested, this, [this](const QPoint &pos) {
         QMenu menu(this);
@@ -99,28 +184,93 @@ MainWindow::MainWindow(QWidget *parent)
         menu.addSeparator();
     
         QAction *clearAct = menu.addAction("Clear");
-    
+
+        menu.addSeparator();
+        addSessionMenuActions(menu);
+
         QAction *selected = menu.exec(m_receiveView->mapToGlobal(pos));
-    
+
         if (selected == copyAct) {
             m_receiveView->copy();
         } else if (selected == selectAllAct) {
             m_receiveView->selectAll();
         } else if (selected == clearAct) {
             m_receiveView->clear();
+            m_sessionSpool.open(m_recordClockOffsetNs);
         }
     });
 
     topRow->addWidget(createSerialPanel());
     serialLayout->addLayout(topRow, 1);
     serialLayout->addWidget(createModemLinesPanel());
+    serialLayout->addWidget(createBridgePanel());
     serialLayout->addWidget(createSendPanel());
 
     rootLayout->setStretchFactor(serialRoot, 1);
 
-    m_serial.setReceiveCallback([this](const QByteArray &data) {
-        handleSerialDataReceived(data);
+    m_serial.setReceiveCallback([this](const QByteArray &data, qint64 timestampNs) {
+        recordSessionChunk(CaptureDirection::Rx, data, timestampNs);
+        m_packetView->feed(data, timestampNs);
+        m_timelineView->feedMain(data, timestampNs);
+        handleSerialDataReceived(data, timestampNs);
     });
+
+    m_serial.setTransmitCallback([this](const QByteArray &data, qint64 timestampNs) {
+        recordSessionChunk(CaptureDirection::Tx, data, timestampNs);
+    });
+
+    m_serial.setTriggerCallback([this](const TriggerRule &rule, const TriggerMatch &match, qint64) {
+        handleTrigger(rule, match);
+    });
+    loadTriggerRules();
+
+    m_serial.setResponderCallback([this](const ResponderRule &, const QByteArray &response, qint64 written, qint64 latencyNs, qint64 timestampNs) {
+        appendTransmitLog(QString("TX responder (%1 bytes, %2): %3")
+                              .arg(written)
+                              .arg(GapHistogram::formatDuration(latencyNs))
+                              .arg(formatReceivedData(response)),
+                          timestampNs);
+    });
+    loadResponderSettings();
+
+    m_packetView = new PacketView(m_appSettings, this);
+    m_packetView->setLogCallback([this](const QString &message) {
+        appendLogMessage(message);
+    });
+    m_timelineView = new TimelineView(m_appSettings, this);
+    m_timelineView->setDataFormatter(formatReceivedData);
+    m_fileTransferView = new FileTransferView(m_serial, m_appSettings, this);
+    m_fileTransferView->setLogCallback([this](const QString &message) {
+        appendLogMessage(message);
+    });
+    m_fileTransferView->setActiveChangedCallback([this](bool) {
+        updateConnectionControls();
+    });
+
+    QString packetSchemaError;
+    if (!m_packetView->restoreSettings(&packetSchemaError)) {
+        appendLogMessage(QString("Saved packet schema ignored: %1").arg(packetSchemaError));
+    }
+
+    m_serial.setBridgeTransmitCallback([this](const QByteArray &data, qint64 written, qint64 timestampNs) {
+        if (written < 0) {
+            appendLogMessage(QString("TX bridge failed (%1 bytes): %2")
+                                 .arg(data.size())
+                                 .arg(formatReceivedData(data)));
+            return;
+        }
+
+        appendTransmitLog(QString("TX bridge (%1 bytes): %2")
+                              .arg(written)
+                              .arg(formatReceivedData(data)),
+                          timestampNs);
+    });
+
+    m_serial.setBridgeClientsChangedCallback([this](int, int) {
+        updateBridgeControls();
+    });
+
+    m_displayModeCombo->setCurrentIndex(m_appSettings.read("view/display", 0).toInt());
 }
 
 QWidget *MainWindow::createSerialPanel()
@@ -190,6 +340,15 @@ QWidget *MainWindow::createSerialPanel()
     addLabeledCombo("Handshake", {"OFF", "RTS/CTS", "XON/XOFF"}, m_handshakeCombo);
     addLabeledCombo("Mode", {"Free", "RS485", "Loopback"}, m_modeCombo);
 
+    loadLoopbackSettings();
+    m_loopbackButton = new QPushButton("Loopback options...");
+    m_loopbackButton->setEnabled(false);
+    serialLayout->addWidget(m_loopbackButton);
+    connect(m_loopbackButton, &QPushButton::clicked, this, &MainWindow::editLoopbackOptions);
+    connect(m_modeCombo, &QComboBox::currentIndexChanged, this, [this](int) {
+        m_loopbackButton->setEnabled(buildSerialConfigFromUi().mode == SerialMode::Loopback);
+    });
+
     serialLayout->addSpacing(8);
 
     m_openButton = new QPushButton("Open");
@@ -260,6 +419,53 @@ QWidget *MainWindow::createModemLinesPanel()
     return group;
 }
 
+QWidget *MainWindow::createBridgePanel()
+{
+    auto *group = new QGroupBox("TCP bridge");
+    auto *layout = new QHBoxLayout(group);
+    layout->setContentsMargins(10, 8, 10, 10);
+    layout->setSpacing(8);
+
+    m_bridgePortSpin = new QSpinBox;
+    m_bridgePortSpin->setRange(0, 65535);
+    m_bridgePortSpin->setSpecialValueText("off");
+    m_bridgePortSpin->setValue(m_appSettings.read("bridge/tcpPort", 7000).toInt());
+
+    m_bridgeObserverSpin = new QSpinBox;
+    m_bridgeObserverSpin->setRange(0, 65535);
+    m_bridgeObserverSpin->setSpecialValueText("off");
+    m_bridgeObserverSpin->setValue(m_appSettings.read("bridge/observerPort", 0).toInt());
+
+    m_bridgeSocketEdit = new QLineEdit(m_appSettings.read("bridge/localSocket").toString());
+    m_bridgeSocketEdit->setPlaceholderText("Local socket");
+
+    m_bridgeLocalOnlyCheck = new QCheckBox("Localhost only");
+    m_bridgeLocalOnlyCheck->setChecked(m_appSettings.read("bridge/localhostOnly", true).toBool());
+
+    m_bridgeButton = new QPushButton("Listen");
+    connect(m_bridgeButton, &QPushButton::clicked, this, &MainWindow::toggleBridge);
+
+    m_bridgeStatusLabel = new QLabel;
+
+    const QString shmName = m_appSettings.read("shm/name", DS_SHM_RING_DEFAULT_NAME).toString();
+    m_shmCheck = new QCheckBox("SHM");
+    m_shmCheck->setToolTip(QString("Publish RX to shared memory %1").arg(shmName));
+    connect(m_shmCheck, &QCheckBox::toggled, this, &MainWindow::toggleSharedMemoryPublisher);
+
+    layout->addWidget(new QLabel("Port"));
+    layout->addWidget(m_bridgePortSpin);
+    layout->addWidget(new QLabel("Observers"));
+    layout->addWidget(m_bridgeObserverSpin);
+    layout->addWidget(m_bridgeSocketEdit, 1);
+    layout->addWidget(m_bridgeLocalOnlyCheck);
+    layout->addWidget(m_bridgeButton);
+    layout->addWidget(m_bridgeStatusLabel);
+    layout->addWidget(m_shmCheck);
+
+    updateBridgeControls();
+    return group;
+}
+
 QWidget *MainWindow::createSendPanel()
 {
     m_sendGroup = new QGroupBox("Send");
@@ -267,9 +473,9 @@ QWidget *MainWindow::createSendPanel()
     layout->setContentsMargins(8, 10, 8, 8);
     layout->setSpacing(8);
 
-    layout->addWidget(createSendRow(""));
-    layout->addWidget(createSendRow(""));
-    layout->addWidget(createSendRow(""));
+    for (int index = 0; index < kSendRowCount; ++index) {
+        layout->addWidget(createSendRow(index, ""));
+    }
 
     m_sendGroup->setEnabled(false);
     return m_sendGroup;
@@ -296,7 +502,7 @@ QWidget *MainWindow::createIndicator(const QString &text, const QColor &color)
     return widget;
 }
 
-QGroupBox *MainWindow::createSendRow(const QString &placeholder)
+QGroupBox *MainWindow::createSendRow(int index, const QString &placeholder)
 {
     auto *row = new QGroupBox;
     auto *layout = new QHBoxLayout(row);
@@ -305,40 +511,100 @@ QGroupBox *MainWindow::createSendRow(const QString &placeholder)
 
     auto *lineEdit = new QLineEdit;
     lineEdit->setPlaceholderText(placeholder);
-
-    auto *hexCheck = new QCheckBox("HEX");
-
+    // Pasted hex dumps can be far longer than QLineEdit's 32767 default.
+    lineEdit->setMaxLength(std::numeric_limits<int>::max());
+
+    const QString settingsPrefix = QString("send/row%1/").arg(index);
+    auto *formatCombo = createComboBox({"Text", "Escaped", "HEX"});
+    formatCombo->setToolTip("Escaped: \\r \\n \\t \\0 \\e \\\\ \\xHH\n"
+                            "Escaped and HEX: {len} {crc16} {crc16:xmodem}");
+    formatCombo->setCurrentIndex(m_appSettings.read(settingsPrefix + "format", static_cast<int>(TxFormat::Text)).toInt());
+    auto *lineEndingCombo = createComboBox({"None", "LF", "CR", "CRLF"});
+    lineEndingCombo->setToolTip("Line ending appended to every send");
+    lineEndingCombo->setCurrentIndex(
+        m_appSettings.read(settingsPrefix + "lineEnding", static_cast<int>(TxLineEnding::Lf)).toInt());
+
+    auto *fileButton = new QPushButton("File...");
+    fileButton->setToolTip("Send a file, encoded with this row's format and line ending");
     auto *sendButton = new QPushButton("Send");
 
     layout->addWidget(lineEdit, 1);
-    layout->addWidget(hexCheck);
+    layout->addWidget(formatCombo);
+    layout->addWidget(lineEndingCombo);
+    layout->addWidget(fileButton);
     layout->addWidget(sendButton);
 
-    connect(sendButton, &QPushButton::clicked, this, [this, lineEdit, hexCheck](){
-        const QString rawText = lineEdit->text();
-        qint64 written = -1;
-    
-        if (hexCheck->isChecked()) {
-            written = this->m_serial.sendHex(rawText);
-        } else {
-            written = this->m_serial.sendText(rawText + "\n");
+    connect(formatCombo, &QComboBox::currentIndexChanged, this, [this, settingsPrefix, lineEndingCombo](int format) {
+        m_appSettings.write(settingsPrefix + "format", format);
+        // Hex payloads are usually complete frames; text is usually a command
+        // line. Only a default: a line ending the user picked is left alone,
+        // and the default itself isn't saved as a choice.
+        if (m_appSettings.read(settingsPrefix + "lineEnding").isValid()) {
+            return;
         }
-    
-        QString visible = rawText;
+        const bool hex = static_cast<TxFormat>(format) == TxFormat::Hex;
+        const QSignalBlocker blocker(lineEndingCombo);
+        lineEndingCombo->setCurrentIndex(static_cast<int>(hex ? TxLineEnding::None : TxLineEnding::Lf));
+    });
+    connect(lineEndingCombo, &QComboBox::currentIndexChanged, this, [this, settingsPrefix](int lineEnding) {
+        m_appSettings.write(settingsPrefix + "lineEnding", lineEnding);
+    });
+
+    const auto rowOptions = [formatCombo, lineEndingCombo]() {
+        TxEncodeOptions options;
+        options.format = static_cast<TxFormat>(formatCombo->currentIndex());
+        options.lineEnding = static_cast<TxLineEnding>(lineEndingCombo->currentIndex());
+        return options;
+    };
+
+    connect(sendButton, &QPushButton::clicked, this, [this, lineEdit, formatCombo, rowOptions](){
+        const QString rawText = lineEdit->text();
+        QString error;
+        qint64 errorPosition = -1;
+        const qint64 written = m_serial.sendEncoded(rawText, rowOptions(), &error, &errorPosition);
+
+        QString visible = rawText.left(kMaxLoggedSendChars);
         visible.replace("\r", "\\r");
         visible.replace("\n", "\\n");
-    
+        if (rawText.size() > kMaxLoggedSendChars) {
+            visible += QString("... (%1 chars)").arg(rawText.size());
+        }
+
         if (written < 0) {
-            appendLogMessage(QString("TX failed | HEX=%1 | data=%2")
-                .arg(hexCheck->isChecked() ? "true" : "false")
-                .arg(visible));
+            appendLogMessage(QString("TX failed | %1 | %2 | data=%3")
+                .arg(formatCombo->currentText(), error, visible));
+            if (errorPosition >= 0) {
+                lineEdit->setFocus();
+                lineEdit->setSelection(static_cast<int>(errorPosition), 1);
+            }
             return;
         }
-    
-        appendLogMessage(QString("TX %1 bytes | HEX=%2 | data=%3")
+
+        appendTransmitLog(QString("TX %1 bytes | %2 | data=%3")
             .arg(written)
-            .arg(hexCheck->isChecked() ? "true" : "false")
-            .arg(visible));
+            .arg(formatCombo->currentText(), visible), m_serial.lastTransmitTimestampNs());
+    });
+
+    connect(fileButton, &QPushButton::clicked, this, [this, formatCombo, rowOptions]() {
+        const QString path = QFileDialog::getOpenFileName(this,
+                                                          "Send file",
+                                                          m_appSettings.read("send/lastFile").toString());
+        if (path.isEmpty()) {
+            return;
+        }
+        m_appSettings.write("send/lastFile", path);
+
+        QString error;
+        qint64 errorPosition = -1;
+        const qint64 written = m_serial.sendFile(path, rowOptions(), &error, &errorPosition);
+        if (written < 0) {
+            appendLogMessage(QString("TX failed | %1 | %2 | file=%3").arg(formatCombo->currentText(), error, path));
+            return;
+        }
+
+        appendTransmitLog(QString("TX %1 bytes | %2 | file=%3")
+            .arg(written)
+            .arg(formatCombo->currentText(), path), m_serial.lastTransmitTimestampNs());
     });
 
     return row;
@@ -347,10 +613,21 @@ QGroupBox *MainWindow::createSendRow(const QString &placeholder)
 void MainWindow::connectToDevice()
 {
     const QString portName = m_serial.getConfig().portName.trimmed();
-    const QString portLabel = portName.isEmpty() ? "serial port" : portName;
+    QString portLabel = portName.isEmpty() ? "serial port" : portName;
+    if (m_serial.isLoopback() || (!m_serial.isConnected() && m_serial.getConfig().mode == SerialMode::Loopback)) {
+        portLabel = "loopback";
+    }
 
     if (m_serial.isConnected()) {
         flushPendingSerialData();
+        if (m_serial.isLoopback()) {
+            m_serial.runOnIoThread([this, &portLabel]() {
+                const LoopbackTransport &loopback = m_serial.loopback();
+                portLabel += QString(" (%1 bytes looped, %2 bits flipped)")
+                                 .arg(loopback.bytesDelivered())
+                                 .arg(loopback.bitsFlipped());
+            });
+        }
         m_serial.disconnectPort();
         updateConnectionControls();
         appendLogMessage(QString("Disconnected from %1").arg(portLabel));
@@ -362,7 +639,11 @@ void MainWindow::connectToDevice()
 
     if (m_serial.connectPort()) {
         m_receiveBuffer.clear();
+        m_receiveBufferTimestampNs = -1;
+        m_rxBytesSeen = 0;
+        m_pendingHighlightOffsets.clear();
         updateConnectionControls();
+        m_timelineView->setMainChannelName(portLabel);
         appendLogMessage(QString("Connected to %1").arg(portLabel));
         if (m_openButton != nullptr) {
             m_openButton->setText("Close");
@@ -374,36 +655,240 @@ void MainWindow::connectToDevice()
     appendLogMessage(QString("Failed to connect to %1").arg(portLabel));
 }
 
-void MainWindow::appendLogMessage(const QString &message)
+void MainWindow::toggleBridge()
+{
+    if (m_serial.isBridgeActive()) {
+        m_serial.stopBridge();
+        updateBridgeControls();
+        appendLogMessage("Bridge stopped");
+        return;
+    }
+
+    BridgeConfig config;
+    config.tcpPort = static_cast<quint16>(m_bridgePortSpin->value());
+    config.observerTcpPort = static_cast<quint16>(m_bridgeObserverSpin->value());
+    config.localSocketName = m_bridgeSocketEdit->text().trimmed();
+    config.localhostOnly = m_bridgeLocalOnlyCheck->isChecked();
+
+    m_appSettings.write("bridge/tcpPort", config.tcpPort);
+    m_appSettings.write("bridge/observerPort", config.observerTcpPort);
+    m_appSettings.write("bridge/localSocket", config.localSocketName);
+    m_appSettings.write("bridge/localhostOnly", config.localhostOnly);
+
+    if (!m_serial.startBridge(config)) {
+        QString error;
+        m_serial.runOnIoThread([this, &error]() {
+            error = m_serial.bridge().lastError();
+        });
+        updateBridgeControls();
+        appendLogMessage(QString("Bridge failed: %1").arg(error));
+        return;
+    }
+
+    updateBridgeControls();
+
+    QStringList endpoints;
+    if (config.tcpPort != 0) {
+        endpoints.append(QString("tcp:%1").arg(config.tcpPort));
+    }
+    if (config.observerTcpPort != 0) {
+        endpoints.append(QString("tcp:%1 (read-only)").arg(config.observerTcpPort));
+    }
+    if (!config.localSocketName.isEmpty()) {
+        endpoints.append(QString("local:%1").arg(config.localSocketName));
+    }
+    appendLogMessage(QString("Bridge listening on %1").arg(endpoints.join(", ")));
+}
+
+void MainWindow::toggleSharedMemoryPublisher(bool enabled)
+{
+    if (!enabled) {
+        if (m_serial.isSharedMemoryPublishing()) {
+            m_serial.stopSharedMemoryPublisher();
+            appendLogMessage("Shared-memory publishing stopped");
+        }
+        return;
+    }
+
+    const QString shmName = m_appSettings.read("shm/name", DS_SHM_RING_DEFAULT_NAME).toString();
+    const bool ok = m_serial.startSharedMemoryPublisher(shmName);
+    QString detail;
+    m_serial.runOnIoThread([this, ok, &detail]() {
+        const ShmPublisher &publisher = m_serial.sharedMemoryPublisher();
+        detail = ok ? publisher.name() : publisher.lastError();
+    });
+
+    if (!ok) {
+        appendLogMessage(QString("Shared-memory publishing failed: %1").arg(detail));
+        const QSignalBlocker blocker(m_shmCheck);
+        m_shmCheck->setChecked(false);
+        return;
+    }
+
+    appendLogMessage(QString("Publishing RX to shared memory %1").arg(detail));
+}
+
+void MainWindow::updateBridgeControls()
+{
+    bool active = false;
+    int clients = 0;
+    int observers = 0;
+    m_serial.runOnIoThread([this, &active, &clients, &observers]() {
+        const SerialBridge &bridge = m_serial.bridge();
+        active = bridge.isActive();
+        clients = bridge.clientCount();
+        observers = bridge.observerCount();
+    });
+
+    if (m_bridgeButton != nullptr) {
+        m_bridgeButton->setText(active ? "Stop" : "Listen");
+    }
+
+    for (QWidget *widget : {static_cast<QWidget *>(m_bridgePortSpin),
+                            static_cast<QWidget *>(m_bridgeObserverSpin),
+                            static_cast<QWidget *>(m_bridgeSocketEdit),
+                            static_cast<QWidget *>(m_bridgeLocalOnlyCheck)}) {
+        if (widget != nullptr) {
+            widget->setEnabled(!active);
+        }
+    }
+
+    if (m_bridgeStatusLabel != nullptr) {
+        m_bridgeStatusLabel->setText(active
+            ? QString("%1 clients, %2 observers")
+                  .arg(clients)
+                  .arg(observers)
+            : QString());
+    }
+}
+
+void MainWindow::appendLogMessage(const QString &message, qint64 timestampNs)
 {
     if (m_receiveView == nullptr) {
         return;
     }
 
-    const QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    m_receiveView->append(QString("[%1] %2").arg(timestamp, message));
+    if (timestampNs < 0) {
+        timestampNs = SerialManager::monotonicNowNs();
+    }
+
+    m_receiveView->append(QString("[%1] %2").arg(formatLogTimestamp(timestampNs), message));
+}
+
+void MainWindow::appendTransmitLog(const QString &message, qint64 timestampNs)
+{
+    appendLogMessage(message, timestampNs);
+    m_lastTxTimestampNs = timestampNs;
+}
+
+QString MainWindow::formatLogTimestamp(qint64 timestampNs)
+{
+    const int mode = m_timeModeCombo != nullptr ? m_timeModeCombo->currentIndex() : TimeModeWallClock;
+    const qint64 previousLineNs = m_lastLineTimestampNs;
+    m_lastLineTimestampNs = timestampNs;
+
+    if (mode == TimeModeSincePrevious) {
+        return previousLineNs < 0 ? QString("+-") : formatRelativeTime(timestampNs - previousLineNs);
+    }
+
+    if (mode == TimeModeSinceTransmit) {
+        return m_lastTxTimestampNs < 0 ? QString("TX+-")
+                                       : "TX" + formatRelativeTime(timestampNs - m_lastTxTimestampNs);
+    }
+
+    // The offset is sampled now rather than at startup so an NTP step or a
+    // suspend since then doesn't leave every later line off by that much.
+    const qint64 wallNs = timestampNs + SerialManager::wallClockOffsetNs();
+    const QDateTime wall = QDateTime::fromMSecsSinceEpoch(wallNs / 1000000);
+    return QString("%1%2")
+        .arg(wall.toString("yyyy-MM-dd HH:mm:ss.zzz"))
+        .arg((wallNs / 1000) % 1000, 3, 10, QChar('0'));
+}
+
+void MainWindow::setTerminalMode(bool enabled)
+{
+    if (enabled == isTerminalMode()) {
+        return;
+    }
+
+    if (enabled) {
+        flushPendingSerialData();
+        m_receiveStack->setCurrentWidget(m_terminalView);
+        m_terminalView->setFocus();
+    } else {
+        // Trigger offsets seen while in terminal mode have no log line to land on.
+        m_pendingHighlightOffsets.clear();
+        m_receiveStack->setCurrentWidget(m_receiveView);
+    }
+}
+
+bool MainWindow::isTerminalMode() const
+{
+    return m_receiveStack != nullptr && m_receiveStack->currentWidget() == m_terminalView;
 }
 
-void MainWindow::handleSerialDataReceived(const QByteArray &data)
+void MainWindow::handleSerialDataReceived(const QByteArray &data, qint64 timestampNs)
 {
+    if (isTerminalMode()) {
+        m_rxBytesSeen += data.size();
+        m_terminalView->feed(data);
+        return;
+    }
+
+    // A line is stamped with the arrival of its first byte.
+    if (m_receiveBuffer.isEmpty()) {
+        m_receiveBufferTimestampNs = timestampNs;
+    }
+    qint64 bufferOffset = m_rxBytesSeen - m_receiveBuffer.size();
+    m_rxBytesSeen += data.size();
     m_receiveBuffer.append(data);
 
     qsizetype newlineIndex = m_receiveBuffer.indexOf('\n');
     while (newlineIndex >= 0) {
         const QByteArray line = m_receiveBuffer.left(newlineIndex + 1);
         m_receiveBuffer.remove(0, newlineIndex + 1);
-        appendReceivedDataLog(line);
+        bufferOffset += line.size();
+        appendReceivedDataLog(line, m_receiveBufferTimestampNs, false, takeHighlight(bufferOffset));
+        m_receiveBufferTimestampNs = timestampNs;
         newlineIndex = m_receiveBuffer.indexOf('\n');
     }
 }
 
-void MainWindow::appendReceivedDataLog(const QByteArray &data, bool partial)
+void MainWindow::appendReceivedDataLog(const QByteArray &data, qint64 timestampNs, bool partial, bool highlight)
 {
     const QString prefix = partial ? "RX partial" : "RX";
     appendLogMessage(QString("%1 (%2 bytes): %3")
                          .arg(prefix)
                          .arg(data.size())
-                         .arg(formatReceivedData(data)));
+                         .arg(formatReceivedData(data)),
+                     timestampNs);
+
+    if (highlight) {
+        highlightLastLogLine();
+    }
+}
+
+bool MainWindow::takeHighlight(qint64 lineEndOffset)
+{
+    // Offsets are match ends in stream order; anything up to this line's end belongs to it.
+    bool highlight = false;
+    while (!m_pendingHighlightOffsets.isEmpty() && m_pendingHighlightOffsets.first() <= lineEndOffset) {
+        m_pendingHighlightOffsets.removeFirst();
+        highlight = true;
+    }
+    return highlight;
+}
+
+void MainWindow::highlightLastLogLine()
+{
+    if (m_receiveView == nullptr) {
+        return;
+    }
+
+    QTextCursor cursor(m_receiveView->document()->lastBlock());
+    QTextBlockFormat format = cursor.blockFormat();
+    format.setBackground(QColor(255, 224, 130));
+    cursor.setBlockFormat(format);
 }
 
 void MainWindow::flushPendingSerialData()
@@ -412,8 +897,601 @@ void MainWindow::flushPendingSerialData()
         return;
     }
 
-    appendReceivedDataLog(m_receiveBuffer, true);
+    appendReceivedDataLog(m_receiveBuffer, m_receiveBufferTimestampNs, true, takeHighlight(m_rxBytesSeen));
     m_receiveBuffer.clear();
+    m_receiveBufferTimestampNs = -1;
+}
+
+// Tools and session actions, shared by the log view and terminal menus.
+void MainWindow::addSessionMenuActions(QMenu &menu)
+{
+    const auto showWindow = [](QWidget *window) {
+        window->show();
+        window->raise();
+        window->activateWindow();
+    };
+
+    connect(menu.addAction("Gap histogram..."), &QAction::triggered, this, [this]() {
+        showGapHistogram();
+    });
+    connect(menu.addAction("Triggers..."), &QAction::triggered, this, [this]() {
+        editTriggerRules();
+    });
+    connect(menu.addAction("Responder..."), &QAction::triggered, this, [this]() {
+        editResponder();
+    });
+    connect(menu.addAction("Packet decoder..."), &QAction::triggered, this, [this, showWindow]() {
+        showWindow(m_packetView);
+    });
+    connect(menu.addAction("Merged timeline..."), &QAction::triggered, this, [this, showWindow]() {
+        showWindow(m_timelineView);
+    });
+    connect(menu.addAction("File transfer..."), &QAction::triggered, this, [this, showWindow]() {
+        showWindow(m_fileTransferView);
+    });
+
+    menu.addSeparator();
+
+    QAction *captureAct = menu.addAction(m_captureWriter.isOpen() ? "Stop capture" : "Start capture...");
+    connect(captureAct, &QAction::triggered, this, [this]() {
+        if (m_captureWriter.isOpen()) {
+            stopCapture();
+        } else {
+            startCapture();
+        }
+    });
+    connect(menu.addAction("Session spool..."), &QAction::triggered, this, [this]() {
+        editSpoolOptions();
+    });
+    QAction *exportSessionAct = menu.addAction("Export session...");
+    exportSessionAct->setEnabled(!m_sessionSpool.isEmpty() && !m_exporter.isRunning());
+    connect(exportSessionAct, &QAction::triggered, this, [this]() {
+        exportSession(false);
+    });
+    QAction *exportCaptureAct = menu.addAction("Export capture file...");
+    exportCaptureAct->setEnabled(!m_exporter.isRunning());
+    connect(exportCaptureAct, &QAction::triggered, this, [this]() {
+        exportSession(true);
+    });
+    QAction *mergeCapturesAct = menu.addAction("Merge capture files...");
+    mergeCapturesAct->setEnabled(!m_exporter.isRunning());
+    connect(mergeCapturesAct, &QAction::triggered, this, [this]() {
+        mergeCaptureFiles();
+    });
+}
+
+void MainWindow::showGapHistogram()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Inter-chunk gap histogram");
+    dialog.resize(640, 480);
+
+    auto *layout = new QVBoxLayout(&dialog);
+    auto *text = new QPlainTextEdit;
+    text->setReadOnly(true);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    const auto histogramText = [this]() {
+        QString result;
+        m_serial.runOnIoThread([this, &result]() {
+            result = m_serial.gapHistogram().toText();
+        });
+        return result;
+    };
+    text->setPlainText(histogramText());
+    layout->addWidget(text);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Reset | QDialogButtonBox::Close);
+    layout->addWidget(buttons);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(buttons->button(QDialogButtonBox::Reset), &QPushButton::clicked, &dialog, [this, text, histogramText]() {
+        m_serial.resetGapHistogram();
+        text->setPlainText(histogramText());
+    });
+
+    dialog.exec();
+}
+
+void MainWindow::recordSessionChunk(CaptureDirection direction, const QByteArray &data, qint64 timestampNs)
+{
+    CaptureRecord record;
+    record.timestampNs = recordTimestampNs(timestampNs);
+    record.direction = direction;
+    record.data = data;
+
+    const qint64 dropped = m_sessionSpool.droppedRecords();
+    if (m_sessionSpool.isOpen() && !m_sessionSpool.append(record)) {
+        m_sessionSpool.close();
+        appendLogMessage("Session spool write failed, session export stops here");
+    }
+    if (dropped == 0 && m_sessionSpool.droppedRecords() > 0) {
+        appendLogMessage(QString("Session spool reached %1 MiB, the oldest records are dropped from here on")
+                             .arg(m_sessionSpool.maxBytes() / kMebibyte));
+    }
+
+    if (m_captureWriter.isOpen() && !m_captureWriter.write(record)) {
+        const QString fileName = m_captureWriter.fileName();
+        m_captureWriter.close();
+        appendLogMessage(QString("Capture to %1 failed, recording stopped").arg(fileName));
+    }
+}
+
+qint64 MainWindow::recordTimestampNs(qint64 timestampNs)
+{
+    // Records carry one offset in the file header, so a clock step since it was
+    // taken is folded into the stamp to keep stamp + offset on the wall clock.
+    // A step back would reorder records; those stall at the last stamp instead.
+    const qint64 stepNs = SerialManager::wallClockOffsetNs() - m_recordClockOffsetNs;
+    if (qAbs(stepNs) >= kClockStepNs) {
+        timestampNs += stepNs;
+    }
+
+    timestampNs = std::max(timestampNs, m_lastRecordTimestampNs);
+    m_lastRecordTimestampNs = timestampNs;
+    return timestampNs;
+}
+
+void MainWindow::startCapture()
+{
+    const QString path = QFileDialog::getSaveFileName(this,
+                                                      "Start capture",
+                                                      m_appSettings.read("capture/lastPath").toString(),
+                                                      "Desktop Serial capture (*.dscap)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    m_appSettings.write("capture/lastPath", path);
+    if (!m_captureWriter.open(path, m_recordClockOffsetNs)) {
+        appendLogMessage(QString("Cannot open capture file %1").arg(path));
+        return;
+    }
+
+    appendLogMessage(QString("Capturing to %1").arg(path));
+}
+
+void MainWindow::stopCapture()
+{
+    if (!m_captureWriter.isOpen()) {
+        return;
+    }
+
+    const QString fileName = m_captureWriter.fileName();
+    const qint64 records = m_captureWriter.recordCount();
+    const bool ok = m_captureWriter.close();
+    appendLogMessage(QString("Capture %1 %2 (%3 records)")
+                         .arg(fileName, ok ? "saved" : "failed")
+                         .arg(records));
+}
+
+void MainWindow::exportSession(bool fromCaptureFile)
+{
+    std::unique_ptr<ExportSource> source;
+    QString sourceLabel = "session";
+
+    if (fromCaptureFile) {
+        const QString capturePath = QFileDialog::getOpenFileName(this,
+                                                                 "Export capture file",
+                                                                 m_appSettings.read("capture/lastPath").toString(),
+                                                                 "Desktop Serial capture (*.dscap *.dsca);;All files (*)");
+        if (capturePath.isEmpty()) {
+            return;
+        }
+
+        QString error;
+        source = ExportSource::fromCaptureFile(capturePath, &error);
+        if (source == nullptr) {
+            appendLogMessage(QString("Cannot read %1: %2").arg(capturePath, error));
+            return;
+        }
+        sourceLabel = capturePath;
+    } else {
+        QString error;
+        source = m_sessionSpool.exportSource(&error);
+        if (source == nullptr) {
+            appendLogMessage(QString("Cannot read the session: %1").arg(error));
+            return;
+        }
+        if (m_sessionSpool.droppedRecords() > 0) {
+            appendLogMessage(QString("The %1 oldest session records were dropped by the spool size cap")
+                                 .arg(m_sessionSpool.droppedRecords()));
+        }
+    }
+
+    startExport(std::move(source), sourceLabel);
+}
+
+void MainWindow::loadSpoolSettings()
+{
+    m_sessionSpool.setDirectory(m_appSettings.read("spool/directory").toString());
+    m_sessionSpool.setMaxBytes(
+        m_appSettings.read("spool/maxMiB", SessionSpool::kDefaultMaxBytes / kMebibyte).toLongLong() * kMebibyte);
+}
+
+void MainWindow::editSpoolOptions()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Session spool");
+
+    auto *layout = new QFormLayout(&dialog);
+
+    auto *directoryRow = new QHBoxLayout;
+    auto *directoryEdit = new QLineEdit(m_appSettings.read("spool/directory").toString());
+    directoryEdit->setPlaceholderText(SessionSpool::defaultDirectory());
+    directoryEdit->setToolTip("Keep this off tmpfs, or the spool lives in RAM");
+    auto *browseButton = new QPushButton("Browse...");
+    connect(browseButton, &QPushButton::clicked, &dialog, [&dialog, directoryEdit]() {
+        const QString directory = QFileDialog::getExistingDirectory(&dialog,
+                                                                    "Session spool directory",
+                                                                    directoryEdit->text().isEmpty()
+                                                                        ? directoryEdit->placeholderText()
+                                                                        : directoryEdit->text());
+        if (!directory.isEmpty()) {
+            directoryEdit->setText(directory);
+        }
+    });
+    directoryRow->addWidget(directoryEdit, 1);
+    directoryRow->addWidget(browseButton);
+    layout->addRow("Directory", directoryRow);
+
+    auto *limitSpin = new QSpinBox;
+    limitSpin->setRange(static_cast<int>(SessionSpool::kMinMaxBytes / kMebibyte), 1024 * 1024);
+    limitSpin->setSuffix(" MiB");
+    limitSpin->setValue(static_cast<int>(m_sessionSpool.maxBytes() / kMebibyte));
+    layout->addRow("Size cap", limitSpin);
+
+    layout->addRow(new QLabel(QString("%1 MiB in use, %2 records kept, %3 dropped")
+                                  .arg(m_sessionSpool.sizeOnDisk() / kMebibyte)
+                                  .arg(m_sessionSpool.recordCount())
+                                  .arg(m_sessionSpool.droppedRecords())));
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addRow(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    const QString previousDirectory = m_sessionSpool.directory();
+    m_appSettings.write("spool/directory", directoryEdit->text().trimmed());
+    m_appSettings.write("spool/maxMiB", limitSpin->value());
+    loadSpoolSettings();
+
+    if (m_sessionSpool.directory() != previousDirectory) {
+        appendLogMessage(QString("The session spool moves to %1 the next time the view is cleared")
+                             .arg(m_sessionSpool.directory()));
+    }
+}
+
+void MainWindow::mergeCaptureFiles()
+{
+    const QStringList capturePaths = QFileDialog::getOpenFileNames(this,
+                                                                   "Merge capture files",
+                                                                   m_appSettings.read("capture/lastPath").toString(),
+                                                                   "Desktop Serial capture (*.dscap *.dsca);;All files (*)");
+    if (capturePaths.size() < 2) {
+        if (capturePaths.size() == 1) {
+            appendLogMessage("Pick at least two capture files to merge");
+        }
+        return;
+    }
+
+    QString error;
+    std::unique_ptr<TimelineMerger> merger = TimelineMerger::fromCaptureFiles(capturePaths, &error);
+    if (merger == nullptr) {
+        appendLogMessage(QString("Cannot merge captures: %1").arg(error));
+        return;
+    }
+
+    startExport(std::move(merger), QString("%1 merged captures").arg(capturePaths.size()));
+}
+
+void MainWindow::startExport(std::unique_ptr<ExportSource> source, const QString &sourceLabel)
+{
+    const QString path = QFileDialog::getSaveFileName(this,
+                                                      "Export",
+                                                      m_appSettings.read("export/lastPath").toString(),
+                                                      "CSV (*.csv);;JSON Lines (*.jsonl);;PCAPNG (*.pcapng)");
+    if (path.isEmpty()) {
+        return;
+    }
+    m_appSettings.write("export/lastPath", path);
+
+    if (!m_exporter.start(path, SessionExporter::formatForPath(path), std::move(source))) {
+        appendLogMessage("An export is already running");
+        return;
+    }
+
+    auto *progress = new QProgressDialog(QString("Exporting %1...").arg(sourceLabel), "Cancel", 0, 1000, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(300);
+    connect(progress, &QProgressDialog::canceled, this, [this]() {
+        m_exporter.cancel();
+    });
+
+    auto *timer = new QTimer(progress);
+    connect(timer, &QTimer::timeout, this, [this, progress, path]() {
+        progress->setValue(std::min(m_exporter.progressPermille(), 999));
+        progress->setLabelText(QString("Exporting... %1 records").arg(m_exporter.recordsWritten()));
+
+        if (!m_exporter.isFinished()) {
+            return;
+        }
+
+        if (m_exporter.succeeded()) {
+            appendLogMessage(QString("Exported %1 records to %2").arg(m_exporter.recordsWritten()).arg(path));
+        } else {
+            appendLogMessage(QString("Export to %1 failed: %2").arg(path, m_exporter.errorString()));
+        }
+        progress->close();
+    });
+    timer->start(100);
+}
+
+namespace
+{
+const QStringList kResponderDelimiterNames = {"LF (\\n)", "CR (\\r)", "CRLF (\\r\\n)"};
+const QList<QByteArray> kResponderDelimiters = {"\n", "\r", "\r\n"};
+} // namespace
+
+void MainWindow::loadResponderSettings()
+{
+    const int delimiter = std::clamp(m_appSettings.read("responder/delimiter", 0).toInt(),
+                                     0,
+                                     static_cast<int>(kResponderDelimiters.size()) - 1);
+    m_serial.runOnIoThread([this, delimiter]() {
+        m_serial.responder().setDelimiter(kResponderDelimiters.at(delimiter));
+    });
+
+    QList<ResponderRule> rules;
+    QString error;
+    if (!Responder::parseRules(m_appSettings.read("responder/rules").toString(), rules, &error)) {
+        // Keep the rules that still parse; only the bad lines are dropped.
+        for (const QString &line : error.split('\n')) {
+            appendLogMessage(QString("Saved responder rule skipped: %1").arg(line));
+        }
+    }
+
+    const bool enabled = m_appSettings.read("responder/enabled", false).toBool();
+    m_serial.runOnIoThread([this, &rules, enabled]() {
+        Responder &responder = m_serial.responder();
+        responder.setRules(rules);
+        responder.setEnabled(enabled);
+    });
+}
+
+void MainWindow::editResponder()
+{
+    bool wasEnabled = false;
+    QByteArray currentDelimiter;
+    m_serial.runOnIoThread([this, &wasEnabled, &currentDelimiter]() {
+        wasEnabled = m_serial.responder().isEnabled();
+        currentDelimiter = m_serial.responder().delimiter();
+    });
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Responder");
+    dialog.resize(680, 560);
+
+    auto *layout = new QVBoxLayout(&dialog);
+
+    auto *optionsRow = new QHBoxLayout;
+    auto *enabledCheck = new QCheckBox("Answer incoming frames");
+    enabledCheck->setChecked(wasEnabled);
+    auto *delimiterCombo = createComboBox(kResponderDelimiterNames);
+    delimiterCombo->setCurrentIndex(std::max<qsizetype>(0, kResponderDelimiters.indexOf(currentDelimiter)));
+    optionsRow->addWidget(enabledCheck);
+    optionsRow->addStretch(1);
+    optionsRow->addWidget(new QLabel("Frame delimiter"));
+    optionsRow->addWidget(delimiterCombo);
+    layout->addLayout(optionsRow);
+
+    auto *help = new QLabel(
+        "One rule per line: <b>exact:</b>, <b>prefix:</b>, <b>regex:</b> or <b>hex:</b>match =&gt; response<br>"
+        "Response: text with escapes (\\r \\n \\xHH) and {crc16}, $0 = frame, $1 / ${name} = regex groups, "
+        "or hex:AA 55");
+    help->setTextFormat(Qt::RichText);
+    help->setWordWrap(true);
+    layout->addWidget(help);
+
+    auto *editor = new QPlainTextEdit(m_appSettings.read("responder/rules").toString());
+    editor->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    editor->setPlaceholderText("exact:PING => PONG\\r\\n\n"
+                               "prefix:AT+ => OK\\r\\n\n"
+                               "regex:^GET (?<key>\\w+)$ => VALUE ${key}=42\\r\\n");
+    layout->addWidget(editor, 2);
+
+    auto *stats = new QPlainTextEdit;
+    stats->setReadOnly(true);
+    stats->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    auto refreshStats = [this, stats]() {
+        QString text;
+        m_serial.runOnIoThread([this, &text]() {
+            const Responder &responder = m_serial.responder();
+            text = QString("frames %1, answered %2\nreply latency\n%3")
+                       .arg(responder.framesSeen())
+                       .arg(responder.framesAnswered())
+                       .arg(responder.latency().toText());
+        });
+        stats->setPlainText(text);
+    };
+    refreshStats();
+    layout->addWidget(stats, 1);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel | QDialogButtonBox::Reset);
+    layout->addWidget(buttons);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(buttons->button(QDialogButtonBox::Reset), &QPushButton::clicked, &dialog, [this, refreshStats]() {
+        m_serial.runOnIoThread([this]() {
+            m_serial.responder().resetStatistics();
+        });
+        refreshStats();
+    });
+
+    QList<ResponderRule> rules;
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, [&dialog, editor, &rules]() {
+        QString error;
+        if (!Responder::parseRules(editor->toPlainText(), rules, &error)) {
+            QMessageBox::warning(&dialog, "Responder", error);
+            return;
+        }
+        dialog.accept();
+    });
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    m_appSettings.write("responder/rules", editor->toPlainText());
+    m_appSettings.write("responder/delimiter", delimiterCombo->currentIndex());
+    m_appSettings.write("responder/enabled", enabledCheck->isChecked());
+
+    const QByteArray delimiter = kResponderDelimiters.at(delimiterCombo->currentIndex());
+    const bool enabled = enabledCheck->isChecked();
+    m_serial.runOnIoThread([this, &rules, &delimiter, enabled]() {
+        Responder &responder = m_serial.responder();
+        responder.setRules(rules);
+        responder.setDelimiter(delimiter);
+        responder.setEnabled(enabled);
+    });
+    appendLogMessage(QString("Responder %1 with %2 rules")
+                         .arg(enabled ? "enabled" : "disabled")
+                         .arg(rules.size()));
+}
+
+void MainWindow::loadTriggerRules()
+{
+    QList<TriggerRule> rules;
+    QString error;
+    if (!TriggerEngine::parseRules(m_appSettings.read("triggers/rules").toString(), rules, &error)) {
+        for (const QString &line : error.split('\n')) {
+            appendLogMessage(QString("Saved trigger skipped: %1").arg(line));
+        }
+    }
+
+    m_serial.setTriggerRules(rules);
+}
+
+void MainWindow::editTriggerRules()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Triggers");
+    dialog.resize(640, 420);
+
+    auto *layout = new QVBoxLayout(&dialog);
+    auto *help = new QLabel(
+        "One rule per line: <b>text:</b>pattern or <b>hex:</b>DE AD =&gt; actions<br>"
+        "Actions: highlight, notify, stop, snapshot, reply:text\\r\\n, replyhex:AA 55<br>"
+        "Escapes in text: \\r \\n \\t \\0 \\e \\xHH; replies also take {crc16} and {len}, \\{ for a literal brace");
+    help->setTextFormat(Qt::RichText);
+    layout->addWidget(help);
+
+    auto *editor = new QPlainTextEdit(m_appSettings.read("triggers/rules").toString());
+    editor->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    editor->setPlaceholderText("text:Guru Meditation => highlight, notify, snapshot\n"
+                               "text:ASSERT => highlight, stop");
+    layout->addWidget(editor);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(buttons);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    QList<TriggerRule> rules;
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, [&dialog, editor, &rules]() {
+        QString error;
+        if (!TriggerEngine::parseRules(editor->toPlainText(), rules, &error)) {
+            QMessageBox::warning(&dialog, "Triggers", error);
+            return;
+        }
+        dialog.accept();
+    });
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    m_appSettings.write("triggers/rules", editor->toPlainText());
+    m_serial.setTriggerRules(rules);
+    int stateCount = 0;
+    m_serial.runOnIoThread([this, &stateCount]() {
+        stateCount = m_serial.triggers().stateCount();
+    });
+    appendLogMessage(QString("%1 triggers loaded (%2 automaton states)")
+                         .arg(rules.size())
+                         .arg(stateCount));
+}
+
+void MainWindow::handleTrigger(const TriggerRule &rule, const TriggerMatch &match)
+{
+    if (rule.actions & TriggerHighlight) {
+        m_pendingHighlightOffsets.append(m_rxBytesSeen + match.endInChunk);
+    }
+
+    // The rest waits until the triggering chunk has reached the session and the
+    // capture file, so snapshots and stopped captures include it.
+    QTimer::singleShot(0, this, [this, rule]() {
+        appendLogMessage(QString("Trigger: %1").arg(rule.source));
+
+        if (rule.actions & TriggerReply) {
+            appendLogMessage(QString("Trigger reply (%1 bytes): %2")
+                                 .arg(rule.reply.size())
+                                 .arg(formatReceivedData(rule.reply)));
+        }
+
+        if (rule.actions & TriggerNotify) {
+            showTriggerNotification(rule);
+        }
+
+        if (rule.actions & TriggerSnapshotCapture) {
+            saveTriggerSnapshot(rule);
+        }
+
+        if (rule.actions & TriggerStopCapture) {
+            stopCapture();
+        }
+    });
+}
+
+void MainWindow::showTriggerNotification(const TriggerRule &rule)
+{
+    if (!QSystemTrayIcon::isSystemTrayAvailable()) {
+        QApplication::alert(this);
+        return;
+    }
+
+    if (m_trayIcon == nullptr) {
+        m_trayIcon = new QSystemTrayIcon(windowIcon(), this);
+        m_trayIcon->setToolTip(windowTitle());
+        m_trayIcon->show();
+    }
+
+    m_trayIcon->showMessage("Serial trigger", rule.source, QSystemTrayIcon::Warning);
+}
+
+void MainWindow::saveTriggerSnapshot(const TriggerRule &rule)
+{
+    const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/snapshots";
+    const QString path = QString("%1/trigger-%2.dscap")
+                             .arg(directory, QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz"));
+
+    if (!QDir().mkpath(directory) || !m_sessionSpool.isOpen()) {
+        appendLogMessage(QString("Snapshot for trigger \"%1\" failed").arg(rule.source));
+        return;
+    }
+
+    // The copy runs on the pool; the spool keeps taking records meanwhile.
+    const qint64 records = m_sessionSpool.recordCount();
+    auto *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, path, records, source = rule.source]() {
+        if (watcher->result()) {
+            appendLogMessage(QString("Snapshot saved to %1 (%2 records)").arg(path).arg(records));
+        } else {
+            appendLogMessage(QString("Snapshot for trigger \"%1\" failed").arg(source));
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(m_sessionSpool.saveSnapshot(path));
 }
 
 void MainWindow::updateConnectionControls()
@@ -429,7 +1507,16 @@ void MainWindow::updateConnectionControls()
     }
 
     if (m_sendGroup != nullptr) {
-        m_sendGroup->setEnabled(isConnected);
+        // A transfer owns the line until it ends.
+        bool transferring = false;
+        m_serial.runOnIoThread([this, &transferring]() {
+            transferring = m_serial.fileTransfer().isActive();
+        });
+        m_sendGroup->setEnabled(isConnected && !transferring);
+    }
+
+    if (m_fileTransferView != nullptr) {
+        m_fileTransferView->updateControls();
     }
 }
 
@@ -437,6 +1524,21 @@ SerialConfig MainWindow::buildSerialConfigFromUi() const
 {
     SerialConfig config = m_serial.getConfig();
 
+    if (m_modeCombo != nullptr) {
+        switch (m_modeCombo->currentIndex()) {
+        case 1:
+            config.mode = SerialMode::Rs485;
+            break;
+        case 2:
+            config.mode = SerialMode::Loopback;
+            break;
+        default:
+            config.mode = SerialMode::Free;
+            break;
+        }
+    }
+    config.loopback = m_loopbackConfig;
+
     if (m_portCombo != nullptr) {
         config.portName = m_portCombo->currentText().trimmed();
     }
@@ -497,3 +1599,70 @@ void MainWindow::syncSerialConfigFromUi()
 {
     m_serial.applyConfig(buildSerialConfigFromUi());
 }
+
+void MainWindow::loadLoopbackSettings()
+{
+    m_loopbackConfig.paceToBaud = m_appSettings.read("loopback/paceToBaud", false).toBool();
+    m_loopbackConfig.latencyUs = m_appSettings.read("loopback/latencyUs", 0).toLongLong();
+    m_loopbackConfig.maxFragmentBytes = m_appSettings.read("loopback/maxFragmentBytes", 0).toInt();
+    m_loopbackConfig.bitErrorRate = m_appSettings.read("loopback/bitErrorsPerMillion", 0.0).toDouble() / 1e6;
+    m_loopbackConfig.seed = m_appSettings.read("loopback/seed", 1).toULongLong();
+}
+
+void MainWindow::editLoopbackOptions()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Loopback");
+
+    auto *layout = new QFormLayout(&dialog);
+
+    auto *paceCheck = new QCheckBox("Pace to baud rate");
+    paceCheck->setChecked(m_loopbackConfig.paceToBaud);
+    layout->addRow(paceCheck);
+
+    auto *latencySpin = new QSpinBox;
+    latencySpin->setRange(0, 10000000);
+    latencySpin->setSuffix(" us");
+    latencySpin->setValue(static_cast<int>(m_loopbackConfig.latencyUs));
+    layout->addRow("Latency", latencySpin);
+
+    auto *fragmentSpin = new QSpinBox;
+    fragmentSpin->setRange(0, 1024 * 1024);
+    fragmentSpin->setSpecialValueText("off");
+    fragmentSpin->setSuffix(" bytes");
+    fragmentSpin->setValue(m_loopbackConfig.maxFragmentBytes);
+    layout->addRow("Max fragment", fragmentSpin);
+
+    auto *errorSpin = new QDoubleSpinBox;
+    errorSpin->setRange(0.0, 100000.0);
+    errorSpin->setDecimals(3);
+    errorSpin->setSuffix(" per 10^6 bits");
+    errorSpin->setValue(m_loopbackConfig.bitErrorRate * 1e6);
+    layout->addRow("Bit errors", errorSpin);
+
+    auto *seedSpin = new QSpinBox;
+    seedSpin->setRange(0, std::numeric_limits<int>::max());
+    seedSpin->setValue(static_cast<int>(m_loopbackConfig.seed));
+    layout->addRow("Seed", seedSpin);
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addRow(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    m_appSettings.write("loopback/paceToBaud", paceCheck->isChecked());
+    m_appSettings.write("loopback/latencyUs", latencySpin->value());
+    m_appSettings.write("loopback/maxFragmentBytes", fragmentSpin->value());
+    m_appSettings.write("loopback/bitErrorsPerMillion", errorSpin->value());
+    m_appSettings.write("loopback/seed", seedSpin->value());
+    loadLoopbackSettings();
+    syncSerialConfigFromUi();
+
+    if (m_serial.isLoopback()) {
+        appendLogMessage("Loopback options take effect the next time the port is opened");
+    }
+}
@@ -15,6 +15,8 @@
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QPushButton>
+#include <QtWidgets/QSpinBox>
+#include <QtWidgets/QSystemTrayIcon>
 #include <QtWidgets/QTextEdit>
 #include <QtWidgets/QVBoxLayout>
 #include <QtWidgets/QWidget>
@@ -23,6 +25,13 @@
 
 #include "SerialManager.h"
 #include "AppSettings.h"
+#include "CaptureFile.h"
+#include "FileTransferView.h"
+#include "PacketView.h"
+#include "SessionExporter.h"
+#include "SessionSpool.h"
+#include "TerminalView.h"
+#include "TimelineView.h"
 
 class QCheckBox;
 class QComboBox;
@@ -30,6 +39,8 @@ class QGroupBox;
 class QLabel;
 class QLineEdit;
 class QPushButton;
+class QSpinBox;
+class QStackedWidget;
 class QTextEdit;
 class QWidget;
 
@@ -48,25 +59,82 @@ private:
     QComboBox *m_parityCombo = nullptr;
     QComboBox *m_handshakeCombo = nullptr;
     QComboBox *m_modeCombo = nullptr;
+    QPushButton *m_loopbackButton = nullptr;
+    LoopbackConfig m_loopbackConfig;
     QPushButton *m_openButton = nullptr;
     QCheckBox *m_dtrCheck = nullptr;
     QCheckBox *m_rtsCheck = nullptr;
     QGroupBox *m_sendGroup = nullptr;
+    QSpinBox *m_bridgePortSpin = nullptr;
+    QSpinBox *m_bridgeObserverSpin = nullptr;
+    QLineEdit *m_bridgeSocketEdit = nullptr;
+    QCheckBox *m_bridgeLocalOnlyCheck = nullptr;
+    QPushButton *m_bridgeButton = nullptr;
+    QLabel *m_bridgeStatusLabel = nullptr;
+    QCheckBox *m_shmCheck = nullptr;
     QByteArray m_receiveBuffer;
+    qint64 m_receiveBufferTimestampNs = -1;
+    qint64 m_rxBytesSeen = 0;
+    QList<qint64> m_pendingHighlightOffsets;
+    QSystemTrayIcon *m_trayIcon = nullptr;
+    QComboBox *m_timeModeCombo = nullptr;
+    QComboBox *m_displayModeCombo = nullptr;
+    QStackedWidget *m_receiveStack = nullptr;
+    TerminalView *m_terminalView = nullptr;
+    PacketView *m_packetView = nullptr;
+    TimelineView *m_timelineView = nullptr;
+    FileTransferView *m_fileTransferView = nullptr;
+    qint64 m_recordClockOffsetNs = 0; // header offset shared by session and capture records
+    qint64 m_lastRecordTimestampNs = -1;
+    qint64 m_lastLineTimestampNs = -1;
+    qint64 m_lastTxTimestampNs = -1;
+    SessionSpool m_sessionSpool;
+    CaptureFileWriter m_captureWriter;
+    SessionExporter m_exporter;
 
     QWidget *createSerialPanel();
     QWidget *createModemLinesPanel();
+    QWidget *createBridgePanel();
     QWidget *createSendPanel();
     QWidget *createIndicator(const QString &text, const QColor &color);
-    QGroupBox *createSendRow(const QString &placeholder);
-    void appendLogMessage(const QString &message);
-    void handleSerialDataReceived(const QByteArray &data);
-    void appendReceivedDataLog(const QByteArray &data, bool partial = false);
+    QGroupBox *createSendRow(int index, const QString &placeholder);
+    void appendLogMessage(const QString &message, qint64 timestampNs = -1);
+    void appendTransmitLog(const QString &message, qint64 timestampNs);
+    QString formatLogTimestamp(qint64 timestampNs);
+    void setTerminalMode(bool enabled);
+    bool isTerminalMode() const;
+    void handleSerialDataReceived(const QByteArray &data, qint64 timestampNs);
+    void appendReceivedDataLog(const QByteArray &data, qint64 timestampNs, bool partial = false, bool highlight = false);
+    bool takeHighlight(qint64 lineEndOffset);
+    void highlightLastLogLine();
+    void addSessionMenuActions(QMenu &menu);
+    void showGapHistogram();
+    void recordSessionChunk(CaptureDirection direction, const QByteArray &data, qint64 timestampNs);
+    qint64 recordTimestampNs(qint64 timestampNs);
+    void startCapture();
+    void stopCapture();
+    void exportSession(bool fromCaptureFile);
+    void loadSpoolSettings();
+    void editSpoolOptions();
+    void mergeCaptureFiles();
+    void startExport(std::unique_ptr<ExportSource> source, const QString &sourceLabel);
+    void loadResponderSettings();
+    void editResponder();
+    void loadTriggerRules();
+    void editTriggerRules();
+    void handleTrigger(const TriggerRule &rule, const TriggerMatch &match);
+    void showTriggerNotification(const TriggerRule &rule);
+    void saveTriggerSnapshot(const TriggerRule &rule);
     void flushPendingSerialData();
     void updateConnectionControls();
     void syncSerialConfigFromUi();
+    void loadLoopbackSettings();
+    void editLoopbackOptions();
     SerialConfig buildSerialConfigFromUi() const;
     void connectToDevice();
+    void toggleBridge();
+    void updateBridgeControls();
+    void toggleSharedMemoryPublisher(bool enabled);
 
     QTextEdit *m_receiveView = nullptr;
 };
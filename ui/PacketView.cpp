@@ -0,0 +1,520 @@
+#include "PacketView.h"
+#include "SerialManager.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDateTime>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QFutureWatcher>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPainter>
+#include <QPainterPath>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QSignalBlocker>
+#include <QSplitter>
+#include <QTableView>
+#include <QThreadPool>
+#include <QVBoxLayout>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+constexpr int kRefreshIntervalMs = 250;
+} // namespace
+
+PacketTableModel::PacketTableModel(const PacketSchema &schema, const PacketTable &table, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_schema(schema)
+    , m_table(table)
+{
+}
+
+void PacketTableModel::setLayout(int layoutIndex)
+{
+    beginResetModel();
+    m_layout = layoutIndex;
+    m_shownRows = m_layout >= 0 ? static_cast<int>(m_table.rowCount(m_layout)) : 0;
+    m_shownEvicted = m_layout >= 0 ? m_table.rowsEvicted(m_layout) : 0;
+    endResetModel();
+}
+
+void PacketTableModel::refresh()
+{
+    if (m_layout < 0) {
+        return;
+    }
+
+    const quint64 evicted = m_table.rowsEvicted(m_layout);
+    if (evicted < m_shownEvicted) {
+        setLayout(m_layout);
+        return;
+    }
+    if (evicted > m_shownEvicted) {
+        // A full table drops its oldest rows; take them off the top.
+        const int removed = static_cast<int>(std::min<quint64>(evicted - m_shownEvicted, m_shownRows));
+        if (removed > 0) {
+            beginRemoveRows(QModelIndex(), 0, removed - 1);
+            m_shownRows -= removed;
+            endRemoveRows();
+        }
+        m_shownEvicted = evicted;
+    }
+
+    const int rows = static_cast<int>(std::min<qsizetype>(m_table.rowCount(m_layout), std::numeric_limits<int>::max()));
+    if (rows < m_shownRows) {
+        setLayout(m_layout);
+    } else if (rows > m_shownRows) {
+        beginInsertRows(QModelIndex(), m_shownRows, rows - 1);
+        m_shownRows = rows;
+        endInsertRows();
+    }
+}
+
+int PacketTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_shownRows;
+}
+
+int PacketTableModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || m_layout < 0) {
+        return 0;
+    }
+    return 1 + m_table.columnCount(m_layout);
+}
+
+QVariant PacketTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || m_layout < 0) {
+        return {};
+    }
+
+    if (role == Qt::TextAlignmentRole) {
+        return index.column() == 0 ? QVariant() : QVariant(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+
+    if (index.column() == 0) {
+        const qint64 wallNs = m_table.timestampNs(m_layout, index.row()) + SerialManager::wallClockOffsetNs();
+        return QDateTime::fromMSecsSinceEpoch(wallNs / 1000000).toString("HH:mm:ss.zzz");
+    }
+
+    const int column = index.column() - 1;
+    return PacketTable::formatValue(m_schema.layouts().at(m_layout).columns.at(column),
+                                    m_table.value(m_layout, index.row(), column));
+}
+
+QVariant PacketTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+    if (orientation == Qt::Vertical) {
+        return m_shownEvicted + section + 1;
+    }
+    if (section == 0) {
+        return "Time";
+    }
+    return m_schema.layouts().at(m_layout).columns.at(section - 1).name;
+}
+
+PacketPlot::PacketPlot(const PacketTable &table, QWidget *parent)
+    : QWidget(parent)
+    , m_table(table)
+{
+    setMinimumHeight(120);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void PacketPlot::setSeries(int layoutIndex, int column)
+{
+    m_layout = layoutIndex;
+    m_column = column;
+    update();
+}
+
+void PacketPlot::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    const qsizetype rows = m_layout >= 0 && m_column >= 0 ? m_table.rowCount(m_layout) : 0;
+    const int width = std::max(1, this->width() - 2);
+    if (rows == 0) {
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(rect(), Qt::AlignCenter, "No data");
+        return;
+    }
+
+    // Min/max per pixel column; drawing the vertical span keeps spikes visible.
+    const int buckets = static_cast<int>(std::min<qsizetype>(rows, width));
+    QList<double> lows(buckets, std::numeric_limits<double>::infinity());
+    QList<double> highs(buckets, -std::numeric_limits<double>::infinity());
+    double minimum = std::numeric_limits<double>::infinity();
+    double maximum = -std::numeric_limits<double>::infinity();
+    for (qsizetype row = 0; row < rows; ++row) {
+        const double value = m_table.value(m_layout, row, m_column);
+        if (!std::isfinite(value)) {
+            continue;
+        }
+        const auto bucket = static_cast<int>(row * buckets / rows);
+        lows[bucket] = std::min(lows.at(bucket), value);
+        highs[bucket] = std::max(highs.at(bucket), value);
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+    }
+
+    if (!std::isfinite(minimum)) {
+        return;
+    }
+    if (maximum == minimum) {
+        maximum += 0.5;
+        minimum -= 0.5;
+    }
+
+    const int textHeight = fontMetrics().height();
+    const double top = textHeight + 2;
+    const double height = std::max(1.0, this->height() - top - 2);
+    const auto yFor = [&](double value) {
+        return top + (maximum - value) / (maximum - minimum) * height;
+    };
+    const auto xFor = [&](int bucket) {
+        return 1.0 + (buckets == 1 ? 0.0 : bucket * static_cast<double>(width - 1) / (buckets - 1));
+    };
+
+    QPainterPath path;
+    bool started = false;
+    for (int bucket = 0; bucket < buckets; ++bucket) {
+        if (lows.at(bucket) > highs.at(bucket)) {
+            continue;
+        }
+        const double x = xFor(bucket);
+        if (!started) {
+            path.moveTo(x, yFor(lows.at(bucket)));
+            started = true;
+        } else {
+            path.lineTo(x, yFor(lows.at(bucket)));
+        }
+        path.lineTo(x, yFor(highs.at(bucket)));
+    }
+
+    painter.setRenderHint(QPainter::Antialiasing, buckets < width / 2);
+    painter.setPen(QPen(palette().color(QPalette::Highlight), 1.0));
+    painter.drawPath(path);
+
+    painter.setPen(palette().color(QPalette::Text));
+    painter.drawText(QRect(4, 0, this->width() - 8, textHeight),
+                     Qt::AlignLeft | Qt::AlignVCenter,
+                     QString("max %1   min %2   %3 packets")
+                         .arg(maximum, 0, 'g', 7)
+                         .arg(minimum, 0, 'g', 7)
+                         .arg(rows));
+}
+
+PacketView::PacketView(AppSettings &settings, QWidget *parent)
+    : QWidget(parent, Qt::Window)
+    , m_settings(settings)
+{
+    setWindowTitle("Packet decoder");
+    resize(900, 640);
+
+    auto *layout = new QVBoxLayout(this);
+
+    auto *schemaRow = new QHBoxLayout;
+    auto *schemaButton = new QPushButton("Load schema...");
+    m_schemaLabel = new QLabel("No schema");
+    m_schemaLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    m_decodeCheck = new QCheckBox("Decode RX");
+    m_decodeCheck->setEnabled(false);
+    schemaRow->addWidget(schemaButton);
+    schemaRow->addWidget(m_schemaLabel, 1);
+    schemaRow->addWidget(m_decodeCheck);
+    layout->addLayout(schemaRow);
+
+    auto *viewRow = new QHBoxLayout;
+    m_layoutCombo = new QComboBox;
+    m_layoutCombo->setMinimumContentsLength(12);
+    m_plotCombo = new QComboBox;
+    m_plotCombo->setMinimumContentsLength(12);
+    auto *clearButton = new QPushButton("Clear");
+    m_exportButton = new QPushButton("Export CSV...");
+    viewRow->addWidget(new QLabel("Packet"));
+    viewRow->addWidget(m_layoutCombo);
+    viewRow->addSpacing(12);
+    viewRow->addWidget(new QLabel("Plot"));
+    viewRow->addWidget(m_plotCombo);
+    viewRow->addStretch(1);
+    viewRow->addWidget(clearButton);
+    viewRow->addWidget(m_exportButton);
+    layout->addLayout(viewRow);
+
+    m_model = new PacketTableModel(m_decoder.schema(), m_table, this);
+    m_tableView = new QTableView;
+    m_tableView->setModel(m_model);
+    m_tableView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_tableView->verticalHeader()->setDefaultSectionSize(m_tableView->fontMetrics().height() + 4);
+    m_tableView->horizontalHeader()->setStretchLastSection(true);
+
+    m_plot = new PacketPlot(m_table);
+
+    auto *splitter = new QSplitter(Qt::Vertical);
+    splitter->addWidget(m_tableView);
+    splitter->addWidget(m_plot);
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 1);
+    layout->addWidget(splitter, 1);
+
+    m_statusLabel = new QLabel;
+    layout->addWidget(m_statusLabel);
+
+    connect(schemaButton, &QPushButton::clicked, this, [this]() {
+        chooseSchema();
+    });
+    connect(m_decodeCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        m_decoder.setEnabled(checked);
+        m_settings.write("decoder/enabled", checked);
+        refresh();
+    });
+    connect(m_layoutCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        selectLayout(index);
+    });
+    connect(m_plotCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        m_plot->setSeries(m_layoutCombo->currentIndex(), index);
+    });
+    connect(clearButton, &QPushButton::clicked, this, [this]() {
+        clear();
+    });
+    connect(m_exportButton, &QPushButton::clicked, this, [this]() {
+        exportCsv();
+    });
+
+    m_refreshTimer.setInterval(kRefreshIntervalMs);
+    connect(&m_refreshTimer, &QTimer::timeout, this, [this]() {
+        refresh();
+    });
+
+    m_table.reset(m_decoder.schema());
+    refresh();
+}
+
+void PacketView::setLogCallback(LogCallback callback)
+{
+    m_logCallback = std::move(callback);
+}
+
+bool PacketView::restoreSettings(QString *errorString)
+{
+    const QString path = m_settings.read("decoder/schemaPath").toString();
+    if (path.isEmpty()) {
+        return true;
+    }
+
+    if (!loadSchema(path, errorString)) {
+        return false;
+    }
+    m_decodeCheck->setChecked(m_settings.read("decoder/enabled", false).toBool());
+    return true;
+}
+
+bool PacketView::loadSchema(const QString &path, QString *errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString != nullptr) {
+            *errorString = QString("%1: %2").arg(path, file.errorString());
+        }
+        return false;
+    }
+
+    PacketSchema schema;
+    QString error;
+    if (!PacketSchema::compile(file.readAll(), schema, &error)) {
+        if (errorString != nullptr) {
+            *errorString = QString("%1: %2").arg(path, error);
+        }
+        return false;
+    }
+
+    // The model and plot read through the decoder's schema, so swap everything under a reset.
+    m_model->setLayout(-1);
+    m_plot->setSeries(-1, -1);
+    m_decoder.setSchema(schema);
+    m_table.reset(m_decoder.schema());
+
+    {
+        const QSignalBlocker blocker(m_layoutCombo);
+        m_layoutCombo->clear();
+        for (const PacketLayout &layout : m_decoder.schema().layouts()) {
+            m_layoutCombo->addItem(layout.name);
+        }
+    }
+    selectLayout(0);
+
+    m_schemaLabel->setText(QFileInfo(path).fileName());
+    m_schemaLabel->setToolTip(path);
+    m_decodeCheck->setEnabled(true);
+    m_settings.write("decoder/schemaPath", path);
+    refresh();
+    return true;
+}
+
+void PacketView::feed(const QByteArray &data, qint64 timestampNs)
+{
+    m_decoder.feed(data, timestampNs, m_table);
+}
+
+void PacketView::clear()
+{
+    m_table.clear();
+    m_decoder.reset();
+    m_decoder.resetStatistics();
+    m_model->refresh();
+    refresh();
+}
+
+bool PacketView::isDecoding() const
+{
+    return m_decoder.isEnabled() && m_decoder.schema().isValid();
+}
+
+void PacketView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    m_refreshTimer.start();
+}
+
+void PacketView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_refreshTimer.stop();
+}
+
+void PacketView::chooseSchema()
+{
+    const QString path = QFileDialog::getOpenFileName(this,
+                                                      "Load packet schema",
+                                                      m_settings.read("decoder/schemaPath").toString(),
+                                                      "Packet schema (*.json);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    if (!loadSchema(path, &error)) {
+        QMessageBox::warning(this, "Packet schema", error);
+        return;
+    }
+    log(QString("Packet schema %1 loaded (%2 packet types)")
+            .arg(path)
+            .arg(m_decoder.schema().layouts().size()));
+}
+
+void PacketView::exportCsv()
+{
+    const int layoutIndex = m_layoutCombo->currentIndex();
+    if (layoutIndex < 0 || m_table.rowCount(layoutIndex) == 0) {
+        return;
+    }
+
+    const QString path = QFileDialog::getSaveFileName(this,
+                                                      "Export packets",
+                                                      m_settings.read("decoder/exportPath").toString(),
+                                                      "CSV (*.csv)");
+    if (path.isEmpty()) {
+        return;
+    }
+    m_settings.write("decoder/exportPath", path);
+
+    // Formatting a full table takes seconds, so it's written from a copy on
+    // the pool. The copy shares the row lists until decoding next appends.
+    const qsizetype rows = m_table.rowCount(layoutIndex);
+    const QString layoutName = m_layoutCombo->currentText();
+    m_exportButton->setEnabled(false);
+    auto *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, path, rows, layoutName]() {
+        m_exportButton->setEnabled(true);
+        const QString error = watcher->result();
+        if (error.isEmpty()) {
+            log(QString("Exported %1 %2 packets to %3").arg(rows).arg(layoutName, path));
+        } else {
+            QMessageBox::warning(this, "Export packets", QString("%1: %2").arg(path, error));
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(QThreadPool::globalInstance(),
+                                         [table = m_table,
+                                          schema = m_decoder.schema(),
+                                          layoutIndex,
+                                          offsetNs = SerialManager::wallClockOffsetNs(),
+                                          path]() {
+                                             QString error;
+                                             if (!table.writeCsv(path, schema, layoutIndex, offsetNs, &error)) {
+                                                 return error.isEmpty() ? QString("write failed") : error;
+                                             }
+                                             return QString();
+                                         }));
+}
+
+void PacketView::selectLayout(int layoutIndex)
+{
+    m_model->setLayout(layoutIndex);
+    m_tableView->resizeColumnsToContents();
+
+    const QSignalBlocker blocker(m_plotCombo);
+    m_plotCombo->clear();
+    if (layoutIndex >= 0) {
+        for (const PacketColumn &column : m_decoder.schema().layouts().at(layoutIndex).columns) {
+            m_plotCombo->addItem(column.name);
+        }
+    }
+
+    // Plot the first packet field rather than the header by default.
+    const int headerColumns = m_decoder.schema().headerColumnCount();
+    const int plotColumn = headerColumns < m_plotCombo->count() ? headerColumns : m_plotCombo->count() - 1;
+    m_plotCombo->setCurrentIndex(plotColumn);
+    m_plot->setSeries(layoutIndex, plotColumn);
+}
+
+void PacketView::refresh()
+{
+    const bool atBottom = m_tableView->verticalScrollBar()->value() == m_tableView->verticalScrollBar()->maximum();
+    m_model->refresh();
+    if (atBottom) {
+        m_tableView->scrollToBottom();
+    }
+    m_plot->update();
+
+    QString status = QString("%1 packets decoded, %2 bytes skipped")
+                         .arg(m_decoder.packetsDecoded())
+                         .arg(m_decoder.bytesSkipped());
+    if (m_table.rowsEvicted() > 0) {
+        status += QString(", table full: oldest %1 dropped").arg(m_table.rowsEvicted());
+    }
+    if (!m_decoder.isEnabled()) {
+        status += " (decoding off)";
+    }
+    m_statusLabel->setText(status);
+}
+
+void PacketView::log(const QString &message)
+{
+    if (m_logCallback) {
+        m_logCallback(message);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QByteArray>
+#include <QtCore/QTimer>
+#include <QtWidgets/QWidget>
+
+#include <functional>
+
+#include "AppSettings.h"
+#include "PacketDecoder.h"
+
+class QCheckBox;
+class QComboBox;
+class QHideEvent;
+class QLabel;
+class QPaintEvent;
+class QPushButton;
+class QShowEvent;
+class QTableView;
+
+// Read-only view of one packet type in a PacketTable. Between clears rows are
+// only appended or, once the table is full, evicted from the top, so refresh()
+// reports them as inserts and removals and the view keeps its scroll position.
+class PacketTableModel : public QAbstractTableModel
+{
+public:
+    PacketTableModel(const PacketSchema &schema, const PacketTable &table, QObject *parent = nullptr);
+
+    void setLayout(int layoutIndex);
+    void refresh();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    const PacketSchema &m_schema;
+    const PacketTable &m_table;
+    int m_layout = -1;
+    int m_shownRows = 0;
+    quint64 m_shownEvicted = 0;
+};
+
+// One column of a packet type against packet index, reduced to a min/max pair
+// per pixel so a million rows cost one pass and a few hundred line segments.
+class PacketPlot : public QWidget
+{
+public:
+    PacketPlot(const PacketTable &table, QWidget *parent = nullptr);
+
+    void setSeries(int layoutIndex, int column);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    const PacketTable &m_table;
+    int m_layout = -1;
+    int m_column = -1;
+};
+
+// Decodes RX through a packet schema and shows the packets as a table and a
+// plot. Decoding keeps running while the window is hidden.
+class PacketView : public QWidget
+{
+public:
+    using LogCallback = std::function<void(const QString &message)>;
+
+    PacketView(AppSettings &settings, QWidget *parent = nullptr);
+
+    void setLogCallback(LogCallback callback);
+    bool restoreSettings(QString *errorString = nullptr);
+    bool loadSchema(const QString &path, QString *errorString = nullptr);
+    void feed(const QByteArray &data, qint64 timestampNs);
+    void clear();
+    bool isDecoding() const;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    AppSettings &m_settings;
+    PacketDecoder m_decoder;
+    PacketTable m_table;
+    PacketTableModel *m_model = nullptr;
+    PacketPlot *m_plot = nullptr;
+    QTableView *m_tableView = nullptr;
+    QLabel *m_schemaLabel = nullptr;
+    QCheckBox *m_decodeCheck = nullptr;
+    QComboBox *m_layoutCombo = nullptr;
+    QComboBox *m_plotCombo = nullptr;
+    QLabel *m_statusLabel = nullptr;
+    QPushButton *m_exportButton = nullptr;
+    QTimer m_refreshTimer;
+    LogCallback m_logCallback;
+
+    void chooseSchema();
+    void exportCsv();
+    void selectLayout(int layoutIndex);
+    void refresh();
+    void log(const QString &message);
+};
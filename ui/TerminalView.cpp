@@ -0,0 +1,525 @@
+#include "TerminalView.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QFocusEvent>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QMenu>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QRegion>
+#include <QScrollBar>
+#include <QSignalBlocker>
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+constexpr int kFrameIntervalMs = 16;
+const QColor kDefaultForeground(0xd0, 0xd0, 0xd0);
+const QColor kDefaultBackground(0x1e, 0x1e, 0x1e);
+
+// xterm's 256-colour palette: 16 base colours, a 6x6x6 cube, then a grey ramp.
+QColor paletteColor(int index)
+{
+    static const QRgb kBaseColors[16] = {
+        0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd, 0xe5e5e5,
+        0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff,
+    };
+
+    if (index < 16) {
+        return QColor(kBaseColors[index]);
+    }
+
+    if (index < 232) {
+        const int cube = index - 16;
+        const auto level = [](int value) { return value == 0 ? 0 : 55 + value * 40; };
+        return QColor(level(cube / 36), level((cube / 6) % 6), level(cube % 6));
+    }
+
+    const int gray = 8 + (index - 232) * 10;
+    return QColor(gray, gray, gray);
+}
+} // namespace
+
+TerminalView::TerminalView(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , m_parser(m_grid)
+{
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setStyleHint(QFont::TypeWriter);
+    setFont(font);
+    for (int style = 0; style < 4; ++style) {
+        m_fonts[style] = font;
+        m_fonts[style].setBold((style & 1) != 0);
+        m_fonts[style].setItalic((style & 2) != 0);
+    }
+
+    const QFontMetrics metrics(font);
+    m_cellWidth = std::max(1, metrics.horizontalAdvance(QLatin1Char('M')));
+    m_cellHeight = std::max(1, metrics.height());
+    m_ascent = metrics.ascent();
+
+    // Every pixel of an update region is painted, so Qt can skip the background
+    // fill and keep the rest of the backing store as it is.
+    viewport()->setAttribute(Qt::WA_OpaquePaintEvent);
+    setFocusPolicy(Qt::StrongFocus);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setInterval(kFrameIntervalMs);
+    connect(&m_frameTimer, &QTimer::timeout, this, [this]() {
+        flushDamage();
+    });
+
+    m_parser.setReplyCallback([this](const QByteArray &reply) {
+        if (m_sendCallback) {
+            m_sendCallback(reply);
+        }
+    });
+}
+
+void TerminalView::setSendCallback(SendCallback callback)
+{
+    m_sendCallback = std::move(callback);
+}
+
+void TerminalView::setContextMenuCallback(ContextMenuCallback callback)
+{
+    m_contextMenuCallback = std::move(callback);
+}
+
+void TerminalView::feed(const QByteArray &data)
+{
+    // Parse now, paint at most once per frame however many chunks arrive.
+    m_parser.feed(data);
+    if (!m_frameTimer.isActive()) {
+        m_frameTimer.start();
+    }
+}
+
+void TerminalView::reset()
+{
+    m_grid.reset();
+    m_parser.reset();
+    flushDamage();
+}
+
+void TerminalView::clearScrollback()
+{
+    m_grid.clearScrollback();
+    flushDamage();
+}
+
+TerminalGrid &TerminalView::grid()
+{
+    return m_grid;
+}
+
+QString TerminalView::title() const
+{
+    return m_parser.title();
+}
+
+bool TerminalView::isFollowingOutput() const
+{
+    return verticalScrollBar()->value() == verticalScrollBar()->maximum();
+}
+
+int TerminalView::viewOffset() const
+{
+    return verticalScrollBar()->value() - verticalScrollBar()->maximum();
+}
+
+QRect TerminalView::cellRect(int row, int firstColumn, int lastColumn) const
+{
+    return QRect(firstColumn * m_cellWidth,
+                 row * m_cellHeight,
+                 (lastColumn - firstColumn + 1) * m_cellWidth,
+                 m_cellHeight);
+}
+
+void TerminalView::updateScrollBar()
+{
+    QScrollBar *bar = verticalScrollBar();
+    const bool follow = isFollowingOutput();
+    const int value = bar->value();
+
+    // Blocked so growing history does not trigger scrollContentsBy() and a full repaint.
+    const QSignalBlocker blocker(bar);
+    bar->setRange(0, m_grid.scrollbackSize());
+    bar->setPageStep(m_grid.rows());
+    bar->setValue(follow ? bar->maximum() : value);
+}
+
+void TerminalView::updateGridSize()
+{
+    m_grid.resize(viewport()->width() / m_cellWidth, viewport()->height() / m_cellHeight);
+    flushDamage();
+}
+
+void TerminalView::flushDamage()
+{
+    m_frameTimer.stop();
+
+    TerminalDamage damage;
+    m_grid.takeDamage(damage);
+    const bool follow = isFollowingOutput();
+    updateScrollBar();
+
+    if (!follow || damage.full) {
+        viewport()->update();
+        return;
+    }
+
+    if (damage.scrolledLines > 0) {
+        const QRect gridRect(0, 0, m_grid.columns() * m_cellWidth, m_grid.rows() * m_cellHeight);
+        viewport()->scroll(0, -damage.scrolledLines * m_cellHeight, gridRect);
+        m_drawnCursorRow -= damage.scrolledLines;
+    }
+
+    for (const TerminalRowDamage &row : damage.rows) {
+        viewport()->update(cellRect(row.row, row.firstColumn, row.lastColumn));
+    }
+
+    if (m_drawnCursorRow >= 0) {
+        viewport()->update(cellRect(m_drawnCursorRow, m_drawnCursorColumn, m_drawnCursorColumn));
+    }
+    viewport()->update(cellRect(m_grid.cursorRow(), m_grid.cursorColumn(), m_grid.cursorColumn()));
+}
+
+QColor TerminalView::resolveColor(quint32 color, bool foreground, bool bold) const
+{
+    if (color == kTerminalDefaultColor) {
+        return foreground ? kDefaultForeground : kDefaultBackground;
+    }
+
+    if ((color & kTerminalRgbColor) != 0) {
+        return QColor(static_cast<QRgb>(color & 0xffffff));
+    }
+
+    int index = static_cast<int>(color);
+    if (foreground && bold && index < 8) {
+        index += 8;
+    }
+    return paletteColor(index);
+}
+
+void TerminalView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    const QRect gridRect(0, 0, m_grid.columns() * m_cellWidth, m_grid.rows() * m_cellHeight);
+
+    for (const QRect &rect : event->region()) {
+        const QRect cells = rect.intersected(gridRect);
+        if (!cells.isEmpty()) {
+            const int firstColumn = cells.left() / m_cellWidth;
+            const int lastColumn = cells.right() / m_cellWidth;
+            for (int row = cells.top() / m_cellHeight; row <= cells.bottom() / m_cellHeight; ++row) {
+                drawCells(painter, row, firstColumn, lastColumn);
+            }
+        }
+    }
+
+    for (const QRect &margin : event->region().subtracted(gridRect)) {
+        painter.fillRect(margin, kDefaultBackground);
+    }
+
+    drawCursor(painter);
+}
+
+void TerminalView::drawCells(QPainter &painter, int viewRow, int firstColumn, int lastColumn)
+{
+    const TerminalLine &line = m_grid.lineAt(viewRow + viewOffset());
+    const TerminalCell blank;
+    const auto cellAt = [&line, &blank](int column) -> const TerminalCell & {
+        return column < line.size() ? line.at(column) : blank;
+    };
+
+    const int baseline = viewRow * m_cellHeight + m_ascent;
+    int column = firstColumn;
+
+    // One fill and one drawText per run of cells sharing a style.
+    while (column <= lastColumn) {
+        const TerminalCell &style = cellAt(column);
+        int end = column + 1;
+        while (end <= lastColumn && cellAt(end).sameStyle(style)) {
+            ++end;
+        }
+
+        QColor foreground = resolveColor(style.fg, true, (style.attrs & TerminalBold) != 0);
+        QColor background = resolveColor(style.bg, false, false);
+        if ((style.attrs & TerminalInverse) != 0) {
+            std::swap(foreground, background);
+        }
+        if ((style.attrs & TerminalDim) != 0) {
+            foreground = foreground.darker(150);
+        }
+
+        const QRect runRect = cellRect(viewRow, column, end - 1);
+        painter.fillRect(runRect, background);
+
+        if ((style.attrs & TerminalHidden) == 0) {
+            QString text;
+            text.reserve(end - column);
+            bool ascii = true;
+            bool blankRun = true;
+            for (int i = column; i < end; ++i) {
+                const char32_t ch = cellAt(i).ch;
+                ascii = ascii && ch < 0x80;
+                blankRun = blankRun && ch == U' ';
+                if (ch < 0x80) {
+                    text.append(QLatin1Char(static_cast<char>(ch)));
+                } else {
+                    text.append(QString::fromUcs4(&ch, 1));
+                }
+            }
+
+            const bool decorated = (style.attrs & (TerminalUnderline | TerminalStrike)) != 0;
+            if (!blankRun || decorated) {
+                QFont font = m_fonts[((style.attrs & TerminalBold) != 0 ? 1 : 0) | ((style.attrs & TerminalItalic) != 0 ? 2 : 0)];
+                font.setUnderline((style.attrs & TerminalUnderline) != 0);
+                font.setStrikeOut((style.attrs & TerminalStrike) != 0);
+                painter.setFont(font);
+                painter.setPen(foreground);
+
+                if (ascii) {
+                    painter.drawText(runRect.left(), baseline, text);
+                } else {
+                    // Fallback glyphs may not match the cell width, so pin each one to its cell.
+                    for (int i = column; i < end; ++i) {
+                        const char32_t ch = cellAt(i).ch;
+                        painter.drawText(i * m_cellWidth, baseline, QString::fromUcs4(&ch, 1));
+                    }
+                }
+            }
+        }
+
+        column = end;
+    }
+}
+
+void TerminalView::drawCursor(QPainter &painter)
+{
+    m_drawnCursorRow = -1;
+    if (!m_grid.isCursorVisible() || !isFollowingOutput()) {
+        return;
+    }
+
+    m_drawnCursorRow = m_grid.cursorRow();
+    m_drawnCursorColumn = m_grid.cursorColumn();
+    const QRect rect = cellRect(m_drawnCursorRow, m_drawnCursorColumn, m_drawnCursorColumn);
+
+    if (!hasFocus()) {
+        painter.setPen(kDefaultForeground);
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(rect.adjusted(0, 0, -1, -1));
+        return;
+    }
+
+    const TerminalLine &line = m_grid.lineAt(m_drawnCursorRow);
+    const char32_t ch = m_drawnCursorColumn < line.size() ? line.at(m_drawnCursorColumn).ch : U' ';
+    painter.fillRect(rect, kDefaultForeground);
+    painter.setFont(m_fonts[0]);
+    painter.setPen(kDefaultBackground);
+    painter.drawText(rect.left(), rect.top() + m_ascent, QString::fromUcs4(&ch, 1));
+}
+
+void TerminalView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateGridSize();
+}
+
+void TerminalView::scrollContentsBy(int, int)
+{
+    viewport()->update();
+}
+
+bool TerminalView::focusNextPrevChild(bool)
+{
+    // Tab belongs to the remote shell.
+    return false;
+}
+
+void TerminalView::focusInEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusInEvent(event);
+    viewport()->update(cellRect(m_grid.cursorRow(), m_grid.cursorColumn(), m_grid.cursorColumn()));
+}
+
+void TerminalView::focusOutEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusOutEvent(event);
+    viewport()->update(cellRect(m_grid.cursorRow(), m_grid.cursorColumn(), m_grid.cursorColumn()));
+}
+
+void TerminalView::keyPressEvent(QKeyEvent *event)
+{
+    const Qt::KeyboardModifiers modifiers = event->modifiers();
+    const int key = event->key();
+
+    if (modifiers == Qt::ShiftModifier && (key == Qt::Key_PageUp || key == Qt::Key_PageDown)) {
+        verticalScrollBar()->triggerAction(key == Qt::Key_PageUp ? QAbstractSlider::SliderPageStepSub
+                                                                  : QAbstractSlider::SliderPageStepAdd);
+        return;
+    }
+
+    if ((modifiers == Qt::ShiftModifier && key == Qt::Key_Insert)
+        || (modifiers == (Qt::ControlModifier | Qt::ShiftModifier) && key == Qt::Key_V)) {
+        pasteClipboard();
+        return;
+    }
+
+    const QByteArray data = encodeKey(event);
+    if (data.isEmpty()) {
+        QAbstractScrollArea::keyPressEvent(event);
+        return;
+    }
+
+    send(data);
+}
+
+QByteArray TerminalView::encodeKey(const QKeyEvent *event) const
+{
+    const bool applicationCursor = m_grid.applicationCursorKeys();
+
+    switch (event->key()) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        return "\r";
+    case Qt::Key_Backspace:
+        return "\x7f";
+    case Qt::Key_Tab:
+        return "\t";
+    case Qt::Key_Backtab:
+        return "\x1b[Z";
+    case Qt::Key_Escape:
+        return "\x1b";
+    case Qt::Key_Up:
+        return applicationCursor ? "\x1bOA" : "\x1b[A";
+    case Qt::Key_Down:
+        return applicationCursor ? "\x1bOB" : "\x1b[B";
+    case Qt::Key_Right:
+        return applicationCursor ? "\x1bOC" : "\x1b[C";
+    case Qt::Key_Left:
+        return applicationCursor ? "\x1bOD" : "\x1b[D";
+    case Qt::Key_Home:
+        return applicationCursor ? "\x1bOH" : "\x1b[H";
+    case Qt::Key_End:
+        return applicationCursor ? "\x1bOF" : "\x1b[F";
+    case Qt::Key_Insert:
+        return "\x1b[2~";
+    case Qt::Key_Delete:
+        return "\x1b[3~";
+    case Qt::Key_PageUp:
+        return "\x1b[5~";
+    case Qt::Key_PageDown:
+        return "\x1b[6~";
+    case Qt::Key_F1:
+        return "\x1bOP";
+    case Qt::Key_F2:
+        return "\x1bOQ";
+    case Qt::Key_F3:
+        return "\x1bOR";
+    case Qt::Key_F4:
+        return "\x1bOS";
+    case Qt::Key_F5:
+        return "\x1b[15~";
+    case Qt::Key_F6:
+        return "\x1b[17~";
+    case Qt::Key_F7:
+        return "\x1b[18~";
+    case Qt::Key_F8:
+        return "\x1b[19~";
+    case Qt::Key_F9:
+        return "\x1b[20~";
+    case Qt::Key_F10:
+        return "\x1b[21~";
+    case Qt::Key_F11:
+        return "\x1b[23~";
+    case Qt::Key_F12:
+        return "\x1b[24~";
+    default:
+        break;
+    }
+
+    const Qt::KeyboardModifiers modifiers = event->modifiers();
+    if ((modifiers & Qt::ControlModifier) != 0) {
+        const int key = event->key();
+        if (key >= Qt::Key_A && key <= Qt::Key_Z) {
+            return QByteArray(1, static_cast<char>(key - Qt::Key_A + 1));
+        }
+        switch (key) {
+        case Qt::Key_At:
+        case Qt::Key_Space:
+            return QByteArray(1, '\0');
+        case Qt::Key_BracketLeft:
+            return "\x1b";
+        case Qt::Key_Backslash:
+            return "\x1c";
+        case Qt::Key_BracketRight:
+            return "\x1d";
+        case Qt::Key_AsciiCircum:
+            return "\x1e";
+        case Qt::Key_Underscore:
+            return "\x1f";
+        default:
+            break;
+        }
+    }
+
+    QByteArray text = event->text().toUtf8();
+    if (!text.isEmpty() && (modifiers & Qt::AltModifier) != 0) {
+        text.prepend('\x1b');
+    }
+    return text;
+}
+
+void TerminalView::send(const QByteArray &data)
+{
+    if (!m_sendCallback) {
+        return;
+    }
+
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    m_sendCallback(data);
+}
+
+void TerminalView::pasteClipboard()
+{
+    QByteArray data = QApplication::clipboard()->text().toUtf8();
+    data.replace("\r\n", "\r");
+    data.replace('\n', '\r');
+    if (!data.isEmpty()) {
+        send(data);
+    }
+}
+
+void TerminalView::contextMenuEvent(QContextMenuEvent *event)
+{
+    QMenu menu(this);
+    QAction *pasteAct = menu.addAction("Paste");
+    pasteAct->setEnabled(static_cast<bool>(m_sendCallback));
+    menu.addSeparator();
+    QAction *clearAct = menu.addAction("Clear scrollback");
+    QAction *resetAct = menu.addAction("Reset terminal");
+    if (m_contextMenuCallback) {
+        menu.addSeparator();
+        m_contextMenuCallback(menu);
+    }
+
+    QAction *selected = menu.exec(event->globalPos());
+    if (selected == pasteAct) {
+        pasteClipboard();
+    } else if (selected == clearAct) {
+        clearScrollback();
+    } else if (selected == resetAct) {
+        reset();
+    }
+}
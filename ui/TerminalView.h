@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QTimer>
+#include <QtGui/QColor>
+#include <QtGui/QFont>
+#include <QtWidgets/QAbstractScrollArea>
+
+#include <functional>
+
+#include "TerminalGrid.h"
+#include "VtParser.h"
+
+class QContextMenuEvent;
+class QFocusEvent;
+class QKeyEvent;
+class QMenu;
+class QPaintEvent;
+class QPainter;
+class QResizeEvent;
+
+// Terminal display: RX goes through VtParser into a TerminalGrid, and repaints
+// are batched on a frame timer so only the cells damaged since the last frame
+// are redrawn. Whole-screen scrolls are blitted with QWidget::scroll(). Key
+// presses are encoded as xterm input and handed to the send callback.
+class TerminalView : public QAbstractScrollArea
+{
+public:
+    using SendCallback = std::function<void(const QByteArray &data)>;
+    // Appends the owner's actions below the terminal's own.
+    using ContextMenuCallback = std::function<void(QMenu &menu)>;
+
+    explicit TerminalView(QWidget *parent = nullptr);
+
+    void setSendCallback(SendCallback callback);
+    void setContextMenuCallback(ContextMenuCallback callback);
+    void feed(const QByteArray &data);
+    void reset();
+    void clearScrollback();
+    TerminalGrid &grid();
+    QString title() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    bool focusNextPrevChild(bool next) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+    void focusInEvent(QFocusEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
+
+private:
+    TerminalGrid m_grid;
+    VtParser m_parser;
+    SendCallback m_sendCallback;
+    ContextMenuCallback m_contextMenuCallback;
+    QTimer m_frameTimer;
+    QFont m_fonts[4]; // regular, bold, italic, bold italic
+    int m_cellWidth = 8;
+    int m_cellHeight = 16;
+    int m_ascent = 12;
+    int m_drawnCursorRow = -1;
+    int m_drawnCursorColumn = -1;
+
+    void flushDamage();
+    void updateScrollBar();
+    void updateGridSize();
+    bool isFollowingOutput() const;
+    int viewOffset() const;
+    QRect cellRect(int row, int firstColumn, int lastColumn) const;
+    QColor resolveColor(quint32 color, bool foreground, bool bold) const;
+    void drawCells(QPainter &painter, int viewRow, int firstColumn, int lastColumn);
+    void drawCursor(QPainter &painter);
+    QByteArray encodeKey(const QKeyEvent *event) const;
+    void send(const QByteArray &data);
+    void pasteClipboard();
+};
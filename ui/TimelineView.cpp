@@ -0,0 +1,263 @@
+#include "TimelineView.h"
+#include "GapHistogram.h"
+
+#include <QComboBox>
+#include <QDateTime>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QListWidget>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+constexpr int kStatusIntervalMs = 250;
+const QStringList kBaudRates = {"9600", "19200", "38400", "57600", "115200", "230400", "460800", "921600"};
+} // namespace
+
+TimelineView::TimelineView(AppSettings &settings, QWidget *parent)
+    : QWidget(parent, Qt::Window)
+    , m_settings(settings)
+{
+    setWindowTitle("Merged timeline");
+    resize(900, 600);
+
+    auto *layout = new QVBoxLayout(this);
+
+    auto *portRow = new QHBoxLayout;
+    m_portCombo = new QComboBox;
+    m_portCombo->setEditable(true);
+    m_portCombo->setMinimumContentsLength(14);
+    for (const QSerialPortInfo &port : QSerialPortInfo::availablePorts()) {
+        m_portCombo->addItem(port.portName());
+    }
+    m_baudCombo = new QComboBox;
+    m_baudCombo->addItems(kBaudRates);
+    m_baudCombo->setCurrentText(m_settings.read("timeline/baudRate", "115200").toString());
+    auto *addButton = new QPushButton("Add port");
+    auto *removeButton = new QPushButton("Remove");
+    m_holdSpin = new QSpinBox;
+    m_holdSpin->setRange(0, 5000);
+    m_holdSpin->setSuffix(" ms");
+    m_holdSpin->setValue(m_settings.read("timeline/holdMs",
+                                         static_cast<int>(LiveTimelineMerger::kDefaultHoldNs / 1000000)).toInt());
+    m_holdSpin->setToolTip("Longest a chunk waits for a quiet port before it is shown");
+    portRow->addWidget(new QLabel("Port"));
+    portRow->addWidget(m_portCombo);
+    portRow->addWidget(m_baudCombo);
+    portRow->addWidget(addButton);
+    portRow->addWidget(removeButton);
+    portRow->addStretch(1);
+    portRow->addWidget(new QLabel("Hold"));
+    portRow->addWidget(m_holdSpin);
+    layout->addLayout(portRow);
+
+    m_channelList = new QListWidget;
+    m_channelList->setMaximumHeight(90);
+    layout->addWidget(m_channelList);
+
+    m_output = new QPlainTextEdit;
+    m_output->setReadOnly(true);
+    m_output->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_output->setMaximumBlockCount(kMaxLines);
+    m_output->setLineWrapMode(QPlainTextEdit::NoWrap);
+    layout->addWidget(m_output, 1);
+
+    auto *statusRow = new QHBoxLayout;
+    m_statusLabel = new QLabel;
+    auto *clearButton = new QPushButton("Clear");
+    statusRow->addWidget(m_statusLabel, 1);
+    statusRow->addWidget(clearButton);
+    layout->addLayout(statusRow);
+
+    m_merger.addChannel("main");
+    m_merger.setHoldNs(static_cast<qint64>(m_holdSpin->value()) * 1000000);
+    m_merger.setOutputCallback([this](const CaptureRecord &record) {
+        appendRecord(record);
+    });
+
+    connect(addButton, &QPushButton::clicked, this, [this]() {
+        addPort();
+    });
+    connect(removeButton, &QPushButton::clicked, this, [this]() {
+        removeSelectedPort();
+    });
+    connect(m_holdSpin, &QSpinBox::valueChanged, this, [this](int value) {
+        m_settings.write("timeline/holdMs", value);
+        m_merger.setHoldNs(static_cast<qint64>(value) * 1000000);
+    });
+    connect(clearButton, &QPushButton::clicked, this, [this]() {
+        // Pending chunks go too, and rows after this aren't held to the old watermark.
+        m_merger.clear();
+        m_output->clear();
+        m_lastLineTimestampNs = -1;
+        updateStatus();
+    });
+
+    m_statusTimer.setInterval(kStatusIntervalMs);
+    connect(&m_statusTimer, &QTimer::timeout, this, [this]() {
+        updateStatus();
+    });
+
+    refreshChannelList();
+    updateStatus();
+}
+
+TimelineView::~TimelineView()
+{
+    // Ports call back into the merger, so close them before it goes away.
+    for (ExtraPort &port : m_ports) {
+        port.serial->disconnectPort();
+    }
+    m_ports.clear();
+}
+
+void TimelineView::setDataFormatter(DataFormatter formatter)
+{
+    m_formatter = std::move(formatter);
+}
+
+void TimelineView::setMainChannelName(const QString &name)
+{
+    m_mainChannelName = name.isEmpty() ? QString("main") : name;
+    refreshChannelList();
+}
+
+bool TimelineView::isMerging() const
+{
+    return !m_ports.empty();
+}
+
+void TimelineView::feedMain(const QByteArray &data, qint64 timestampNs)
+{
+    if (isMerging()) {
+        m_merger.push(0, CaptureDirection::Rx, data, timestampNs);
+    }
+}
+
+void TimelineView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    updateStatus();
+    m_statusTimer.start();
+}
+
+void TimelineView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_statusTimer.stop();
+}
+
+void TimelineView::addPort()
+{
+    const QString portName = m_portCombo->currentText().trimmed();
+    if (portName.isEmpty()) {
+        return;
+    }
+
+    for (const ExtraPort &port : m_ports) {
+        if (port.serial->getConfig().portName == portName) {
+            QMessageBox::information(this, "Merged timeline", QString("%1 is already in the timeline").arg(portName));
+            return;
+        }
+    }
+
+    SerialConfig config;
+    config.portName = portName;
+    config.baudRate = m_baudCombo->currentText().toInt();
+
+    ExtraPort port;
+    port.serial = std::make_unique<SerialManager>();
+    if (!port.serial->connectPort(config)) {
+        QMessageBox::warning(this, "Merged timeline", QString("Failed to open %1").arg(portName));
+        return;
+    }
+
+    port.channel = m_merger.addChannel(QString("%1@%2").arg(portName).arg(config.baudRate));
+    if (port.channel < 0) {
+        port.serial->disconnectPort();
+        QMessageBox::warning(this, "Merged timeline", "No more channels");
+        return;
+    }
+
+    const int channel = port.channel;
+    port.serial->setReceiveCallback([this, channel](const QByteArray &data, qint64 timestampNs) {
+        m_merger.push(channel, CaptureDirection::Rx, data, timestampNs);
+    });
+
+    m_settings.write("timeline/baudRate", m_baudCombo->currentText());
+    m_ports.push_back(std::move(port));
+    refreshChannelList();
+}
+
+void TimelineView::removeSelectedPort()
+{
+    const int row = m_channelList->currentRow();
+    const auto it = std::find_if(m_ports.begin(), m_ports.end(), [row](const ExtraPort &port) {
+        return port.channel == row;
+    });
+    if (it == m_ports.end()) {
+        return;
+    }
+
+    // Channel numbers stay stable; the closed one just stops holding the others back.
+    it->serial->disconnectPort();
+    m_merger.setChannelActive(it->channel, false);
+    m_ports.erase(it);
+    if (m_ports.empty()) {
+        m_merger.flush();
+    }
+    refreshChannelList();
+}
+
+void TimelineView::refreshChannelList()
+{
+    m_channelNames = m_merger.channelNames();
+    m_channelNames[0] = m_mainChannelName;
+
+    m_channelList->clear();
+    for (int channel = 0; channel < m_channelNames.size(); ++channel) {
+        const bool open = channel == 0 || std::any_of(m_ports.begin(), m_ports.end(), [channel](const ExtraPort &port) {
+            return port.channel == channel;
+        });
+        auto *item = new QListWidgetItem(QString("%1  %2%3").arg(channel).arg(m_channelNames.at(channel), open ? "" : "  (closed)"));
+        if (!open) {
+            item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+        }
+        m_channelList->addItem(item);
+    }
+}
+
+void TimelineView::appendRecord(const CaptureRecord &record)
+{
+    const qint64 wallNs = record.timestampNs + SerialManager::wallClockOffsetNs();
+    const QString time = QString("%1%2")
+                             .arg(QDateTime::fromMSecsSinceEpoch(wallNs / 1000000).toString("HH:mm:ss.zzz"))
+                             .arg((wallNs / 1000) % 1000, 3, 10, QChar('0'));
+    const QString delta = m_lastLineTimestampNs < 0
+                              ? QString("-")
+                              : "+" + GapHistogram::formatDuration(record.timestampNs - m_lastLineTimestampNs);
+    m_lastLineTimestampNs = record.timestampNs;
+
+    m_output->appendPlainText(QString("%1 %2 [%3] RX (%4 bytes): %5")
+                                  .arg(time, delta.rightJustified(10))
+                                  .arg(m_channelNames.value(record.channel))
+                                  .arg(record.data.size())
+                                  .arg(m_formatter ? m_formatter(record.data) : QString::fromLatin1(record.data.toHex(' '))));
+}
+
+void TimelineView::updateStatus()
+{
+    m_statusLabel->setText(QString("%1 extra ports, %2 chunks merged, %3 waiting, %4 late")
+                               .arg(m_ports.size())
+                               .arg(m_merger.recordsMerged())
+                               .arg(m_merger.pendingRecords())
+                               .arg(m_merger.lateRecords()));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QTimer>
+#include <QtWidgets/QWidget>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "AppSettings.h"
+#include "SerialManager.h"
+#include "TimelineMerger.h"
+
+class QComboBox;
+class QHideEvent;
+class QLabel;
+class QListWidget;
+class QPlainTextEdit;
+class QShowEvent;
+class QSpinBox;
+
+// RX from the main port and any number of extra ports, interleaved in arrival
+// order by a LiveTimelineMerger. Channel 0 is the main window's port; extra
+// ports are opened here and only feed this view.
+class TimelineView : public QWidget
+{
+public:
+    using DataFormatter = std::function<QString(const QByteArray &data)>;
+    static constexpr int kMaxLines = 20000;
+
+    TimelineView(AppSettings &settings, QWidget *parent = nullptr);
+    ~TimelineView() override;
+
+    void setDataFormatter(DataFormatter formatter);
+    void setMainChannelName(const QString &name);
+    bool isMerging() const;
+    void feedMain(const QByteArray &data, qint64 timestampNs);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    struct ExtraPort
+    {
+        int channel = -1;
+        std::unique_ptr<SerialManager> serial;
+    };
+
+    AppSettings &m_settings;
+    LiveTimelineMerger m_merger;
+    std::vector<ExtraPort> m_ports;
+    DataFormatter m_formatter;
+    qint64 m_lastLineTimestampNs = -1;
+    QString m_mainChannelName = "main";
+    QStringList m_channelNames;
+    QComboBox *m_portCombo = nullptr;
+    QComboBox *m_baudCombo = nullptr;
+    QSpinBox *m_holdSpin = nullptr;
+    QListWidget *m_channelList = nullptr;
+    QPlainTextEdit *m_output = nullptr;
+    QLabel *m_statusLabel = nullptr;
+    QTimer m_statusTimer;
+
+    void addPort();
+    void removeSelectedPort();
+    void refreshChannelList();
+    void appendRecord(const CaptureRecord &record);
+    void updateStatus();
+};